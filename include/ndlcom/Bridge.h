@@ -20,6 +20,25 @@ extern "C" {
  */
 #define NDLCOM_BRIDGE_FLAGS_FORWARDING_ENABLED 0x01
 
+/**
+ * @brief Size of the tx scratch buffer for ndlcomBridgeSetScratchBuffers()
+ *
+ * Holds one encoded message, its compressed variant, the compressed
+ * payload and the plain frame for interfaces using
+ * NDLCOM_EXTERNAL_INTERFACE_FLAGS_FRAMED.
+ */
+#define NDLCOM_BRIDGE_TX_SCRATCH_SIZE                                          \
+    (2 * NDLCOM_MAX_ENCODED_MESSAGE_SIZE + NDLCOM_MAX_PAYLOAD_SIZE +           \
+     NDLCOM_MAX_DECODED_MESSAGE_SIZE)
+
+/**
+ * @brief One slot of the send queue, see ndlcomBridgeSetSendQueue()
+ */
+struct NDLComBridgeQueuedMessage {
+    struct NDLComHeader header;
+    uint8_t payload[NDLCOM_MAX_PAYLOAD_SIZE];
+};
+
 /**
  * @brief Encapsulate sending, receiving and routing of NDLCom messages
  *
@@ -86,6 +105,27 @@ struct NDLComBridge {
      * Current set of flags which are handled by the bridge functions/processes
      */
     uint8_t flags;
+    /**
+     * Optional memory for reading from the interfaces and for encoding, see
+     * ndlcomBridgeSetScratchBuffers(). Buffers on the stack are used if 0.
+     */
+    uint8_t *rxScratch;
+    size_t rxScratchSize;
+    uint8_t *txScratch;
+    /** set while "rxScratch" holds bytes which are being parsed */
+    uint8_t rxScratchBusy;
+    /**
+     * Optional FIFO for messages sent by handlers, see
+     * ndlcomBridgeSetSendQueue(). "sendQueueHead" is the oldest message.
+     */
+    struct NDLComBridgeQueuedMessage *sendQueue;
+    size_t sendQueueSize;
+    size_t sendQueueHead;
+    size_t sendQueueUsed;
+    /** number of messages which did not fit into the send queue */
+    size_t sendQueueDropped;
+    /** set while the handlers are called */
+    uint8_t dispatching;
 };
 
 /**
@@ -98,6 +138,56 @@ struct NDLComBridge {
  */
 void ndlcomBridgeInit(struct NDLComBridge *bridge);
 
+/**
+ * @brief Use preallocated buffers instead of the stack
+ *
+ * Normally every call to read an interface puts a buffer of
+ * NDLCOM_BRIDGE_TEMPORARY_RXBUFFER_SIZE on the stack, and every outgoing
+ * message a variable length array for the encoded message. With scratch
+ * buffers the stack usage of the bridge is small and fixed, and the same
+ * memory is reused for every message.
+ *
+ * Encoding never calls back into handlers, so the tx buffer is safe against
+ * handlers sending messages. The rx buffer is not: a handler calling
+ * ndlcomBridgeProcess() of its own bridge will read nothing.
+ *
+ * Pass 0 for a buffer to go back to the stack. The memory has to stay valid as
+ * long as it is used by the bridge.
+ *
+ * @param bridge The bridge to use
+ * @param rxBuffer memory for the bytes read from an interface at once
+ * @param rxSize size of "rxBuffer", at least 1
+ * @param txBuffer memory of NDLCOM_BRIDGE_TX_SCRATCH_SIZE bytes
+ */
+void ndlcomBridgeSetScratchBuffers(struct NDLComBridge *bridge, void *rxBuffer,
+                                   const size_t rxSize, void *txBuffer);
+
+/**
+ * @brief Queue messages sent from within handlers
+ *
+ * Without a queue, a handler calling ndlcomBridgeSendRaw() (or
+ * ndlcomNodeSend()) directly encodes the new message and calls all handlers
+ * again, nested on the same stack. With a queue the message is copied into
+ * the next free slot instead. The queued messages are processed in order once
+ * the handlers are done with the current message, before
+ * ndlcomBridgeProcess() or the outer ndlcomBridgeSendRaw() return. Messages
+ * queued by handlers of a queued message are appended and processed in the
+ * same loop.
+ *
+ * If the queue is full the message is dropped and counted in
+ * NDLComBridge::sendQueueDropped, ndlcomBridgeSendRaw() returns false then.
+ *
+ * Pass 0 to go back to direct processing, but not from within a handler.
+ *
+ * @param bridge The bridge to use
+ * @param slots memory for "count" messages, has to stay valid as long as it is
+ *              used by the bridge
+ * @param count number of slots
+ */
+void ndlcomBridgeSetSendQueue(struct NDLComBridge *bridge,
+                              struct NDLComBridgeQueuedMessage *slots,
+                              const size_t count);
+
 /**
  * @brief Sets the flags of the bridge
  *
@@ -126,14 +216,30 @@ void ndlcomBridgeSetFlags(struct NDLComBridge *bridge, const uint8_t flags);
  * will not be prepared correctly. The normal way to send messages is to the
  * ndlcomNodeSend()
  *
+ * NOTE: Called from within a handler of a bridge having a send queue, the
+ * message is only queued, see ndlcomBridgeSetSendQueue().
+ *
  * @param bridge The bridge to use
  * @param header The message header, fully valid and prepared with packet
  *               counter and length
  * @param payload Memory containing the actual payload
+ * @return false if the message was dropped because the send queue is full
+ */
+uint8_t ndlcomBridgeSendRaw(struct NDLComBridge *bridge,
+                            const struct NDLComHeader *header,
+                            const void *payload);
+
+/**
+ * @brief Write out the batches of all interfaces
+ *
+ * Only needed for interfaces with a batch buffer, see
+ * ndlcomExternalInterfaceSetBatchBuffer(). Called at the end of
+ * ndlcomBridgeProcessOnce() and ndlcomBridgeSendRaw(), so there is normally
+ * no need to call this manually.
+ *
+ * @param bridge The bridge to flush
  */
-void ndlcomBridgeSendRaw(struct NDLComBridge *bridge,
-                         const struct NDLComHeader *header,
-                         const void *payload);
+void ndlcomBridgeFlush(struct NDLComBridge *bridge);
 
 /**
  * @brief Process all data which can be read on each interface
@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <algorithm>
+#include <functional>
 #include <iostream>
 #include <memory>
 #include <regex>
@@ -14,6 +15,7 @@
 #include "ndlcom/Bridge.h"
 #include "ndlcom/ExternalInterface.h"
 #include "ndlcom/InternalHandler.hpp"
+#include "ndlcom/Metrics.hpp"
 #include "ndlcom/Payload.hpp"
 #include "ndlcom/Types.h"
 
@@ -35,13 +37,33 @@ std::vector<NDLComId> convertStringToIds(std::vector<std::string> numbers,
 // registered interface.
 void setRoutingByString(std::weak_ptr<class ndlcom::ExternalInterfaceBase> p,
                         std::string conn, std::ostream &out);
+// use the "&"-separated tail of an uri-string like "3,6,14&compress" to
+// initialize routingtable and options of already registered interface. parts
+// consisting only of numbers go to setRoutingByString(), all others are
+// "key=value" pairs passed to ExternalInterfaceBase::setOption(). values which
+// are no valid number where one is expected are reported and skipped
+void setOptionsByString(std::weak_ptr<class ndlcom::ExternalInterfaceBase> p,
+                        std::string conn, std::ostream &out);
 
 class Bridge {
   public:
     /**
      * Initializes c-datastructures and stores the ostream reference.
+     *
+     * The bridge reads and encodes using scratch buffers owned by this
+     * object, see ndlcomBridgeSetScratchBuffers(), with "rxScratchSize" bytes
+     * read from an interface at once.
+     *
+     * Messages sent by handlers wait in a queue of "sendQueueSize" messages
+     * until the current one is handled, see ndlcomBridgeSetSendQueue(). Zero,
+     * the default, processes them directly, nested into the handler. With a
+     * queue, a handler sending more than fits gets false from its send().
      */
-    Bridge(std::ostream &_out = std::cerr);
+    Bridge(std::ostream &_out = std::cerr,
+           size_t rxScratchSize = defaultRxScratchSize,
+           size_t sendQueueSize = defaultSendQueueSize);
+    static const size_t defaultRxScratchSize;
+    static const size_t defaultSendQueueSize;
     ~Bridge();
     /**
      * Deleting "copy" and "assignment" prevents some possibly weird behaviour
@@ -57,6 +79,17 @@ class Bridge {
     void printRoutingTable();
     void printStatus();
 
+    /**
+     * @brief Snapshot of all counters known to this bridge
+     *
+     * Collects the statistics of all ExternalInterfaceBase, the miss-events
+     * of all registered ndlcom::BridgeMissEvents and the known entries of the
+     * NDLComRoutingTable. Only copies values and asks the kernel for queue
+     * sizes, so it is cheap enough to be called from within the processing
+     * loop. See ndlcom::MetricsServer for exporting it.
+     */
+    struct BridgeMetrics getMetrics() const;
+
     /**
      * @brief Main entry to data processing
      *
@@ -78,16 +111,20 @@ class Bridge {
      *
      * Can be used to fully specify a message to be send by the bridge. This is
      * not the normal way of sending messages, see ndlcom::Node::send().
+     *
+     * @return false if dropped, see ndlcomBridgeSendRaw()
      */
-    void sendMessageRaw(struct ndlcom::RawPayload out);
+    bool sendMessageRaw(struct ndlcom::RawPayload out);
 
     /**
      * @brief Transmitting a raw message from the bridge
      *
      * Can be used to fully specify a message to be send by the bridge. This is
      * not the normal way of sending messages, see ndlcom::Node::send().
+     *
+     * @return false if dropped, see ndlcomBridgeSendRaw()
      */
-    void sendMessageRaw(const struct NDLComHeader *header, const void *payload);
+    bool sendMessageRaw(const struct NDLComHeader *header, const void *payload);
 
     /**
      * @brief Parse string containing "uri", create ExternalInterfaceBase 
@@ -98,20 +135,27 @@ class Bridge {
      * parsing. Knows about the following types:
      *
      * "udp://localhost:$SRCPORT:$DSTPORT (default: 34000 and 34001)
+     * "udpmc://239.255.0.1:$PORT" (default: 34002)
      * "fpga:///dev/NDLCom"
      * "serial:///dev/ttyUSB0:$BAUDRATE" (default: 921600)
      * "pipe:///tmp/testpipe"
      * "pty:///tmp/testpty"
      * "tcpclient://localhost:$PORT" (default: 2000)
+     * "tcpserver://:$PORT" (default: 2000)
+     * "unix:///run/ndlcom.sock"
      *
      * Every uri can have a trailing string specifying apriori information
      * concerning the NDLComRoutingTable for this ExternalInterface in the
-     * format "&1,2,3".
+     * format "&1,2,3". Options for the interface follow in the same way, as
+     * "&key" or "&key=value", see ExternalInterfaceBase::setOption(). For
+     * example "serial:///dev/ttyUSB0:115200&1,2,3&compress".
      *
-     * The actual regexes are implemented in the respective interface. The list
-     * of which interfaces to parse is implemented inside this function. For
-     * information about the specific behaviour of returned interface classes
-     * see their respective header.
+     * The scheme in front of "://" picks the interface type from a registry,
+     * so only the regex of this one type is ever compiled and matched. The
+     * types above are registered by default, more can be added with
+     * registerInterfaceType(). The actual regexes are implemented in the
+     * respective interface. For information about the specific behaviour of
+     * returned interface classes see their respective header.
      *
      * This function obtains ownership of the returned pointers.
      *
@@ -124,6 +168,49 @@ class Bridge {
     createInterface(std::string uri,
                     uint8_t flags = NDLCOM_EXTERNAL_INTERFACE_FLAGS_DEFAULT);
 
+    /**
+     * creates an interface for an uri with a registered scheme. returns an
+     * empty pointer if the uri does not fit.
+     */
+    typedef std::function<std::weak_ptr<class ndlcom::ExternalInterfaceBase>(
+        class ndlcom::Bridge &bridge, const std::string &uri, uint8_t flags)>
+        InterfaceFactory;
+
+    /**
+     * @brief make createInterface() know about another scheme
+     *
+     * Meant for interface types living outside of this library. The factory
+     * is called for every uri starting with "scheme://", for all bridges. An
+     * already registered scheme is replaced.
+     */
+    static void registerInterfaceType(const std::string &scheme,
+                                      InterfaceFactory factory);
+
+    /**
+     * @brief the factory for an interface class providing the usual "uri()"
+     *
+     * The class needs a ctor taking "(NDLComBridge&, std::smatch&, uint8_t)",
+     * the last match of its regex is taken as routing and options, just like
+     * for the types of this library:
+     *
+     *    ndlcom::Bridge::registerInterfaceType(
+     *        "my", ndlcom::Bridge::interfaceFactory<MyInterface>());
+     */
+    template <typename T> static InterfaceFactory interfaceFactory() {
+        return [](class ndlcom::Bridge &bridge, const std::string &uri,
+                  uint8_t flags) {
+            std::smatch match;
+            if (!std::regex_match(uri, match, T::uri())) {
+                return std::weak_ptr<class ndlcom::ExternalInterfaceBase>();
+            }
+            return ExternalInterfaceCreator<T>::createInterfaceByMatch(
+                &bridge, uri, match, flags);
+        };
+    }
+
+    /** the schemes createInterface() knows about, sorted */
+    static std::vector<std::string> getInterfaceTypes();
+
     /**
      * Recursive template-based parsing of uri into provided list of types
      *
@@ -148,14 +235,14 @@ class Bridge {
             uint8_t flags) {
             // try to match the given uri to the regex of the Head, and
             // create interface if it matched:
-            if (std::regex_match(uri, match, Head::uri)) {
+            if (std::regex_match(uri, match, Head::uri())) {
                 return ExternalInterfaceCreator<Head>::createInterfaceByMatch(
                     bridge, uri, match, flags);
             }
             // if this didn't work _and_ we have only one type left in the Tail
             // additionally try to match this type to the uri:
             if (sizeof...(Tail) == 1) {
-                if (std::regex_match(uri, match, FirstOfTail::uri)) {
+                if (std::regex_match(uri, match, FirstOfTail::uri())) {
                     return ExternalInterfaceCreator<
                         FirstOfTail>::createInterfaceByMatch(bridge, uri,
                                                              match, flags);
@@ -187,9 +274,9 @@ class Bridge {
             // reuse the bridges factory
             std::weak_ptr<class ExternalInterfaceBase> retval =
                 bridge->createExternalInterface<T>(match, flags);
-            // routingtable intitialization: we just assume that each uri has
-            // the routing-table stuff at the end, last match...
-            setRoutingByString(retval, match[match.size() - 1].str(),
+            // routingtable and option intitialization: we just assume that
+            // each uri has this stuff at the end, last match...
+            setOptionsByString(retval, match[match.size() - 1].str(),
                                std::cerr);
             // Note that the bridge is the exclusive owner of the created
             // interface, we can only return only a weak pointer!
@@ -200,7 +287,7 @@ class Bridge {
     /**
      * tries to match one of the given _types_ onto the uri-string given
      *
-     * Will use a "Args...::uri" regex, so make sure the given interface
+     * Will use a "Args...::uri()" regex, so make sure the given interface
      * classes provide this. Then tries every to match+create a new
      * ExternalInterface for every type named in the variadic template.
      */
@@ -335,6 +422,10 @@ class Bridge {
     /**
      * @brief obtain the list of currently active interfaces
      *
+     * Like getMetrics(), getInterfaceByName() and getInterfaceByOrigin(),
+     * this includes the children of interfaces, like the clients accepted by
+     * a server, see ExternalInterfaceBase::getChildren().
+     *
      * NOTE: This function os _not_ here to stay, just provided for backward
      * compatibility... Using strings for idendentity checks is not safe...
      */
@@ -346,6 +437,10 @@ class Bridge {
     size_t getInterfaceCount() const;
 
   private:
+    /** the interfaces created here, each followed by its children */
+    std::vector<std::shared_ptr<class ndlcom::ExternalInterfaceBase>>
+    getAllInterfaces() const;
+
     // these datastructures are needed to be able to cleanup the created
     // classes/structs in dtor, but not earlier.
     std::vector<std::shared_ptr<class ndlcom::ExternalInterfaceBase>>
@@ -362,6 +457,11 @@ class Bridge {
      */
     struct NDLComBridge bridge;
 
+    /** kept out of the stack of the processing thread */
+    std::vector<uint8_t> rxScratch;
+    std::vector<uint8_t> txScratch;
+    std::vector<struct NDLComBridgeQueuedMessage> sendQueue;
+
   protected:
     std::ostream &out;
 };
@@ -1,10 +1,12 @@
 #ifndef NDLCOM_BRIDGE_HANDLER_HPP
 #define NDLCOM_BRIDGE_HANDLER_HPP
 
-#include <bitset>
+#include <stdint.h>
 #include <iostream>
+#include <vector>
 
 #include "ndlcom/InternalHandler.hpp"
+#include "ndlcom/Metrics.hpp"
 #include "ndlcom/Types.h"
 
 namespace ndlcom {
@@ -24,6 +26,17 @@ class BridgePrintAll final : public BridgeHandler {
  *
  * this class hooks looks at every received pacakge and checks the packet
  * counter for a miss-event; prints a message but never sends messages itself.
+ *
+ * The state is only kept for sender/receiver pairs which where actually
+ * observed, in a small open-addressing hash table which grows on demand. So
+ * the per-packet lookup stays within a few cache lines and status output is
+ * proportional to the number of active pairs.
+ *
+ * Additionally to the total number of miss events, loss and reorder
+ * statistics are gathered in consecutive windows of "windowSize" packets per
+ * pair. A positive difference between observed and expected packet counter is
+ * taken as lost packets, a negative one as a late (reordered or duplicated)
+ * packet.
  */
 class BridgeMissEvents : public BridgeHandler {
   public:
@@ -34,39 +47,67 @@ class BridgeMissEvents : public BridgeHandler {
                         const struct NDLComExternalInterface *origin) override;
     /** resets the counter of observed miss events */
     void resetMissEvents();
+    /** all sender/receiver pairs with at least one observed miss event */
+    std::vector<struct MissEventMetrics> getMissEvents() const;
     /** prints its own name and the information on observed missevents */
     void printStatus(const std::string prefix) const final;
 
+    /**
+     * number of packets per pair after which the loss and reorder rates are
+     * updated. has to be larger than zero.
+     */
+    void setWindowSize(uint16_t packets);
+    uint16_t getWindowSize() const;
+    static const uint16_t defaultWindowSize;
+
   protected:
     /**
-     * consult and update the "alreadySeen" bitset, possibly count up
-     * numberOfPacketMissEvents.
+     * consult and update the entry for this pair, possibly count up
+     * its number of miss events.
      *
      * returns diff between expected and observed packet counter.
      */
     int isMiss(const struct NDLComHeader *);
   private:
     /**
-     * keep this matrix to count miss-events between all possible combinations of
-     * known deviceIds
-     */
-    unsigned int numberOfPacketMissEvents[NDLCOM_MAX_NUMBER_OF_DEVICES]
-                                         [NDLCOM_MAX_NUMBER_OF_DEVICES];
-    /**
-     * remembers the expected PacketCounter for each deviceId, based on the
-     * last-seen counter incremented by 1.
+     * Everything we know about one sender/receiver pair. Kept small, so that
+     * the hot entries of the table share cache lines.
      */
-    NDLComCounter expectedNextPacketCounter[NDLCOM_MAX_NUMBER_OF_DEVICES]
-                                           [NDLCOM_MAX_NUMBER_OF_DEVICES];
+    struct PairState {
+        /** "mSenderId << 8 | mReceiverId" */
+        uint16_t key;
+        /** false for empty slots of the table */
+        bool used;
+        /**
+         * remembers the expected PacketCounter, based on the last-seen counter
+         * incremented by 1.
+         */
+        NDLComCounter expectedNextPacketCounter;
+        /** total number of miss events, cleared by resetMissEvents() */
+        uint32_t numberOfPacketMissEvents;
+        /** counters of the currently running window */
+        uint32_t windowLost;
+        uint16_t windowPackets;
+        uint16_t windowReordered;
+        /** rates of the last completed window, in "per 65535" */
+        uint16_t lossRate;
+        uint16_t reorderRate;
+    };
     /**
-     * On the calculation of the size of the bitset: for each combination of
-     * sender+receiver we have to remember if we saw it before. this is
-     * essentially a 16bit number of boolean flags. something like this one,
-     * with 65536 flags. we need less, as we ignore BROADCASTS, but this is
-     * well... yes?
+     * lookup of the entry for the given pair, creates it if needed. "created"
+     * tells if this pair was seen for the first time.
      */
-    std::bitset<NDLCOM_MAX_NUMBER_OF_DEVICES * NDLCOM_MAX_NUMBER_OF_DEVICES>
-        alreadySeen;
+    struct PairState &lookup(uint16_t key, bool &created);
+    /** double the size of the table and reinsert all entries */
+    void grow();
+    /** the slot where "key" is, or where it would have to be inserted */
+    size_t findSlot(const std::vector<struct PairState> &slots,
+                    uint16_t key) const;
+
+    /** size is always a power of two, and at most half of it is used */
+    std::vector<struct PairState> table;
+    size_t usedSlots;
+    uint16_t windowSize;
 };
 
 /**
@@ -0,0 +1,66 @@
+#ifndef NDLCOM_CANFRAMING_HPP
+#define NDLCOM_CANFRAMING_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <linux/can.h>
+#include <vector>
+
+namespace ndlcom {
+
+/**
+ * @brief Splitting escaped messages into can frames, and back again
+ *
+ * The first data byte of every can frame is a control byte: the highest bit
+ * marks a frame starting with the beginning of a message, the lower seven
+ * bits count the frames. The rest carries the escaped bytes. Every message
+ * starts a new can frame, so a receiver noticing a gap in the count skips to
+ * the next message, nothing of the broken one ends up glued to another one
+ * in the parser.
+ *
+ * Above eight bytes can-fd knows only some lengths. The last frame of a
+ * message is filled up to the next one with start/stop flags, which the
+ * parser takes as empty messages between two real ones.
+ *
+ * Without "sequenced" the frames carry only the escaped bytes, like older
+ * peers expect them. Nothing is padded then, the frames are cut to the
+ * valid lengths instead.
+ */
+class CanFraming {
+  public:
+    /** @param maxDataLength CAN_MAX_DLEN or CANFD_MAX_DLEN */
+    explicit CanFraming(size_t maxDataLength);
+
+    /** appends the frames for one escaped message to "frames" */
+    void pack(const void *buf, size_t count, canid_t canId,
+              std::vector<struct canfd_frame> &frames);
+    /**
+     * copies the escaped bytes of "frame" to "buf", which needs room for
+     * "maxDataLength" bytes
+     *
+     * @return number of bytes, 0 if the frame was skipped after a gap
+     */
+    size_t unpack(const struct canfd_frame &frame, void *buf);
+
+    /** the shortest length of a can-fd frame with room for "count" bytes */
+    static uint8_t validLength(size_t count);
+
+    static const uint8_t firstFlag;
+    static const uint8_t sequenceMask;
+
+    size_t maxDataLength;
+    bool sequenced;
+    /** frames missing in the count */
+    unsigned long framesLost;
+    /** frames thrown away while waiting for the start of a message */
+    unsigned long framesSkipped;
+
+  private:
+    uint8_t txSequence;
+    uint8_t rxSequence;
+    bool synchronized;
+};
+
+} // namespace ndlcom
+
+#endif /*NDLCOM_CANFRAMING_HPP*/
@@ -0,0 +1,122 @@
+/**
+ * @file include/ndlcom/Compression.h
+ * @brief Optional compression of payloads on slow links
+ *
+ * Payloads are compressed by the NDLComBridge for every NDLComExternalInterface
+ * with the flag NDLCOM_EXTERNAL_INTERFACE_FLAGS_COMPRESS, and decompressed
+ * again when received from such an interface. The header of the packet is
+ * not touched, only "mDataLen" changes.
+ *
+ * A compressed payload is flagged by its first byte, followed by the method
+ * used:
+ *
+ *     [NDLCOM_COMPRESSION_MARKER][method] data...
+ *
+ * Legacy receivers see an unknown first payload byte and ignore the packet,
+ * as they would do for any other unknown representation.
+ *
+ * Two codecs tuned for small payloads are tried, the smaller result is used:
+ *
+ * - RLE: PackBits-style run length encoding. Good for zeros and padding.
+ * - DELTA_RLE: the difference to the previous byte, then RLE. Good for slowly
+ *   changing values and counters.
+ *
+ * If compressing does not make the payload smaller it is sent unchanged.
+ * Payloads which happen to start with NDLCOM_COMPRESSION_MARKER are sent with
+ * the STORED method to keep them apart from compressed ones. This costs two
+ * bytes, and is not possible for payloads longer than
+ * NDLCOM_MAX_PAYLOAD_SIZE-2 which do not compress either. The bridge does not
+ * send those on compressed interfaces at all, see
+ * ndlcomExternalInterfaceGetPacketsRefused(), so that every payload starting
+ * with the marker received there is a compressed one. Choose a marker which
+ * is not used as first payload byte in your system.
+ */
+#ifndef NDLCOM_COMPRESSION_H
+#define NDLCOM_COMPRESSION_H
+
+#include "ndlcom/Types.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/**
+ * First payload byte of compressed payloads.
+ */
+#ifndef NDLCOM_COMPRESSION_MARKER
+#define NDLCOM_COMPRESSION_MARKER 0xf5
+#endif
+
+/** the payload is copied unchanged after the two header bytes */
+#define NDLCOM_COMPRESSION_METHOD_STORED 0x00
+/** PackBits run length encoding */
+#define NDLCOM_COMPRESSION_METHOD_RLE 0x01
+/** bytewise difference to the previous byte, then PackBits */
+#define NDLCOM_COMPRESSION_METHOD_DELTA_RLE 0x02
+
+/** number of bytes in front of the compressed data */
+#define NDLCOM_COMPRESSION_HEADER_SIZE 2
+
+/**
+ * @brief Try to compress a payload
+ *
+ * @param dst Buffer for the compressed payload, including the marker.
+ *            NDLCOM_MAX_PAYLOAD_SIZE bytes are always enough.
+ * @param dstSize Size of the "dst" buffer
+ * @param src The payload to compress
+ * @param srcSize Number of bytes in "src"
+ * @return Number of bytes written to "dst". Zero if the payload is to be sent
+ *         unchanged, or, if it starts with NDLCOM_COMPRESSION_MARKER and
+ *         "dstSize" is NDLCOM_MAX_PAYLOAD_SIZE, that it cannot be sent on a
+ *         compressed link.
+ */
+size_t ndlcomCompressPayload(void *dst, const size_t dstSize, const void *src,
+                             const size_t srcSize);
+
+/**
+ * @brief Restore a payload compressed by ndlcomCompressPayload()
+ *
+ * @param dst Buffer for the original payload. NDLCOM_MAX_PAYLOAD_SIZE bytes
+ *            are always enough.
+ * @param dstSize Size of the "dst" buffer
+ * @param src The received payload
+ * @param srcSize Number of bytes in "src"
+ * @return Number of bytes written to "dst". Zero if "src" is not a valid
+ *         compressed payload, it is to be used unchanged.
+ */
+size_t ndlcomDecompressPayload(void *dst, const size_t dstSize,
+                               const void *src, const size_t srcSize);
+
+/**
+ * @brief The PackBits run length encoding used by the RLE methods
+ *
+ * Exposed for other users of the same encoding, like the delta frames of
+ * ndlcom::NodeHandlerDelta. No header is added.
+ *
+ * @param dst Buffer for the encoded data
+ * @param dstSize Size of the "dst" buffer
+ * @param src Data to encode
+ * @param srcSize Number of bytes in "src"
+ * @return Number of bytes written to "dst". Zero if more than "dstSize"
+ *         bytes would be needed.
+ */
+size_t ndlcomRunLengthEncode(void *dst, const size_t dstSize, const void *src,
+                             const size_t srcSize);
+
+/**
+ * @brief Reverse of ndlcomRunLengthEncode()
+ *
+ * @return Number of bytes written to "dst". Zero if "src" is malformed or
+ *         would not fit into "dstSize" bytes.
+ */
+size_t ndlcomRunLengthDecode(void *dst, const size_t dstSize, const void *src,
+                             const size_t srcSize);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /*NDLCOM_COMPRESSION_H*/
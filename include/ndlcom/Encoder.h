@@ -24,9 +24,9 @@ extern "C" {
  *
  *    (2 + 2 * (sizeof(NDLComHeader) + pHeader->mDataLen + sizeof(NDLComCrc)))
  *
- * NOTE: error-passing of a too-small buffer is a bit broken. this function
- * will just return 0 or silently return a half-encoded message if the output
- * buffer is deemed too small.
+ * NOTE: the check of the buffer size assumes the worst case for each section
+ * on its own. if one of them is deemed too small nothing valid is written and
+ * 0 is returned, even if the actual escaped message would have fitted.
  *
  * @param outputBuffer Data will be written into this buffer.
  * @param outputBufferSize Size of the buffer.
@@ -74,6 +74,27 @@ size_t ndlcomEncodeVar(void *outputBuffer, const size_t outputBufferSize,
                        const struct NDLComHeader *header,
                        size_t additionalSections, ...);
 
+/**
+ * @brief Encoding a message for transports which keep message boundaries
+ *
+ * Only the header, the payload and -- if "withCrc" is set -- the crc as
+ * computed by ndlcomEncode(). There are no start/stop flags and nothing is
+ * escaped, so a message needs at most NDLCOM_MAX_DECODED_MESSAGE_SIZE bytes.
+ * The length of the frame follows from the "mDataLen" of the header. See
+ * NDLCOM_EXTERNAL_INTERFACE_FLAGS_FRAMED and ndlcomParserReceiveFramed().
+ *
+ * @param outputBuffer Data will be written into this buffer.
+ * @param outputBufferSize Size of the buffer.
+ * @param header Pointer to a PacketHeader struct.
+ * @param data Pointer to the payload, "mDataLen" bytes.
+ * @param withCrc append the crc
+ *
+ * @return Number of bytes used in the output buffer. 0 on too-small-buffer.
+ */
+size_t ndlcomEncodeFramed(void *outputBuffer, const size_t outputBufferSize,
+                          const struct NDLComHeader *header, const void *data,
+                          const int withCrc);
+
 #if defined(__cplusplus)
 }
 #endif
@@ -26,6 +26,38 @@ extern "C" {
  * Messages received on interface wont be used to update NDLComRoutingTable
  */
 #define NDLCOM_EXTERNAL_INTERFACE_FLAGS_DEBUG_MIRROR 0x01
+/**
+ * @brief Compress payloads on this interface
+ *
+ * Intended for slow links like serial lines. The bridge compresses payloads
+ * before writing them to this interface and decompresses payloads received
+ * from it, see "ndlcom/Compression.h". The other side of the link has to use
+ * the same flag.
+ */
+#define NDLCOM_EXTERNAL_INTERFACE_FLAGS_COMPRESS 0x02
+
+/**
+ * @brief Write and read plain frames on this interface
+ *
+ * For transports which keep message boundaries or never lose bytes, like
+ * datagrams, tcp or unix sockets between two hosts. Messages are written as
+ * header and payload, see ndlcomEncodeFramed(), one message per frame and
+ * without escaping or crc. Received bytes are parsed with
+ * ndlcomParserReceiveFramed(). The other side of the link has to use the
+ * same flags.
+ *
+ * Payloads are not compressed on these interfaces, the compress flag is
+ * ignored.
+ */
+#define NDLCOM_EXTERNAL_INTERFACE_FLAGS_FRAMED 0x04
+
+/**
+ * @brief Append the crc to plain frames
+ *
+ * Only used together with NDLCOM_EXTERNAL_INTERFACE_FLAGS_FRAMED, for
+ * transports without a checksum of their own.
+ */
+#define NDLCOM_EXTERNAL_INTERFACE_FLAGS_FRAMED_CRC 0x08
 
 /**
  * @brief Callback to "write" escaped data from the bridge to somewhere.
@@ -56,6 +88,60 @@ typedef size_t (*NDLComExternalInterfaceReadEscapedBytes)(void *context,
                                                           void *buf,
                                                           const size_t count);
 
+/**
+ * @brief One encoded message, as passed to a vectored write callback
+ *
+ * Member order and types follow POSIX "struct iovec", but this header does
+ * not depend on it.
+ */
+struct NDLComExternalInterfaceFrame {
+    /** first byte of the escaped message, including its flags */
+    const void *data;
+    /** number of bytes */
+    size_t length;
+};
+
+/**
+ * @brief Callback to "write" a batch of escaped messages at once
+ *
+ * Same rules as NDLComExternalInterfaceWriteEscapedBytes: never block. An
+ * interface may pass all frames to the hardware in one go, like "writev()" or
+ * "sendmmsg()" do. Message boundaries are preserved by the frames, which
+ * matters for datagram based interfaces.
+ *
+ * @param context Will contain the pointer which was passed during init
+ * @param frames Array of messages to be written, in this order
+ * @param count Number of entries in "frames"
+ * @return Number of bytes accepted, summed over all frames. Less than the
+ *         total means bytes where dropped.
+ */
+typedef size_t (*NDLComExternalInterfaceWriteEscapedFrames)(
+    void *context, const struct NDLComExternalInterfaceFrame *frames,
+    const size_t count);
+
+/**
+ * @brief Callback to get a file descriptor to wait on for incoming data
+ *
+ * Allows an application to "poll()" all interfaces of a bridge instead of
+ * calling "ndlcomBridgeProcess()" in a busy loop.
+ *
+ * @param context Will contain the pointer which was passed during init
+ * @return a file descriptor, or -1 if there is none
+ */
+typedef int (*NDLComExternalInterfacePollFd)(void *context);
+
+/**
+ * @brief The callbacks of an ExternalInterface, for ndlcomExternalInterfaceInitOps()
+ */
+struct NDLComExternalInterfaceOps {
+    /** mandatory */
+    NDLComExternalInterfaceReadEscapedBytes read;
+    /** mandatory */
+    NDLComExternalInterfaceWriteEscapedFrames writeFrames;
+    /** optional, may be 0 */
+    NDLComExternalInterfacePollFd pollFd;
+};
+
 /**
  * @brief Datastructure to describe an ExternalInterface
  *
@@ -81,10 +167,31 @@ struct NDLComExternalInterface {
     uint8_t flags;
     /** every interface needs its parser */
     struct NDLComParser parser;
+    /** number of packets successfully decoded from this interface */
+    uint32_t packetsReceived;
+    /** number of encoded packets handed to the "write" callback */
+    uint32_t packetsTransmitted;
+    /** number of packets which cannot be sent on this interface */
+    uint32_t packetsRefused;
     /** callback to read data from the interface */
     NDLComExternalInterfaceReadEscapedBytes read;
-    /** callback to write data into the interface */
+    /** callback to write data into the interface, 0 if "writeFrames" is used */
     NDLComExternalInterfaceWriteEscapedBytes write;
+    /** vectored variant of "write", 0 if "write" is used */
+    NDLComExternalInterfaceWriteEscapedFrames writeFrames;
+    /** optional callback, may be 0 */
+    NDLComExternalInterfacePollFd pollFd;
+    /**
+     * Optional batching of outgoing messages, see
+     * ndlcomExternalInterfaceSetBatchBuffer(). Memory is provided by the
+     * user, "batchFramesMax" is 0 if disabled.
+     */
+    struct NDLComExternalInterfaceFrame *batchFrames;
+    size_t batchFramesMax;
+    size_t batchFramesUsed;
+    uint8_t *batchBuffer;
+    size_t batchBufferSize;
+    size_t batchBufferUsed;
     /** this struct is stored in a linked list as part "NDLComBridge" */
     struct list_head list;
 };
@@ -105,6 +212,86 @@ ndlcomExternalInterfaceInit(struct NDLComExternalInterface *externalInterface,
                             NDLComExternalInterfaceReadEscapedBytes read,
                             const uint8_t flags, void *context);
 
+/**
+ * @brief Initialization of ExternalInterface using the vectored callbacks
+ *
+ * Like ndlcomExternalInterfaceInit(), but with a write callback which gets
+ * whole batches of messages and reports the number of accepted bytes. The
+ * "ops" are copied.
+ *
+ * @param externalInterface pointer to the struct to initialize
+ * @param ops the callbacks to use
+ * @param flags flags to be used during initialization
+ * @param context Additional pointer to store "private" information to be
+ *                passed during calling the callback
+ */
+void ndlcomExternalInterfaceInitOps(
+    struct NDLComExternalInterface *externalInterface,
+    const struct NDLComExternalInterfaceOps *ops, const uint8_t flags,
+    void *context);
+
+/**
+ * @brief Write frames using whichever write callback the interface has
+ *
+ * Interfaces initialized with the flat "write" callback get one call per
+ * frame, which is assumed to accept everything.
+ *
+ * Bypasses the batch, see ndlcomExternalInterfaceFlush() to keep ordering.
+ *
+ * @return Number of bytes accepted by the interface
+ */
+size_t ndlcomExternalInterfaceWriteFrames(
+    struct NDLComExternalInterface *externalInterface,
+    const struct NDLComExternalInterfaceFrame *frames, const size_t count);
+
+/**
+ * @brief Returns the file descriptor to wait on, or -1 if there is none
+ */
+int ndlcomExternalInterfaceGetPollFd(
+    const struct NDLComExternalInterface *externalInterface);
+
+/**
+ * @brief Collect outgoing messages and write them as a batch
+ *
+ * Messages written by the NDLComBridge are copied into "buffer" and handed to
+ * the write callback together, once the batch is full or when the bridge is
+ * done with processing, see ndlcomBridgeFlush(). Messages larger than the
+ * buffer are written on their own, in order.
+ *
+ * Pending messages are flushed before the buffers are changed. Pass 0 for
+ * "maxFrames" to disable batching again. The memory has to stay valid as long
+ * as it is used by the interface.
+ *
+ * @param externalInterface the interface in question
+ * @param frames storage for "maxFrames" descriptors
+ * @param maxFrames maximum number of messages in one batch
+ * @param buffer storage for the encoded messages of one batch
+ * @param size size of "buffer", should hold at least one
+ *             NDLCOM_MAX_ENCODED_MESSAGE_SIZE
+ */
+void ndlcomExternalInterfaceSetBatchBuffer(
+    struct NDLComExternalInterface *externalInterface,
+    struct NDLComExternalInterfaceFrame *frames, const size_t maxFrames,
+    void *buffer, const size_t size);
+
+/**
+ * @brief Append one encoded message to the batch, or write it directly
+ *
+ * Used by the NDLComBridge. Without a batch buffer the message is written
+ * right away.
+ */
+void ndlcomExternalInterfaceQueue(
+    struct NDLComExternalInterface *externalInterface, const void *buf,
+    const size_t count);
+
+/**
+ * @brief Write all messages pending in the batch
+ *
+ * @return Number of bytes accepted by the interface
+ */
+size_t ndlcomExternalInterfaceFlush(
+    struct NDLComExternalInterface *externalInterface);
+
 /**
  * @brief Returns the number of mismatched CRC events
  *
@@ -118,6 +305,40 @@ ndlcomExternalInterfaceInit(struct NDLComExternalInterface *externalInterface,
 uint32_t ndlcomExternalInterfaceGetCrcFails(
     const struct NDLComExternalInterface *externalInterface);
 
+/**
+ * @brief Returns the number of packets decoded from this interface
+ *
+ * Counted by the NDLComBridge after each successfully parsed packet, prior to
+ * routing and handling it.
+ */
+uint32_t ndlcomExternalInterfaceGetPacketsReceived(
+    const struct NDLComExternalInterface *externalInterface);
+
+/**
+ * @brief Returns the number of packets written to this interface
+ *
+ * Counted by the NDLComBridge for every encoded packet which is passed into
+ * NDLComExternalInterface::write, be it routed, broadcasted or mirrored.
+ */
+uint32_t ndlcomExternalInterfaceGetPacketsTransmitted(
+    const struct NDLComExternalInterface *externalInterface);
+
+/**
+ * @brief Returns the number of packets not written to this interface
+ *
+ * Counted by the NDLComBridge for packets it does not send on this interface
+ * at all, like payloads which cannot be sent with
+ * NDLCOM_EXTERNAL_INTERFACE_FLAGS_COMPRESS, see "ndlcom/Compression.h".
+ */
+uint32_t ndlcomExternalInterfaceGetPacketsRefused(
+    const struct NDLComExternalInterface *externalInterface);
+
+/**
+ * @brief Reset the packet counters of this interface to zero
+ */
+void ndlcomExternalInterfaceResetPacketCounters(
+    struct NDLComExternalInterface *externalInterface);
+
 /**
  * @brief Tell the NDLComBridge that deviceId is reachable on this interface
  *
@@ -133,6 +354,9 @@ void ndlcomExternalInterfaceSetRoutingForDeviceId(
  * @brief Influence flags defined for the interface at runtime.
  *
  * Will set the given flag pattern. Be carefull not to overwrite anything.
+ * Switching between escaped messages and plain frames drops a message which
+ * is received halfway. Only for an interface passed through
+ * ndlcomExternalInterfaceInit() already, which sets the first flags itself.
  *
  * @param externalInterface The pointer to work on
  * @param flags The pattern to set.
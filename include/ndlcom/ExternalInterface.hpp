@@ -6,14 +6,24 @@
 // for "socklen_t" and "struct sockaddr_in":
 #include <unistd.h>
 #include <netinet/in.h>
+// for "struct ucred"
+#include <sys/socket.h>
+// for "struct epoll_event"
+#include <sys/epoll.h>
 // detecting closed interfaces
 #include <poll.h>
 #include <stdint.h>
 #include <stdio.h>
 // for "speed_t"
 #include <asm-generic/termbits.h>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <regex>
 #include <string>
+#include <vector>
 
 // ouh...
 #include <linux/if.h>
@@ -21,17 +31,22 @@
 #include <linux/can.h>
 #include <linux/can/raw.h>
 
+#include "ndlcom/CanFraming.hpp"
 #include "ndlcom/ExternalInterface.h"
 #include "ndlcom/ExternalInterfaceBase.hpp"
+#include "ndlcom/IoUring.hpp"
 
 namespace ndlcom {
 
 /**
- * @brief base-class to handle interfaces which use "FILE" internally
+ * @brief base-class to handle interfaces which are a file descriptor
  *
  * this class just implements to read/write functions around the calls to
- * "fread()" and "fwrite()", as this is always (tm) the same. adds
- * error-checking and looping-until-all-bytes-are-written.
+ * "read()" and "writev()" on a non-blocking descriptor, as this is always (tm)
+ * the same. adds error-checking and looping-until-all-bytes-are-written.
+ *
+ * there is no stdio buffering in between: a read is one syscall, a batch of
+ * frames is written with one syscall.
  */
 class ExternalInterfaceStream : public ndlcom::ExternalInterfaceBase {
   public:
@@ -41,21 +56,50 @@ class ExternalInterfaceStream : public ndlcom::ExternalInterfaceBase {
     ~ExternalInterfaceStream() override;
 
   protected:
-    FILE *fd_read;
-    FILE *fd_write;
+    /**
+     * set by the deriving classes, which also close them. has to be
+     * non-blocking. may be the same descriptor.
+     */
+    int fd_read;
+    int fd_write;
 
     size_t readEscapedBytes(void *buf, size_t count) override;
-    void writeEscapedBytes(const void *buf, size_t count) override;
+    size_t writeEscapedBytes(const void *buf, size_t count) override;
+    /** all frames in one "writev()" */
+    size_t writeEscapedFrames(const struct NDLComExternalInterfaceFrame *frames,
+                              size_t count) override;
+
+    /** reads and writes "fd_read", if enabled */
+    std::unique_ptr<IoUring> uring;
+
+  public:
+    size_t getRxQueueDepth() const override;
+    size_t getTxQueueDepth() const override;
+    int getPollFd() const override;
+    bool setIoUring(bool enable) override;
+
+  protected:
+    /**
+     * used to detect when the underlying device vanishes. like usb-ports.
+     * only called when "read()" reports the end of the file, a non-blocking
+     * descriptor without data reports EAGAIN instead.
+     */
+    void checkHangup();
 
   private:
-    /* used to detect when the underlying device vanishes. like usb-ports */
     struct pollfd ufd;
 };
 
 /**
  * reading and writing on a serial port with the given baudrate
  *
- * straightforward.
+ * straightforward. any baudrate can be given, not only the standard ones.
+ *
+ * usb-serial adapters collect bytes for some milliseconds before sending
+ * them to the host, see setLatencyTimer() and setLowLatency() to get rid of
+ * that. the time from writing something until the next bytes arrive is
+ * measured and shown in printStatus(), as the round-trip time of a request
+ * and its answer.
  */
 class ExternalInterfaceSerial : public ExternalInterfaceStream {
   public:
@@ -66,7 +110,7 @@ class ExternalInterfaceSerial : public ExternalInterfaceStream {
     ~ExternalInterfaceSerial() override;
 
     // regex for "uri" string, optional routing table at the end
-    static const std::regex uri;
+    static const std::regex &uri();
     static const speed_t defaultBaudrate;
     // ctor using provided match-argument of the given uri. we pass the
     // match-object so that we do not have a ctor accepting just a string --
@@ -75,13 +119,64 @@ class ExternalInterfaceSerial : public ExternalInterfaceStream {
         struct NDLComBridge &_bridge, std::smatch match,
         uint8_t flags = NDLCOM_EXTERNAL_INTERFACE_FLAGS_DEFAULT);
 
+    /**
+     * Additional keys:
+     *
+     * - "lowlatency": see setLowLatency(). A value of "0" disables it.
+     * - "latency": latency timer in ms, see setLatencyTimer().
+     * - "vmin", "vtime": see setReadThresholds().
+     * - "flow": "none", "rtscts" or "xonxoff", see setFlowControl().
+     */
+    bool setOption(const std::string &key, const std::string &value) override;
+
+    /**
+     * Set "ASYNC_LOW_LATENCY" of the serial driver, which hands received
+     * bytes to the reader at once. Prints a note if the driver does not know
+     * about it.
+     */
+    void setLowLatency(bool enable);
+    /**
+     * Set the latency timer of an usb-serial adapter like the FTDI ones, in
+     * milliseconds. The default of 16 delays every answer. Written through
+     * sysfs, prints a note if there is no such file for this device.
+     */
+    void setLatencyTimer(unsigned int milliseconds);
+    /**
+     * Set "VMIN" and "VTIME" of the terminal, only used for blocking reads
+     * like the ones done with io_uring. Negative values keep the current
+     * setting.
+     */
+    void setReadThresholds(int vmin, int vtime);
+    /** "none", "rtscts" or "xonxoff" */
+    void setFlowControl(const std::string &mode);
+
+    /** number of measured round-trips, and the times of them */
+    unsigned long roundTrips;
+    std::chrono::microseconds roundTripMin;
+    std::chrono::microseconds roundTripMax;
+    std::chrono::microseconds roundTripSum;
+
+    /** adds the round-trip times to the output of the base-class */
+    void printStatus(const std::string prefix) const override;
+
+  protected:
+    void noteIncomingBytes(const void *buf, size_t count) override;
+    void noteOutgoingBytes(const void *buf, size_t count) override;
+
   private:
+    struct termios2 getTermios() const;
+    void setTermios(const struct termios2 &tio);
+
     /**
      * this class tries to be a good citizen: it restores the terminal setting
      * which where there before it changed them
      */
     struct termios2 oldtio;
     int fd;
+    const std::string deviceName;
+    /** written something, and nothing was read since then */
+    bool awaitingReply;
+    std::chrono::steady_clock::time_point lastWrite;
 };
 
 /**
@@ -97,7 +192,7 @@ class ExternalInterfaceFpga : public ExternalInterfaceStream {
         uint8_t flags = NDLCOM_EXTERNAL_INTERFACE_FLAGS_DEFAULT);
     ~ExternalInterfaceFpga() override;
 
-    static const std::regex uri;
+    static const std::regex &uri();
     ExternalInterfaceFpga(
         struct NDLComBridge &_bridge, std::smatch match,
         uint8_t flags = NDLCOM_EXTERNAL_INTERFACE_FLAGS_DEFAULT);
@@ -124,21 +219,83 @@ class ExternalInterfaceUdp : public ndlcom::ExternalInterfaceBase {
     ~ExternalInterfaceUdp() override;
 
     size_t readEscapedBytes(void *buf, size_t count) override;
-    void writeEscapedBytes(const void *buf, size_t count) override;
+    size_t writeEscapedBytes(const void *buf, size_t count) override;
+    /** one datagram per frame, all passed to "sendmmsg()" at once */
+    size_t writeEscapedFrames(const struct NDLComExternalInterfaceFrame *frames,
+                              size_t count) override;
+
+    size_t getRxQueueDepth() const override;
+    size_t getTxQueueDepth() const override;
+    /**
+     * the socket, or io_uring. once "aggregate" was set an epoll set which
+     * also becomes readable when the timer of the aggregation expired
+     */
+    int getPollFd() const override;
+    bool setIoUring(bool enable) override;
 
-    static const std::regex uri;
+    static const std::regex &uri();
     static const unsigned int defaultInPort;
     static const unsigned int defaultOutPort;
     static const unsigned int defaultSocketPriority;
+    static const size_t defaultAggregateSize;
+    static const std::chrono::microseconds defaultAggregateDelay;
     
     ExternalInterfaceUdp(
         struct NDLComBridge &_bridge, std::smatch match,
         uint8_t flags = NDLCOM_EXTERNAL_INTERFACE_FLAGS_DEFAULT);
 
+    /**
+     * Additional keys:
+     *
+     * - "aggregate": packs frames into datagrams of up to N bytes, like
+     *   "aggregate=1400,200us". a datagram is sent when the next frame does
+     *   not fit anymore, or when its first frame waited for the given time
+     *   ("us" or "ms", default 200us). the other side parses them like any
+     *   other stream of escaped frames. ignored for framed interfaces, which
+     *   need one message per datagram. the timer is looked at while reading,
+     *   getPollFd() wakes up the bridge for it. does not go together with
+     *   "thread".
+     */
+    bool setOption(const std::string &key, const std::string &value) override;
+
+    /** adds the number of datagrams when aggregating */
+    void printStatus(const std::string prefix) const override;
+
+    /** bytes per datagram when aggregating, 0 if every frame is sent alone */
+    size_t aggregateSize;
+    std::chrono::microseconds aggregateDelay;
+    unsigned long datagramsTransmitted;
+
   private:
+    /**
+     * replies go to where the last datagram came from. called by the reader
+     * thread if there is one.
+     */
+    void learnSender(const struct sockaddr_in &addr_recv);
+    /** a copy of "addr_out", taken by every write */
+    struct sockaddr_in getDestination() const;
+    /** false for a datagram which is not exactly one plain frame */
+    bool isWholeFrame(const void *buf, size_t count) const;
+    /** sends what was aggregated so far, if anything */
+    void sendAggregate();
+    /** creates "timerFd" and "epollFd" */
+    void createAggregateTimer();
+    /** where the received datagrams show up, the socket or io_uring */
+    int getReadFd() const;
+
     struct sockaddr_in addr_in;
     struct sockaddr_in addr_out;
+    /** guards "addr_out" against learnSender() */
+    mutable std::mutex addrMutex;
     int fd;
+    std::unique_ptr<IoUring> uring;
+    std::vector<uint8_t> aggregate;
+    /** when the first frame in "aggregate" was added */
+    std::chrono::steady_clock::time_point aggregateSince;
+    /** expires "aggregateDelay" after "aggregateSince" */
+    int timerFd;
+    /** "timerFd" and getReadFd(), only when aggregating */
+    int epollFd;
     // hmpf... the call to "recvfrom()" wants a _pointer_ to the
     // length-argument... and the pointer cannot even be a const-one...
     // manman... serious? why?
@@ -146,12 +303,84 @@ class ExternalInterfaceUdp : public ndlcom::ExternalInterfaceBase {
 };
 
 /**
- * essentially (only) a tcp-listener
+ * sends every frame once to a multicast group, for any number of listeners
+ *
+ * in contrast to ExternalInterfaceUdp the destination never changes. what is
+ * sent to the group by others is read, while the datagrams looped back from
+ * this interface itself are skipped. listeners may also answer to a unicast
+ * port, see the "reply" option. every frame is one datagram.
+ */
+class ExternalInterfaceUdpMulticast : public ndlcom::ExternalInterfaceBase {
+  public:
+    ExternalInterfaceUdpMulticast(
+        struct NDLComBridge &_bridge, std::string group,
+        unsigned int port = defaultPort,
+        uint8_t flags = NDLCOM_EXTERNAL_INTERFACE_FLAGS_DEFAULT);
+    ~ExternalInterfaceUdpMulticast() override;
+
+    size_t readEscapedBytes(void *buf, size_t count) override;
+    size_t writeEscapedBytes(const void *buf, size_t count) override;
+    /** one datagram per frame, all passed to "sendmmsg()" at once */
+    size_t writeEscapedFrames(const struct NDLComExternalInterfaceFrame *frames,
+                              size_t count) override;
+
+    size_t getRxQueueDepth() const override;
+    size_t getTxQueueDepth() const override;
+    /** an epoll set of the group and the reply socket */
+    int getPollFd() const override;
+
+    static const std::regex &uri();
+    static const unsigned int defaultPort;
+    static const unsigned int defaultTtl;
+    ExternalInterfaceUdpMulticast(
+        struct NDLComBridge &_bridge, std::smatch match,
+        uint8_t flags = NDLCOM_EXTERNAL_INTERFACE_FLAGS_DEFAULT);
+
+    /**
+     * Additional keys:
+     *
+     * - "ttl": how many routers the datagrams may pass (default: 1, only the
+     *   local network).
+     * - "loop": "0" to not deliver the datagrams to listeners on this host.
+     * - "reply": sends from this port, and reads what listeners send to it
+     *   as unicast. otherwise a random port is used. Has to come before
+     *   "thread", the socket is read by the thread.
+     */
+    bool setOption(const std::string &key, const std::string &value) override;
+
+  private:
+    /** a non-blocking udp socket bound to "port" on all addresses */
+    int openSocket(unsigned int port);
+    /** reads one datagram from "sock", except the ones sent by ourself */
+    size_t readFrom(int sock, void *buf, size_t count);
+
+    struct sockaddr_in group;
+    /** source of the datagrams sent by us, to recognize them when looped */
+    struct sockaddr_in self;
+    /** member of the group */
+    int rxFd;
+    /** sends to the group, and gets the unicast replies */
+    int txFd;
+    int epollFd;
+};
+
+/**
+ * connects to a tcp server, and keeps the connection up
+ *
+ * connecting is done in the background: the ctor only starts it, and every
+ * call of readEscapedBytes() looks how far it got. if connecting fails or an
+ * established connection breaks, the next attempt is made after a delay
+ * starting at "retryMin" and doubling with every failure up to "retryMax".
+ * the bridge goes on with the other interfaces meanwhile.
  *
- * need some server-implementation to "listen()" before we can connect to it.
- * closes connection (with throw) on error, like unreachable destination.
+ * while there is no connection, or the socket is full, up to "txQueueSize"
+ * outgoing frames are kept and written once possible. newer frames are
+ * dropped if there is no more room. the rest of a frame cut by a broken
+ * connection is dropped as well, the new connection starts with a whole one.
+ * the same for a message received only in part.
  *
- * Note: the call to "connect()" is done in a blocking manner!
+ * only resolving the hostname is done in a blocking manner, for each attempt
+ * until it succeeded once.
  */
 class ExternalInterfaceTcpClient : public ndlcom::ExternalInterfaceBase {
   public:
@@ -161,16 +390,396 @@ class ExternalInterfaceTcpClient : public ndlcom::ExternalInterfaceBase {
     ~ExternalInterfaceTcpClient() override;
 
     size_t readEscapedBytes(void *buf, size_t count) override;
-    void writeEscapedBytes(const void *buf, size_t count) override;
-
-    static const std::regex uri;
+    size_t writeEscapedBytes(const void *buf, size_t count) override;
+    /** all frames in one "sendmsg()" */
+    size_t writeEscapedFrames(const struct NDLComExternalInterfaceFrame *frames,
+                              size_t count) override;
+
+    size_t getRxQueueDepth() const override;
+    /** the queued frames, and what the socket holds */
+    size_t getTxQueueDepth() const override;
+    /** the same descriptor for all connections, a reader thread waits on it */
+    int getPollFd() const override;
+    /** used for every connection, once it is there */
+    bool setIoUring(bool enable) override;
+
+    static const std::regex &uri();
     static const unsigned int defaultPort;
+    static const std::chrono::milliseconds defaultRetryMin;
+    static const std::chrono::milliseconds defaultRetryMax;
+    static const size_t defaultTxQueueSize;
     ExternalInterfaceTcpClient(
         struct NDLComBridge &_bridge, std::smatch match,
         uint8_t flags = NDLCOM_EXTERNAL_INTERFACE_FLAGS_DEFAULT);
 
+    /**
+     * Additional keys:
+     *
+     * - "retry": first delay between two attempts to connect, in ms.
+     * - "retrymax": longest delay between two attempts, in ms.
+     * - "txqueue": number of frames kept while not connected.
+     */
+    bool setOption(const std::string &key, const std::string &value) override;
+
+    bool isConnected() const;
+
+    /** how often the connection came back after it was lost */
+    unsigned long reconnects;
+    /** time without connection, from loosing it until it came back */
+    std::chrono::milliseconds lastOutage;
+    std::chrono::milliseconds longestOutage;
+
+    std::chrono::milliseconds retryMin;
+    std::chrono::milliseconds retryMax;
+    size_t txQueueSize;
+
+    /** adds the connection state and the outages */
+    void printStatus(const std::string prefix) const override;
+    /** adds the connection state and the outages */
+    struct InterfaceMetrics getMetrics() const override;
+
   private:
+    /** starts connecting when it is time, looks whether it succeeded */
+    void advanceConnection();
+    void startConnecting();
+    bool resolve();
+    void connectionEstablished();
+    /** schedules the next attempt */
+    void connectionFailed(const std::string &reason);
+    void connectionLost(const std::string &reason);
+    /** writes queued frames, until the socket is full */
+    void flushTxQueue();
+
+    enum State { DISCONNECTED, CONNECTING, CONNECTED };
+
+    const std::string hostname;
+    const unsigned int port;
     struct sockaddr_in addr;
+    bool resolved;
+    int fd;
+    State state;
+    bool everConnected;
+    /** only the first failure of an outage is printed */
+    bool failureReported;
+    std::chrono::milliseconds retryDelay;
+    std::chrono::steady_clock::time_point nextAttempt;
+    std::chrono::steady_clock::time_point disconnectedSince;
+    std::deque<std::vector<uint8_t>> txQueue;
+    /** bytes of the first frame in the queue already written */
+    size_t txQueueOffset;
+    size_t txQueueBytes;
+    bool useUring;
+    std::unique_ptr<IoUring> uring;
+    /** reading may be done by another thread than writing */
+    mutable std::mutex mutex;
+};
+
+/**
+ * common part of ExternalInterfaceTcpServer and ExternalInterfaceUnixServer
+ *
+ * every accepted connection becomes an interface of its own, a child of the
+ * server. the children are registered in the bridge and owned by the server,
+ * ndlcom::Bridge sees them through getChildren(): they are counted, listed
+ * in the metrics and found by their origin like every other interface.
+ *
+ * new connections are accepted and closed ones removed each time the bridge
+ * reads the server, so this is only done in the thread of the bridge. the
+ * server itself does not send anything.
+ */
+class ExternalInterfaceServer : public ndlcom::ExternalInterfaceBase {
+  public:
+    ExternalInterfaceServer(
+        struct NDLComBridge &_bridge, std::string label,
+        uint8_t flags = NDLCOM_EXTERNAL_INTERFACE_FLAGS_DEFAULT);
+    /** deregisters all children */
+    ~ExternalInterfaceServer() override;
+
+    /** the clients got their own copy */
+    size_t writeEscapedBytes(const void *buf, size_t count) override;
+
+    /**
+     * Reading in a thread or with io_uring is not possible, as reading
+     * changes the interfaces of the bridge: "thread", "cpu", "prio" and
+     * "uring" are refused.
+     */
+    bool setOption(const std::string &key, const std::string &value) override;
+
+    /** all currently connected clients */
+    std::vector<std::shared_ptr<ExternalInterfaceBase>>
+    getChildren() const override;
+
+    /** adds the connected clients to the output of the base-class */
+    void printStatus(const std::string prefix) const override;
+
+  protected:
+    /** nothing is sent, so nothing is counted */
+    void noteOutgoingBytes(const void *buf, size_t count) override;
+
+    /**
+     * creates the interface for a new connection, with the address of the
+     * other side. returning nullptr refuses the connection, the descriptor
+     * has to be closed then.
+     */
+    typedef std::function<std::shared_ptr<ExternalInterfaceBase>(
+        int client, const struct sockaddr_storage &peer)>
+        ChildFactory;
+    /**
+     * accepts all pending connections of the listening socket "fd", without
+     * blocking, and registers what "factory" makes of them
+     */
+    void acceptChildren(int fd, const ChildFactory &factory);
+    /** deregisters and drops the children "isClosed" says so for */
+    void removeChildren(
+        const std::function<bool(ExternalInterfaceBase &)> &isClosed);
+
+    std::vector<std::shared_ptr<ExternalInterfaceBase>> children;
+};
+
+class ExternalInterfaceTcpServer;
+
+/**
+ * one connection accepted by ExternalInterfaceTcpServer
+ *
+ * created and owned by the server, and registered as an interface of its own
+ * in the bridge, with its own entries in the routing table.
+ *
+ * the socket is only read when the epoll set of the server reported it
+ * readable, so many idle clients cost nothing. what does not fit into the
+ * socket is kept in a buffer of up to "txBufferSize" bytes, written before
+ * anything else the next time. a slow client only looses its own messages,
+ * whole ones.
+ */
+class ExternalInterfaceTcpServerClient : public ndlcom::ExternalInterfaceBase {
+  public:
+    ExternalInterfaceTcpServerClient(
+        struct NDLComBridge &_bridge, std::string label,
+        ExternalInterfaceTcpServer &server, int fd, size_t txBufferSize,
+        uint8_t flags = NDLCOM_EXTERNAL_INTERFACE_FLAGS_DEFAULT);
+    ~ExternalInterfaceTcpServerClient() override;
+
+    size_t readEscapedBytes(void *buf, size_t count) override;
+    size_t writeEscapedBytes(const void *buf, size_t count) override;
+    /** all frames in one "sendmsg()" */
+    size_t writeEscapedFrames(const struct NDLComExternalInterfaceFrame *frames,
+                              size_t count) override;
+
+    size_t getRxQueueDepth() const override;
+    /** the buffered bytes, and what the socket holds */
+    size_t getTxQueueDepth() const override;
+    int getPollFd() const override;
+
+    /**
+     * "thread", "cpu", "prio" and "uring" are refused: reading writes the
+     * buffered bytes and asks the epoll set of the server, both only in the
+     * thread of the bridge.
+     */
+    bool setOption(const std::string &key, const std::string &value) override;
+
+    /** the other side closed the connection */
+    bool isClosed() const;
+
+  private:
+    friend class ExternalInterfaceTcpServer;
+    /** writes buffered bytes, until the socket is full */
+    void flushTxBuffer();
+
+    ExternalInterfaceTcpServer &server;
+    int fd;
+    /** set from the epoll set of the server, until "recv()" got everything */
+    bool readable;
+    std::vector<uint8_t> txBuffer;
+    const size_t txBufferSize;
+    bool closed;
+};
+
+/**
+ * accepts tcp connections on a port
+ *
+ * the uri "tcpserver://:2000" listens on all addresses, a hostname in front
+ * of the port on only this one. every connection becomes an
+ * ExternalInterfaceTcpServerClient, with the flags of the server at that time
+ * and "TCP_NODELAY" set. accepting never blocks the bridge.
+ *
+ * the listening socket and all clients are in one epoll set: getPollFd() is
+ * the one descriptor to wait on, and it is asked once per round of the bridge
+ * which clients have something to read, instead of trying every one of them.
+ *
+ * the clients are children of the server, see ExternalInterfaceServer.
+ */
+class ExternalInterfaceTcpServer : public ndlcom::ExternalInterfaceServer {
+  public:
+    ExternalInterfaceTcpServer(
+        struct NDLComBridge &_bridge, std::string hostname,
+        unsigned int port = defaultPort,
+        uint8_t flags = NDLCOM_EXTERNAL_INTERFACE_FLAGS_DEFAULT);
+    ~ExternalInterfaceTcpServer() override;
+
+    /** accepts and removes clients, never returns any bytes */
+    size_t readEscapedBytes(void *buf, size_t count) override;
+    /** the epoll set, readable for new connections and data of clients */
+    int getPollFd() const override;
+
+    static const std::regex &uri();
+    static const unsigned int defaultPort;
+    static const size_t defaultTxBufferSize;
+    ExternalInterfaceTcpServer(
+        struct NDLComBridge &_bridge, std::smatch match,
+        uint8_t flags = NDLCOM_EXTERNAL_INTERFACE_FLAGS_DEFAULT);
+
+    /**
+     * Additional keys:
+     *
+     * - "txbuffer": bytes buffered for each client, see
+     *   ExternalInterfaceTcpServerClient.
+     */
+    bool setOption(const std::string &key, const std::string &value) override;
+
+    /** buffer for bytes not fitting into the socket of a client */
+    size_t txBufferSize;
+
+    /** the port actually used, if "0" was given */
+    unsigned int getPort() const;
+
+    /** all currently connected clients */
+    std::vector<std::weak_ptr<ExternalInterfaceTcpServerClient>>
+    getClients() const;
+
+  private:
+    friend class ExternalInterfaceTcpServerClient;
+    /**
+     * asks the epoll set once per round of the bridge: the first of the
+     * clients or the server to be read does it, reading the server ends the
+     * round.
+     */
+    void pollEvents();
+
+    int fd;
+    int epollFd;
+    /** pollEvents() was done in this round */
+    bool polled;
+    /** the listening socket was reported readable */
+    bool acceptable;
+    /** room for an event of every client, and the listening socket */
+    std::vector<struct epoll_event> events;
+};
+
+/**
+ * one local process connected to an ExternalInterfaceUnixServer
+ *
+ * created and owned by the server, and registered as an interface of its own
+ * in the bridge. so every client gets its own entries in the routing table,
+ * and messages for one client do not go to the others.
+ *
+ * every message is one packet of the "SOCK_SEQPACKET" socket. packets which
+ * do not fit into the socket are kept in a queue of up to "txQueueSize"
+ * frames, written before anything else the next time. a slow client only
+ * looses its own messages.
+ */
+class ExternalInterfaceUnixClient : public ndlcom::ExternalInterfaceBase {
+  public:
+    ExternalInterfaceUnixClient(
+        struct NDLComBridge &_bridge, std::string label, int fd,
+        const struct ucred &credentials, size_t txQueueSize,
+        uint8_t flags = NDLCOM_EXTERNAL_INTERFACE_FLAGS_DEFAULT);
+    ~ExternalInterfaceUnixClient() override;
+
+    size_t readEscapedBytes(void *buf, size_t count) override;
+    size_t writeEscapedBytes(const void *buf, size_t count) override;
+    /** one packet per frame, all passed to "sendmmsg()" at once */
+    size_t writeEscapedFrames(const struct NDLComExternalInterfaceFrame *frames,
+                              size_t count) override;
+
+    size_t getRxQueueDepth() const override;
+    /** the queued packets, and what the socket holds */
+    size_t getTxQueueDepth() const override;
+    int getPollFd() const override;
+
+    /**
+     * "thread", "cpu", "prio" and "uring" are refused: reading writes the
+     * queued packets, only in the thread of the bridge.
+     */
+    bool setOption(const std::string &key, const std::string &value) override;
+
+    /** the process on the other side, as it was when connecting */
+    const struct ucred credentials;
+
+    /** the other side closed the connection */
+    bool isClosed() const;
+
+  private:
+    /** writes queued packets, until the socket is full */
+    void flushTxQueue();
+
+    int fd;
+    /** one received packet, handed out in pieces if needed */
+    std::vector<uint8_t> rx;
+    size_t rxLength;
+    size_t rxPosition;
+    std::deque<std::vector<uint8_t>> txQueue;
+    size_t txQueueBytes;
+    const size_t txQueueSize;
+    bool closed;
+};
+
+/**
+ * listens on a unix domain socket for local processes
+ *
+ * the uri "unix:///run/ndlcom.sock" creates a "SOCK_SEQPACKET" socket at the
+ * given path. every process connecting to it becomes an
+ * ExternalInterfaceUnixClient, with the flags of the server at that time.
+ * like a "udp://localhost" interface with message boundaries, but without
+ * using ports, and with the credentials of the other side known.
+ *
+ * the clients are children of the server, see ExternalInterfaceServer.
+ *
+ * a stale socket file of a previous process is replaced, one still in use is
+ * an error. the file is removed again in the dtor.
+ */
+class ExternalInterfaceUnixServer : public ndlcom::ExternalInterfaceServer {
+  public:
+    ExternalInterfaceUnixServer(
+        struct NDLComBridge &_bridge, std::string path,
+        uint8_t flags = NDLCOM_EXTERNAL_INTERFACE_FLAGS_DEFAULT);
+    ~ExternalInterfaceUnixServer() override;
+
+    /** accepts and removes clients, never returns any bytes */
+    size_t readEscapedBytes(void *buf, size_t count) override;
+    int getPollFd() const override;
+
+    static const std::regex &uri();
+    static const size_t defaultTxQueueSize;
+    ExternalInterfaceUnixServer(
+        struct NDLComBridge &_bridge, std::smatch match,
+        uint8_t flags = NDLCOM_EXTERNAL_INTERFACE_FLAGS_DEFAULT);
+
+    /**
+     * Additional keys:
+     *
+     * - "uid", "gid": only accept processes of this user or group, see
+     *   allowedUid and allowedGid.
+     * - "mode": permissions of the socket file, octal like "0660".
+     * - "txqueue": number of packets queued for each client, see
+     *   ExternalInterfaceUnixClient.
+     */
+    bool setOption(const std::string &key, const std::string &value) override;
+
+    /**
+     * if not negative, a connecting process needs this user id or group id
+     * to be accepted. checked with the credentials of the process. with both
+     * set, one of them has to match.
+     */
+    int allowedUid;
+    int allowedGid;
+    /** queue for packets not fitting into the socket of a client */
+    size_t txQueueSize;
+
+    /** all currently connected clients */
+    std::vector<std::weak_ptr<ExternalInterfaceUnixClient>> getClients() const;
+
+  private:
+    bool isAllowed(const struct ucred &credentials) const;
+
+    const std::string path;
     int fd;
 };
 
@@ -195,16 +804,21 @@ class ExternalInterfaceTcpClient : public ndlcom::ExternalInterfaceBase {
  * "can://$deviceName:canIdRx:canIdTx", where the device name is followed by
  * the two canIds used to send and receive frames.
  *
- * Additional notes:
+ * every message is split into can frames with a control byte in front, see
+ * CanFraming. a lost frame is noticed, and the message it belonged to is
+ * skipped as a whole. on "can fd" interfaces the frames are as long as
+ * possible, the last one of a message only as long as needed. "&raw" sends
+ * plain bytes without control byte, for older peers.
  *
- * would be nice to register also for CAN error message, check them when
- * receiving? throw runtime-error when hardware defect is detected? or just
- * close? dunno...  see include/uapi/linux/can/error.h
+ * all frames of one write go out in one "sendmmsg()", reading takes as many
+ * as there are with one "recvmmsg()". a full transmit queue drops the
+ * remaining frames.
  *
- * there are error frames and overload frames
+ * Additional notes:
  *
- * longer messages, the "can fd" type, where not considered. can be added, for
- * sure. but is not yet.
+ * error frames (bus-off, passive, tx timeout) are only counted. throw
+ * runtime-error when hardware defect is detected? or just close? dunno...
+ * see include/uapi/linux/can/error.h
  *
  * there is a 1microsecond timestamp generated when receiving a frame. sadly we
  * cannot use it in this framework in a sensible way.
@@ -222,28 +836,56 @@ class ExternalInterfaceCan : public ndlcom::ExternalInterfaceBase {
     ~ExternalInterfaceCan() override;
 
     size_t readEscapedBytes(void *buf, size_t count) override;
-    void writeEscapedBytes(const void *buf, size_t count) override;
+    size_t writeEscapedBytes(const void *buf, size_t count) override;
+    /** the frames of all messages in one "sendmmsg()" */
+    size_t writeEscapedFrames(const struct NDLComExternalInterfaceFrame *frames,
+                              size_t count) override;
+    int getPollFd() const override;
 
     // could this be made into a more generic template-struct with std::tuple
     // for the default-arguments...?
-    static const std::regex uri;
+    static const std::regex &uri();
     static const canid_t defaultCanIdRx;
     static const canid_t defaultCanIdTx;
+    /** frames read with one call at most */
+    static const size_t rxBatchSize;
 
     // TODO: document this crap...
     ExternalInterfaceCan(
         struct NDLComBridge &_bridge, std::smatch match,
         uint8_t flags = NDLCOM_EXTERNAL_INTERFACE_FLAGS_DEFAULT);
 
+    /**
+     * Additional keys:
+     *
+     * - "raw": frames without control byte, lost frames are not noticed.
+     *   Has to come before "thread", the frames are unpacked by the thread.
+     *
+     * "framed" is refused, the padding of the frames needs the escaping.
+     * Reading in a thread is fine otherwise, reading and writing use
+     * different frames and sequence counters.
+     */
+    bool setOption(const std::string &key, const std::string &value) override;
+
+    /** adds lost frames and error frames */
+    void printStatus(const std::string prefix) const override;
+
+    CanFraming framing;
+    unsigned long errorFrames;
+
   private:
+    /** sends "txFrames", returns how many went out */
+    size_t sendFrames();
+
     struct can_filter can_filter;
     canid_t canIdTx;
     canid_t canIdRx;
     can_err_mask_t err_mask;
     struct sockaddr_can addr;
     int fd;
-    socklen_t len;
     size_t max_data_len;
+    std::vector<struct canfd_frame> txFrames;
+    std::vector<struct canfd_frame> rxFrames;
 };
 
 /**
@@ -269,9 +911,10 @@ class ExternalInterfacePipe : public ndlcom::ExternalInterfaceBase {
     ~ExternalInterfacePipe() override;
 
     size_t readEscapedBytes(void *buf, size_t count) override;
-    void writeEscapedBytes(const void *buf, size_t count) override;
+    size_t writeEscapedBytes(const void *buf, size_t count) override;
+    int getPollFd() const override;
 
-    static const std::regex uri;
+    static const std::regex &uri();
     ExternalInterfacePipe(
         struct NDLComBridge &_bridge, std::smatch match,
         uint8_t flags = NDLCOM_EXTERNAL_INTERFACE_FLAGS_DEFAULT);
@@ -301,7 +944,7 @@ class ExternalInterfacePty : public ExternalInterfaceStream {
     size_t readEscapedBytes(void *buf, size_t count) override;
     // we can reuse the write function of the base-class
 
-    static const std::regex uri;
+    static const std::regex &uri();
     ExternalInterfacePty(
         struct NDLComBridge &_bridge, std::smatch match,
         uint8_t flags = NDLCOM_EXTERNAL_INTERFACE_FLAGS_DEFAULT);
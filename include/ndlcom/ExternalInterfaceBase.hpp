@@ -3,13 +3,18 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <atomic>
+#include <exception>
 #include <iostream>
 #include <string>
 #include <memory>
+#include <thread>
+#include <vector>
 
 #include "ndlcom/ExternalInterface.h"
 #include "ndlcom/HandlerCommon.hpp"
 #include "ndlcom/Bridge.hpp"
+#include "ndlcom/Metrics.hpp"
 #include "ndlcom/Types.h"
 
 namespace ndlcom {
@@ -31,10 +36,12 @@ typedef class HandlerCommon<struct NDLComBridge, struct NDLComExternalInterface>
  * virtual functions around the read/write interface and provides some
  * convenience like common output stream, pauseing and statistics.
  *
- * TODO:
- * - change signature of "writeEscapedBytes" to return the number of bytes
- *   actually written so that we can count bytes which where lost due to
- *   buffer-full.
+ * Outgoing messages are collected in a batch of up to "defaultBatchSize"
+ * messages and passed to writeEscapedFrames() at once, after the bridge is
+ * done with processing. See setBatchSize().
+ *
+ * Optionally, reading can be done by a thread of its own, see
+ * startReaderThread().
  */
 class ExternalInterfaceBase : public ExternalInterfaceVeryBase {
   public:
@@ -42,10 +49,111 @@ class ExternalInterfaceBase : public ExternalInterfaceVeryBase {
         struct NDLComBridge &bridge, std::string label,
         std::ostream &out = std::cerr,
         uint8_t flags = NDLCOM_EXTERNAL_INTERFACE_FLAGS_DEFAULT);
+    ~ExternalInterfaceBase();
 
-    virtual void writeEscapedBytes(const void *buf, size_t count) = 0;
+    /**
+     * Write one escaped message, or any part of the bytestream.
+     *
+     * @return the number of bytes actually written. The rest is counted in
+     *         "bytesDropped".
+     */
+    virtual size_t writeEscapedBytes(const void *buf, size_t count) = 0;
     virtual size_t readEscapedBytes(void *buf, size_t count) = 0;
 
+    /**
+     * Write a batch of escaped messages. The default implementation calls
+     * writeEscapedBytes() for each of them, deriving classes may use
+     * something like "writev()" instead.
+     *
+     * @return the number of bytes actually written, summed over all frames
+     */
+    virtual size_t
+    writeEscapedFrames(const struct NDLComExternalInterfaceFrame *frames,
+                       size_t count);
+
+    /**
+     * File descriptor which becomes readable when there is data for
+     * readEscapedBytes(), to be used with "poll()". The default
+     * implementation returns -1, meaning there is none.
+     */
+    virtual int getPollFd() const;
+
+    /**
+     * File descriptor to wait on before processing the bridge: the one of
+     * the reader thread if there is one, otherwise getPollFd(). This is what
+     * ndlcomExternalInterfaceGetPollFd() returns for this interface.
+     */
+    int getWakeupFd() const;
+
+    /**
+     * Maximum number of outgoing messages collected before they are
+     * written. A value of 0 or 1 writes every message on its own, as soon as
+     * the bridge has it. At most IOV_MAX.
+     */
+    void setBatchSize(size_t frames);
+    static const size_t defaultBatchSize;
+
+    /**
+     * Read this interface in a thread of its own. The thread waits on
+     * getPollFd() (or polls every millisecond if there is none) and puts
+     * everything read into a ring of "readerRingSize" bytes, where the bridge
+     * picks it up. getWakeupFd() then becomes readable when the ring has
+     * data.
+     *
+     * This allows to give the thread its own core and priority, see
+     * setReaderThreadCpu() and setReaderThreadPriority(), so that a slow
+     * interface or a busy bridge do not delay reading a fast link. Handling
+     * and forwarding of the messages stays in the thread calling the bridge.
+     *
+     * readEscapedBytes() is then called by the thread, concurrently to
+     * writeEscapedBytes() and writeEscapedFrames() called by the bridge. A
+     * file descriptor alone does not make this safe: deriving classes have to
+     * guard everything used by both sides, like queues of unsent bytes,
+     * learned addresses or the state of a connection, or refuse the "thread"
+     * option in setOption(). The same for options changing what
+     * readEscapedBytes() uses while the thread runs. Errors reported by
+     * readEscapedBytes() stop the thread and are thrown again in the next
+     * call of the bridge.
+     *
+     * Stopped in deregisterHandler(), at the latest.
+     */
+    void startReaderThread();
+    void stopReaderThread();
+    bool hasReaderThread() const;
+    static const size_t readerRingSize;
+
+    /**
+     * Pin the reader thread to the given core, starting it if needed
+     */
+    void setReaderThreadCpu(int cpu);
+    /**
+     * Run the reader thread with "SCHED_FIFO" and the given priority,
+     * starting it if needed. A priority of 0 goes back to normal scheduling.
+     * Needs root or "CAP_SYS_NICE".
+     */
+    void setReaderThreadPriority(int priority);
+
+    /**
+     * Lock all current and future memory of the process, to avoid page faults
+     * in realtime threads. The buffers of the interfaces are allocated and
+     * written in advance, every reader thread touches its stack when started.
+     * Needs root or "CAP_IPC_LOCK".
+     */
+    void lockMemory();
+
+    /**
+     * Read and write through io_uring instead of the normal system calls, see
+     * ndlcom::IoUring. Saves the system calls of the busy path, writes do not
+     * wait for the device.
+     *
+     * The default does nothing, interfaces using a file descriptor override
+     * this.
+     *
+     * @return false if not supported by the interface, the build or the
+     *         running kernel
+     */
+    virtual bool setIoUring(bool enable);
+
     /**
      * Allows to temporarily silence this ExternalInterface. No more data will
      * be written to hardware. Note that reads are still performed to empty the
@@ -63,10 +171,44 @@ class ExternalInterfaceBase : public ExternalInterfaceVeryBase {
      */
     unsigned long bytesReceived;
 
+    /**
+     * Total number of raw-bytes which could not be written by this interface,
+     * for example due to full buffers. Counted from the return values of
+     * writeEscapedBytes() and writeEscapedFrames()
+     */
+    unsigned long bytesDropped;
+
     /**
      * Allows settings flags on the interface. Not many are currently supported
      */
     void setFlag(uint8_t flag, bool value);
+    bool getFlag(uint8_t flag) const;
+
+    /**
+     * Apply one "key=value" option given in the uri. Known keys:
+     *
+     * - "compress": compress payloads on this interface, see
+     *   NDLCOM_EXTERNAL_INTERFACE_FLAGS_COMPRESS. A value of "0" disables it.
+     * - "batch": number of messages to write at once, see setBatchSize().
+     * - "thread": read in a thread of its own, see startReaderThread(). A
+     *   value of "0" stops it.
+     * - "cpu": pin the reader thread to this core, see setReaderThreadCpu().
+     * - "prio": realtime priority of the reader thread, see
+     *   setReaderThreadPriority().
+     * - "mlock": lock the memory of the process, see lockMemory().
+     * - "framed": write and read plain frames, see
+     *   NDLCOM_EXTERNAL_INTERFACE_FLAGS_FRAMED. A value of "crc" adds the crc,
+     *   "0" goes back to escaped messages.
+     * - "uring": use io_uring, see setIoUring(). A value of "0" disables it,
+     *   the normal system calls are used if it is not available.
+     *
+     * Deriving classes may handle additional keys and pass on the rest.
+     *
+     * @param key the part in front of the "="
+     * @param value the part after the "=", may be empty
+     * @return false if the key is unknown
+     */
+    virtual bool setOption(const std::string &key, const std::string &value);
 
     /**
      * Set NDLComRoutingTable to use this ExternalInterface to reach the given
@@ -80,14 +222,53 @@ class ExternalInterfaceBase : public ExternalInterfaceVeryBase {
     void resetCrcFails();
     size_t getCrcFails() const;
 
+    /** number of NDLCom packets decoded from this interface */
+    size_t getPacketsReceived() const;
+    /** number of NDLCom packets written into this interface */
+    size_t getPacketsTransmitted() const;
+    /**
+     * number of NDLCom packets the bridge did not write into this interface,
+     * see ndlcomExternalInterfaceGetPacketsRefused()
+     */
+    size_t getPacketsRefused() const;
+
+    /**
+     * Number of bytes currently waiting to be read from the underlying
+     * device, as far as this can be known. Has to be cheap and must not
+     * block. The default implementation returns 0.
+     */
+    virtual size_t getRxQueueDepth() const;
+    /**
+     * Number of bytes currently waiting to be written out by the underlying
+     * device, as far as this can be known. Has to be cheap and must not
+     * block. The default implementation returns 0.
+     */
+    virtual size_t getTxQueueDepth() const;
+
+    /**
+     * Collect all the counters of this interface in one struct, see
+     * ndlcom::Bridge::getMetrics(). Deriving classes may add what they know
+     * about their connection.
+     */
+    virtual struct InterfaceMetrics getMetrics() const;
+
+    /**
+     * Interfaces created and registered by this one, like the connections
+     * accepted by a server. They are owned by this interface, but
+     * ndlcom::Bridge lists, counts and looks them up like its own. The
+     * default implementation returns none.
+     */
+    virtual std::vector<std::shared_ptr<ExternalInterfaceBase>>
+    getChildren() const;
+
     /**
      * prints to "out", calls HandlerCommon::printStatus
      *
      * the name of the interface on the first line, and then crcFails, bytesRx
      * and bytesTx on the second line. If the interface is paused, it will be
-     * indicated by appending "[PAUSED]"
+     * indicated by appending "[PAUSED]", compression by "[COMPRESS]"
      */
-    void printStatus(const std::string prefix) const final;
+    void printStatus(const std::string prefix) const override;
 
   protected:
     /**
@@ -114,6 +295,27 @@ class ExternalInterfaceBase : public ExternalInterfaceVeryBase {
      */
     virtual void noteOutgoingBytes(const void *buf, size_t count);
 
+    /**
+     * Helper function which adds up the number of lost bytes into
+     * "bytesDropped".
+     *
+     * Called with the difference between the bytes handed to
+     * writeEscapedFrames() and the bytes it reports as written.
+     *
+     * @param count number of bytes which where lost
+     */
+    virtual void noteDroppedBytes(size_t count);
+
+    /**
+     * Forget the message the parser is in the middle of, for interfaces
+     * where the bytes of a new connection follow those of a broken one.
+     *
+     * May be called from any thread, also from readEscapedBytes() running in
+     * the reader thread. The parser is reset in the thread of the bridge,
+     * right after the last byte already read.
+     */
+    void resetParser();
+
     /**
      * a common error-reporting function, which shall be used to report
      * non-recoverable errors. the default implementation will "throw" a
@@ -133,17 +335,59 @@ class ExternalInterfaceBase : public ExternalInterfaceVeryBase {
     /**
      * Wrapper function to bridge between C and C++ realm
      */
-    static void writeWrapper(void *context, const void *buf,
-                             const size_t count);
+    static size_t
+    writeFramesWrapper(void *context,
+                       const struct NDLComExternalInterfaceFrame *frames,
+                       const size_t count);
     /**
      * Wrapper function to bridge between C and C++ realm
      */
     static size_t readWrapper(void *context, void *buf, const size_t count);
+    /**
+     * Wrapper function to bridge between C and C++ realm
+     */
+    static int pollFdWrapper(void *context);
+    /**
+     * Body of the reader thread
+     */
+    void readerLoop();
+    /**
+     * Takes bytes out of the ring filled by the reader thread
+     */
+    size_t readFromRing(void *buf, size_t count);
     /**
      * The wrapped C-datastructure
      */
     struct NDLComExternalInterface external;
 
+    /** memory handed to ndlcomExternalInterfaceSetBatchBuffer() */
+    std::vector<struct NDLComExternalInterfaceFrame> batchFrames;
+    std::vector<uint8_t> batchBuffer;
+
+    /**
+     * Single-producer/single-consumer ring between the reader thread and the
+     * bridge. "readerHead" and "readerTail" count bytes written and read.
+     */
+    std::vector<uint8_t> readerRing;
+    std::atomic<size_t> readerHead;
+    std::atomic<size_t> readerTail;
+    std::atomic<bool> readerStop;
+    std::atomic<bool> readerFailed;
+    std::thread readerThread;
+    /** readable while the ring has data */
+    int readerEventFd;
+    /** what the reader thread caught, thrown in the thread of the bridge */
+    std::exception_ptr readerError;
+
+    /** set by resetParser() */
+    std::atomic<bool> parserResetRequested;
+    /**
+     * with a reader thread: the parser is reset when the bridge reaches the
+     * byte "parserResetAt" of the ring
+     */
+    std::atomic<bool> parserResetPending;
+    std::atomic<size_t> parserResetAt;
+
     /**
      * this will allow the bridge to look into our templated member struct
      * "caller", which is "protected" by the ndlcom::HandlerCommon base-class
@@ -0,0 +1,90 @@
+#ifndef NDLCOM_EXTERNALINTERFACELOOPBACK_HPP
+#define NDLCOM_EXTERNALINTERFACELOOPBACK_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "ndlcom/Bridge.hpp"
+#include "ndlcom/ExternalInterface.h"
+#include "ndlcom/ExternalInterfaceBase.hpp"
+
+namespace ndlcom {
+
+/**
+ * @brief The shared memory of two connected ExternalInterfaceLoopback
+ *
+ * One ring of bytes for each direction, with a fixed capacity allocated in
+ * the ctor. Not thread safe: both ends have to be processed by the same
+ * thread.
+ */
+class LoopbackLink {
+  public:
+    LoopbackLink(size_t capacity = defaultCapacity);
+
+    static const size_t defaultCapacity;
+
+    struct Ring {
+        std::vector<uint8_t> buffer;
+        /** position of the oldest byte */
+        size_t head;
+        /** number of bytes in the ring */
+        size_t fill;
+
+        /** all or nothing: returns false if "count" bytes do not fit */
+        bool write(const void *buf, size_t count);
+        /** returns the number of bytes copied into "buf" */
+        size_t read(void *buf, size_t count);
+    };
+
+    /** unique number, used for the labels of the interfaces */
+    const unsigned int id;
+    /** "ring[0]" is written by side 0, "ring[1]" by side 1 */
+    struct Ring ring[2];
+};
+
+/**
+ * @brief In-process ExternalInterface, connected to one other instance
+ *
+ * Two of these share a LoopbackLink and connect two ndlcom::Bridge in the
+ * same process, for testing and benchmarking of bridge topologies without
+ * hardware. Use connectBridges() to create both ends at once.
+ *
+ * Encoded messages are written into the ring of the other side as a whole.
+ * If a message does not fit it is dropped, and counted in "bytesDropped".
+ */
+class ExternalInterfaceLoopback : public ExternalInterfaceBase {
+  public:
+    ExternalInterfaceLoopback(
+        struct NDLComBridge &bridge, std::shared_ptr<LoopbackLink> link,
+        unsigned int side,
+        uint8_t flags = NDLCOM_EXTERNAL_INTERFACE_FLAGS_DEFAULT);
+
+    size_t readEscapedBytes(void *buf, size_t count) override;
+    size_t writeEscapedBytes(const void *buf, size_t count) override;
+
+    size_t getRxQueueDepth() const override;
+    size_t getTxQueueDepth() const override;
+
+  private:
+    std::shared_ptr<LoopbackLink> link;
+    struct LoopbackLink::Ring &rx;
+    struct LoopbackLink::Ring &tx;
+};
+
+/**
+ * @brief Connect two bridges by a pair of ExternalInterfaceLoopback
+ *
+ * @return the interfaces created in "a" and "b", owned by the bridges
+ */
+std::pair<std::weak_ptr<ExternalInterfaceLoopback>,
+          std::weak_ptr<ExternalInterfaceLoopback>>
+connectBridges(Bridge &a, Bridge &b,
+               size_t capacity = LoopbackLink::defaultCapacity,
+               uint8_t flags = NDLCOM_EXTERNAL_INTERFACE_FLAGS_DEFAULT);
+
+} // namespace ndlcom
+
+#endif /*NDLCOM_EXTERNALINTERFACELOOPBACK_HPP*/
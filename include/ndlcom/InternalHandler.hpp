@@ -100,7 +100,8 @@ class BridgeHandler
         ndlcomBridgeHandlerInit(&internal, handleWrapper,
                                 NDLCOM_BRIDGE_HANDLER_FLAGS_DEFAULT, this);
     }
-    void sendRaw(const struct NDLComHeader *header, const void *payload);
+    /** @return false if dropped, see ndlcomBridgeSendRaw() */
+    bool sendRaw(const struct NDLComHeader *header, const void *payload);
     /**
      * To be called after ctor
      */
@@ -127,7 +128,8 @@ class NodeHandler
         ndlcomNodeHandlerInit(&internal, handleWrapper,
                               NDLCOM_NODE_HANDLER_FLAGS_DEFAULT, this);
     }
-    void send(const NDLComId receiverId, const void *payload,
+    /** @return false if dropped, see ndlcomBridgeSendRaw() */
+    bool send(const NDLComId receiverId, const void *payload,
               const size_t length);
     /**
      * To be called after ctor
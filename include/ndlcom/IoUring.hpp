@@ -0,0 +1,192 @@
+#ifndef NDLCOM_IOURING_HPP
+#define NDLCOM_IOURING_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "ndlcom/ExternalInterface.h"
+
+namespace ndlcom {
+
+/**
+ * @brief Reading and writing one file descriptor through io_uring
+ *
+ * Uses the raw system calls, there is no dependency on liburing. Only
+ * available if the kernel headers at build time know all the opcodes used
+ * (5.6 or newer) and the kernel allows it at runtime, see valid().
+ *
+ * A read is always armed into a receive buffer, registered with the kernel
+ * if possible. read() only looks at the completion queue and copies what
+ * arrived, without a system call unless the read has to be armed again.
+ * Writes are copied into one of two buffers: one is in flight while the next
+ * batch is collected in the other one, so write() never waits for the device.
+ * A batch is one "write" for stream-like descriptors, or one "sendmsg" per
+ * frame for datagrams. If both buffers are full, write() accepts less.
+ *
+ * The descriptor is switched to blocking mode, io_uring then waits for it to
+ * become ready instead of returning EAGAIN. The caller never blocks, but
+ * should not use the descriptor directly anymore.
+ *
+ * All functions lock a mutex, so reading and writing from different threads
+ * is fine.
+ */
+class IoUring {
+  public:
+    /**
+     * @param fd the descriptor to use, stays owned by the caller
+     * @param datagram use "recvmsg"/"sendmsg" with addresses, for udp sockets
+     */
+    IoUring(int fd, bool datagram);
+    /**
+     * cancels everything still in flight, waiting half a second at most. the
+     * descriptor stays open, with its flags as before.
+     */
+    ~IoUring();
+    IoUring(const IoUring &) = delete;
+    IoUring &operator=(const IoUring &) = delete;
+
+    /** false if there is no io_uring, nothing else works then */
+    bool valid() const;
+
+    /**
+     * Copies what the armed read got into "buf". Never blocks.
+     *
+     * @return number of bytes, 0 if nothing arrived or the descriptor
+     *         reached its end (see eof()), or a negative "errno" like a
+     *         system call.
+     */
+    ssize_t read(void *buf, size_t count);
+    /** a stream-like descriptor was closed, it will not be read again */
+    bool eof() const;
+    /** sender of the datagram returned by the last read() */
+    struct sockaddr_in getSender() const;
+
+    /**
+     * Queues the frames and starts writing them, if nothing else is in
+     * flight.
+     *
+     * @param to destination of datagrams, ignored for streams
+     * @return number of bytes accepted, or a negative "errno" if an earlier
+     *         write failed
+     */
+    ssize_t write(const struct NDLComExternalInterfaceFrame *frames,
+                  size_t count, const struct sockaddr_in *to = nullptr);
+    /** bytes accepted by write() but not written in the end, then reset */
+    size_t takeDropped();
+
+    /** becomes readable when the kernel completed something */
+    int getPollFd() const;
+
+    /**
+     * For a stream-like descriptor which now refers to a new connection,
+     * see dup3(). Cancels what still hangs on the old one, counting unsent
+     * bytes as dropped, and starts reading again. getPollFd() stays the same.
+     *
+     * @return false if the old requests did not end in time, the object has
+     *         to be destroyed then
+     */
+    bool restart();
+
+    /** size of the receive buffer and of each of the two send buffers */
+    static const size_t bufferSize;
+    /** maximum number of datagrams in one send buffer */
+    static const size_t maxFrames;
+
+  private:
+    void setup();
+    void teardown();
+    /** handles all entries in the completion queue */
+    void reap();
+    void armRead();
+    /** clears O_NONBLOCK of "fd", remembering the old flags */
+    void makeBlocking();
+    /** submits the collecting buffer, if there is something in it */
+    void flushTx();
+    /** next free submission entry, or nullptr */
+    void *getSqe();
+    /** number of submission entries which can be prepared right now */
+    unsigned getSqSpace() const;
+    /** hands the prepared entries to the kernel, waiting for "wait" */
+    int submit(unsigned wait);
+    /**
+     * cancels the read and the writes in flight, one by one by their
+     * "user_data", and waits a limited time for them to end.
+     *
+     * @return false if the kernel still has requests after the timeout
+     */
+    bool cancelAll();
+
+    const int fd;
+    const bool datagram;
+    int oldFlags;
+
+    int ringFd;
+    void *sqRing;
+    size_t sqRingSize;
+    void *cqRing;
+    size_t cqRingSize;
+    void *sqes;
+    size_t sqesSize;
+    unsigned *sqHead;
+    unsigned *sqTail;
+    unsigned *sqMask;
+    unsigned *sqArray;
+    unsigned sqEntries;
+    /** entries prepared but not yet handed to the kernel */
+    unsigned sqLocalTail;
+    unsigned *cqHead;
+    unsigned *cqTail;
+    unsigned *cqMask;
+    void *cqes;
+    /** buffers are registered, "rx" is index 0, "tx" 1 and 2 */
+    bool fixedBuffers;
+    /** requests the kernel has not completed yet */
+    unsigned outstanding;
+    /** set in the destructor, nothing new is submitted */
+    bool cancelling;
+
+    /**
+     * everything the kernel reads or writes while a request is in flight. on
+     * its own, so that it can be left behind if cancelling takes too long.
+     */
+    struct Buffers {
+        std::vector<uint8_t> rx;
+        struct sockaddr_in rxSender;
+        struct iovec rxIov;
+        struct msghdr rxMsg;
+        /** "tx[txFill]" collects, the other one may be in flight */
+        std::vector<uint8_t> tx[2];
+        std::vector<struct iovec> txIov[2];
+        std::vector<struct msghdr> txMsg[2];
+        struct sockaddr_in txTo[2];
+    };
+    std::unique_ptr<struct Buffers> buffers;
+
+    size_t rxLength;
+    size_t rxPosition;
+    bool rxArmed;
+    bool rxEof;
+    int rxError;
+    struct sockaddr_in sender;
+
+    size_t txLength[2];
+    std::vector<size_t> txFrames[2];
+    unsigned txFill;
+    /** requests of the other buffer not completed yet */
+    unsigned txInFlight;
+    size_t txDropped;
+    int txError;
+
+    mutable std::mutex mutex;
+};
+
+} // namespace ndlcom
+
+#endif /*NDLCOM_IOURING_HPP*/
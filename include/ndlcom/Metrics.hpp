@@ -0,0 +1,148 @@
+#ifndef NDLCOM_METRICS_HPP
+#define NDLCOM_METRICS_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "ndlcom/Types.h"
+
+namespace ndlcom {
+
+class Bridge;
+
+/**
+ * @brief Snapshot of the counters of one ndlcom::ExternalInterfaceBase
+ *
+ * Byte counters are raw (escaped) bytes as seen on the wire, packet counters
+ * are whole NDLCom packets as seen by the NDLComBridge.
+ */
+struct InterfaceMetrics {
+    std::string label;
+    bool mirror;
+    bool paused;
+    unsigned long bytesReceived;
+    unsigned long bytesTransmitted;
+    /** bytes which where handed to the interface but could not be written */
+    unsigned long bytesDropped;
+    unsigned long packetsReceived;
+    unsigned long packetsTransmitted;
+    /** packets the bridge did not send here, see ExternalInterfaceBase */
+    unsigned long packetsRefused;
+    unsigned long crcFails;
+    /** bytes waiting in the receive-queue, as far as the OS tells us */
+    size_t rxQueueDepth;
+    /** bytes waiting in the transmit-queue, as far as the OS tells us */
+    size_t txQueueDepth;
+    /** false while an interface like a tcp client waits for its peer */
+    bool connected;
+    /** how often the connection came back after it was lost */
+    unsigned long reconnects;
+    /** how long the last outage lasted */
+    std::chrono::milliseconds lastOutage;
+};
+
+/**
+ * @brief Number of observed miss-events for one sender/receiver pair
+ *
+ * The rates are fractions of the packets in the last completed window of
+ * ndlcom::BridgeMissEvents, zero if no window was completed yet.
+ */
+struct MissEventMetrics {
+    NDLComId senderId;
+    NDLComId receiverId;
+    unsigned long missEvents;
+    double lossRate;
+    double reorderRate;
+};
+
+/**
+ * @brief One known entry of the NDLComRoutingTable
+ *
+ * The "interface" is the label of the ExternalInterfaceBase, or "internal" for
+ * deviceIds used by a ndlcom::Node of this bridge.
+ */
+struct RoutingMetrics {
+    NDLComId deviceId;
+    std::string interface;
+};
+
+/**
+ * @brief Everything ndlcom::Bridge::getMetrics() knows about the bridge
+ */
+struct BridgeMetrics {
+    std::chrono::time_point<std::chrono::system_clock> timestamp;
+    /** messages sent by handlers which did not fit into the send queue */
+    unsigned long sendQueueDropped;
+    std::vector<struct InterfaceMetrics> interfaces;
+    std::vector<struct MissEventMetrics> missEvents;
+    std::vector<struct RoutingMetrics> routing;
+};
+
+/**
+ * @brief Serialize a snapshot as one single line of JSON
+ *
+ * No trailing newline is written. The format is kept flat and stable, so that
+ * it can be scraped by simple tools:
+ *
+ *   {"timestamp":1500000000.123,"sendQueueDropped":0,
+ *    "interfaces":[{"label":"udp://...",...}],
+ *    "missEvents":[{"sender":1,"receiver":2,"count":3,"lossRate":0.01,
+ *                   "reorderRate":0}],
+ *    "routing":[{"deviceId":1,"interface":"udp://..."}]}
+ */
+void writeMetricsJson(std::ostream &out, const struct BridgeMetrics &metrics);
+
+/**
+ * @brief Export ndlcom::Bridge::getMetrics() over a local unix socket
+ *
+ * Listens on a SOCK_STREAM unix socket at the given path. Each newly connected
+ * client immediately gets the current snapshot, and afterwards one snapshot
+ * every "interval". Each snapshot is one line of JSON, see writeMetricsJson().
+ * Scraping is as simple as:
+ *
+ *   socat -u UNIX-CONNECT:/run/ndlcomBridge.metrics - | head -n1
+ *
+ * Everything is done non-blocking from within process(), which is to be
+ * called from the main-loop of the bridge. Clients which are too slow to
+ * accept a whole snapshot are disconnected instead of stalling the
+ * forwarding of packets.
+ */
+class MetricsServer {
+  public:
+    MetricsServer(const ndlcom::Bridge &bridge, std::string path,
+                  std::chrono::milliseconds interval =
+                      std::chrono::milliseconds(1000),
+                  std::ostream &out = std::cerr);
+    /** closes all connections and removes the socket file */
+    ~MetricsServer();
+    MetricsServer(const MetricsServer &) = delete;
+    MetricsServer &operator=(MetricsServer const &) = delete;
+
+    /**
+     * Accept new clients and send a snapshot to all clients if the interval
+     * elapsed. Never blocks.
+     */
+    void process();
+
+    /** the number of currently connected clients */
+    size_t getClientCount() const;
+
+  private:
+    void sendSnapshot(const std::vector<int> &receivers);
+
+    const ndlcom::Bridge &bridge;
+    const std::string path;
+    const std::chrono::milliseconds interval;
+    std::ostream &out;
+    std::chrono::time_point<std::chrono::steady_clock> nextSnapshot;
+    int fd;
+    std::vector<int> clients;
+};
+
+} // namespace ndlcom
+
+#endif /*NDLCOM_METRICS_HPP*/
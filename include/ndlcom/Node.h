@@ -126,9 +126,10 @@ NDLComId ndlcomNodeGetOwnDeviceId(const struct NDLComNode* node);
  * @param receiverId
  * @param payload
  * @param payloadSize
+ * @return false if the message was dropped, see ndlcomBridgeSendRaw()
  */
-void ndlcomNodeSend(struct NDLComNode *node, const NDLComId receiverId,
-                    const void *payload, const size_t payloadSize);
+uint8_t ndlcomNodeSend(struct NDLComNode *node, const NDLComId receiverId,
+                       const void *payload, const size_t payloadSize);
 
 /**
  * @brief Register node handler
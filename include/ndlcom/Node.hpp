@@ -100,8 +100,9 @@ class Node : public BridgeHandlerBase {
      * @brief Sending a new message as wrapped "OutgoingPayload"
      *
      * @param out The prepared payload structure to be used for sending
+     * @return false if dropped, see ndlcomBridgeSendRaw()
      */
-    void send(struct ndlcom::OutgoingPayload out);
+    bool send(struct ndlcom::OutgoingPayload out);
 
     /**
      * @brief Sending a new message
@@ -111,8 +112,9 @@ class Node : public BridgeHandlerBase {
      * @param receiverId Where to send to
      * @param payload Pointer to memory containing the payload
      * @param payloadSize Number of bytes to transmit
+     * @return false if dropped, see ndlcomBridgeSendRaw()
      */
-    void send(const NDLComId receiverId, const void *payload,
+    bool send(const NDLComId receiverId, const void *payload,
               const size_t payloadSize);
 
     /**
@@ -0,0 +1,146 @@
+#ifndef NDLCOM_NODE_HANDLER_DELTA_HPP
+#define NDLCOM_NODE_HANDLER_DELTA_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <iostream>
+#include <vector>
+
+#include "ndlcom/InternalHandler.hpp"
+#include "ndlcom/Types.h"
+
+/**
+ * The first payload byte of every message used by ndlcom::NodeHandlerDelta.
+ * Messages starting with other bytes are ignored. Override if this clashes
+ * with the representation ids used in your system.
+ */
+#ifndef NDLCOM_DELTA_MARKER
+#define NDLCOM_DELTA_MARKER 0xf6
+#endif
+
+/** the complete message follows */
+#define NDLCOM_DELTA_KIND_KEYFRAME 0x00
+/** the run length encoded XOR to the previous message follows */
+#define NDLCOM_DELTA_KIND_DELTA 0x01
+/** sent back by a receiver which lost track of a stream */
+#define NDLCOM_DELTA_KIND_REQUEST 0x02
+
+/** bytes used in front of the data of each frame */
+#define NDLCOM_DELTA_HEADER_SIZE 4
+/** largest payload which can be passed into sendStream() */
+#define NDLCOM_DELTA_MAX_PAYLOAD_SIZE                                          \
+    (NDLCOM_MAX_PAYLOAD_SIZE - NDLCOM_DELTA_HEADER_SIZE)
+
+namespace ndlcom {
+
+/**
+ * @brief Delta encoding of periodic messages
+ *
+ * Meant for telemetry: the same struct sent over and over to the same
+ * receiver, with only a few bytes changing in between. Each combination of
+ * receiver and "type", which is the first payload byte (usually the
+ * representation id), forms a stream. Most messages of a stream are sent as
+ * "delta", the XOR to the previous message packed by ndlcomRunLengthEncode().
+ * Every "keyframeInterval" messages, when the length changes or when the
+ * delta would not be smaller, the complete message is sent as "keyframe":
+ *
+ *     [marker][kind][type][seq] data...
+ *
+ * The 8bit "seq" is counted up for every message of a stream. The receiving
+ * side keeps the last message of every stream, keyed by sender and "type",
+ * and passes the reconstructed messages to handleStream(). A delta which does
+ * not follow its predecessor is dropped, as are all following deltas until
+ * the next keyframe. When losing track of a stream, the receiver asks the
+ * sender once for an early keyframe. If this request is lost as well, the
+ * periodic keyframe will resync the stream.
+ *
+ * Both sides keep their streams in a fixed number of preallocated entries.
+ * If all are used, the least recently used stream is forgotten. For the
+ * sender this just means a keyframe for the next message of this stream.
+ */
+class NodeHandlerDelta : public NodeHandler {
+  public:
+    NodeHandlerDelta(struct NDLComNode &node,
+                     size_t numberOfStreams = defaultNumberOfStreams,
+                     unsigned int keyframeInterval = defaultKeyframeInterval,
+                     std::ostream &out = std::cerr);
+
+    static const size_t defaultNumberOfStreams;
+    static const unsigned int defaultKeyframeInterval;
+
+    /**
+     * @brief Send one message of a stream to "receiverId"
+     *
+     * @return false if the message is empty or larger than
+     *         NDLCOM_DELTA_MAX_PAYLOAD_SIZE. Nothing is sent in this case.
+     */
+    bool sendStream(const NDLComId receiverId, const void *payload,
+                    const size_t length);
+
+    /**
+     * Called for every reconstructed message. The buffer is only valid during
+     * the call.
+     */
+    virtual void handleStream(const NDLComId senderId, const void *payload,
+                              const size_t length) = 0;
+
+    void handle(const struct NDLComHeader *header, const void *payload,
+                const struct NDLComExternalInterface *origin) final;
+
+    void printStatus(const std::string prefix) const override;
+
+    /** the normal "send()" would not update the stream */
+    void send(const NDLComId receiverId, const void *payload,
+              const size_t length) = delete;
+
+    unsigned long keyframesSent;
+    unsigned long deltasSent;
+    /** payload bytes not sent thanks to deltas, compared to keyframes */
+    unsigned long bytesSaved;
+    unsigned long keyframesRequested;
+    unsigned long messagesReceived;
+    /** deltas which could not be applied */
+    unsigned long messagesLost;
+
+  private:
+    struct Stream {
+        bool used;
+        /** "data" holds the last message of the stream */
+        bool valid;
+        /**
+         * sender: the receiver asked for a keyframe. receiver: we asked the
+         * sender for a keyframe
+         */
+        bool keyframeRequested;
+        NDLComId peerId;
+        uint8_t type;
+        uint8_t seq;
+        uint8_t length;
+        unsigned int sinceKeyframe;
+        unsigned long lastUsed;
+        uint8_t data[NDLCOM_DELTA_MAX_PAYLOAD_SIZE];
+    };
+
+    /**
+     * returns nullptr if "create" is false and there is no such stream. the
+     * least recently used entry is reused otherwise.
+     */
+    struct Stream *findStream(std::vector<struct Stream> &streams,
+                              const NDLComId peerId, const uint8_t type,
+                              const bool create);
+    void handleKeyframe(const NDLComId senderId, const uint8_t type,
+                        const uint8_t seq, const uint8_t *data,
+                        const size_t length);
+    void handleDelta(const NDLComId senderId, const uint8_t type,
+                     const uint8_t seq, const uint8_t *data,
+                     const size_t length);
+
+    const unsigned int keyframeInterval;
+    std::vector<struct Stream> sending;
+    std::vector<struct Stream> receiving;
+    unsigned long useCounter;
+};
+
+} // namespace ndlcom
+
+#endif /*NDLCOM_NODE_HANDLER_DELTA_HPP*/
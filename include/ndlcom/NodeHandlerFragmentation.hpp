@@ -0,0 +1,147 @@
+#ifndef NDLCOM_NODE_HANDLER_FRAGMENTATION_HPP
+#define NDLCOM_NODE_HANDLER_FRAGMENTATION_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include "ndlcom/InternalHandler.hpp"
+#include "ndlcom/Types.h"
+
+/**
+ * The first payload byte of every fragment sent by
+ * ndlcom::NodeHandlerFragmentation. Messages starting with other bytes are
+ * ignored. Override if this clashes with the representation ids used in your
+ * system.
+ */
+#ifndef NDLCOM_FRAGMENT_MARKER
+#define NDLCOM_FRAGMENT_MARKER 0xf4
+#endif
+
+/** bytes used in front of the chunk of user data in each fragment */
+#define NDLCOM_FRAGMENT_HEADER_SIZE 6
+/** size of the chunk of user data carried by every but the last fragment */
+#define NDLCOM_FRAGMENT_CHUNK_SIZE                                             \
+    (NDLCOM_MAX_PAYLOAD_SIZE - NDLCOM_FRAGMENT_HEADER_SIZE)
+
+namespace ndlcom {
+
+/**
+ * @brief Transfer messages larger than NDLCOM_MAX_PAYLOAD_SIZE
+ *
+ * sendLarge() cuts a buffer into fragments of NDLCOM_FRAGMENT_CHUNK_SIZE bytes
+ * and sends all of them at once, without waiting for any answer. Each
+ * fragment is a normal NDLCom packet with a small header in front:
+ *
+ *     [marker][messageId][index, 2 byte LE][count, 2 byte LE] chunk...
+ *
+ * The "messageId" is counted up for every message to the same receiver, so
+ * that fragments of consecutive messages cannot be mixed up.
+ *
+ * The receiving side reassembles the fragments in a fixed number of slots,
+ * each one with a buffer of "maxMessageSize" bytes. All memory is allocated in
+ * the ctor. Fragments may arrive in any order, duplicates are ignored (also
+ * for up to "timeout" after the message was completed). When all fragments of
+ * a message arrived, handleLarge() is called. Incomplete
+ * messages are dropped "timeout" after their last fragment, or when all slots
+ * are in use and a new message starts (the oldest one is dropped then).
+ *
+ * There is no retransmission: if a fragment is lost, the whole message is
+ * lost. Combine with a reliable transport if needed.
+ *
+ * Timeouts are checked in process(), which should be called periodically.
+ */
+class NodeHandlerFragmentation : public NodeHandler {
+  public:
+    NodeHandlerFragmentation(
+        struct NDLComNode &node, size_t maxMessageSize = defaultMaxMessageSize,
+        size_t numberOfSlots = defaultNumberOfSlots,
+        std::chrono::milliseconds timeout = defaultTimeout,
+        std::ostream &out = std::cerr);
+
+    static const size_t defaultMaxMessageSize;
+    static const size_t defaultNumberOfSlots;
+    static const std::chrono::milliseconds defaultTimeout;
+
+    /**
+     * @brief Send "length" bytes to "receiverId", fragmented as needed
+     *
+     * @return false if the message is empty or larger than maxMessageSize.
+     *         Nothing is sent in this case. Also false if a fragment did not
+     *         fit into the send queue of the bridge, see ndlcom::Bridge: a
+     *         handler sending a message of more fragments than the queue has
+     *         slots. The fragments after it are not sent then.
+     */
+    bool sendLarge(const NDLComId receiverId, const void *data,
+                   const size_t length);
+
+    /**
+     * Called for every completely reassembled message. The buffer is only
+     * valid during the call.
+     */
+    virtual void handleLarge(const NDLComId senderId, const void *data,
+                             const size_t length) = 0;
+
+    /**
+     * @brief Drop incomplete messages which timed out. Never blocks.
+     */
+    void process();
+
+    void handle(const struct NDLComHeader *header, const void *payload,
+                const struct NDLComExternalInterface *origin) final;
+
+    void printStatus(const std::string prefix) const override;
+
+    /** the normal "send()" would not add the fragment header */
+    void send(const NDLComId receiverId, const void *payload,
+              const size_t length) = delete;
+
+    unsigned long messagesSent;
+    unsigned long messagesReceived;
+    /** incomplete messages which where dropped due to timeout or eviction */
+    unsigned long messagesDropped;
+    /** fragments which where invalid or did not fit into maxMessageSize */
+    unsigned long fragmentsRejected;
+
+  private:
+    typedef std::chrono::time_point<std::chrono::steady_clock> TimePoint;
+
+    struct Slot {
+        bool used;
+        NDLComId senderId;
+        uint8_t messageId;
+        uint16_t count;
+        uint16_t missing;
+        size_t length;
+        TimePoint lastFragment;
+        /** one flag per fragment. sized for maxMessageSize */
+        std::vector<bool> received;
+        /** sized for maxMessageSize */
+        std::vector<uint8_t> buffer;
+    };
+
+    struct Slot &findSlot(const NDLComId senderId, const uint8_t messageId,
+                          const uint16_t count);
+
+    const size_t maxMessageSize;
+    const size_t maxFragments;
+    const std::chrono::milliseconds timeout;
+    std::vector<struct Slot> slots;
+    /** next messageId to use for every receiver */
+    uint8_t nextMessageId[NDLCOM_MAX_NUMBER_OF_DEVICES];
+    /**
+     * the last message completed for every sender. late duplicates of its
+     * fragments would otherwise occupy a slot until they time out.
+     */
+    struct Completed {
+        bool valid;
+        uint8_t messageId;
+        TimePoint when;
+    } lastCompleted[NDLCOM_MAX_NUMBER_OF_DEVICES];
+};
+
+} // namespace ndlcom
+
+#endif /*NDLCOM_NODE_HANDLER_FRAGMENTATION_HPP*/
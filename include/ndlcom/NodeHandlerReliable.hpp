@@ -0,0 +1,199 @@
+#ifndef NDLCOM_NODE_HANDLER_RELIABLE_HPP
+#define NDLCOM_NODE_HANDLER_RELIABLE_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "ndlcom/InternalHandler.hpp"
+#include "ndlcom/Types.h"
+
+/**
+ * The first payload byte of every message used by ndlcom::NodeHandlerReliable.
+ * Messages starting with other bytes are left alone, so that reliable and
+ * unreliable traffic can be mixed on the same Node. Override if this clashes
+ * with the representation ids used in your system.
+ */
+#ifndef NDLCOM_RELIABLE_MARKER_DATA
+#define NDLCOM_RELIABLE_MARKER_DATA 0xf0
+#endif
+/** like NDLCOM_RELIABLE_MARKER_DATA, but resets the receivers state */
+#ifndef NDLCOM_RELIABLE_MARKER_SYNC
+#define NDLCOM_RELIABLE_MARKER_SYNC 0xf1
+#endif
+/** everything up to a sequence number was received */
+#ifndef NDLCOM_RELIABLE_MARKER_ACK
+#define NDLCOM_RELIABLE_MARKER_ACK 0xf2
+#endif
+/** like NDLCOM_RELIABLE_MARKER_ACK, plus a bitmap of what is missing */
+#ifndef NDLCOM_RELIABLE_MARKER_NACK
+#define NDLCOM_RELIABLE_MARKER_NACK 0xf3
+#endif
+
+/** bytes used in front of the user payload of each data message */
+#define NDLCOM_RELIABLE_HEADER_SIZE 3
+/** largest payload which can be passed into sendReliable() */
+#define NDLCOM_RELIABLE_MAX_PAYLOAD_SIZE                                       \
+    (NDLCOM_MAX_PAYLOAD_SIZE - NDLCOM_RELIABLE_HEADER_SIZE)
+/** the bitmap in NACK messages limits the number of packets in flight */
+#define NDLCOM_RELIABLE_MAX_WINDOW_SIZE 32
+
+namespace ndlcom {
+
+/**
+ * @brief Selective-repeat ARQ between two Nodes
+ *
+ * Adds optional reliable, in-order delivery on top of a ndlcom::Node. Normal
+ * messages of the node are neither touched nor changed in their wire-format.
+ * The reliable messages are ordinary NDLCom packets with a small header in
+ * front of the payload:
+ *
+ *     DATA/SYNC: [marker][epoch][seq] user payload...
+ *     ACK:       [marker][epoch][next expected seq]
+ *     NACK:      [marker][epoch][next expected seq][bitmap, 4 byte LE]
+ *
+ * A separate 8bit sequence number is needed, the "mCounter" of the
+ * NDLComHeader is shared with all other messages sent to the same receiver.
+ * The "epoch" is chosen randomly when a sender starts talking to a peer and
+ * changed whenever it gives up on a message. The first message of an epoch is
+ * sent as SYNC, which resets the receiving side. Messages of an unknown epoch
+ * are ignored, so restarts on either side are survived.
+ *
+ * For each peer the sender keeps a window of up to "windowSize" unacknowledged
+ * messages in preallocated slots. Every received data message is answered: by
+ * an ACK if everything before it arrived, or by a NACK carrying a bitmap of
+ * received messages after the first missing one. The sender frees acknowledged
+ * slots and immediately retransmits the ones reported missing. Messages not
+ * acknowledged within "timeout" are retransmitted, after "maxRetries" attempts
+ * the whole window for this peer is dropped and counted as failed.
+ *
+ * The receiver buffers out-of-order messages and passes them in order to
+ * handleReliable(). Duplicates are acknowledged again, but not delivered.
+ *
+ * Timeouts are only checked in process(), which has to be called
+ * periodically, for example in the same loop as ndlcom::Bridge::process().
+ */
+class NodeHandlerReliable : public NodeHandler {
+  public:
+    NodeHandlerReliable(
+        struct NDLComNode &node, uint8_t windowSize = defaultWindowSize,
+        std::chrono::milliseconds timeout = defaultTimeout,
+        unsigned int maxRetries = defaultMaxRetries,
+        std::ostream &out = std::cerr);
+
+    static const uint8_t defaultWindowSize;
+    static const std::chrono::milliseconds defaultTimeout;
+    static const unsigned int defaultMaxRetries;
+
+    /**
+     * @brief Queue a message for reliable delivery to "receiverId"
+     *
+     * The message is sent right away and kept for retransmission until it is
+     * acknowledged.
+     *
+     * @return false if the window for this receiver is full, the payload is
+     *         larger than NDLCOM_RELIABLE_MAX_PAYLOAD_SIZE or "receiverId" is
+     *         the broadcast address. Nothing is sent in this case.
+     */
+    bool sendReliable(const NDLComId receiverId, const void *payload,
+                      const size_t length);
+
+    /**
+     * @brief Number of messages to this receiver which are not yet
+     * acknowledged
+     */
+    size_t getPendingCount(const NDLComId receiverId) const;
+
+    /**
+     * @brief Retransmit messages which timed out. Never blocks.
+     */
+    void process();
+
+    /**
+     * Called for each reliable message, exactly once and in order for each
+     * sender.
+     */
+    virtual void handleReliable(const NDLComId senderId, const void *payload,
+                                const size_t length) = 0;
+
+    /**
+     * Called when a message could not be delivered after "maxRetries"
+     * retransmissions. The default implementation prints to "out".
+     */
+    virtual void handleFailure(const NDLComId receiverId, const void *payload,
+                               const size_t length);
+
+    void handle(const struct NDLComHeader *header, const void *payload,
+                const struct NDLComExternalInterface *origin) final;
+
+    void printStatus(const std::string prefix) const override;
+
+    /** the normal "send()" would bypass the window */
+    void send(const NDLComId receiverId, const void *payload,
+              const size_t length) = delete;
+
+    /** totals over all peers */
+    unsigned long messagesSent;
+    unsigned long messagesRetransmitted;
+    unsigned long messagesFailed;
+    unsigned long messagesDelivered;
+    unsigned long messagesDuplicate;
+
+  private:
+    typedef std::chrono::time_point<std::chrono::steady_clock> TimePoint;
+
+    /** one message in the retransmit buffer of the sender */
+    struct TxSlot {
+        bool used;
+        bool sync;
+        uint8_t retries;
+        uint8_t length;
+        TimePoint lastSent;
+        uint8_t data[NDLCOM_MAX_PAYLOAD_SIZE];
+    };
+    /** one message waiting in the reorder buffer of the receiver */
+    struct RxSlot {
+        bool used;
+        uint8_t length;
+        uint8_t data[NDLCOM_RELIABLE_MAX_PAYLOAD_SIZE];
+    };
+    /** state for one remote deviceId, allocated when first needed */
+    struct Peer {
+        /** sender side. slots are indexed by "seq % windowSize" */
+        uint8_t txEpoch;
+        bool txNeedSync;
+        uint8_t txBase;
+        uint8_t txNext;
+        std::vector<struct TxSlot> tx;
+        /** receiver side */
+        bool rxKnown;
+        uint8_t rxEpoch;
+        uint8_t rxNext;
+        std::vector<struct RxSlot> rx;
+    };
+
+    struct Peer &getPeer(const NDLComId deviceId);
+    void transmit(const NDLComId receiverId, struct TxSlot &slot);
+    void handleData(const NDLComId senderId, bool sync, const uint8_t *data,
+                    size_t length);
+    void handleAck(const NDLComId senderId, bool nack, const uint8_t *data,
+                   size_t length);
+    void sendAck(const NDLComId receiverId, struct Peer &peer);
+    /** drop everything in flight, the next message starts a new epoch */
+    void resetSender(const NDLComId receiverId, struct Peer &peer);
+
+    const uint8_t windowSize;
+    const std::chrono::milliseconds timeout;
+    const unsigned int maxRetries;
+    std::map<NDLComId, std::unique_ptr<struct Peer>> peers;
+    std::minstd_rand epochGenerator;
+};
+
+} // namespace ndlcom
+
+#endif /*NDLCOM_NODE_HANDLER_RELIABLE_HPP*/
@@ -146,6 +146,23 @@ void ndlcomParserDestroy(struct NDLComParser *parser);
 size_t ndlcomParserReceive(struct NDLComParser *parser, const void *newData,
                            size_t newDataLen);
 
+/**
+ * @brief Like ndlcomParserReceive(), for messages from ndlcomEncodeFramed()
+ *
+ * There are no start/stop flags to synchronize on, the bytes have to start at
+ * a message boundary and nothing may be lost in between. Messages with a bad
+ * crc are counted and dropped as usual.
+ *
+ * @param parser Pointer to state information.
+ * @param newData Pointer to received data that should be parsed.
+ * @param newDataLen Number of bytes to be parsed.
+ * @param withCrc the messages carry a crc
+ * @return number of accepted bytes
+ */
+size_t ndlcomParserReceiveFramed(struct NDLComParser *parser,
+                                 const void *newData, size_t newDataLen,
+                                 const int withCrc);
+
 /**
  * @brief Return true if a packet is available.
  *
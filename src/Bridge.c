@@ -1,11 +1,14 @@
 #include "ndlcom/Bridge.h"
 
 #include "ndlcom/BridgeHandler.h"
+#include "ndlcom/Compression.h"
 #include "ndlcom/Encoder.h"
 #include "ndlcom/ExternalInterface.h"
 #include "ndlcom/Parser.h"
 #include "ndlcom/Routing.h"
 
+#include <string.h>
+
 /**
  * Size if the temporary rxBuffer which is the block size of data when calling
  * "read()" of the external interfaces during parsing. The size of one encoded
@@ -45,6 +48,56 @@ static inline int deviceIdIsNotInternallyUsed(const struct NDLComBridge *bridge,
             bridge);
 }
 
+/*
+ * The variants of one outgoing message, as prepared by
+ * ndlcomBridgeProcessOutgoingMessage(). A length of 0 means there is none.
+ */
+struct NDLComBridgeEncoded {
+    const uint8_t *txBuffer;
+    size_t len;
+    const uint8_t *compressedBuffer;
+    size_t compressedLen;
+    /* the payload would look compressed, see "ndlcom/Compression.h" */
+    int compressRefused;
+    /* without the crc, which follows if any interface wants it */
+    const uint8_t *framedBuffer;
+    size_t framedLen;
+};
+
+/*
+ * Writes an encoded message to one ExternalInterface, or into its batch.
+ * Interfaces asking for compression get the compressed variant, if there is
+ * one, and nothing if the payload cannot be told apart from a compressed one.
+ * Interfaces using plain frames get the frame.
+ */
+static inline void
+ndlcomBridgeWriteExternalInterface(struct NDLComExternalInterface *externalInterface,
+                                   const struct NDLComBridgeEncoded *encoded) {
+    if (externalInterface->flags & NDLCOM_EXTERNAL_INTERFACE_FLAGS_FRAMED) {
+        ndlcomExternalInterfaceQueue(
+            externalInterface, encoded->framedBuffer,
+            encoded->framedLen + (externalInterface->flags &
+                                          NDLCOM_EXTERNAL_INTERFACE_FLAGS_FRAMED_CRC
+                                      ? sizeof(NDLComCrc)
+                                      : 0));
+    } else if (encoded->compressRefused &&
+               (externalInterface->flags &
+                NDLCOM_EXTERNAL_INTERFACE_FLAGS_COMPRESS)) {
+        externalInterface->packetsRefused++;
+        return;
+    } else if (encoded->compressedLen &&
+               (externalInterface->flags &
+                NDLCOM_EXTERNAL_INTERFACE_FLAGS_COMPRESS)) {
+        ndlcomExternalInterfaceQueue(externalInterface,
+                                     encoded->compressedBuffer,
+                                     encoded->compressedLen);
+    } else {
+        ndlcomExternalInterfaceQueue(externalInterface, encoded->txBuffer,
+                                     encoded->len);
+    }
+    externalInterface->packetsTransmitted++;
+}
+
 /*
  * After messages where received by an external interface or after they are
  * assembled externally and inserted using "ndlcomBridgeSendRaw()" they pass
@@ -70,9 +123,91 @@ ndlcomBridgeProcessOutgoingMessage(struct NDLComBridge *bridge,
      * but makes the code easier to reason...
      *
      * NOTE: Variable length array, so this will eventually safe some stack?
+     * Unless the bridge has a scratch buffer, then it is a dummy.
      */
-    uint8_t txBuffer[NDLCOM_MAX_ENCODED_MESSAGE_SIZE_FOR_PACKET(header)];
-    size_t len = ndlcomEncode(txBuffer, sizeof(txBuffer), header, payload);
+    uint8_t txStack[bridge->txScratch
+                        ? 1
+                        : NDLCOM_MAX_ENCODED_MESSAGE_SIZE_FOR_PACKET(header)];
+    uint8_t *txBuffer = bridge->txScratch ? bridge->txScratch : txStack;
+    const size_t txSize = bridge->txScratch ? NDLCOM_MAX_ENCODED_MESSAGE_SIZE
+                                            : sizeof(txStack);
+    size_t len = 0;
+
+    /**
+     * The compressed variant and the plain frame are only prepared if at
+     * least one interface wants them. The buffers are small VLAs otherwise,
+     * or behind the encoded message in the scratch buffer.
+     */
+    int escaped = 0;
+    int compress = 0;
+    int framed = 0;
+    int framedCrc = 0;
+    list_for_each_entry(externalInterface, &bridge->externalInterfaceList,
+                        list) {
+        if (externalInterface->flags & NDLCOM_EXTERNAL_INTERFACE_FLAGS_FRAMED) {
+            framed = 1;
+            framedCrc |= externalInterface->flags &
+                         NDLCOM_EXTERNAL_INTERFACE_FLAGS_FRAMED_CRC;
+        } else {
+            escaped = 1;
+            compress |= externalInterface->flags &
+                        NDLCOM_EXTERNAL_INTERFACE_FLAGS_COMPRESS;
+        }
+    }
+    /* links using only plain frames do not pay for escaping */
+    if (escaped) {
+        len = ndlcomEncode(txBuffer, txSize, header, payload);
+    }
+    const int compressOnStack = compress && !bridge->txScratch;
+    uint8_t compressedPayloadStack[compressOnStack ? NDLCOM_MAX_PAYLOAD_SIZE
+                                                   : 1];
+    uint8_t compressedBufferStack[compressOnStack ? txSize : 1];
+    uint8_t *compressedBuffer =
+        bridge->txScratch ? txBuffer + NDLCOM_MAX_ENCODED_MESSAGE_SIZE
+                          : compressedBufferStack;
+    uint8_t *compressedPayload =
+        bridge->txScratch ? txBuffer + 2 * NDLCOM_MAX_ENCODED_MESSAGE_SIZE
+                          : compressedPayloadStack;
+    size_t compressedLen = 0;
+    int compressRefused = 0;
+    if (compress) {
+        struct NDLComHeader compressedHeader = *header;
+        const size_t compressedDataLen =
+            ndlcomCompressPayload(compressedPayload, NDLCOM_MAX_PAYLOAD_SIZE,
+                                  payload, header->mDataLen);
+        if (compressedDataLen) {
+            compressedHeader.mDataLen = compressedDataLen;
+            compressedLen = ndlcomEncode(compressedBuffer, txSize,
+                                         &compressedHeader, compressedPayload);
+        } else if (header->mDataLen && *(const uint8_t *)payload ==
+                                           NDLCOM_COMPRESSION_MARKER) {
+            compressRefused = 1;
+        }
+    }
+
+    const int framedOnStack = framed && !bridge->txScratch;
+    uint8_t framedStack[framedOnStack
+                            ? NDLCOM_MAX_DECODED_MESSAGE_SIZE_FOR_PACKET(header)
+                            : 1];
+    struct NDLComBridgeEncoded encoded;
+    encoded.txBuffer = txBuffer;
+    encoded.len = len;
+    encoded.compressedBuffer = compressedBuffer;
+    encoded.compressedLen = compressedLen;
+    encoded.compressRefused = compressRefused;
+    encoded.framedBuffer = framedStack;
+    encoded.framedLen = 0;
+    if (framed) {
+        uint8_t *framedBuffer =
+            bridge->txScratch ? txBuffer + 2 * NDLCOM_MAX_ENCODED_MESSAGE_SIZE +
+                                    NDLCOM_MAX_PAYLOAD_SIZE
+                              : framedStack;
+        ndlcomEncodeFramed(framedBuffer,
+                           NDLCOM_MAX_DECODED_MESSAGE_SIZE_FOR_PACKET(header),
+                           header, payload, framedCrc);
+        encoded.framedBuffer = framedBuffer;
+        encoded.framedLen = sizeof(struct NDLComHeader) + header->mDataLen;
+    }
 
     /**
      * Some ExternalInterface are "mirrors", they want to get _all_ messages,
@@ -85,8 +220,8 @@ ndlcomBridgeProcessOutgoingMessage(struct NDLComBridge *bridge,
             /* only debug-interfaces! */
             if (externalInterface->flags &
                 NDLCOM_EXTERNAL_INTERFACE_FLAGS_DEBUG_MIRROR) {
-                externalInterface->write(externalInterface->context, txBuffer,
-                                         len);
+                ndlcomBridgeWriteExternalInterface(externalInterface,
+                                                   &encoded);
             }
         }
     }
@@ -117,8 +252,8 @@ ndlcomBridgeProcessOutgoingMessage(struct NDLComBridge *bridge,
                 /* do not use the mirror interfaces, they already got the message! */
                 if (!(externalInterface->flags &
                     NDLCOM_EXTERNAL_INTERFACE_FLAGS_DEBUG_MIRROR)) {
-                    externalInterface->write(externalInterface->context,
-                                             txBuffer, len);
+                    ndlcomBridgeWriteExternalInterface(externalInterface,
+                                                       &encoded);
                 }
             }
         }
@@ -157,25 +292,20 @@ ndlcomBridgeProcessOutgoingMessage(struct NDLComBridge *bridge,
             /**
              * Finally write the ExternalInterface using its function pointer.
              */
-            destination->write(destination->context, txBuffer, len);
+            ndlcomBridgeWriteExternalInterface(destination, &encoded);
         }
     }
 }
 
 /**
- * Called for messages which:
- * - where successfully received from an external interface, after the update
- *   to the routing table
- * - after a new message is summoned in "ndlcomBridgeSendRaw()", from the
- *   internal side directed at the world
+ * Forwards one message and calls the handlers.
  *
  * NOTE: "origin" can be either be a pointer to one of the external interfaces
  * or the "bridge" pointer itself, if it comes from internal.
  */
-static void ndlcomBridgeProcessDecodedMessage(struct NDLComBridge *bridge,
-                                              const struct NDLComHeader *header,
-                                              const void *payload,
-                                              void *origin) {
+static void ndlcomBridgeHandleMessage(struct NDLComBridge *bridge,
+                                      const struct NDLComHeader *header,
+                                      const void *payload, void *origin) {
     /* used as loop-variable for the lists */
     struct NDLComBridgeHandler *bridgeHandler, *temp;
 
@@ -210,20 +340,89 @@ static void ndlcomBridgeProcessDecodedMessage(struct NDLComBridge *bridge,
     }
 }
 
+/**
+ * Called for messages which:
+ * - where successfully received from an external interface, after the update
+ *   to the routing table
+ * - after a new message is summoned in "ndlcomBridgeSendRaw()", from the
+ *   internal side directed at the world
+ *
+ * Afterwards the messages queued by the handlers are processed, including the
+ * ones queued meanwhile. A slot stays in use until its message is done, so
+ * the handlers can see the payload in the queue.
+ */
+static void ndlcomBridgeProcessDecodedMessage(struct NDLComBridge *bridge,
+                                              const struct NDLComHeader *header,
+                                              const void *payload,
+                                              void *origin) {
+    /* a handler can still read an interface and end up here again. only the
+     * outermost call works off the queue */
+    const uint8_t wasDispatching = bridge->dispatching;
+    struct NDLComBridgeQueuedMessage *queued;
+
+    bridge->dispatching = 1;
+    ndlcomBridgeHandleMessage(bridge, header, payload, origin);
+    while (!wasDispatching && bridge->sendQueueUsed) {
+        queued = &bridge->sendQueue[bridge->sendQueueHead];
+        ndlcomBridgeHandleMessage(bridge, &queued->header, queued->payload,
+                                  bridge);
+        bridge->sendQueueHead =
+            (bridge->sendQueueHead + 1) % bridge->sendQueueSize;
+        bridge->sendQueueUsed--;
+    }
+    bridge->dispatching = wasDispatching;
+}
+
+/* copies a message sent by a handler into the next free slot, false if there
+ * is none */
+static uint8_t ndlcomBridgeQueueMessage(struct NDLComBridge *bridge,
+                                        const struct NDLComHeader *header,
+                                        const void *payload) {
+    struct NDLComBridgeQueuedMessage *queued;
+    if (bridge->sendQueueUsed == bridge->sendQueueSize) {
+        bridge->sendQueueDropped++;
+        return 0;
+    }
+    queued = &bridge->sendQueue[(bridge->sendQueueHead + bridge->sendQueueUsed) %
+                                bridge->sendQueueSize];
+    queued->header = *header;
+    memcpy(queued->payload, payload, header->mDataLen);
+    bridge->sendQueueUsed++;
+    return 1;
+}
+
 /* reading and parsing bytes from one ExternalInterface */
 static size_t ndlcomBridgeProcessExternalInterface(
     struct NDLComBridge *bridge,
     struct NDLComExternalInterface *externalInterface) {
 
-    /* some variables we'll need later */
-    uint8_t rawReadBuffer[NDLCOM_BRIDGE_TEMPORARY_RXBUFFER_SIZE];
+    /* some variables we'll need later. the buffer is a dummy if the bridge
+     * has a scratch buffer */
+    uint8_t rawReadStack[bridge->rxScratch
+                             ? 1
+                             : NDLCOM_BRIDGE_TEMPORARY_RXBUFFER_SIZE];
+    uint8_t *rawReadBuffer = rawReadStack;
+    size_t rawReadSize = sizeof(rawReadStack);
     size_t bytesRead;
     size_t bytesProcessed = 0;
     const struct NDLComHeader *header;
     const void *payload;
+    /* used if a compressed payload is received */
+    struct NDLComHeader decompressedHeader;
+    uint8_t decompressedPayload[NDLCOM_MAX_PAYLOAD_SIZE];
+    size_t decompressedDataLen;
+
+    if (bridge->rxScratch) {
+        /* called again by a handler, while the buffer is still in use */
+        if (bridge->rxScratchBusy) {
+            return 0;
+        }
+        rawReadBuffer = bridge->rxScratch;
+        rawReadSize = bridge->rxScratchSize;
+    }
 
     bytesRead = externalInterface->read(externalInterface->context,
-                                        rawReadBuffer, sizeof(rawReadBuffer));
+                                        rawReadBuffer, rawReadSize);
 
     /**
      * shave off some cycles in the hot-path in case we could not read
@@ -231,16 +430,49 @@ static size_t ndlcomBridgeProcessExternalInterface(
     if (bytesRead == 0) {
         return 0;
     }
+    if (bridge->rxScratch) {
+        bridge->rxScratchBusy = 1;
+    }
 
     do {
-        bytesProcessed += ndlcomParserReceive(&externalInterface->parser,
-                                              rawReadBuffer + bytesProcessed,
-                                              bytesRead - bytesProcessed);
+        if (externalInterface->flags & NDLCOM_EXTERNAL_INTERFACE_FLAGS_FRAMED) {
+            bytesProcessed += ndlcomParserReceiveFramed(
+                &externalInterface->parser, rawReadBuffer + bytesProcessed,
+                bytesRead - bytesProcessed,
+                externalInterface->flags &
+                    NDLCOM_EXTERNAL_INTERFACE_FLAGS_FRAMED_CRC);
+        } else {
+            bytesProcessed += ndlcomParserReceive(
+                &externalInterface->parser, rawReadBuffer + bytesProcessed,
+                bytesRead - bytesProcessed);
+        }
 
         if (ndlcomParserHasPacket(&externalInterface->parser)) {
 
             header = ndlcomParserGetHeader(&externalInterface->parser);
             payload = ndlcomParserGetPacket(&externalInterface->parser);
+            externalInterface->packetsReceived++;
+
+            /*
+             * Restore compressed payloads. Everything behind this point only
+             * sees the original message.
+             */
+            if ((externalInterface->flags &
+                 NDLCOM_EXTERNAL_INTERFACE_FLAGS_COMPRESS) &&
+                !(externalInterface->flags &
+                  NDLCOM_EXTERNAL_INTERFACE_FLAGS_FRAMED) &&
+                header->mDataLen &&
+                *(const uint8_t *)payload == NDLCOM_COMPRESSION_MARKER) {
+                decompressedDataLen = ndlcomDecompressPayload(
+                    decompressedPayload, sizeof(decompressedPayload), payload,
+                    header->mDataLen);
+                if (decompressedDataLen) {
+                    decompressedHeader = *header;
+                    decompressedHeader.mDataLen = decompressedDataLen;
+                    header = &decompressedHeader;
+                    payload = decompressedPayload;
+                }
+            }
 
             /*
              * Got a packet!
@@ -295,6 +527,9 @@ static size_t ndlcomBridgeProcessExternalInterface(
         }
 
     } while (bytesRead != bytesProcessed);
+    if (rawReadBuffer == bridge->rxScratch) {
+        bridge->rxScratchBusy = 0;
+    }
     return bytesProcessed;
 }
 
@@ -309,6 +544,31 @@ void ndlcomBridgeInit(struct NDLComBridge *bridge) {
 
     /* Per default, enable forwarding */
     bridge->flags = NDLCOM_BRIDGE_FLAGS_FORWARDING_ENABLED;
+
+    /* and use the stack */
+    ndlcomBridgeSetScratchBuffers(bridge, 0, 0, 0);
+
+    /* handlers sending messages call the bridge directly */
+    bridge->dispatching = 0;
+    ndlcomBridgeSetSendQueue(bridge, 0, 0);
+}
+
+void ndlcomBridgeSetScratchBuffers(struct NDLComBridge *bridge, void *rxBuffer,
+                                   const size_t rxSize, void *txBuffer) {
+    bridge->rxScratch = rxSize ? (uint8_t *)rxBuffer : 0;
+    bridge->rxScratchSize = bridge->rxScratch ? rxSize : 0;
+    bridge->txScratch = (uint8_t *)txBuffer;
+    bridge->rxScratchBusy = 0;
+}
+
+void ndlcomBridgeSetSendQueue(struct NDLComBridge *bridge,
+                              struct NDLComBridgeQueuedMessage *slots,
+                              const size_t count) {
+    bridge->sendQueue = count ? slots : 0;
+    bridge->sendQueueSize = bridge->sendQueue ? count : 0;
+    bridge->sendQueueHead = 0;
+    bridge->sendQueueUsed = 0;
+    bridge->sendQueueDropped = 0;
 }
 
 void ndlcomBridgeSetFlags(struct NDLComBridge *bridge, const uint8_t flags)
@@ -317,9 +577,9 @@ void ndlcomBridgeSetFlags(struct NDLComBridge *bridge, const uint8_t flags)
 }
 
 /* inserting new messages into the bridge */
-void ndlcomBridgeSendRaw(struct NDLComBridge *bridge,
-                         const struct NDLComHeader *header,
-                         const void *payload) {
+uint8_t ndlcomBridgeSendRaw(struct NDLComBridge *bridge,
+                            const struct NDLComHeader *header,
+                            const void *payload) {
     /*
      * Inserting new messages into the bridge. By using the "bridge" itself as
      * origin, we can later detect messages which are not coming from one of
@@ -328,8 +588,24 @@ void ndlcomBridgeSendRaw(struct NDLComBridge *bridge,
      * NOTE: We could also call "ndlcomBridgeProcessOutgoingMessage()" instead.
      * This would prevent internal interfaces from being able to see messages
      * originating from inside...
+     *
+     * Sent by a handler, the message waits in the queue until the current one
+     * is done. It is flushed by whoever called the bridge in the first place.
      */
+    if (bridge->dispatching && bridge->sendQueue) {
+        return ndlcomBridgeQueueMessage(bridge, header, payload);
+    }
     ndlcomBridgeProcessDecodedMessage(bridge, header, payload, bridge);
+    ndlcomBridgeFlush(bridge);
+    return 1;
+}
+
+void ndlcomBridgeFlush(struct NDLComBridge *bridge) {
+    struct NDLComExternalInterface *externalInterface;
+    list_for_each_entry(externalInterface, &bridge->externalInterfaceList,
+                        list) {
+        ndlcomExternalInterfaceFlush(externalInterface);
+    }
 }
 
 /*
@@ -365,6 +641,8 @@ size_t ndlcomBridgeProcessOnce(struct NDLComBridge *bridge) {
         /* guard against removal of handlers by other handlers... */
         CHECK_LIST_IN_LOOP(externalInterface, temp, list);
     }
+    /* everything forwarded during this round goes out in batches */
+    ndlcomBridgeFlush(bridge);
     return bytesReadOverall;
 }
 
@@ -431,7 +709,9 @@ void ndlcomBridgeDeregisterExternalInterface(
     if (!ndlcomBridgeCheckExternalInterface(bridge, externalInterface)) {
         return;
     }
-    /* at first remove the known destination from the routing table */
+    /* pending messages still belong to this interface */
+    ndlcomExternalInterfaceFlush(externalInterface);
+    /* then remove the known destination from the routing table */
     ndlcomRoutingTableInvalidateInterface(&bridge->routingTable,
                                           externalInterface);
     /* and now we can delete it */
@@ -3,6 +3,9 @@
 #include <stddef.h>
 #include <iomanip>
 #include <limits>
+#include <map>
+#include <mutex>
+#include <stdexcept>
 
 #include "ndlcom/BridgeHandler.hpp"
 #include "ndlcom/ExternalInterface.hpp"
@@ -67,7 +70,60 @@ ndlcom::setRoutingByString(std::weak_ptr<class ndlcom::ExternalInterfaceBase> p,
     }
 }
 
-Bridge::Bridge(std::ostream &_out) : out(_out) { ndlcomBridgeInit(&bridge); }
+void
+ndlcom::setOptionsByString(std::weak_ptr<class ndlcom::ExternalInterfaceBase> p,
+                           std::string conn, std::ostream &out) {
+
+    std::shared_ptr<class ndlcom::ExternalInterfaceBase> interface = p.lock();
+
+    for (auto part : splitStringIntoStrings(conn, '&')) {
+        if (part.empty()) {
+            continue;
+        }
+        if (part.find_first_not_of("0123456789,") == std::string::npos) {
+            setRoutingByString(p, part, out);
+            continue;
+        }
+        const size_t equal = part.find('=');
+        const std::string key = part.substr(0, equal);
+        const std::string value =
+            equal == std::string::npos ? "" : part.substr(equal + 1);
+        bool known;
+        try {
+            known = interface->setOption(key, value);
+        } catch (const std::invalid_argument &e) {
+            out << "ParseUri: ignoring option '" << part
+                << "' with invalid value for '" << interface->label << "'\n";
+            continue;
+        } catch (const std::out_of_range &e) {
+            out << "ParseUri: ignoring option '" << part
+                << "' with value out of range for '" << interface->label
+                << "'\n";
+            continue;
+        }
+        if (known) {
+            out << "ParseUri: set option '" << part << "' for '"
+                << interface->label << "'\n";
+        } else {
+            out << "ParseUri: ignoring unknown option '" << part << "' for '"
+                << interface->label << "'\n";
+        }
+    }
+}
+
+const size_t Bridge::defaultRxScratchSize = 4096;
+// nesting as before, unless asked for
+const size_t Bridge::defaultSendQueueSize = 0;
+
+Bridge::Bridge(std::ostream &_out, size_t rxScratchSize, size_t sendQueueSize)
+    : rxScratch(std::max<size_t>(rxScratchSize, 1)),
+      txScratch(NDLCOM_BRIDGE_TX_SCRATCH_SIZE), sendQueue(sendQueueSize),
+      out(_out) {
+    ndlcomBridgeInit(&bridge);
+    ndlcomBridgeSetScratchBuffers(&bridge, rxScratch.data(), rxScratch.size(),
+                                  txScratch.data());
+    ndlcomBridgeSetSendQueue(&bridge, sendQueue.data(), sendQueue.size());
+}
 
 Bridge::~Bridge() {
     // no iterators, as the call inside the loop would invalidate them
@@ -101,9 +157,22 @@ Bridge::~Bridge() {
     }
 }
 
+std::vector<std::shared_ptr<class ndlcom::ExternalInterfaceBase>>
+Bridge::getAllInterfaces() const {
+    std::vector<std::shared_ptr<class ndlcom::ExternalInterfaceBase>> retval;
+    for (auto it : externalInterfaces) {
+        retval.push_back(it);
+        // the clients of a server, right behind it
+        std::vector<std::shared_ptr<class ndlcom::ExternalInterfaceBase>>
+            children = it->getChildren();
+        retval.insert(retval.end(), children.begin(), children.end());
+    }
+    return retval;
+}
+
 std::weak_ptr<ndlcom::ExternalInterfaceBase>
 Bridge::getInterfaceByName(const std::string name) const {
-    for (auto it : externalInterfaces) {
+    for (auto it : getAllInterfaces()) {
         if (it->label == name) {
             return it;
         }
@@ -113,7 +182,7 @@ Bridge::getInterfaceByName(const std::string name) const {
 
 std::weak_ptr<class ndlcom::ExternalInterfaceBase> Bridge::getInterfaceByOrigin(
     const struct NDLComExternalInterface *origin) const {
-    for (auto it : externalInterfaces) {
+    for (auto it : getAllInterfaces()) {
         if (&it->handler == origin) {
             return it;
         }
@@ -123,13 +192,13 @@ std::weak_ptr<class ndlcom::ExternalInterfaceBase> Bridge::getInterfaceByOrigin(
 
 std::vector<std::string> Bridge::getInterfaceNames() const {
     std::vector<std::string> retval;
-    for (auto it : externalInterfaces) {
+    for (auto it : getAllInterfaces()) {
         retval.push_back(it->label);
     }
     return retval;
 }
 
-size_t Bridge::getInterfaceCount() const { return externalInterfaces.size(); }
+size_t Bridge::getInterfaceCount() const { return getAllInterfaces().size(); }
 
 std::weak_ptr<class ndlcom::BridgeHandler> Bridge::enablePrintAll() {
     return createBridgeHandler<class ndlcom::BridgePrintAll>();
@@ -139,18 +208,78 @@ std::weak_ptr<class ndlcom::BridgeHandler> Bridge::enablePrintMiss() {
     return createBridgeHandler<class ndlcom::BridgePrintMissEvents>();
 }
 
+namespace {
+/** the known uri schemes, shared by all bridges */
+struct InterfaceRegistry {
+    InterfaceRegistry()
+        : factories{
+              {"serial", Bridge::interfaceFactory<ExternalInterfaceSerial>()},
+              {"udp", Bridge::interfaceFactory<ExternalInterfaceUdp>()},
+              {"udpmc",
+               Bridge::interfaceFactory<ExternalInterfaceUdpMulticast>()},
+              {"fpga", Bridge::interfaceFactory<ExternalInterfaceFpga>()},
+              {"pipe", Bridge::interfaceFactory<ExternalInterfacePipe>()},
+              {"can", Bridge::interfaceFactory<ExternalInterfaceCan>()},
+              {"pty", Bridge::interfaceFactory<ExternalInterfacePty>()},
+              {"tcpclient",
+               Bridge::interfaceFactory<ExternalInterfaceTcpClient>()},
+              {"tcpserver",
+               Bridge::interfaceFactory<ExternalInterfaceTcpServer>()},
+              {"unix", Bridge::interfaceFactory<ExternalInterfaceUnixServer>()},
+          } {}
+    std::mutex mutex;
+    std::map<std::string, Bridge::InterfaceFactory> factories;
+};
+
+InterfaceRegistry &interfaceRegistry() {
+    static InterfaceRegistry registry;
+    return registry;
+}
+} // namespace
+
+void Bridge::registerInterfaceType(const std::string &scheme,
+                                   InterfaceFactory factory) {
+    InterfaceRegistry &registry = interfaceRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.factories[scheme] = factory;
+}
+
+std::vector<std::string> Bridge::getInterfaceTypes() {
+    InterfaceRegistry &registry = interfaceRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    std::vector<std::string> retval;
+    for (const auto &it : registry.factories) {
+        retval.push_back(it.first);
+    }
+    return retval;
+}
+
 std::weak_ptr<class ndlcom::ExternalInterfaceBase>
 Bridge::createInterface(std::string uri, uint8_t flags) {
-    std::shared_ptr<class ndlcom::ExternalInterfaceBase> ret(
-        createInterfaceByUri<ExternalInterfaceSerial, ExternalInterfaceUdp,
-                             ExternalInterfaceFpga, ExternalInterfacePipe,
-                             ExternalInterfaceCan, ExternalInterfacePty,
-                             ExternalInterfaceTcpClient>(uri, flags));
-    return ret;
+    const size_t pos = uri.find("://");
+    if (pos == std::string::npos) {
+        return std::weak_ptr<class ndlcom::ExternalInterfaceBase>();
+    }
+    InterfaceFactory factory;
+    {
+        InterfaceRegistry &registry = interfaceRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        auto it = registry.factories.find(uri.substr(0, pos));
+        if (it == registry.factories.end()) {
+            return std::weak_ptr<class ndlcom::ExternalInterfaceBase>();
+        }
+        factory = it->second;
+    }
+    // called without the lock, the factory may as well register something
+    return factory(*this, uri, flags);
 }
 
 void Bridge::printStatus() {
     out << "--- Bridge status ---\n";
+    if (!sendQueue.empty()) {
+        out << "send queue: " << sendQueue.size()
+            << " slots, dropped: " << bridge.sendQueueDropped << "\n";
+    }
     out << "ndlcomNode:\n";
     if (!nodes.empty()) {
         for (auto it : nodes) {
@@ -171,6 +300,48 @@ void Bridge::printStatus() {
     }
 }
 
+struct BridgeMetrics Bridge::getMetrics() const {
+    struct BridgeMetrics retval;
+    retval.timestamp = std::chrono::system_clock::now();
+    retval.sendQueueDropped = bridge.sendQueueDropped;
+    for (auto it : getAllInterfaces()) {
+        retval.interfaces.push_back(it->getMetrics());
+    }
+    for (auto it : bridgeHandler) {
+        std::shared_ptr<class ndlcom::BridgeMissEvents> missEvents =
+            std::dynamic_pointer_cast<class ndlcom::BridgeMissEvents>(it);
+        if (missEvents) {
+            std::vector<struct MissEventMetrics> events =
+                missEvents->getMissEvents();
+            retval.missEvents.insert(retval.missEvents.end(), events.begin(),
+                                     events.end());
+        }
+    }
+    for (size_t deviceId = 0;
+         deviceId < sizeof(bridge.routingTable.table) /
+                        sizeof(bridge.routingTable.table[0]);
+         ++deviceId) {
+        const void *destination = bridge.routingTable.table[deviceId];
+        if (destination == NDLCOM_ROUTING_ALL_INTERFACES) {
+            continue;
+        }
+        struct RoutingMetrics entry;
+        entry.deviceId = deviceId;
+        if (destination == &bridge) {
+            // see the note in "Routing.h" on this special case
+            entry.interface = "internal";
+        } else {
+            std::shared_ptr<class ndlcom::ExternalInterfaceBase> interface =
+                getInterfaceByOrigin(
+                    static_cast<const struct NDLComExternalInterface *>(
+                        destination)).lock();
+            entry.interface = interface ? interface->label : "<unknown>";
+        }
+        retval.routing.push_back(entry);
+    }
+    return retval;
+}
+
 void Bridge::printRoutingTable() {
     struct NDLComExternalInterface *externalInterface;
     if (list_empty(&bridge.externalInterfaceList)) {
@@ -221,11 +392,11 @@ Bridge::enableOwnId(const NDLComId nodeDeviceId, bool print) {
 void Bridge::process() { ndlcomBridgeProcess(&bridge); }
 void Bridge::processOnce() { ndlcomBridgeProcessOnce(&bridge); }
 
-void Bridge::sendMessageRaw(struct ndlcom::RawPayload msg) {
-    ndlcomBridgeSendRaw(&bridge, &msg.header, msg.data());
+bool Bridge::sendMessageRaw(struct ndlcom::RawPayload msg) {
+    return ndlcomBridgeSendRaw(&bridge, &msg.header, msg.data());
 }
 
-void Bridge::sendMessageRaw(const struct NDLComHeader *header,
+bool Bridge::sendMessageRaw(const struct NDLComHeader *header,
                             const void *payload) {
-    ndlcomBridgeSendRaw(&bridge, header, payload);
+    return ndlcomBridgeSendRaw(&bridge, header, payload);
 }
@@ -1,11 +1,11 @@
 #include "ndlcom/BridgeHandler.hpp"
 
+#include <algorithm>
 #include <iomanip>
 // input/output
 #include <iostream>
 #include <limits>
 #include <string>
-#include <string.h> // memset
 
 using namespace ndlcom;
 
@@ -24,10 +24,12 @@ void BridgePrintAll::handle(const struct NDLComHeader *header,
     out << std::string(" bytes of payload\n");
 }
 
+const uint16_t BridgeMissEvents::defaultWindowSize = 256;
+
 BridgeMissEvents::BridgeMissEvents(struct NDLComBridge &bridge,
                                    std::ostream &_out)
-    : BridgeHandler(bridge, "BridgeMissEvents", _out),
-      numberOfPacketMissEvents{{0}}, expectedNextPacketCounter{{0}} {}
+    : BridgeHandler(bridge, "BridgeMissEvents", _out), table(16),
+      usedSlots(0), windowSize(defaultWindowSize) {}
 
 void BridgeMissEvents::handle(
     const struct NDLComHeader *header, const void *payload,
@@ -36,29 +38,99 @@ void BridgeMissEvents::handle(
     isMiss(header);
 }
 
+void BridgeMissEvents::setWindowSize(uint16_t packets) {
+    windowSize = packets ? packets : 1;
+}
+
+uint16_t BridgeMissEvents::getWindowSize() const { return windowSize; }
+
 void BridgeMissEvents::printStatus(const std::string prefix) const {
     HandlerCommon::printStatus(prefix);
-    // print "miss statistics"...
-    bool printed = false;
-    for (int fromId = 0; fromId < NDLCOM_MAX_NUMBER_OF_DEVICES; fromId++) {
-        for (int toId = 0; toId < NDLCOM_MAX_NUMBER_OF_DEVICES; toId++) {
-            if (numberOfPacketMissEvents[fromId][toId]) {
-                printed = true;
-                out << prefix << "    from " << fromId << " to " << toId
-                    << ":  " << numberOfPacketMissEvents[fromId][toId]
-                    << " miss event"
-                    << (numberOfPacketMissEvents[fromId][toId] > 1 ? "s" : "")
-                    << "\n";
-            }
-        }
+    // print "miss statistics", ordered by sender and receiver
+    std::vector<struct MissEventMetrics> events = getMissEvents();
+    std::streamsize precision = out.precision(3);
+    for (auto it : events) {
+        out << prefix << "    from " << (int)it.senderId << " to "
+            << (int)it.receiverId << ":  " << it.missEvents << " miss event"
+            << (it.missEvents > 1 ? "s" : "") << " (last window: "
+            << it.lossRate * 100. << "% lost, " << it.reorderRate * 100.
+            << "% reordered)\n";
     }
-    if (!printed) {
+    out.precision(precision);
+    if (events.empty()) {
         out << "    no missevents observed yet\n";
     }
 }
 
 void BridgeMissEvents::resetMissEvents() {
-    memset(numberOfPacketMissEvents, 0, sizeof numberOfPacketMissEvents);
+    for (auto &it : table) {
+        it.numberOfPacketMissEvents = 0;
+    }
+}
+
+std::vector<struct MissEventMetrics> BridgeMissEvents::getMissEvents() const {
+    std::vector<struct MissEventMetrics> retval;
+    for (auto it : table) {
+        if (it.used && it.numberOfPacketMissEvents) {
+            struct MissEventMetrics entry;
+            entry.senderId = it.key >> sizeof(NDLComId) * 8;
+            entry.receiverId = it.key & std::numeric_limits<NDLComId>::max();
+            entry.missEvents = it.numberOfPacketMissEvents;
+            entry.lossRate = it.lossRate / 65535.;
+            entry.reorderRate = it.reorderRate / 65535.;
+            retval.push_back(entry);
+        }
+    }
+    // the table is in hash order
+    std::sort(retval.begin(), retval.end(),
+              [](const struct MissEventMetrics &a,
+                 const struct MissEventMetrics &b) {
+                  return a.senderId < b.senderId ||
+                         (a.senderId == b.senderId &&
+                          a.receiverId < b.receiverId);
+              });
+    return retval;
+}
+
+size_t BridgeMissEvents::findSlot(const std::vector<struct PairState> &slots,
+                                  uint16_t key) const {
+    const size_t mask = slots.size() - 1;
+    // fibonacci hashing spreads the adjacent keys of one sender over the table
+    size_t slot = ((uint32_t)key * 40503u >> 4) & mask;
+    while (slots[slot].used && slots[slot].key != key) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+void BridgeMissEvents::grow() {
+    std::vector<struct PairState> bigger(table.size() * 2);
+    for (auto it : table) {
+        if (it.used) {
+            bigger[findSlot(bigger, it.key)] = it;
+        }
+    }
+    table.swap(bigger);
+}
+
+struct BridgeMissEvents::PairState &BridgeMissEvents::lookup(uint16_t key,
+                                                             bool &created) {
+    size_t slot = findSlot(table, key);
+    created = !table[slot].used;
+    if (!created) {
+        return table[slot];
+    }
+    // new pair. keep the load factor below one half so that probing stays
+    // short. this is the only place where memory is allocated.
+    if (2 * (usedSlots + 1) > table.size()) {
+        grow();
+        slot = findSlot(table, key);
+    }
+    usedSlots++;
+    table[slot] = PairState();
+    table[slot].key = key;
+    table[slot].used = true;
+    return table[slot];
 }
 
 int BridgeMissEvents::isMiss(const struct NDLComHeader *header) {
@@ -75,31 +147,48 @@ int BridgeMissEvents::isMiss(const struct NDLComHeader *header) {
             return retval;
     }
 
-    if (!alreadySeen.test(header->mSenderId << sizeof(NDLComId) * 8 |
-                          header->mReceiverId)) {
-        // this is the first time we see a packet for this combination of
-        // sender and receiver. therefore it does not make sense to count an
-        // eventually unexpected packet counter as miss-event. we did not know
-        // what to expect in the first place.
-        alreadySeen.set(header->mSenderId << sizeof(NDLComId) * 8 |
-                        header->mReceiverId);
-    } else {
+    bool firstSeen;
+    struct PairState &state = lookup(
+        header->mSenderId << sizeof(NDLComId) * 8 | header->mReceiverId,
+        firstSeen);
+
+    // if this is the first time we see a packet for this combination of
+    // sender and receiver it does not make sense to count an eventually
+    // unexpected packet counter as miss-event. we did not know what to expect
+    // in the first place.
+    if (!firstSeen) {
         // if we saw this combination before we can go and test of the
         // packet-counter matches our expectation.
-        if (expectedNextPacketCounter[header->mSenderId][header->mReceiverId] !=
-            header->mCounter) {
-            retval = header->mCounter -
-                     expectedNextPacketCounter[header->mSenderId]
-                                              [header->mReceiverId];
+        if (state.expectedNextPacketCounter != header->mCounter) {
+            retval = header->mCounter - state.expectedNextPacketCounter;
             // and count!
-            numberOfPacketMissEvents[header->mSenderId][header->mReceiverId]++;
+            state.numberOfPacketMissEvents++;
+            // for the statistics the difference is taken modulo the size of
+            // the counter: a small step back is a late packet, not 250 lost
+            // ones.
+            int8_t step = header->mCounter - state.expectedNextPacketCounter;
+            if (step > 0) {
+                state.windowLost += step;
+            } else {
+                state.windowReordered++;
+            }
         }
     }
     // in any case we remember the next expected packet counter of this
-    // connecetion. for the wraparound: the counter will overflow by itself...
-    // is this undefined behaviour?
-    expectedNextPacketCounter[header->mSenderId][header->mReceiverId] =
-        header->mCounter + 1;
+    // connecetion. the counter is unsigned and will just wrap around.
+    state.expectedNextPacketCounter = header->mCounter + 1;
+
+    // close the window after "windowSize" packets. lost packets count into
+    // the total as well, as they would have been received.
+    state.windowPackets++;
+    const uint32_t total = state.windowPackets + state.windowLost;
+    if (state.windowPackets >= windowSize) {
+        state.lossRate = (uint32_t)state.windowLost * 65535 / total;
+        state.reorderRate = (uint32_t)state.windowReordered * 65535 / total;
+        state.windowPackets = 0;
+        state.windowLost = 0;
+        state.windowReordered = 0;
+    }
     //and done
     return retval;
 }
@@ -0,0 +1,86 @@
+#include "ndlcom/CanFraming.hpp"
+
+#include "ndlcom/Types.h"
+
+#include <string.h>
+#include <algorithm>
+
+using namespace ndlcom;
+
+const uint8_t CanFraming::firstFlag = 0x80;
+const uint8_t CanFraming::sequenceMask = 0x7f;
+
+CanFraming::CanFraming(size_t _maxDataLength)
+    : maxDataLength(_maxDataLength), sequenced(true), framesLost(0),
+      framesSkipped(0), txSequence(0), rxSequence(0), synchronized(false) {}
+
+uint8_t CanFraming::validLength(size_t count) {
+    static const uint8_t lengths[] = {12, 16, 20, 24, 32, 48, CANFD_MAX_DLEN};
+    if (count <= CAN_MAX_DLEN) {
+        return count;
+    }
+    for (uint8_t length : lengths) {
+        if (count <= length) {
+            return length;
+        }
+    }
+    return CANFD_MAX_DLEN;
+}
+
+void CanFraming::pack(const void *buf, size_t count, canid_t canId,
+                      std::vector<struct canfd_frame> &frames) {
+    const uint8_t *data = static_cast<const uint8_t *>(buf);
+    const size_t header = sequenced ? 1 : 0;
+    size_t pos = 0;
+    while (pos < count) {
+        struct canfd_frame frame;
+        memset(&frame, 0, sizeof(frame));
+        frame.can_id = canId;
+        size_t chunk = std::min(count - pos, maxDataLength - header);
+        if (sequenced) {
+            frame.data[0] =
+                (pos == 0 ? firstFlag : 0) | (txSequence++ & sequenceMask);
+        } else if (chunk > CAN_MAX_DLEN && validLength(chunk) != chunk) {
+            // the longest valid length below, the rest follows
+            size_t shorter = chunk;
+            while (validLength(shorter) != shorter) {
+                shorter--;
+            }
+            chunk = shorter;
+        }
+        memcpy(frame.data + header, data + pos, chunk);
+        frame.len = header + chunk;
+        const uint8_t length = validLength(frame.len);
+        memset(frame.data + frame.len, NDLCOM_START_STOP_FLAG,
+               length - frame.len);
+        frame.len = length;
+        frames.push_back(frame);
+        pos += chunk;
+    }
+}
+
+size_t CanFraming::unpack(const struct canfd_frame &frame, void *buf) {
+    if (!sequenced) {
+        memcpy(buf, frame.data, frame.len);
+        return frame.len;
+    }
+    if (frame.len == 0) {
+        return 0;
+    }
+    const uint8_t control = frame.data[0];
+    const uint8_t sequence = control & sequenceMask;
+    if (synchronized && sequence != rxSequence) {
+        framesLost += (sequence - rxSequence) & sequenceMask;
+        synchronized = false;
+    }
+    rxSequence = (sequence + 1) & sequenceMask;
+    if (!synchronized) {
+        if (!(control & firstFlag)) {
+            framesSkipped++;
+            return 0;
+        }
+        synchronized = true;
+    }
+    memcpy(buf, frame.data + 1, frame.len - 1);
+    return frame.len - 1;
+}
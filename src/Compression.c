@@ -0,0 +1,169 @@
+#include "ndlcom/Compression.h"
+
+#include <string.h>
+
+/*
+ * PackBits: a control byte "n" is followed by
+ * - n in 0..127: n+1 literal bytes
+ * - n in 129..255: one byte, to be repeated 257-n times (2..128)
+ * - n == 128: nothing, is skipped
+ */
+size_t ndlcomRunLengthEncode(void *_dst, const size_t dstSize,
+                             const void *_src, const size_t srcSize) {
+    uint8_t *dst = (uint8_t *)_dst;
+    const uint8_t *src = (const uint8_t *)_src;
+    size_t in = 0;
+    size_t out = 0;
+    while (in < srcSize) {
+        size_t run = 1;
+        while (in + run < srcSize && run < 128 && src[in + run] == src[in]) {
+            run++;
+        }
+        if (run >= 3) {
+            if (out + 2 > dstSize) {
+                return 0;
+            }
+            dst[out++] = (uint8_t)(257 - run);
+            dst[out++] = src[in];
+            in += run;
+            continue;
+        }
+        /* collect literals until the next run of three starts */
+        size_t literal = 0;
+        while (in + literal < srcSize && literal < 128) {
+            const size_t pos = in + literal;
+            if (pos + 2 < srcSize && src[pos] == src[pos + 1] &&
+                src[pos] == src[pos + 2]) {
+                break;
+            }
+            literal++;
+        }
+        if (out + 1 + literal > dstSize) {
+            return 0;
+        }
+        dst[out++] = (uint8_t)(literal - 1);
+        memcpy(dst + out, src + in, literal);
+        out += literal;
+        in += literal;
+    }
+    return out;
+}
+
+size_t ndlcomRunLengthDecode(void *_dst, const size_t dstSize,
+                             const void *_src, const size_t srcSize) {
+    uint8_t *dst = (uint8_t *)_dst;
+    const uint8_t *src = (const uint8_t *)_src;
+    size_t in = 0;
+    size_t out = 0;
+    while (in < srcSize) {
+        const uint8_t n = src[in++];
+        if (n < 128) {
+            const size_t literal = n + 1;
+            if (in + literal > srcSize || out + literal > dstSize) {
+                return 0;
+            }
+            memcpy(dst + out, src + in, literal);
+            in += literal;
+            out += literal;
+        } else if (n > 128) {
+            const size_t run = 257 - n;
+            if (in + 1 > srcSize || out + run > dstSize) {
+                return 0;
+            }
+            memset(dst + out, src[in++], run);
+            out += run;
+        }
+    }
+    return out;
+}
+
+size_t ndlcomCompressPayload(void *dst, const size_t dstSize, const void *src,
+                             const size_t srcSize) {
+    uint8_t *out = (uint8_t *)dst;
+    const uint8_t *in = (const uint8_t *)src;
+    uint8_t delta[NDLCOM_MAX_PAYLOAD_SIZE];
+    size_t best = 0;
+    size_t limit;
+    size_t len;
+    size_t i;
+
+    if (srcSize == 0 || srcSize > sizeof(delta) ||
+        dstSize <= NDLCOM_COMPRESSION_HEADER_SIZE) {
+        return 0;
+    }
+    /* only worth it if it gets smaller */
+    limit = dstSize - NDLCOM_COMPRESSION_HEADER_SIZE;
+    if (srcSize - 1 < limit + NDLCOM_COMPRESSION_HEADER_SIZE) {
+        limit = srcSize - 1 - NDLCOM_COMPRESSION_HEADER_SIZE;
+    }
+    if (srcSize > NDLCOM_COMPRESSION_HEADER_SIZE + 1) {
+        len = ndlcomRunLengthEncode(out + NDLCOM_COMPRESSION_HEADER_SIZE, limit,
+                                    in, srcSize);
+        if (len) {
+            out[1] = NDLCOM_COMPRESSION_METHOD_RLE;
+            best = len;
+            limit = len - 1;
+        }
+        delta[0] = in[0];
+        for (i = 1; i < srcSize; ++i) {
+            delta[i] = in[i] - in[i - 1];
+        }
+        /* the second try must not overwrite the first result if it fails */
+        if (limit) {
+            uint8_t packed[NDLCOM_MAX_PAYLOAD_SIZE];
+            len = ndlcomRunLengthEncode(packed, limit, delta, srcSize);
+            if (len) {
+                memcpy(out + NDLCOM_COMPRESSION_HEADER_SIZE, packed, len);
+                out[1] = NDLCOM_COMPRESSION_METHOD_DELTA_RLE;
+                best = len;
+            }
+        }
+    }
+    if (best) {
+        out[0] = NDLCOM_COMPRESSION_MARKER;
+        return NDLCOM_COMPRESSION_HEADER_SIZE + best;
+    }
+    /* keep uncompressed payloads starting with the marker apart */
+    if (in[0] == NDLCOM_COMPRESSION_MARKER &&
+        srcSize + NDLCOM_COMPRESSION_HEADER_SIZE <= dstSize &&
+        srcSize + NDLCOM_COMPRESSION_HEADER_SIZE <= NDLCOM_MAX_PAYLOAD_SIZE) {
+        out[0] = NDLCOM_COMPRESSION_MARKER;
+        out[1] = NDLCOM_COMPRESSION_METHOD_STORED;
+        memcpy(out + NDLCOM_COMPRESSION_HEADER_SIZE, in, srcSize);
+        return NDLCOM_COMPRESSION_HEADER_SIZE + srcSize;
+    }
+    return 0;
+}
+
+size_t ndlcomDecompressPayload(void *dst, const size_t dstSize,
+                               const void *src, const size_t srcSize) {
+    uint8_t *out = (uint8_t *)dst;
+    const uint8_t *in = (const uint8_t *)src;
+    const uint8_t *data = in + NDLCOM_COMPRESSION_HEADER_SIZE;
+    const size_t dataSize = srcSize - NDLCOM_COMPRESSION_HEADER_SIZE;
+    size_t len;
+    size_t i;
+
+    if (srcSize <= NDLCOM_COMPRESSION_HEADER_SIZE ||
+        in[0] != NDLCOM_COMPRESSION_MARKER) {
+        return 0;
+    }
+    switch (in[1]) {
+    case NDLCOM_COMPRESSION_METHOD_STORED:
+        if (dataSize > dstSize) {
+            return 0;
+        }
+        memcpy(out, data, dataSize);
+        return dataSize;
+    case NDLCOM_COMPRESSION_METHOD_RLE:
+        return ndlcomRunLengthDecode(out, dstSize, data, dataSize);
+    case NDLCOM_COMPRESSION_METHOD_DELTA_RLE:
+        len = ndlcomRunLengthDecode(out, dstSize, data, dataSize);
+        for (i = 1; i < len; ++i) {
+            out[i] += out[i - 1];
+        }
+        return len;
+    default:
+        return 0;
+    }
+}
@@ -8,6 +8,7 @@
 #include <stdarg.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
 #include "ndlcom/Crc.h"
 #include "ndlcom/Types.h"
@@ -125,17 +126,25 @@ size_t ndlcomEncodeVar(void *outputBuffer, const size_t outputBufferSize,
                        size_t additionalSections, ...) {
     NDLComCrc crc;
     size_t wrote = 0;
+    size_t appended;
     size_t i, overallPayloadLen = 0;
     va_list ap;
 
     /* prepare the packet */
     wrote += ndlcomEncodeInit((uint8_t *)outputBuffer + wrote,
                               outputBufferSize - wrote, &crc);
+    if (!wrote) {
+        return 0;
+    }
 
     /* append the header itself */
-    wrote += ndlcomEncodeAppendPayload((uint8_t *)outputBuffer + wrote,
-                                       outputBufferSize - wrote, header,
-                                       sizeof(struct NDLComHeader), &crc);
+    appended = ndlcomEncodeAppendPayload((uint8_t *)outputBuffer + wrote,
+                                         outputBufferSize - wrote, header,
+                                         sizeof(struct NDLComHeader), &crc);
+    if (!appended) {
+        return 0;
+    }
+    wrote += appended;
 
     /* since we have the variable-argument feature we do not know the length of
      * the sections combined. for later testing for consistency with the number
@@ -148,10 +157,17 @@ size_t ndlcomEncodeVar(void *outputBuffer, const size_t outputBufferSize,
         const size_t dataLen = va_arg(ap, const size_t);
         /* don't forget the counting */
         overallPayloadLen += dataLen;
-        /* now encode the obtained chunk */
-        wrote += ndlcomEncodeAppendPayload((uint8_t *)outputBuffer + wrote,
-                                           outputBufferSize - wrote, data,
-                                           dataLen, &crc);
+        /* now encode the obtained chunk. a chunk which does not fit leaves a
+         * hole in the message, it would be accepted as a broken packet on the
+         * other side */
+        appended = ndlcomEncodeAppendPayload((uint8_t *)outputBuffer + wrote,
+                                             outputBufferSize - wrote, data,
+                                             dataLen, &crc);
+        if (dataLen && !appended) {
+            va_end(ap);
+            return 0;
+        }
+        wrote += appended;
     }
     va_end(ap);
 
@@ -173,13 +189,49 @@ size_t ndlcomEncodeVar(void *outputBuffer, const size_t outputBufferSize,
      * different.
      */
     /*crc ^= 0xffff;*/
-    wrote += ndlcomEncodeAppendPayload((uint8_t *)outputBuffer + wrote,
-                                       outputBufferSize - wrote, &crc,
-                                       sizeof(NDLComCrc), NULL);
+    appended = ndlcomEncodeAppendPayload((uint8_t *)outputBuffer + wrote,
+                                         outputBufferSize - wrote, &crc,
+                                         sizeof(NDLComCrc), NULL);
+    if (!appended) {
+        return 0;
+    }
+    wrote += appended;
 
-    wrote += ndlcomEncodeFinalize((uint8_t *)outputBuffer + wrote,
-                                  outputBufferSize - wrote);
+    appended = ndlcomEncodeFinalize((uint8_t *)outputBuffer + wrote,
+                                    outputBufferSize - wrote);
+    if (!appended) {
+        return 0;
+    }
+    wrote += appended;
 
     /* and finally report what we did */
     return wrote;
 }
+
+/* no flags, no escaping. the crc covers the same bytes as in ndlcomEncode() */
+size_t ndlcomEncodeFramed(void *outputBuffer, const size_t outputBufferSize,
+                          const struct NDLComHeader *header, const void *data,
+                          const int withCrc) {
+    uint8_t *pWritePos = (uint8_t *)outputBuffer;
+    const uint8_t *pRead;
+    const size_t len = sizeof(struct NDLComHeader) + header->mDataLen;
+    NDLComCrc crc = NDLCOM_CRC_INITIAL_VALUE;
+    size_t i;
+
+    if (outputBufferSize < len + (withCrc ? sizeof(NDLComCrc) : 0)) {
+        return 0;
+    }
+
+    memcpy(pWritePos, header, sizeof(struct NDLComHeader));
+    memcpy(pWritePos + sizeof(struct NDLComHeader), data, header->mDataLen);
+    if (!withCrc) {
+        return len;
+    }
+
+    pRead = pWritePos;
+    for (i = 0; i < len; ++i) {
+        crc = ndlcomDoCrc(crc, pRead + i);
+    }
+    memcpy(pWritePos + len, &crc, sizeof(NDLComCrc));
+    return len + sizeof(NDLComCrc);
+}
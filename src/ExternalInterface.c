@@ -1,6 +1,8 @@
 #include "ndlcom/ExternalInterface.h"
 #include "ndlcom/Bridge.h"
 
+#include <string.h>
+
 void
 ndlcomExternalInterfaceInit(struct NDLComExternalInterface *externalInterface,
                             NDLComExternalInterfaceWriteEscapedBytes write,
@@ -10,20 +12,147 @@ ndlcomExternalInterfaceInit(struct NDLComExternalInterface *externalInterface,
     externalInterface->context = context;
     externalInterface->read = read;
     externalInterface->write = write;
+    externalInterface->writeFrames = 0;
+    externalInterface->pollFd = 0;
     // this interface is not connected to a "bridge" yet.
     externalInterface->bridge = 0;
+    // batching has to be enabled explicitly
+    externalInterface->batchFrames = 0;
+    externalInterface->batchFramesMax = 0;
+    externalInterface->batchFramesUsed = 0;
+    externalInterface->batchBuffer = 0;
+    externalInterface->batchBufferSize = 0;
+    externalInterface->batchBufferUsed = 0;
 
-    ndlcomExternalInterfaceSetFlags(externalInterface, flags);
+    // not with ndlcomExternalInterfaceSetFlags(), which needs a parser and
+    // the old flags
     ndlcomParserCreate(&externalInterface->parser, sizeof(struct NDLComParser));
+    externalInterface->flags = flags;
+    ndlcomExternalInterfaceResetPacketCounters(externalInterface);
 
     INIT_LIST_HEAD(&externalInterface->list);
 }
 
+void ndlcomExternalInterfaceInitOps(
+    struct NDLComExternalInterface *externalInterface,
+    const struct NDLComExternalInterfaceOps *ops, const uint8_t flags,
+    void *context) {
+    ndlcomExternalInterfaceInit(externalInterface, 0, ops->read, flags,
+                                context);
+    externalInterface->writeFrames = ops->writeFrames;
+    externalInterface->pollFd = ops->pollFd;
+}
+
+size_t ndlcomExternalInterfaceWriteFrames(
+    struct NDLComExternalInterface *externalInterface,
+    const struct NDLComExternalInterfaceFrame *frames, const size_t count) {
+    size_t accepted = 0;
+    size_t i;
+    if (externalInterface->writeFrames) {
+        return externalInterface->writeFrames(externalInterface->context,
+                                              frames, count);
+    }
+    // the shim for the flat callback, which cannot report anything
+    for (i = 0; i < count; ++i) {
+        externalInterface->write(externalInterface->context, frames[i].data,
+                                 frames[i].length);
+        accepted += frames[i].length;
+    }
+    return accepted;
+}
+
+int ndlcomExternalInterfaceGetPollFd(
+    const struct NDLComExternalInterface *externalInterface) {
+    if (!externalInterface->pollFd) {
+        return -1;
+    }
+    return externalInterface->pollFd(externalInterface->context);
+}
+
+void ndlcomExternalInterfaceSetBatchBuffer(
+    struct NDLComExternalInterface *externalInterface,
+    struct NDLComExternalInterfaceFrame *frames, const size_t maxFrames,
+    void *buffer, const size_t size) {
+    ndlcomExternalInterfaceFlush(externalInterface);
+    externalInterface->batchFrames = frames;
+    externalInterface->batchFramesMax = (frames && buffer) ? maxFrames : 0;
+    externalInterface->batchBuffer = (uint8_t *)buffer;
+    externalInterface->batchBufferSize = size;
+}
+
+void ndlcomExternalInterfaceQueue(
+    struct NDLComExternalInterface *externalInterface, const void *buf,
+    const size_t count) {
+    struct NDLComExternalInterfaceFrame *frame;
+    uint8_t *dst;
+
+    // does not fit at all, keep the order and write it on its own
+    if (count > externalInterface->batchBufferSize ||
+        !externalInterface->batchFramesMax) {
+        struct NDLComExternalInterfaceFrame single;
+        single.data = buf;
+        single.length = count;
+        ndlcomExternalInterfaceFlush(externalInterface);
+        ndlcomExternalInterfaceWriteFrames(externalInterface, &single, 1);
+        return;
+    }
+    if (externalInterface->batchFramesUsed ==
+            externalInterface->batchFramesMax ||
+        count > externalInterface->batchBufferSize -
+                    externalInterface->batchBufferUsed) {
+        ndlcomExternalInterfaceFlush(externalInterface);
+    }
+
+    dst = externalInterface->batchBuffer + externalInterface->batchBufferUsed;
+    memcpy(dst, buf, count);
+    frame = &externalInterface->batchFrames[externalInterface->batchFramesUsed];
+    frame->data = dst;
+    frame->length = count;
+    externalInterface->batchFramesUsed++;
+    externalInterface->batchBufferUsed += count;
+}
+
+size_t ndlcomExternalInterfaceFlush(
+    struct NDLComExternalInterface *externalInterface) {
+    size_t accepted;
+    if (!externalInterface->batchFramesUsed) {
+        return 0;
+    }
+    accepted = ndlcomExternalInterfaceWriteFrames(
+        externalInterface, externalInterface->batchFrames,
+        externalInterface->batchFramesUsed);
+    externalInterface->batchFramesUsed = 0;
+    externalInterface->batchBufferUsed = 0;
+    return accepted;
+}
+
 uint32_t ndlcomExternalInterfaceGetCrcFails(
     const struct NDLComExternalInterface *externalInterface) {
     return ndlcomParserGetNumberOfCRCFails(&externalInterface->parser);
 }
 
+uint32_t ndlcomExternalInterfaceGetPacketsReceived(
+    const struct NDLComExternalInterface *externalInterface) {
+    return externalInterface->packetsReceived;
+}
+
+uint32_t ndlcomExternalInterfaceGetPacketsTransmitted(
+    const struct NDLComExternalInterface *externalInterface) {
+    return externalInterface->packetsTransmitted;
+}
+
+uint32_t ndlcomExternalInterfaceGetPacketsRefused(
+    const struct NDLComExternalInterface *externalInterface) {
+    return externalInterface->packetsRefused;
+}
+
+void ndlcomExternalInterfaceResetPacketCounters(
+    struct NDLComExternalInterface *externalInterface) {
+    externalInterface->packetsReceived = 0;
+    externalInterface->packetsTransmitted = 0;
+    externalInterface->packetsRefused = 0;
+}
+
 void ndlcomExternalInterfaceSetRoutingForDeviceId(
     struct NDLComExternalInterface *externalInterface,
     const NDLComId deviceId) {
@@ -36,5 +165,11 @@ void ndlcomExternalInterfaceSetRoutingForDeviceId(
 
 void ndlcomExternalInterfaceSetFlags(
     struct NDLComExternalInterface *externalInterface, const uint8_t flags) {
+    const uint8_t framing = NDLCOM_EXTERNAL_INTERFACE_FLAGS_FRAMED |
+                            NDLCOM_EXTERNAL_INTERFACE_FLAGS_FRAMED_CRC;
+    /* a half received message does not make sense in the other format */
+    if ((externalInterface->flags ^ flags) & framing) {
+        ndlcomParserDestroyPacket(&externalInterface->parser);
+    }
     externalInterface->flags = flags;
 }
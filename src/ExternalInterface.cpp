@@ -9,52 +9,90 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <libgen.h>
 #include <limits.h>
 #include <netdb.h>
+#include <poll.h>
 #include <stdlib.h>
+#include <sys/epoll.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <sys/uio.h>
+#include <sys/un.h>
 #include <unistd.h>
+#include <algorithm>
 #include <cstdio>
 #include <cstring>
 #include <iostream>
+#include <vector>
 #include <netinet/ip.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 
 #include <linux/if.h>
+#include <linux/serial.h>
 #include <linux/can/error.h>
 #include <linux/can/raw.h>
+#include <linux/sockios.h>
 
 using namespace ndlcom;
 
+/**
+ * Ask the kernel about the number of bytes waiting in one of the queues of a
+ * descriptor. Whatever goes wrong (the request may not be supported for the
+ * kind of file we have) is reported as an empty queue, as this is only used
+ * for statistics.
+ */
+static size_t queueDepthOfDescriptor(int fd, unsigned long request) {
+    int depth = 0;
+    if (fd < 0 || ioctl(fd, request, &depth) == -1 || depth < 0) {
+        return 0;
+    }
+    return depth;
+}
+
+/**
+ * switches "uring" on or off for "fd". the descriptor is made non-blocking
+ * again when switching back to the normal syscalls.
+ */
+static bool toggleIoUring(std::unique_ptr<IoUring> &uring, int fd,
+                          bool datagram, bool enable) {
+    if (!enable) {
+        if (uring) {
+            uring.reset();
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        }
+        return true;
+    }
+    if (!uring && fd >= 0) {
+        uring.reset(new IoUring(fd, datagram));
+        if (!uring->valid()) {
+            uring.reset();
+        }
+    }
+    return uring != nullptr;
+}
+
 ExternalInterfaceStream::ExternalInterfaceStream(struct NDLComBridge &bridge,
                                                  std::string _label,
                                                  uint8_t flags)
     : ndlcom::ExternalInterfaceBase(bridge, _label, std::cerr, flags),
-      fd_read(nullptr), fd_write(nullptr) {
+      fd_read(-1), fd_write(-1) {
     // setting "udf.events" implicitly to zero means: listen only to the
     // error-events POLLHUP, POLLERR, and POLLNVAL
     memset(&ufd, 0, sizeof(struct pollfd));
 }
 
 ExternalInterfaceStream::~ExternalInterfaceStream() {
-    if (fd_write) {
-        fclose(fd_write);
-    }
-    if (fd_read) {
-        fclose(fd_read);
-    }
+    // nothing may be in flight when the descriptor is closed by the deriving
+    // class
+    uring.reset();
 }
 
-size_t ExternalInterfaceStream::readEscapedBytes(void *buf, size_t count) {
-    // this should never happen...
-    if (!fd_read) {
-        return 0;
-    }
-
-    // check if our descriptor is still valid
-    ufd.fd = fileno(fd_read);
+void ExternalInterfaceStream::checkHangup() {
+    ufd.fd = fd_read;
 again:
     if (poll(&ufd, 1, 0) < 0) {
         // cope with signals
@@ -65,42 +103,140 @@ again:
     // if there are any bits set in "ufd.revents", an error occured
     if (ufd.revents) {
         reportRuntimeError("connection closed itself", __FILE__, __LINE__);
+    }
+}
+
+size_t ExternalInterfaceStream::readEscapedBytes(void *buf, size_t count) {
+    // this should never happen...
+    if (fd_read < 0) {
         return 0;
     }
 
-    size_t bytesRead = fread(buf, sizeof(char), count, fd_read);
-    if (bytesRead == 0) {
-        if (ferror(fd_read)) {
-            if (errno == EAGAIN) {
-                return 0;
-            } else {
-                reportRuntimeError("error during fread(): " +
-                                       std::string(strerror(errno)),
-                                   __FILE__, __LINE__);
-                return 0;
-            }
-        } else {
+    if (uring) {
+        ssize_t bytesRead = uring->read(buf, count);
+        if (uring->eof() || bytesRead == -EIO) {
+            reportRuntimeError("connection closed itself", __FILE__, __LINE__);
+        } else if (bytesRead < 0) {
+            reportRuntimeError("error during read: " +
+                                   std::string(strerror(-bytesRead)),
+                               __FILE__, __LINE__);
+        }
+        return bytesRead > 0 ? bytesRead : 0;
+    }
+
+again:
+    ssize_t bytesRead = read(fd_read, buf, count);
+    if (bytesRead < 0) {
+        if (errno == EINTR) {
+            // ignore signals
+            goto again;
+        } else if (errno == EAGAIN) {
+            // nothing to read, just return
             return 0;
         }
+        reportRuntimeError("error during read(): " +
+                               std::string(strerror(errno)),
+                           __FILE__, __LINE__);
+        return 0;
+    }
+    if (bytesRead == 0) {
+        // the end of the file. a hangup, or just nothing for some devices
+        checkHangup();
+        return 0;
     }
     /* out << "stream read " << bytesRead << " bytes\n"; */
     return bytesRead;
 }
 
-void ExternalInterfaceStream::writeEscapedBytes(const void *buf, size_t count) {
-    /* out << "trying to write " << count << "\n"; */
-    if (!fd_write)
-        return;
-    size_t written = fwrite((const char *)buf, sizeof(char), count, fd_write);
+size_t ExternalInterfaceStream::writeEscapedBytes(const void *buf,
+                                                  size_t count) {
+    struct NDLComExternalInterfaceFrame frame;
+    frame.data = buf;
+    frame.length = count;
+    return writeEscapedFrames(&frame, 1);
+}
+
+size_t ExternalInterfaceStream::writeEscapedFrames(
+    const struct NDLComExternalInterfaceFrame *frames, size_t count) {
+    /* out << "trying to write " << count << " frames\n"; */
+    if (fd_write < 0)
+        return 0;
+    size_t written = 0;
+    size_t total = 0;
+    if (uring) {
+        noteDroppedBytes(uring->takeDropped());
+        ssize_t accepted = uring->write(frames, count);
+        if (accepted < 0) {
+            reportRuntimeError("error during write: " +
+                                   std::string(strerror(-accepted)),
+                               __FILE__, __LINE__);
+        }
+        for (size_t i = 0; i < count; ++i) {
+            total += frames[i].length;
+        }
+        if ((size_t)accepted != total) {
+            out << label << ": bytes lost. slow interface?\n";
+        }
+        return accepted;
+    }
+    std::vector<struct iovec> iov(count);
+    for (size_t i = 0; i < count; ++i) {
+        iov[i].iov_base = const_cast<void *>(frames[i].data);
+        iov[i].iov_len = frames[i].length;
+        total += frames[i].length;
+    }
+    struct iovec *next = iov.data();
+    size_t left = iov.size();
+    while (written < total) {
+        ssize_t r = writev(fd_write, next, std::min<size_t>(left, IOV_MAX));
+        if (r == -1) {
+            if (errno == EINTR) {
+                // ignore signals
+                continue;
+            }
+            // full, or gone. a hangup is reported when reading
+            break;
+        }
+        written += r;
+        // skip what went out, the stream may have been cut anywhere
+        while (r > 0 && left) {
+            if ((size_t)r >= next->iov_len) {
+                r -= next->iov_len;
+                next++;
+                left--;
+            } else {
+                next->iov_base = (char *)next->iov_base + r;
+                next->iov_len -= r;
+                r = 0;
+            }
+        }
+    }
     // happens when there is a "slow" interface which is getting data from a
     // "fast" one. it cannot cope.
-    if (written != count) {
+    if (written != total) {
         out << label << ": bytes lost. slow interface?\n";
     }
-    // not sure: flushing needed?
-    fflush(fd_write);
 
-    return;
+    return written;
+}
+
+size_t ExternalInterfaceStream::getRxQueueDepth() const {
+    return queueDepthOfDescriptor(fd_read, FIONREAD);
+}
+
+size_t ExternalInterfaceStream::getTxQueueDepth() const {
+    return queueDepthOfDescriptor(fd_write, TIOCOUTQ);
+}
+
+int ExternalInterfaceStream::getPollFd() const {
+    if (uring) {
+        return uring->getPollFd();
+    }
+    return fd_read;
+}
+
+bool ExternalInterfaceStream::setIoUring(bool enable) {
+    return toggleIoUring(uring, fd_read, false, enable);
 }
 
 ExternalInterfaceSerial::ExternalInterfaceSerial(struct NDLComBridge &bridge,
@@ -109,7 +245,10 @@ ExternalInterfaceSerial::ExternalInterfaceSerial(struct NDLComBridge &bridge,
                                                  uint8_t flags)
     : ExternalInterfaceStream(bridge, "serial://" + device_name + ":" +
                                           std::to_string(baudrate),
-                              flags) {
+                              flags),
+      roundTrips(0), roundTripMin(std::chrono::microseconds::max()),
+      roundTripMax(0), roundTripSum(0), deviceName(device_name),
+      awaitingReply(false) {
     fd = open(device_name.c_str(), O_RDWR | O_NOCTTY | O_NDELAY);
     if (fd == -1) {
         reportRuntimeError(strerror(errno), __FILE__, __LINE__);
@@ -158,21 +297,18 @@ ExternalInterfaceSerial::ExternalInterfaceSerial(struct NDLComBridge &bridge,
         reportRuntimeError(strerror(errno), __FILE__, __LINE__);
     }
 
-    // finally use the obtained filedescriptior to fill the FILE things used by
-    // the baseclass.
-    fd_read = fdopen(fd, "r");
-    if (!fd_read) {
-        reportRuntimeError(strerror(errno), __FILE__, __LINE__);
-    }
-    fd_write = fdopen(fd, "r+");
-    if (!fd_write) {
-        reportRuntimeError(strerror(errno), __FILE__, __LINE__);
-    }
+    // finally the obtained filedescriptior is used by the baseclass.
+    fd_read = fd;
+    fd_write = fd;
 }
 
 const speed_t ndlcom::ExternalInterfaceSerial::defaultBaudrate = 921600;
-const std::regex ndlcom::ExternalInterfaceSerial::uri(
-    "^serial://([^:&]*)(?::(\\d+))?(?:&(.*))?$");
+const std::regex &ndlcom::ExternalInterfaceSerial::uri() {
+    // compiled on first use, not by every program linking the library
+    static const std::regex regex(
+        "^serial://([^:&]*)(?::(\\d+))?(?:&(.*))?$");
+    return regex;
+}
 ExternalInterfaceSerial::ExternalInterfaceSerial(struct NDLComBridge &_bridge,
                                                  std::smatch match,
                                                  uint8_t flags)
@@ -182,6 +318,7 @@ ExternalInterfaceSerial::ExternalInterfaceSerial(struct NDLComBridge &_bridge,
                               flags) {}
 
 ExternalInterfaceSerial::~ExternalInterfaceSerial() {
+    uring.reset();
     // release exclusive access
     ioctl(fd, TIOCNXCL);
     // restore old settings.
@@ -189,6 +326,145 @@ ExternalInterfaceSerial::~ExternalInterfaceSerial() {
     close(fd);
 }
 
+bool ExternalInterfaceSerial::setOption(const std::string &key,
+                                        const std::string &value) {
+    if (key == "lowlatency") {
+        setLowLatency(value != "0");
+        return true;
+    }
+    if (key == "latency") {
+        setLatencyTimer(std::stoul(value));
+        return true;
+    }
+    if (key == "vmin") {
+        setReadThresholds(std::stoi(value), -1);
+        return true;
+    }
+    if (key == "vtime") {
+        setReadThresholds(-1, std::stoi(value));
+        return true;
+    }
+    if (key == "flow") {
+        setFlowControl(value);
+        return true;
+    }
+    return ExternalInterfaceStream::setOption(key, value);
+}
+
+void ExternalInterfaceSerial::setLowLatency(bool enable) {
+    struct serial_struct serial;
+    if (ioctl(fd, TIOCGSERIAL, &serial) == -1) {
+        out << label << ": no low-latency flag: " << strerror(errno) << "\n";
+        return;
+    }
+    if (enable) {
+        serial.flags |= ASYNC_LOW_LATENCY;
+    } else {
+        serial.flags &= ~ASYNC_LOW_LATENCY;
+    }
+    if (ioctl(fd, TIOCSSERIAL, &serial) == -1) {
+        out << label << ": no low-latency flag: " << strerror(errno) << "\n";
+    }
+}
+
+void ExternalInterfaceSerial::setLatencyTimer(unsigned int milliseconds) {
+    // the name of the tty, also when given as a symlink like the ones in
+    // "/dev/serial/by-id"
+    char resolved[PATH_MAX];
+    if (!realpath(deviceName.c_str(), resolved)) {
+        reportRuntimeError(strerror(errno), __FILE__, __LINE__);
+    }
+    const std::string tty = basename(resolved);
+    const std::string path = "/sys/class/tty/" + tty + "/device/latency_timer";
+    FILE *file = fopen(path.c_str(), "w");
+    if (!file) {
+        out << label << ": no latency timer at '" << path
+            << "': " << strerror(errno) << "\n";
+        return;
+    }
+    const bool failed = fprintf(file, "%u\n", milliseconds) < 0;
+    if (fclose(file) != 0 || failed) {
+        out << label << ": could not set latency timer: " << strerror(errno)
+            << "\n";
+    }
+}
+
+void ExternalInterfaceSerial::setReadThresholds(int vmin, int vtime) {
+    struct termios2 tio = getTermios();
+    if (vmin >= 0) {
+        tio.c_cc[VMIN] = vmin;
+    }
+    if (vtime >= 0) {
+        tio.c_cc[VTIME] = vtime;
+    }
+    setTermios(tio);
+}
+
+void ExternalInterfaceSerial::setFlowControl(const std::string &mode) {
+    struct termios2 tio = getTermios();
+    tio.c_cflag &= ~CRTSCTS;
+    tio.c_iflag &= ~(IXON | IXOFF | IXANY);
+    if (mode == "rtscts") {
+        tio.c_cflag |= CRTSCTS;
+    } else if (mode == "xonxoff") {
+        tio.c_iflag |= IXON | IXOFF;
+    } else if (mode != "none") {
+        reportRuntimeError("unknown flow control '" + mode + "'", __FILE__,
+                           __LINE__);
+    }
+    setTermios(tio);
+}
+
+struct termios2 ExternalInterfaceSerial::getTermios() const {
+    struct termios2 tio;
+    if (ioctl(fd, TCGETS2, &tio) == -1) {
+        reportRuntimeError(strerror(errno), __FILE__, __LINE__);
+    }
+    return tio;
+}
+
+void ExternalInterfaceSerial::setTermios(const struct termios2 &tio) {
+    if (ioctl(fd, TCSETS2, &tio) == -1) {
+        reportRuntimeError(strerror(errno), __FILE__, __LINE__);
+    }
+}
+
+void ExternalInterfaceSerial::noteIncomingBytes(const void *buf,
+                                                size_t count) {
+    ExternalInterfaceStream::noteIncomingBytes(buf, count);
+    if (!count || !awaitingReply) {
+        return;
+    }
+    awaitingReply = false;
+    const std::chrono::microseconds rtt =
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - lastWrite);
+    roundTrips++;
+    roundTripSum += rtt;
+    roundTripMin = std::min(roundTripMin, rtt);
+    roundTripMax = std::max(roundTripMax, rtt);
+}
+
+void ExternalInterfaceSerial::noteOutgoingBytes(const void *buf,
+                                                size_t count) {
+    ExternalInterfaceStream::noteOutgoingBytes(buf, count);
+    // measured from the first write not answered yet
+    if (count && !awaitingReply) {
+        awaitingReply = true;
+        lastWrite = std::chrono::steady_clock::now();
+    }
+}
+
+void ExternalInterfaceSerial::printStatus(const std::string prefix) const {
+    ExternalInterfaceStream::printStatus(prefix);
+    if (roundTrips) {
+        out << prefix << "   roundTrip: " << roundTrips
+            << " min: " << roundTripMin.count()
+            << "us avg: " << roundTripSum.count() / roundTrips
+            << "us max: " << roundTripMax.count() << "us\n";
+    }
+}
+
 ExternalInterfaceFpga::ExternalInterfaceFpga(struct NDLComBridge &bridge,
                                              std::string device_name,
                                              uint8_t flags)
@@ -202,23 +478,23 @@ ExternalInterfaceFpga::ExternalInterfaceFpga(struct NDLComBridge &bridge,
     if (fd == -1) {
         reportRuntimeError(strerror(errno), __FILE__, __LINE__);
     }
-    fd_read = fdopen(fd, "r");
-    if (!fd_read) {
-        reportRuntimeError(strerror(errno), __FILE__, __LINE__);
-    }
-    fd_write = fdopen(fd, "r+");
-    if (!fd_write) {
-        reportRuntimeError(strerror(errno), __FILE__, __LINE__);
-    }
+    fd_read = fd;
+    fd_write = fd;
 }
 
-const std::regex
-    ndlcom::ExternalInterfaceFpga::uri("^fpga://([^:&]*)(?:&:(.*))?$");
+const std::regex &ndlcom::ExternalInterfaceFpga::uri() {
+    static const std::regex regex(
+        "^fpga://([^:&]*)(?:&:(.*))?$");
+    return regex;
+}
 ExternalInterfaceFpga::ExternalInterfaceFpga(struct NDLComBridge &_bridge,
                                              std::smatch match, uint8_t flags)
     : ExternalInterfaceFpga(_bridge, match[1], flags) {}
 
-ExternalInterfaceFpga::~ExternalInterfaceFpga() { close(fd); }
+ExternalInterfaceFpga::~ExternalInterfaceFpga() {
+    uring.reset();
+    close(fd);
+}
 
 ExternalInterfaceUdp::ExternalInterfaceUdp(struct NDLComBridge &bridge,
                                            std::string hostname,
@@ -231,6 +507,8 @@ ExternalInterfaceUdp::ExternalInterfaceUdp(struct NDLComBridge &bridge,
                                                 " Socket priority: " +
                                                 std::to_string(socket_priority),
                                     std::cerr, flags),
+      aggregateSize(0), aggregateDelay(defaultAggregateDelay),
+      datagramsTransmitted(0), timerFd(-1), epollFd(-1),
       len(sizeof(struct sockaddr_in)) {
 
     // prevent this:
@@ -327,8 +605,15 @@ ExternalInterfaceUdp::ExternalInterfaceUdp(struct NDLComBridge &bridge,
 const unsigned int ndlcom::ExternalInterfaceUdp::defaultInPort = 34000;
 const unsigned int ndlcom::ExternalInterfaceUdp::defaultOutPort = 34001;
 const unsigned int ndlcom::ExternalInterfaceUdp::defaultSocketPriority = 0;
-const std::regex ndlcom::ExternalInterfaceUdp::uri(
-    "^udp://([^:&]*)(?::(\\d+))?(?::(\\d+))?(?::(\[0-9]|1[0-5]))?(?:&(.*))?$");
+// leaves room for ip and udp headers in a usual mtu of 1500
+const size_t ndlcom::ExternalInterfaceUdp::defaultAggregateSize = 1400;
+const std::chrono::microseconds
+    ndlcom::ExternalInterfaceUdp::defaultAggregateDelay(200);
+const std::regex &ndlcom::ExternalInterfaceUdp::uri() {
+    static const std::regex regex(
+        "^udp://([^:&]*)(?::(\\d+))?(?::(\\d+))?(?::([0-9]|1[0-5]))?(?:&(.*))?$");
+    return regex;
+}
 ExternalInterfaceUdp::ExternalInterfaceUdp(struct NDLComBridge &_bridge,
                                            std::smatch match, uint8_t flags)
     : ExternalInterfaceUdp(
@@ -338,10 +623,40 @@ ExternalInterfaceUdp::ExternalInterfaceUdp(struct NDLComBridge &_bridge,
 	  match[4].length() ? std::stoi(match[4].str()) : defaultSocketPriority,
           flags) {}
 
-ExternalInterfaceUdp::~ExternalInterfaceUdp() { close(fd); }
+ExternalInterfaceUdp::~ExternalInterfaceUdp() {
+    try {
+        sendAggregate();
+    } catch (const std::exception &e) {
+        // the last frames are lost, nothing to do about it anymore
+    }
+    uring.reset();
+    for (int f : {epollFd, timerFd}) {
+        if (f != -1) {
+            close(f);
+        }
+    }
+    close(fd);
+}
 
 size_t ExternalInterfaceUdp::readEscapedBytes(void *buf, size_t count) {
     /* out << "trying to read " << count << " bytes\n"; */
+    // the timer of the aggregation is looked at in every round of the bridge.
+    // sending disarms "timerFd" as well
+    if (!aggregate.empty() &&
+        std::chrono::steady_clock::now() - aggregateSince >= aggregateDelay) {
+        sendAggregate();
+    }
+    if (uring) {
+        ssize_t bytesRead = uring->read(buf, count);
+        if (bytesRead < 0 && bytesRead != -ENOTCONN) {
+            reportRuntimeError(strerror(-bytesRead), __FILE__, __LINE__);
+        }
+        if (bytesRead <= 0 || !isWholeFrame(buf, bytesRead)) {
+            return 0;
+        }
+        learnSender(uring->getSender());
+        return bytesRead;
+    }
     struct sockaddr_in addr_recv;
 again:
     ssize_t bytesRead =
@@ -366,34 +681,75 @@ again:
     /*     << inet_ntoa(addr_recv.sin_addr) << ":" << ntohs(addr_recv.sin_port)
      */
     /*     << "'\n"; */
-    if (addr_out.sin_addr.s_addr != addr_recv.sin_addr.s_addr) {
-        std::string address_from(inet_ntoa(addr_out.sin_addr));
-        std::string address_to(inet_ntoa(addr_recv.sin_addr));
-        out << "ExternalInterfaceUdp: switch outgoing connection from '"
-            << address_from.c_str() << ":" << ntohs(addr_out.sin_port)
-            << "' to '" << address_to.c_str() << ":" << ntohs(addr_out.sin_port)
-            << "'\n";
+    if (!isWholeFrame(buf, bytesRead)) {
+        return 0;
+    }
+    learnSender(addr_recv);
+    return bytesRead;
+}
+
+bool ExternalInterfaceUdp::isWholeFrame(const void *buf, size_t count) const {
+    if (!getFlag(NDLCOM_EXTERNAL_INTERFACE_FLAGS_FRAMED)) {
+        return true;
+    }
+    // one message per datagram. anything else would be parsed together with
+    // the next datagram, there are no flags to find the start again
+    const struct NDLComHeader *header =
+        static_cast<const struct NDLComHeader *>(buf);
+    return count >= sizeof(struct NDLComHeader) &&
+           count == sizeof(struct NDLComHeader) + header->mDataLen +
+                        (getFlag(NDLCOM_EXTERNAL_INTERFACE_FLAGS_FRAMED_CRC)
+                             ? sizeof(NDLComCrc)
+                             : 0);
+}
+
+void ExternalInterfaceUdp::learnSender(const struct sockaddr_in &addr_recv) {
+    struct sockaddr_in addr_old;
+    {
+        // the bridge may be writing right now, see getDestination()
+        std::lock_guard<std::mutex> lock(addrMutex);
+        if (addr_out.sin_addr.s_addr == addr_recv.sin_addr.s_addr) {
+            return;
+        }
+        addr_old = addr_out;
         addr_out.sin_addr = addr_recv.sin_addr;
         /*
          * this will tell the socket to use the port of the sender upon the
          * next reply...
          *
-         * NOTE: if you re-enable this line, adopt the output above!
+         * NOTE: if you re-enable this line, adopt the output below!
          */
         /* addr_out.sin_port = addr_recv.sin_port; */
     }
-    return bytesRead;
+    std::string address_from(inet_ntoa(addr_old.sin_addr));
+    std::string address_to(inet_ntoa(addr_recv.sin_addr));
+    out << "ExternalInterfaceUdp: switch outgoing connection from '"
+        << address_from.c_str() << ":" << ntohs(addr_old.sin_port) << "' to '"
+        << address_to.c_str() << ":" << ntohs(addr_old.sin_port) << "'\n";
+}
+
+struct sockaddr_in ExternalInterfaceUdp::getDestination() const {
+    std::lock_guard<std::mutex> lock(addrMutex);
+    return addr_out;
 }
 
-void ExternalInterfaceUdp::writeEscapedBytes(const void *buf, size_t count) {
+size_t ExternalInterfaceUdp::writeEscapedBytes(const void *buf,
+                                               size_t count) {
     /* out << "trying to write " << count << " bytes\n"; */
+    if (uring) {
+        struct NDLComExternalInterfaceFrame frame;
+        frame.data = buf;
+        frame.length = count;
+        return writeEscapedFrames(&frame, 1);
+    }
+    const struct sockaddr_in to = getDestination();
     size_t alreadyWritten = 0;
 again:
     while (alreadyWritten < count) {
         ssize_t written =
             sendto(fd, (const char *)buf + alreadyWritten,
                    count - alreadyWritten, MSG_NOSIGNAL,
-                   (struct sockaddr *)&addr_out, sizeof(struct sockaddr_in));
+                   (const struct sockaddr *)&to, sizeof(struct sockaddr_in));
         if (written == -1) {
             if (errno == EINTR) {
                 // ignore signals
@@ -401,17 +757,257 @@ again:
             } else if (errno == EPIPE) {
                 // this means the connection is not set up correctly... assume
                 // that we know what we do...
-                return;
+                return alreadyWritten;
             }
             reportRuntimeError(strerror(errno), __FILE__, __LINE__);
         }
+        datagramsTransmitted++;
         /* out << "wrote " << written << " bytes to '" */
         /*     << inet_ntoa(addr_out.sin_addr) << ":" <<
          * ntohs(addr_out.sin_port) */
         /*     << "'\n"; */
         alreadyWritten += written;
     }
-    return;
+    return alreadyWritten;
+}
+
+size_t ExternalInterfaceUdp::writeEscapedFrames(
+    const struct NDLComExternalInterfaceFrame *frames, size_t count) {
+    if (aggregateSize && !getFlag(NDLCOM_EXTERNAL_INTERFACE_FLAGS_FRAMED)) {
+        size_t total = 0;
+        for (size_t i = 0; i < count; ++i) {
+            const uint8_t *data = static_cast<const uint8_t *>(frames[i].data);
+            if (aggregate.size() + frames[i].length > aggregateSize) {
+                sendAggregate();
+            }
+            if (aggregate.empty()) {
+                aggregateSince = std::chrono::steady_clock::now();
+                // wakes up a bridge waiting on getPollFd() in time
+                struct itimerspec timeout;
+                memset(&timeout, 0, sizeof(timeout));
+                timeout.it_value.tv_sec = aggregateDelay.count() / 1000000;
+                timeout.it_value.tv_nsec =
+                    aggregateDelay.count() % 1000000 * 1000;
+                timerfd_settime(timerFd, 0, &timeout, nullptr);
+            }
+            // a frame larger than a whole datagram goes out on its own
+            aggregate.insert(aggregate.end(), data, data + frames[i].length);
+            if (aggregate.size() >= aggregateSize) {
+                sendAggregate();
+            }
+            total += frames[i].length;
+        }
+        if (!aggregate.empty() && std::chrono::steady_clock::now() -
+                                          aggregateSince >=
+                                      aggregateDelay) {
+            sendAggregate();
+        }
+        return total;
+    }
+    if (uring) {
+        noteDroppedBytes(uring->takeDropped());
+        const struct sockaddr_in to = getDestination();
+        ssize_t accepted = uring->write(frames, count, &to);
+        if (accepted == -EPIPE) {
+            // see writeEscapedBytes()
+            return 0;
+        } else if (accepted < 0) {
+            reportRuntimeError(strerror(-accepted), __FILE__, __LINE__);
+        }
+        // one datagram per frame accepted
+        for (size_t i = 0, left = accepted;
+             i < count && frames[i].length <= left; ++i) {
+            left -= frames[i].length;
+            datagramsTransmitted++;
+        }
+        return accepted;
+    }
+    struct sockaddr_in to = getDestination();
+    std::vector<struct iovec> iov(count);
+    std::vector<struct mmsghdr> msgs(count);
+    for (size_t i = 0; i < count; ++i) {
+        iov[i].iov_base = const_cast<void *>(frames[i].data);
+        iov[i].iov_len = frames[i].length;
+        memset(&msgs[i], 0, sizeof(msgs[i]));
+        msgs[i].msg_hdr.msg_name = &to;
+        msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    size_t alreadySent = 0;
+    size_t written = 0;
+    while (alreadySent < count) {
+        int sent = sendmmsg(fd, msgs.data() + alreadySent, count - alreadySent,
+                            MSG_NOSIGNAL);
+        if (sent == -1) {
+            if (errno == EINTR) {
+                // ignore signals
+                continue;
+            } else if (errno == EPIPE) {
+                // see writeEscapedBytes()
+                break;
+            }
+            reportRuntimeError(strerror(errno), __FILE__, __LINE__);
+            break;
+        }
+        for (int i = 0; i < sent; ++i) {
+            written += msgs[alreadySent + i].msg_len;
+        }
+        alreadySent += sent;
+        datagramsTransmitted += sent;
+    }
+    return written;
+}
+
+void ExternalInterfaceUdp::sendAggregate() {
+    if (aggregate.empty()) {
+        return;
+    }
+    // disarming also clears an expiration not read yet
+    struct itimerspec disarm;
+    memset(&disarm, 0, sizeof(disarm));
+    timerfd_settime(timerFd, 0, &disarm, nullptr);
+    if (uring) {
+        struct NDLComExternalInterfaceFrame frame;
+        frame.data = aggregate.data();
+        frame.length = aggregate.size();
+        noteDroppedBytes(uring->takeDropped());
+        const struct sockaddr_in to = getDestination();
+        ssize_t accepted = uring->write(&frame, 1, &to);
+        if (accepted < 0 && accepted != -EPIPE) {
+            reportRuntimeError(strerror(-accepted), __FILE__, __LINE__);
+        }
+        if (accepted > 0) {
+            datagramsTransmitted++;
+        } else {
+            noteDroppedBytes(aggregate.size());
+        }
+        aggregate.clear();
+        return;
+    }
+    const struct sockaddr_in to = getDestination();
+again:
+    ssize_t written =
+        sendto(fd, aggregate.data(), aggregate.size(), MSG_NOSIGNAL,
+               (const struct sockaddr *)&to, sizeof(struct sockaddr_in));
+    if (written == -1) {
+        if (errno == EINTR) {
+            // ignore signals
+            goto again;
+        } else if (errno != EPIPE && errno != EAGAIN) {
+            reportRuntimeError(strerror(errno), __FILE__, __LINE__);
+        }
+        // the frames were already counted as written, they are lost now
+        noteDroppedBytes(aggregate.size());
+    } else {
+        datagramsTransmitted++;
+    }
+    aggregate.clear();
+}
+
+bool ExternalInterfaceUdp::setOption(const std::string &key,
+                                     const std::string &value) {
+    if (key == "aggregate") {
+        if (hasReaderThread()) {
+            reportRuntimeError("'aggregate' does not go together with 'thread'",
+                               __FILE__, __LINE__);
+        }
+        size_t size = defaultAggregateSize;
+        std::chrono::microseconds delay = defaultAggregateDelay;
+        if (!value.empty()) {
+            size_t pos;
+            size = std::stoul(value, &pos);
+            if (pos < value.size() && value[pos] == ',') {
+                const std::string time = value.substr(pos + 1);
+                delay = std::chrono::microseconds(std::stoul(time, &pos));
+                const std::string unit = time.substr(pos);
+                if (unit == "ms") {
+                    delay *= 1000;
+                } else if (!unit.empty() && unit != "us") {
+                    reportRuntimeError("unknown unit '" + unit +
+                                           "' for 'aggregate', use 'us' or 'ms'",
+                                       __FILE__, __LINE__);
+                }
+            }
+        }
+        sendAggregate();
+        aggregateSize = size;
+        aggregateDelay = delay;
+        if (aggregateSize && timerFd == -1) {
+            createAggregateTimer();
+        }
+        return true;
+    }
+    if ((key == "thread" && value != "0") || key == "cpu" || key == "prio") {
+        if (aggregateSize) {
+            reportRuntimeError("'" + key + "' does not go together with " +
+                                   "'aggregate'",
+                               __FILE__, __LINE__);
+        }
+    }
+    return ExternalInterfaceBase::setOption(key, value);
+}
+
+void ExternalInterfaceUdp::printStatus(const std::string prefix) const {
+    ExternalInterfaceBase::printStatus(prefix);
+    if (aggregateSize) {
+        out << prefix << "   datagrams: " << datagramsTransmitted
+            << " aggregate: " << aggregateSize << "bytes "
+            << aggregateDelay.count() << "us\n";
+    }
+}
+
+size_t ExternalInterfaceUdp::getRxQueueDepth() const {
+    return queueDepthOfDescriptor(fd, SIOCINQ);
+}
+
+size_t ExternalInterfaceUdp::getTxQueueDepth() const {
+    return aggregate.size() + queueDepthOfDescriptor(fd, SIOCOUTQ);
+}
+
+int ExternalInterfaceUdp::getPollFd() const {
+    return epollFd != -1 ? epollFd : getReadFd();
+}
+
+int ExternalInterfaceUdp::getReadFd() const {
+    return uring ? uring->getPollFd() : fd;
+}
+
+bool ExternalInterfaceUdp::setIoUring(bool enable) {
+    if (epollFd == -1) {
+        return toggleIoUring(uring, fd, true, enable);
+    }
+    // the ring is closed when switching back, remove it before
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, getReadFd(), nullptr);
+    const bool retval = toggleIoUring(uring, fd, true, enable);
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = getReadFd();
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, event.data.fd, &event);
+    return retval;
+}
+
+void ExternalInterfaceUdp::createAggregateTimer() {
+    timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timerFd == -1) {
+        reportRuntimeError("timerfd_create() failed: " +
+                               std::string(strerror(errno)),
+                           __FILE__, __LINE__);
+    }
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd == -1) {
+        reportRuntimeError("epoll_create1() failed: " +
+                               std::string(strerror(errno)),
+                           __FILE__, __LINE__);
+    }
+    for (int f : {getReadFd(), timerFd}) {
+        struct epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.fd = f;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, f, &event);
+    }
 }
 
 ExternalInterfaceCan::ExternalInterfaceCan(struct NDLComBridge &bridge,
@@ -422,6 +1018,7 @@ ExternalInterfaceCan::ExternalInterfaceCan(struct NDLComBridge &bridge,
                                                 std::to_string(_canIdRx) + ":" +
                                                 std::to_string(_canIdTx),
                                     std::cerr, flags),
+      framing(CAN_MAX_DLEN), errorFrames(0),
       /* filtering for a certain canId mask */
       can_filter{_canIdRx, CAN_SFF_MASK},
       /* store the value nevertheless, for future reference: */
@@ -429,8 +1026,7 @@ ExternalInterfaceCan::ExternalInterfaceCan(struct NDLComBridge &bridge,
       /* actually errors would be handy as well (untested): */
       err_mask(CAN_ERR_TX_TIMEOUT | CAN_ERR_CRTL_RX_PASSIVE |
                CAN_ERR_CRTL_TX_PASSIVE | CAN_ERR_BUSOFF),
-      addr{0}, len(sizeof(struct sockaddr_in)),
-      max_data_len(CAN_MAX_DLEN) {
+      addr{0}, max_data_len(CAN_MAX_DLEN) {
 
     // error is missing/not working as expected
 
@@ -478,6 +1074,8 @@ ExternalInterfaceCan::ExternalInterfaceCan(struct NDLComBridge &bridge,
     } else {
         reportRuntimeError("could not determine CAN type", __FILE__, __LINE__);
     }
+    framing.maxDataLength = max_data_len;
+    rxFrames.resize(rxBatchSize);
 
     bind(fd, (struct sockaddr *)&addr, sizeof(addr));
 
@@ -505,8 +1103,12 @@ ExternalInterfaceCan::ExternalInterfaceCan(struct NDLComBridge &bridge,
 
 const canid_t ndlcom::ExternalInterfaceCan::defaultCanIdRx = 42;
 const canid_t ndlcom::ExternalInterfaceCan::defaultCanIdTx = 43;
-const std::regex ndlcom::ExternalInterfaceCan::uri(
-    "^can://([^:&]*)(?::(\\d+))?(?::(\\d+))?(?:&(.*))?$");
+const size_t ndlcom::ExternalInterfaceCan::rxBatchSize = 64;
+const std::regex &ndlcom::ExternalInterfaceCan::uri() {
+    static const std::regex regex(
+        "^can://([^:&]*)(?::(\\d+))?(?::(\\d+))?(?:&(.*))?$");
+    return regex;
+}
 ExternalInterfaceCan::ExternalInterfaceCan(struct NDLComBridge &_bridge,
                                            std::smatch match, uint8_t flags)
     : ExternalInterfaceCan(
@@ -518,134 +1120,902 @@ ExternalInterfaceCan::ExternalInterfaceCan(struct NDLComBridge &_bridge,
 ExternalInterfaceCan::~ExternalInterfaceCan() { close(fd); }
 
 size_t ExternalInterfaceCan::readEscapedBytes(void *buf, size_t count) {
-
-    struct canfd_frame frame;
-    size_t alreadyRead = 0;
-
-    while (alreadyRead < (count - sizeof(frame.data))) {
-again:
-        // using recvfrom, so that we specifiy the interface from where we read
-        const ssize_t retVal = recvfrom(fd, &frame, sizeof(struct canfd_frame), 0,
-                                     (struct sockaddr *)&addr, &len);
-        const size_t bytesRead = retVal > 0 ? retVal : 0;
-
-        if (retVal < 0) {
-            if (errno == EINTR) {
-                // ignore signals
-                goto again;
-            } else if (errno == EAGAIN) {
-                // nothing more to read, just return
-                goto done;
-            }
-            reportRuntimeError(strerror(errno), __FILE__, __LINE__);
+    // every frame may give this many bytes
+    const size_t frameBytes = max_data_len;
+    const size_t frames = std::min(rxBatchSize, count / frameBytes);
+    if (frames == 0) {
+        return 0;
+    }
+    std::vector<struct iovec> iov(frames);
+    std::vector<struct mmsghdr> msgs(frames);
+    for (size_t i = 0; i < frames; ++i) {
+        iov[i].iov_base = &rxFrames[i];
+        iov[i].iov_len = sizeof(struct canfd_frame);
+        memset(&msgs[i], 0, sizeof(msgs[i]));
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    int received;
+    do {
+        received = recvmmsg(fd, msgs.data(), frames, MSG_DONTWAIT, nullptr);
+    } while (received == -1 && errno == EINTR);
+    if (received == -1) {
+        if (errno == EAGAIN) {
+            // nothing to read, just return
             return 0;
         }
+        reportRuntimeError(strerror(errno), __FILE__, __LINE__);
+    }
 
-        if ((bytesRead != sizeof(struct can_frame)) &&
-            (bytesRead != sizeof(struct canfd_frame))) {
+    size_t alreadyRead = 0;
+    for (int i = 0; i < received; ++i) {
+        const struct canfd_frame &frame = rxFrames[i];
+        if (msgs[i].msg_len != CAN_MTU && msgs[i].msg_len != CANFD_MTU) {
             reportRuntimeError("verybogus", __FILE__, __LINE__);
-            return 0;
-	}
-
+        }
+        if (frame.can_id & CAN_ERR_FLAG) {
+            errorFrames++;
+            continue;
+        }
         // TODO: if interface would be bound to "any" we would have to add
         // additional checks?
+        alreadyRead += framing.unpack(frame, (char *)buf + alreadyRead);
+    }
+    return alreadyRead;
+}
 
-        memcpy((char*)buf+alreadyRead, frame.data, frame.len);
+size_t ExternalInterfaceCan::writeEscapedBytes(const void *buf,
+                                               size_t count) {
+    struct NDLComExternalInterfaceFrame frame;
+    frame.data = buf;
+    frame.length = count;
+    return writeEscapedFrames(&frame, 1);
+}
 
-        alreadyRead += frame.len;
+size_t ExternalInterfaceCan::writeEscapedFrames(
+    const struct NDLComExternalInterfaceFrame *frames, size_t count) {
+    txFrames.clear();
+    // where the can frames of each message end
+    std::vector<size_t> ends(count);
+    for (size_t i = 0; i < count; ++i) {
+        framing.pack(frames[i].data, frames[i].length, canIdTx, txFrames);
+        ends[i] = txFrames.size();
+    }
+    const size_t sent = sendFrames();
+    // only messages which went out completely count as written
+    size_t written = 0;
+    for (size_t i = 0; i < count && ends[i] <= sent; ++i) {
+        written += frames[i].length;
     }
-done:
+    return written;
+}
 
-    return alreadyRead;
+size_t ExternalInterfaceCan::sendFrames() {
+    // classic frames are the first part of a "canfd_frame"
+    const size_t mtu = max_data_len > CAN_MAX_DLEN ? CANFD_MTU : CAN_MTU;
+    std::vector<struct iovec> iov(txFrames.size());
+    std::vector<struct mmsghdr> msgs(txFrames.size());
+    for (size_t i = 0; i < txFrames.size(); ++i) {
+        iov[i].iov_base = &txFrames[i];
+        iov[i].iov_len = mtu;
+        memset(&msgs[i], 0, sizeof(msgs[i]));
+        msgs[i].msg_hdr.msg_name = &addr;
+        msgs[i].msg_hdr.msg_namelen = sizeof(addr);
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    size_t alreadySent = 0;
+    while (alreadySent < txFrames.size()) {
+        int sent = sendmmsg(fd, msgs.data() + alreadySent,
+                            txFrames.size() - alreadySent, MSG_DONTWAIT);
+        if (sent == -1) {
+            if (errno == EINTR) {
+                // ignore signals
+                continue;
+            } else if (errno == ENOBUFS || errno == EAGAIN) {
+                // the transmit queue is full. the rest is lost, the other
+                // side notices the gap
+                break;
+            }
+            reportRuntimeError(strerror(errno), __FILE__, __LINE__);
+        }
+        alreadySent += sent;
+    }
+    return alreadySent;
 }
 
-void ExternalInterfaceCan::writeEscapedBytes(const void *buf, size_t count) {
+bool ExternalInterfaceCan::setOption(const std::string &key,
+                                     const std::string &value) {
+    if (key == "raw") {
+        if (hasReaderThread()) {
+            reportRuntimeError("'raw' has to come before 'thread'", __FILE__,
+                               __LINE__);
+        }
+        framing.sequenced = value == "0";
+        return true;
+    }
+    if (key == "framed" && value != "0") {
+        reportRuntimeError("can interfaces do not support 'framed'", __FILE__,
+                           __LINE__);
+    }
+    return ExternalInterfaceBase::setOption(key, value);
+}
 
-    size_t alreadyWritten = 0;
-    struct canfd_frame frame;
-    // the "sockaddr_can" struct has a rx/tx field
-    frame.can_id = canIdTx;
-    frame.len = max_data_len;
-again:
-    while (alreadyWritten < count) {
+void ExternalInterfaceCan::printStatus(const std::string prefix) const {
+    ExternalInterfaceBase::printStatus(prefix);
+    out << prefix << "   framesLost: " << framing.framesLost
+        << " framesSkipped: " << framing.framesSkipped
+        << " errorFrames: " << errorFrames << "\n";
+}
+
+int ExternalInterfaceCan::getPollFd() const { return fd; }
+
+ExternalInterfaceUdpMulticast::ExternalInterfaceUdpMulticast(
+    struct NDLComBridge &bridge, std::string groupAddress, unsigned int port,
+    uint8_t flags)
+    : ndlcom::ExternalInterfaceBase(bridge, "udpmc://" + groupAddress + ":" +
+                                                std::to_string(port),
+                                    std::cerr, flags),
+      rxFd(-1), txFd(-1), epollFd(-1) {
+    memset(&group, 0, sizeof(group));
+    group.sin_family = AF_INET;
+    group.sin_port = htons(port);
+    if (inet_pton(AF_INET, groupAddress.c_str(), &group.sin_addr) != 1 ||
+        !IN_MULTICAST(ntohl(group.sin_addr.s_addr))) {
+        reportRuntimeError("'" + groupAddress + "' is no multicast group",
+                           __FILE__, __LINE__);
+    }
 
-        // we'll rewrite the "size" field only for the last chunk. for all the
-        // other ones the initial value (8byte, set before the loop) is used.
-        // it might work like this?
-        if (alreadyWritten+max_data_len > count) {
-            frame.len = count - alreadyWritten;
+    // other listeners on this host use the same port
+    rxFd = openSocket(port);
+    struct ip_mreq mreq;
+    memset(&mreq, 0, sizeof(mreq));
+    mreq.imr_multiaddr = group.sin_addr;
+    mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+    if (setsockopt(rxFd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) ==
+        -1) {
+        reportRuntimeError("joining '" + groupAddress + "' failed: " +
+                               std::string(strerror(errno)),
+                           __FILE__, __LINE__);
+    }
+    txFd = openSocket(0);
+    const unsigned int ttl = defaultTtl;
+    setsockopt(txFd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+
+    // the source address chosen by the kernel for the group, our own
+    // datagrams come back from there when looped
+    memset(&self, 0, sizeof(self));
+    int probe = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, IPPROTO_UDP);
+    socklen_t len = sizeof(self);
+    if (probe != -1 &&
+        connect(probe, (struct sockaddr *)&group, sizeof(group)) == 0) {
+        getsockname(probe, (struct sockaddr *)&self, &len);
+    }
+    if (probe != -1) {
+        close(probe);
+    }
+    struct sockaddr_in bound;
+    len = sizeof(bound);
+    getsockname(txFd, (struct sockaddr *)&bound, &len);
+    self.sin_port = bound.sin_port;
+
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd == -1) {
+        reportRuntimeError("epoll_create1() failed: " +
+                               std::string(strerror(errno)),
+                           __FILE__, __LINE__);
+    }
+    for (int sock : {rxFd, txFd}) {
+        struct epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.fd = sock;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, sock, &event);
+    }
+}
+
+const unsigned int ndlcom::ExternalInterfaceUdpMulticast::defaultPort = 34002;
+const unsigned int ndlcom::ExternalInterfaceUdpMulticast::defaultTtl = 1;
+const std::regex &ndlcom::ExternalInterfaceUdpMulticast::uri() {
+    static const std::regex regex(
+        "^udpmc://([^:&]*)(?::(\\d+))?(?:&(.*))?$");
+    return regex;
+}
+ExternalInterfaceUdpMulticast::ExternalInterfaceUdpMulticast(
+    struct NDLComBridge &_bridge, std::smatch match, uint8_t flags)
+    : ExternalInterfaceUdpMulticast(
+          _bridge, match[1],
+          match[2].length() ? std::stoi(match[2].str()) : defaultPort, flags) {}
+
+ExternalInterfaceUdpMulticast::~ExternalInterfaceUdpMulticast() {
+    for (int fd : {epollFd, txFd, rxFd}) {
+        if (fd != -1) {
+            close(fd);
         }
+    }
+}
 
-        memcpy(frame.data, (const char *)buf + alreadyWritten, frame.len);
+int ExternalInterfaceUdpMulticast::openSocket(unsigned int port) {
+    int sock = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                      IPPROTO_UDP);
+    if (sock == -1) {
+        reportRuntimeError(strerror(errno), __FILE__, __LINE__);
+    }
+    const int one = 1;
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+        const std::string error = strerror(errno);
+        close(sock);
+        reportRuntimeError("bind() to port " + std::to_string(port) +
+                               " failed: " + error,
+                           __FILE__, __LINE__);
+    }
+    return sock;
+}
 
-        ssize_t written = sendto(fd, &frame, max_data_len+8, 0,
-                                 (struct sockaddr *)&addr, sizeof(addr));
-        if (written == -1) {
+size_t ExternalInterfaceUdpMulticast::readFrom(int sock, void *buf,
+                                              size_t count) {
+    while (true) {
+        struct sockaddr_in from;
+        socklen_t len = sizeof(from);
+        ssize_t bytesRead =
+            recvfrom(sock, buf, count, 0, (struct sockaddr *)&from, &len);
+        if (bytesRead < 0) {
             if (errno == EINTR) {
                 // ignore signals
-                goto again;
+                continue;
+            } else if (errno == EAGAIN) {
+                // nothing to read, just return
+                return 0;
             }
             reportRuntimeError(strerror(errno), __FILE__, __LINE__);
         }
-        alreadyWritten += frame.len;
+        if (from.sin_addr.s_addr == self.sin_addr.s_addr &&
+            from.sin_port == self.sin_port) {
+            // looped back, we sent this ourself
+            continue;
+        }
+        if (getFlag(NDLCOM_EXTERNAL_INTERFACE_FLAGS_FRAMED)) {
+            // one message per datagram, see ExternalInterfaceUdp
+            const struct NDLComHeader *header =
+                static_cast<const struct NDLComHeader *>(buf);
+            if ((size_t)bytesRead < sizeof(struct NDLComHeader) ||
+                (size_t)bytesRead !=
+                    sizeof(struct NDLComHeader) + header->mDataLen +
+                        (getFlag(NDLCOM_EXTERNAL_INTERFACE_FLAGS_FRAMED_CRC)
+                             ? sizeof(NDLComCrc)
+                             : 0)) {
+                continue;
+            }
+        }
+        return bytesRead;
     }
-    return;
 }
 
+size_t ExternalInterfaceUdpMulticast::readEscapedBytes(void *buf,
+                                                       size_t count) {
+    size_t bytesRead = readFrom(rxFd, buf, count);
+    if (bytesRead == 0) {
+        bytesRead = readFrom(txFd, buf, count);
+    }
+    return bytesRead;
+}
+
+size_t ExternalInterfaceUdpMulticast::writeEscapedBytes(const void *buf,
+                                                        size_t count) {
+    struct NDLComExternalInterfaceFrame frame;
+    frame.data = buf;
+    frame.length = count;
+    return writeEscapedFrames(&frame, 1);
+}
+
+size_t ExternalInterfaceUdpMulticast::writeEscapedFrames(
+    const struct NDLComExternalInterfaceFrame *frames, size_t count) {
+    std::vector<struct iovec> iov(count);
+    std::vector<struct mmsghdr> msgs(count);
+    for (size_t i = 0; i < count; ++i) {
+        iov[i].iov_base = const_cast<void *>(frames[i].data);
+        iov[i].iov_len = frames[i].length;
+        memset(&msgs[i], 0, sizeof(msgs[i]));
+        msgs[i].msg_hdr.msg_name = &group;
+        msgs[i].msg_hdr.msg_namelen = sizeof(group);
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    size_t alreadySent = 0;
+    size_t written = 0;
+    while (alreadySent < count) {
+        int sent = sendmmsg(txFd, msgs.data() + alreadySent,
+                            count - alreadySent, MSG_NOSIGNAL);
+        if (sent == -1) {
+            if (errno == EINTR) {
+                // ignore signals
+                continue;
+            } else if (errno == EAGAIN || errno == ENETUNREACH ||
+                       errno == ENETDOWN) {
+                // nobody may be listening anyways, the rest is lost
+                break;
+            }
+            reportRuntimeError(strerror(errno), __FILE__, __LINE__);
+        }
+        for (int i = 0; i < sent; ++i) {
+            written += msgs[alreadySent + i].msg_len;
+        }
+        alreadySent += sent;
+    }
+    return written;
+}
+
+bool ExternalInterfaceUdpMulticast::setOption(const std::string &key,
+                                              const std::string &value) {
+    if (key == "ttl") {
+        const unsigned int ttl = std::stoul(value);
+        if (setsockopt(txFd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl,
+                       sizeof(ttl)) == -1) {
+            reportRuntimeError("setting ttl failed: " +
+                                   std::string(strerror(errno)),
+                               __FILE__, __LINE__);
+        }
+        return true;
+    }
+    if (key == "loop") {
+        const unsigned int loop = value != "0";
+        setsockopt(txFd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+        return true;
+    }
+    if (key == "reply") {
+        if (hasReaderThread()) {
+            // the thread would read the socket closed here
+            reportRuntimeError("'reply' has to come before 'thread'",
+                               __FILE__, __LINE__);
+        }
+        // same settings for the new socket
+        unsigned int ttl = defaultTtl, loop = 1;
+        socklen_t len = sizeof(ttl);
+        getsockopt(txFd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, &len);
+        len = sizeof(loop);
+        getsockopt(txFd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, &len);
+        const int sock = openSocket(std::stoul(value));
+        setsockopt(sock, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+        setsockopt(sock, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, txFd, nullptr);
+        close(txFd);
+        txFd = sock;
+        struct epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.fd = txFd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, txFd, &event);
+        self.sin_port = htons(std::stoul(value));
+        return true;
+    }
+    return ExternalInterfaceBase::setOption(key, value);
+}
+
+size_t ExternalInterfaceUdpMulticast::getRxQueueDepth() const {
+    return queueDepthOfDescriptor(rxFd, SIOCINQ) +
+           queueDepthOfDescriptor(txFd, SIOCINQ);
+}
+
+size_t ExternalInterfaceUdpMulticast::getTxQueueDepth() const {
+    return queueDepthOfDescriptor(txFd, SIOCOUTQ);
+}
+
+int ExternalInterfaceUdpMulticast::getPollFd() const { return epollFd; }
+
 ExternalInterfaceTcpClient::ExternalInterfaceTcpClient(
-    struct NDLComBridge &bridge, std::string hostname, unsigned int port,
+    struct NDLComBridge &bridge, std::string _hostname, unsigned int _port,
     uint8_t flags)
-    : ndlcom::ExternalInterfaceBase(bridge, "tcpclient://" + hostname + ":" +
-                                                std::to_string(port),
-                                    std::cerr, flags) {
+    : ndlcom::ExternalInterfaceBase(bridge, "tcpclient://" + _hostname + ":" +
+                                                std::to_string(_port),
+                                    std::cerr, flags),
+      reconnects(0), lastOutage(0), longestOutage(0),
+      retryMin(defaultRetryMin), retryMax(defaultRetryMax),
+      txQueueSize(defaultTxQueueSize), hostname(_hostname), port(_port),
+      resolved(false), fd(-1), state(DISCONNECTED), everConnected(false),
+      failureReported(false), retryDelay(defaultRetryMin),
+      nextAttempt(std::chrono::steady_clock::now()),
+      disconnectedSince(nextAttempt), txQueueOffset(0), txQueueBytes(0),
+      useUring(false) {
+    std::lock_guard<std::mutex> lock(mutex);
+    // only started here, the bridge does not wait for the peer
+    advanceConnection();
+}
 
-    struct addrinfo hints = {0};
+const unsigned int ndlcom::ExternalInterfaceTcpClient::defaultPort = 2000;
+const std::chrono::milliseconds
+    ndlcom::ExternalInterfaceTcpClient::defaultRetryMin(100);
+const std::chrono::milliseconds
+    ndlcom::ExternalInterfaceTcpClient::defaultRetryMax(10000);
+const size_t ndlcom::ExternalInterfaceTcpClient::defaultTxQueueSize = 256;
+const std::regex &ndlcom::ExternalInterfaceTcpClient::uri() {
+    static const std::regex regex(
+        "^tcpclient://([^:&]*)(?::(\\d+))?(?:&(.*))?$");
+    return regex;
+}
+
+ExternalInterfaceTcpClient::ExternalInterfaceTcpClient(
+    struct NDLComBridge &_bridge, std::smatch match, uint8_t flags)
+    : ExternalInterfaceTcpClient(
+          _bridge, match[1],
+          match[2].length() ? std::stoi(match[2].str()) : defaultPort, flags) {}
+
+ExternalInterfaceTcpClient::~ExternalInterfaceTcpClient() {
+    uring.reset();
+    if (fd != -1) {
+        close(fd);
+    }
+}
+
+bool ExternalInterfaceTcpClient::resolve() {
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
     hints.ai_family = AF_INET;
     hints.ai_socktype = SOCK_STREAM;
     hints.ai_protocol = IPPROTO_TCP;
 
-    if ((fd = socket(hints.ai_family, hints.ai_socktype, hints.ai_protocol)) < 0) {
-        reportRuntimeError("failed to create socket: " +
-                               std::string(strerror(errno)),
-                           __FILE__, __LINE__);
-    }
-
     struct addrinfo *result;
-    // try to resolve the hostname-string
-    if (int retval =
-            getaddrinfo(hostname.c_str(), nullptr, &hints, &result) != 0) {
-        reportRuntimeError(gai_strerror(retval), __FILE__, __LINE__);
+    // try to resolve the hostname-string. blocks, but only until it worked
+    // once
+    int retval = getaddrinfo(hostname.c_str(), nullptr, &hints, &result);
+    if (retval != 0) {
+        connectionFailed("cannot resolve '" + hostname +
+                         "': " + gai_strerror(retval));
+        return false;
     }
-
     memset(&addr, 0, sizeof(addr));
     memcpy(&addr, (struct sockaddr_in *)result->ai_addr,
            sizeof(struct sockaddr_in));
     addr.sin_family = AF_INET;
     addr.sin_port = htons(port);
-    /* establish connection */
-    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
-        reportRuntimeError("failed to connect: " + std::string(strerror(errno)),
+    freeaddrinfo(result);
+    resolved = true;
+    return true;
+}
+
+void ExternalInterfaceTcpClient::startConnecting() {
+    if (!resolved && !resolve()) {
+        return;
+    }
+    int s = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                   IPPROTO_TCP);
+    if (s < 0) {
+        reportRuntimeError("failed to create socket: " +
+                               std::string(strerror(errno)),
                            __FILE__, __LINE__);
     }
-    // only after calling "connect()" we switch to nonblocking mode. would have
-    // to wait anyways... this blocks the gui during "connect()", but...
-    fcntl(fd, F_SETFL, O_NONBLOCK);
+    if (fd == -1) {
+        fd = s;
+    } else {
+        // the new socket takes the number of the old one, a reader thread
+        // may already wait on it
+        dup3(s, fd, O_CLOEXEC);
+        close(s);
+    }
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+        connectionEstablished();
+    } else if (errno == EINPROGRESS || errno == EINTR) {
+        state = CONNECTING;
+    } else {
+        connectionFailed(strerror(errno));
+    }
+}
 
-    freeaddrinfo(result);
+void ExternalInterfaceTcpClient::advanceConnection() {
+    if (state == DISCONNECTED) {
+        if (std::chrono::steady_clock::now() < nextAttempt) {
+            return;
+        }
+        startConnecting();
+    }
+    if (state == CONNECTING) {
+        struct pollfd pfd = {fd, POLLOUT, 0};
+        if (poll(&pfd, 1, 0) <= 0) {
+            // still waiting for the peer
+            return;
+        }
+        int error = 0;
+        socklen_t len = sizeof(error);
+        if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &len) == -1) {
+            error = errno;
+        }
+        if (error) {
+            connectionFailed(strerror(error));
+            return;
+        }
+        connectionEstablished();
+    }
 }
 
-const unsigned int ndlcom::ExternalInterfaceTcpClient::defaultPort = 2000;
-const std::regex ndlcom::ExternalInterfaceTcpClient::uri(
-    "^tcpclient://([^:&]*)(?::(\\d+))?(?:&(.*))?$");
-ExternalInterfaceTcpClient::ExternalInterfaceTcpClient(
-    struct NDLComBridge &_bridge, std::smatch match, uint8_t flags)
-    : ExternalInterfaceTcpClient(
-          _bridge, match[1],
-          match[2].length() ? std::stoi(match[2].str()) : defaultPort, flags) {}
+void ExternalInterfaceTcpClient::connectionEstablished() {
+    state = CONNECTED;
+    retryDelay = retryMin;
+    if (everConnected) {
+        reconnects++;
+        lastOutage = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - disconnectedSince);
+        longestOutage = std::max(longestOutage, lastOutage);
+        out << label << ": connected again after " << lastOutage.count()
+            << "ms\n";
+    }
+    everConnected = true;
+    failureReported = false;
+    // the ring of the last connection is kept, a reader thread waits on it
+    if (uring && !uring->restart()) {
+        uring.reset();
+    }
+    if (useUring) {
+        toggleIoUring(uring, fd, false, true);
+    }
+    flushTxQueue();
+}
+
+void ExternalInterfaceTcpClient::connectionFailed(const std::string &reason) {
+    if (!failureReported) {
+        out << label << ": connecting failed: " << reason
+            << ", trying again\n";
+        failureReported = true;
+    }
+    state = DISCONNECTED;
+    nextAttempt = std::chrono::steady_clock::now() + retryDelay;
+    retryDelay = std::min(retryDelay * 2, retryMax);
+}
 
-ExternalInterfaceTcpClient::~ExternalInterfaceTcpClient() { close(fd); }
+void ExternalInterfaceTcpClient::connectionLost(const std::string &reason) {
+    out << label << ": " << reason << ", reconnecting\n";
+    // a message cut in the middle would be garbage for the next connection,
+    // in both directions
+    resetParser();
+    if (txQueueOffset) {
+        noteDroppedBytes(txQueue.front().size() - txQueueOffset);
+        txQueueBytes -= txQueue.front().size();
+        txQueue.pop_front();
+        txQueueOffset = 0;
+    }
+    state = DISCONNECTED;
+    disconnectedSince = std::chrono::steady_clock::now();
+    // the first attempt right away, the peer may be restarting
+    nextAttempt = disconnectedSince;
+    failureReported = true;
+}
+
+void ExternalInterfaceTcpClient::flushTxQueue() {
+    if (uring) {
+        noteDroppedBytes(uring->takeDropped());
+    }
+    while (state == CONNECTED && !txQueue.empty()) {
+        const std::vector<uint8_t> &front = txQueue.front();
+        if (uring) {
+            struct NDLComExternalInterfaceFrame frame;
+            frame.data = front.data() + txQueueOffset;
+            frame.length = front.size() - txQueueOffset;
+            ssize_t accepted = uring->write(&frame, 1);
+            if (accepted < 0) {
+                connectionLost(strerror(-accepted));
+                return;
+            } else if (accepted == 0) {
+                return;
+            }
+        } else {
+            ssize_t written = send(fd, front.data() + txQueueOffset,
+                                   front.size() - txQueueOffset, MSG_NOSIGNAL);
+            if (written == -1) {
+                if (errno == EINTR) {
+                    // ignore signals
+                    continue;
+                } else if (errno != EAGAIN) {
+                    connectionLost(strerror(errno));
+                }
+                return;
+            }
+            txQueueOffset += written;
+            if (txQueueOffset < front.size()) {
+                // the socket is full
+                return;
+            }
+        }
+        txQueueBytes -= front.size();
+        txQueue.pop_front();
+        txQueueOffset = 0;
+    }
+}
 
 size_t ExternalInterfaceTcpClient::readEscapedBytes(void *buf, size_t count) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (state != CONNECTED) {
+        advanceConnection();
+        return 0;
+    }
+    flushTxQueue();
+    if (uring) {
+        ssize_t bytesRead = uring->read(buf, count);
+        if (uring->eof()) {
+            connectionLost("connection closed by peer");
+            return 0;
+        } else if (bytesRead < 0) {
+            connectionLost(strerror(-bytesRead));
+            return 0;
+        }
+        return bytesRead;
+    }
+again:
+    ssize_t bytesRead = recv(fd, buf, count, 0);
+    if (bytesRead < 0) {
+        if (errno == EINTR) {
+            // ignore signals
+            goto again;
+        } else if (errno != EAGAIN) {
+            connectionLost(strerror(errno));
+        }
+        return 0;
+    } else if (bytesRead == 0 && count) {
+        connectionLost("connection closed by peer");
+    }
+    return bytesRead;
+}
+
+size_t ExternalInterfaceTcpClient::writeEscapedBytes(const void *buf,
+                                                     size_t count) {
+    struct NDLComExternalInterfaceFrame frame;
+    frame.data = buf;
+    frame.length = count;
+    return writeEscapedFrames(&frame, 1);
+}
+
+size_t ExternalInterfaceTcpClient::writeEscapedFrames(
+    const struct NDLComExternalInterfaceFrame *frames, size_t count) {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t written = 0;
+    // directly to the socket only if nothing older is waiting
+    if (state == CONNECTED) {
+        flushTxQueue();
+    }
+    if (state == CONNECTED && txQueue.empty()) {
+        if (uring) {
+            ssize_t accepted = uring->write(frames, count);
+            if (accepted < 0) {
+                connectionLost(strerror(-accepted));
+            } else {
+                written = accepted;
+            }
+        } else {
+            std::vector<struct iovec> iov(count);
+            for (size_t i = 0; i < count; ++i) {
+                iov[i].iov_base = const_cast<void *>(frames[i].data);
+                iov[i].iov_len = frames[i].length;
+            }
+            struct msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = iov.data();
+            msg.msg_iovlen = std::min<size_t>(iov.size(), IOV_MAX);
+            ssize_t r;
+            do {
+                r = sendmsg(fd, &msg, MSG_NOSIGNAL);
+            } while (r == -1 && errno == EINTR);
+            if (r >= 0) {
+                written = r;
+            } else if (errno != EAGAIN) {
+                connectionLost(strerror(errno));
+            }
+        }
+    }
+    // the rest waits in the queue: a frame cut in the middle in any case,
+    // the following whole ones as long as there is room
+    size_t skip = written;
+    for (size_t i = 0; i < count; ++i) {
+        const size_t length = frames[i].length;
+        if (skip >= length) {
+            skip -= length;
+            continue;
+        }
+        if (!skip && txQueue.size() >= txQueueSize) {
+            continue;
+        }
+        const uint8_t *data = static_cast<const uint8_t *>(frames[i].data);
+        txQueue.emplace_back(data, data + length);
+        txQueueBytes += length;
+        if (skip) {
+            txQueueOffset = skip;
+        }
+        written += length - skip;
+        skip = 0;
+    }
+    return written;
+}
+
+int ExternalInterfaceTcpClient::getPollFd() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return uring ? uring->getPollFd() : fd;
+}
+
+bool ExternalInterfaceTcpClient::setIoUring(bool enable) {
+    std::lock_guard<std::mutex> lock(mutex);
+    useUring = enable;
+    if (enable && state != CONNECTED) {
+        // tried once connected, without it if not available
+        return true;
+    }
+    return toggleIoUring(uring, fd, false, enable);
+}
+
+bool ExternalInterfaceTcpClient::setOption(const std::string &key,
+                                           const std::string &value) {
+    if (key == "retry") {
+        std::lock_guard<std::mutex> lock(mutex);
+        retryMin = std::chrono::milliseconds(std::stoul(value));
+        retryDelay = retryMin;
+        return true;
+    }
+    if (key == "retrymax") {
+        retryMax = std::chrono::milliseconds(std::stoul(value));
+        return true;
+    }
+    if (key == "txqueue") {
+        txQueueSize = std::stoul(value);
+        return true;
+    }
+    return ExternalInterfaceBase::setOption(key, value);
+}
+
+bool ExternalInterfaceTcpClient::isConnected() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return state == CONNECTED;
+}
+
+size_t ExternalInterfaceTcpClient::getRxQueueDepth() const {
+    return queueDepthOfDescriptor(fd, SIOCINQ);
+}
+
+size_t ExternalInterfaceTcpClient::getTxQueueDepth() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return txQueueBytes + (state == CONNECTED
+                               ? queueDepthOfDescriptor(fd, SIOCOUTQ)
+                               : 0);
+}
+
+void ExternalInterfaceTcpClient::printStatus(const std::string prefix) const {
+    ExternalInterfaceBase::printStatus(prefix);
+    out << prefix << "   " << (isConnected() ? "connected" : "not connected")
+        << ", reconnects: " << reconnects
+        << " lastOutage: " << lastOutage.count()
+        << "ms longestOutage: " << longestOutage.count() << "ms\n";
+}
+
+struct InterfaceMetrics ExternalInterfaceTcpClient::getMetrics() const {
+    struct InterfaceMetrics retval = ExternalInterfaceBase::getMetrics();
+    retval.connected = isConnected();
+    retval.reconnects = reconnects;
+    retval.lastOutage = lastOutage;
+    return retval;
+}
+
+// options for reading in a thread or with io_uring, which some interfaces
+// cannot do
+static bool isReaderOption(const std::string &key) {
+    return key == "thread" || key == "cpu" || key == "prio" || key == "uring";
+}
+
+ExternalInterfaceServer::ExternalInterfaceServer(struct NDLComBridge &bridge,
+                                                 std::string label,
+                                                 uint8_t flags)
+    : ndlcom::ExternalInterfaceBase(bridge, label, std::cerr, flags) {}
+
+ExternalInterfaceServer::~ExternalInterfaceServer() {
+    for (auto it : children) {
+        it->deregisterHandler();
+    }
+    children.clear();
+}
+
+size_t ExternalInterfaceServer::writeEscapedBytes(const void *buf,
+                                                  size_t count) {
+    // the clients got their own copy
+    return count;
+}
+
+void ExternalInterfaceServer::noteOutgoingBytes(const void *buf,
+                                                size_t count) {}
+
+void ExternalInterfaceServer::acceptChildren(int fd,
+                                             const ChildFactory &factory) {
+    while (true) {
+        struct sockaddr_storage peer;
+        socklen_t len = sizeof(peer);
+        int client = accept4(fd, (struct sockaddr *)&peer, &len,
+                             SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client == -1) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                // try the next one
+                continue;
+            } else if (errno != EAGAIN) {
+                reportRuntimeError("accept() failed: " +
+                                       std::string(strerror(errno)),
+                                   __FILE__, __LINE__);
+            }
+            return;
+        }
+        std::shared_ptr<ExternalInterfaceBase> p = factory(client, peer);
+        if (!p) {
+            continue;
+        }
+        // the same as the bridge would do for us
+        p->registerHandler();
+        children.push_back(p);
+        out << label << ": accepted " << p->label << "\n";
+    }
+}
+
+void ExternalInterfaceServer::removeChildren(
+    const std::function<bool(ExternalInterfaceBase &)> &isClosed) {
+    for (auto it = children.begin(); it != children.end();) {
+        if (isClosed(**it)) {
+            out << (*it)->label << ": connection closed\n";
+            (*it)->deregisterHandler();
+            it = children.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+bool ExternalInterfaceServer::setOption(const std::string &key,
+                                        const std::string &value) {
+    if (isReaderOption(key)) {
+        // reading adds and removes interfaces, only in the thread of the
+        // bridge
+        return false;
+    }
+    return ExternalInterfaceBase::setOption(key, value);
+}
+
+std::vector<std::shared_ptr<ExternalInterfaceBase>>
+ExternalInterfaceServer::getChildren() const {
+    return children;
+}
+
+void ExternalInterfaceServer::printStatus(const std::string prefix) const {
+    ExternalInterfaceBase::printStatus(prefix);
+    for (auto it : children) {
+        it->printStatus(prefix + "  ");
+    }
+}
+
+ExternalInterfaceTcpServerClient::ExternalInterfaceTcpServerClient(
+    struct NDLComBridge &bridge, std::string label,
+    ExternalInterfaceTcpServer &_server, int _fd, size_t _txBufferSize,
+    uint8_t flags)
+    : ndlcom::ExternalInterfaceBase(bridge, label, std::cerr, flags),
+      server(_server), fd(_fd), readable(true), txBufferSize(_txBufferSize),
+      closed(false) {}
+
+ExternalInterfaceTcpServerClient::~ExternalInterfaceTcpServerClient() {
+    close(fd);
+}
+
+bool ExternalInterfaceTcpServerClient::isClosed() const { return closed; }
+
+bool ExternalInterfaceTcpServerClient::setOption(const std::string &key,
+                                                 const std::string &value) {
+    if (isReaderOption(key)) {
+        // the buffer and the epoll set are not guarded
+        return false;
+    }
+    return ExternalInterfaceBase::setOption(key, value);
+}
+
+size_t ExternalInterfaceTcpServerClient::readEscapedBytes(void *buf,
+                                                          size_t count) {
+    // the bridge reads every interface regularly, a good time to retry
+    flushTxBuffer();
+    server.pollEvents();
+    if (!readable || closed) {
+        return 0;
+    }
 again:
     ssize_t bytesRead = recv(fd, buf, count, 0);
     if (bytesRead < 0) {
@@ -653,33 +2023,583 @@ again:
             // ignore signals
             goto again;
         } else if (errno == EAGAIN) {
-            // nothing to read, just return
+            // nothing to read, wait for the epoll set
+            readable = false;
             return 0;
         }
-        // TODO: is this correct?
-        reportRuntimeError(strerror(errno), __FILE__, __LINE__);
+        // like a reset connection. the server removes us
+        out << label << ": " << strerror(errno) << "\n";
+        closed = true;
+        return 0;
+    }
+    if (bytesRead == 0) {
+        // closed by the other side
+        closed = true;
         return 0;
     }
+    if ((size_t)bytesRead < count) {
+        // got everything there was
+        readable = false;
+    }
     return bytesRead;
 }
 
-void ExternalInterfaceTcpClient::writeEscapedBytes(const void *buf,
-                                                   size_t count) {
-    size_t alreadyWritten = 0;
-again:
-    while (alreadyWritten < count) {
-        ssize_t written = send(fd, (const char *)buf + alreadyWritten,
-                               count - alreadyWritten, MSG_NOSIGNAL);
-        if (written == -1) {
+size_t ExternalInterfaceTcpServerClient::writeEscapedBytes(const void *buf,
+                                                           size_t count) {
+    struct NDLComExternalInterfaceFrame frame;
+    frame.data = buf;
+    frame.length = count;
+    return writeEscapedFrames(&frame, 1);
+}
+
+size_t ExternalInterfaceTcpServerClient::writeEscapedFrames(
+    const struct NDLComExternalInterfaceFrame *frames, size_t count) {
+    if (closed) {
+        return 0;
+    }
+    flushTxBuffer();
+    size_t sent = 0;
+    // with something buffered, everything new goes behind it
+    if (txBuffer.empty()) {
+        std::vector<struct iovec> iov(count);
+        for (size_t i = 0; i < count; ++i) {
+            iov[i].iov_base = const_cast<void *>(frames[i].data);
+            iov[i].iov_len = frames[i].length;
+        }
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov.data();
+        msg.msg_iovlen = std::min<size_t>(iov.size(), IOV_MAX);
+        ssize_t r;
+        do {
+            r = sendmsg(fd, &msg, MSG_NOSIGNAL);
+        } while (r == -1 && errno == EINTR);
+        if (r == -1 && errno != EAGAIN) {
+            // gone. noticed when reading
+            return 0;
+        }
+        sent = r > 0 ? r : 0;
+    }
+    // the rest of a frame cut by the socket has to follow in any case, the
+    // other ones only as a whole
+    size_t written = sent;
+    size_t skip = sent;
+    for (size_t i = 0; i < count; ++i) {
+        const uint8_t *data = static_cast<const uint8_t *>(frames[i].data);
+        if (skip >= frames[i].length) {
+            skip -= frames[i].length;
+            continue;
+        }
+        if (skip == 0 && txBuffer.size() + frames[i].length > txBufferSize) {
+            continue;
+        }
+        txBuffer.insert(txBuffer.end(), data + skip, data + frames[i].length);
+        written += frames[i].length - skip;
+        skip = 0;
+    }
+    return written;
+}
+
+void ExternalInterfaceTcpServerClient::flushTxBuffer() {
+    while (!txBuffer.empty() && !closed) {
+        ssize_t sent =
+            send(fd, txBuffer.data(), txBuffer.size(), MSG_NOSIGNAL);
+        if (sent == -1) {
+            if (errno == EINTR) {
+                // ignore signals
+                continue;
+            } else if (errno != EAGAIN) {
+                // gone, the buffer will never be written
+                noteDroppedBytes(txBuffer.size());
+                txBuffer.clear();
+            }
+            return;
+        }
+        txBuffer.erase(txBuffer.begin(), txBuffer.begin() + sent);
+    }
+}
+
+size_t ExternalInterfaceTcpServerClient::getRxQueueDepth() const {
+    return queueDepthOfDescriptor(fd, SIOCINQ);
+}
+
+size_t ExternalInterfaceTcpServerClient::getTxQueueDepth() const {
+    return txBuffer.size() + queueDepthOfDescriptor(fd, SIOCOUTQ);
+}
+
+int ExternalInterfaceTcpServerClient::getPollFd() const { return fd; }
+
+ExternalInterfaceTcpServer::ExternalInterfaceTcpServer(
+    struct NDLComBridge &bridge, std::string hostname, unsigned int port,
+    uint8_t flags)
+    : ndlcom::ExternalInterfaceServer(bridge, "tcpserver://" + hostname +
+                                                  ":" + std::to_string(port),
+                                      flags),
+      txBufferSize(defaultTxBufferSize), fd(-1), epollFd(-1), polled(false),
+      acceptable(false), events(1) {
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (!hostname.empty()) {
+        struct addrinfo hints = {0};
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        struct addrinfo *result;
+        // try to resolve the hostname-string
+        int retval = getaddrinfo(hostname.c_str(), nullptr, &hints, &result);
+        if (retval != 0) {
+            reportRuntimeError(gai_strerror(retval), __FILE__, __LINE__);
+        }
+        addr.sin_addr = ((struct sockaddr_in *)result->ai_addr)->sin_addr;
+        freeaddrinfo(result);
+    }
+
+    fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        reportRuntimeError("failed to create socket: " +
+                               std::string(strerror(errno)),
+                           __FILE__, __LINE__);
+    }
+    // do not wait for old connections of a previous process to time out
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1 ||
+        listen(fd, SOMAXCONN) == -1) {
+        const std::string error = strerror(errno);
+        close(fd);
+        reportRuntimeError("failed to listen on port " +
+                               std::to_string(port) + ": " + error,
+                           __FILE__, __LINE__);
+    }
+
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    // the listening socket is the one without a client
+    ev.data.ptr = nullptr;
+    if (epollFd == -1 || epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+        const std::string error = strerror(errno);
+        close(fd);
+        if (epollFd != -1) {
+            close(epollFd);
+        }
+        reportRuntimeError("failed to create epoll set: " + error, __FILE__,
+                           __LINE__);
+    }
+}
+
+const unsigned int ndlcom::ExternalInterfaceTcpServer::defaultPort = 2000;
+const size_t ndlcom::ExternalInterfaceTcpServer::defaultTxBufferSize = 65536;
+const std::regex &ndlcom::ExternalInterfaceTcpServer::uri() {
+    static const std::regex regex(
+        "^tcpserver://([^:&]*)(?::(\\d+))?(?:&(.*))?$");
+    return regex;
+}
+ExternalInterfaceTcpServer::ExternalInterfaceTcpServer(
+    struct NDLComBridge &_bridge, std::smatch match, uint8_t flags)
+    : ExternalInterfaceTcpServer(
+          _bridge, match[1],
+          match[2].length() ? std::stoi(match[2].str()) : defaultPort, flags) {}
+
+ExternalInterfaceTcpServer::~ExternalInterfaceTcpServer() {
+    // the clients are closed by the base-class
+    close(epollFd);
+    close(fd);
+}
+
+size_t ExternalInterfaceTcpServer::readEscapedBytes(void *buf, size_t count) {
+    // in case there are no clients to do it
+    pollEvents();
+    // the clients are read before the server, they ask again in the next
+    // round
+    polled = false;
+    removeChildren([this](ExternalInterfaceBase &child) {
+        ExternalInterfaceTcpServerClient &client =
+            static_cast<ExternalInterfaceTcpServerClient &>(child);
+        if (!client.isClosed()) {
+            return false;
+        }
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, client.fd, nullptr);
+        return true;
+    });
+    if (acceptable) {
+        acceptable = false;
+        acceptChildren(fd, [this](int client,
+                                  const struct sockaddr_storage &peer) {
+            const struct sockaddr_in &addr =
+                reinterpret_cast<const struct sockaddr_in &>(peer);
+            // small messages shall go out at once
+            int one = 1;
+            setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            char host[INET_ADDRSTRLEN];
+            inet_ntop(AF_INET, &addr.sin_addr, host, sizeof(host));
+            std::shared_ptr<ExternalInterfaceTcpServerClient> p =
+                std::make_shared<ExternalInterfaceTcpServerClient>(
+                    caller, label + "#" + host + ":" +
+                                std::to_string(ntohs(addr.sin_port)),
+                    *this, client, txBufferSize, handler.flags);
+            struct epoll_event ev;
+            memset(&ev, 0, sizeof(ev));
+            ev.events = EPOLLIN | EPOLLRDHUP;
+            ev.data.ptr = p.get();
+            if (epoll_ctl(epollFd, EPOLL_CTL_ADD, client, &ev) == -1) {
+                out << label << ": refusing " << p->label << ": "
+                    << strerror(errno) << "\n";
+                // closes the descriptor
+                return std::shared_ptr<ExternalInterfaceBase>();
+            }
+            return std::shared_ptr<ExternalInterfaceBase>(p);
+        });
+        events.resize(children.size() + 1);
+    }
+    return 0;
+}
+
+int ExternalInterfaceTcpServer::getPollFd() const { return epollFd; }
+
+unsigned int ExternalInterfaceTcpServer::getPort() const {
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    if (getsockname(fd, (struct sockaddr *)&addr, &len) == -1) {
+        return 0;
+    }
+    return ntohs(addr.sin_port);
+}
+
+void ExternalInterfaceTcpServer::pollEvents() {
+    if (polled) {
+        return;
+    }
+    polled = true;
+    int ready;
+    do {
+        ready = epoll_wait(epollFd, events.data(), events.size(), 0);
+    } while (ready == -1 && errno == EINTR);
+    for (int i = 0; i < ready; ++i) {
+        if (events[i].data.ptr) {
+            // data, or a hangup seen when reading
+            static_cast<ExternalInterfaceTcpServerClient *>(events[i].data.ptr)
+                ->readable = true;
+        } else {
+            acceptable = true;
+        }
+    }
+}
+
+bool ExternalInterfaceTcpServer::setOption(const std::string &key,
+                                           const std::string &value) {
+    if (key == "txbuffer") {
+        txBufferSize = std::stoul(value);
+        return true;
+    }
+    return ExternalInterfaceServer::setOption(key, value);
+}
+
+std::vector<std::weak_ptr<ExternalInterfaceTcpServerClient>>
+ExternalInterfaceTcpServer::getClients() const {
+    std::vector<std::weak_ptr<ExternalInterfaceTcpServerClient>> retval;
+    for (auto it : children) {
+        retval.push_back(
+            std::static_pointer_cast<ExternalInterfaceTcpServerClient>(it));
+    }
+    return retval;
+}
+
+// a packet from a client has to fit, or it is truncated
+static const size_t unixPacketSize = 65536;
+
+ExternalInterfaceUnixClient::ExternalInterfaceUnixClient(
+    struct NDLComBridge &bridge, std::string label, int _fd,
+    const struct ucred &_credentials, size_t _txQueueSize, uint8_t flags)
+    : ndlcom::ExternalInterfaceBase(bridge, label, std::cerr, flags),
+      credentials(_credentials), fd(_fd), rx(unixPacketSize), rxLength(0),
+      rxPosition(0), txQueueBytes(0), txQueueSize(_txQueueSize),
+      closed(false) {}
+
+ExternalInterfaceUnixClient::~ExternalInterfaceUnixClient() { close(fd); }
+
+bool ExternalInterfaceUnixClient::isClosed() const { return closed; }
+
+bool ExternalInterfaceUnixClient::setOption(const std::string &key,
+                                            const std::string &value) {
+    if (isReaderOption(key)) {
+        // the queue is not guarded
+        return false;
+    }
+    return ExternalInterfaceBase::setOption(key, value);
+}
+
+size_t ExternalInterfaceUnixClient::readEscapedBytes(void *buf, size_t count) {
+    // the bridge reads every interface regularly, a good time to retry
+    flushTxQueue();
+    if (rxPosition == rxLength) {
+        if (closed) {
+            return 0;
+        }
+    again:
+        ssize_t bytesRead = recv(fd, rx.data(), rx.size(), MSG_TRUNC);
+        if (bytesRead < 0) {
             if (errno == EINTR) {
                 // ignore signals
                 goto again;
+            } else if (errno == EAGAIN) {
+                // nothing to read, just return
+                return 0;
             }
-            reportRuntimeError(strerror(errno), __FILE__, __LINE__);
+            // like a reset connection. the server removes us
+            out << label << ": " << strerror(errno) << "\n";
+            closed = true;
+            return 0;
+        }
+        if (bytesRead == 0) {
+            // closed by the other side. an empty packet would look the same,
+            // but nobody sends them
+            closed = true;
+            return 0;
+        }
+        if ((size_t)bytesRead > rx.size()) {
+            out << label << ": packet of " << bytesRead
+                << " bytes truncated\n";
+            bytesRead = rx.size();
+        }
+        rxLength = bytesRead;
+        rxPosition = 0;
+    }
+    const size_t len = std::min(count, rxLength - rxPosition);
+    memcpy(buf, rx.data() + rxPosition, len);
+    rxPosition += len;
+    return len;
+}
+
+size_t ExternalInterfaceUnixClient::writeEscapedBytes(const void *buf,
+                                                      size_t count) {
+    struct NDLComExternalInterfaceFrame frame;
+    frame.data = buf;
+    frame.length = count;
+    return writeEscapedFrames(&frame, 1);
+}
+
+size_t ExternalInterfaceUnixClient::writeEscapedFrames(
+    const struct NDLComExternalInterfaceFrame *frames, size_t count) {
+    if (closed) {
+        return 0;
+    }
+    flushTxQueue();
+    size_t alreadySent = 0;
+    size_t written = 0;
+    // with something queued, everything new goes behind it
+    if (txQueue.empty()) {
+        std::vector<struct iovec> iov(count);
+        std::vector<struct mmsghdr> msgs(count);
+        for (size_t i = 0; i < count; ++i) {
+            iov[i].iov_base = const_cast<void *>(frames[i].data);
+            iov[i].iov_len = frames[i].length;
+            memset(&msgs[i], 0, sizeof(msgs[i]));
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+        while (alreadySent < count) {
+            int sent = sendmmsg(fd, msgs.data() + alreadySent,
+                                count - alreadySent, MSG_NOSIGNAL);
+            if (sent == -1) {
+                if (errno == EINTR) {
+                    // ignore signals
+                    continue;
+                } else if (errno == EAGAIN) {
+                    // the socket is full, queue the rest
+                    break;
+                }
+                // gone. noticed when reading
+                return written;
+            }
+            for (int i = 0; i < sent; ++i) {
+                written += msgs[alreadySent + i].msg_len;
+            }
+            alreadySent += sent;
         }
-        alreadyWritten += written;
     }
-    return;
+    for (size_t i = alreadySent; i < count && txQueue.size() < txQueueSize;
+         ++i) {
+        const uint8_t *data = static_cast<const uint8_t *>(frames[i].data);
+        txQueue.emplace_back(data, data + frames[i].length);
+        txQueueBytes += frames[i].length;
+        written += frames[i].length;
+    }
+    return written;
+}
+
+void ExternalInterfaceUnixClient::flushTxQueue() {
+    while (!txQueue.empty() && !closed) {
+        ssize_t sent = send(fd, txQueue.front().data(), txQueue.front().size(),
+                            MSG_NOSIGNAL);
+        if (sent == -1) {
+            if (errno == EINTR) {
+                // ignore signals
+                continue;
+            } else if (errno != EAGAIN) {
+                // gone, the queue will never be written
+                noteDroppedBytes(txQueueBytes);
+                txQueue.clear();
+                txQueueBytes = 0;
+            }
+            return;
+        }
+        txQueueBytes -= txQueue.front().size();
+        txQueue.pop_front();
+    }
+}
+
+size_t ExternalInterfaceUnixClient::getRxQueueDepth() const {
+    return queueDepthOfDescriptor(fd, SIOCINQ);
+}
+
+size_t ExternalInterfaceUnixClient::getTxQueueDepth() const {
+    return txQueueBytes + queueDepthOfDescriptor(fd, SIOCOUTQ);
+}
+
+int ExternalInterfaceUnixClient::getPollFd() const { return fd; }
+
+ExternalInterfaceUnixServer::ExternalInterfaceUnixServer(
+    struct NDLComBridge &bridge, std::string _path, uint8_t flags)
+    : ndlcom::ExternalInterfaceServer(bridge, "unix://" + _path, flags),
+      allowedUid(-1), allowedGid(-1), txQueueSize(defaultTxQueueSize),
+      path(_path), fd(-1) {
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+        reportRuntimeError("invalid path for unix socket: '" + path + "'",
+                           __FILE__, __LINE__);
+    }
+    memcpy(addr.sun_path, path.c_str(), path.size());
+
+    // a socket file left by a process which is gone can be replaced
+    struct stat st;
+    if (lstat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+        int probe = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+        const bool stale =
+            probe != -1 &&
+            connect(probe, (struct sockaddr *)&addr, sizeof(addr)) == -1 &&
+            errno == ECONNREFUSED;
+        if (probe != -1) {
+            close(probe);
+        }
+        if (!stale) {
+            reportRuntimeError("'" + path + "' is in use", __FILE__,
+                               __LINE__);
+        }
+        unlink(path.c_str());
+    }
+
+    fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        reportRuntimeError("failed to create socket: " +
+                               std::string(strerror(errno)),
+                           __FILE__, __LINE__);
+    }
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1 ||
+        listen(fd, SOMAXCONN) == -1) {
+        const std::string error = strerror(errno);
+        close(fd);
+        reportRuntimeError("failed to listen on '" + path + "': " + error,
+                           __FILE__, __LINE__);
+    }
+}
+
+const size_t ndlcom::ExternalInterfaceUnixServer::defaultTxQueueSize = 256;
+const std::regex &ndlcom::ExternalInterfaceUnixServer::uri() {
+    static const std::regex regex(
+        "^unix://([^&]*)(?:&(.*))?$");
+    return regex;
+}
+ExternalInterfaceUnixServer::ExternalInterfaceUnixServer(
+    struct NDLComBridge &_bridge, std::smatch match, uint8_t flags)
+    : ExternalInterfaceUnixServer(_bridge, match[1], flags) {}
+
+ExternalInterfaceUnixServer::~ExternalInterfaceUnixServer() {
+    // the clients are closed by the base-class
+    close(fd);
+    unlink(path.c_str());
+}
+
+size_t ExternalInterfaceUnixServer::readEscapedBytes(void *buf, size_t count) {
+    removeChildren([](ExternalInterfaceBase &child) {
+        return static_cast<ExternalInterfaceUnixClient &>(child).isClosed();
+    });
+    acceptChildren(fd, [this](int client,
+                              const struct sockaddr_storage &peer) {
+        struct ucred credentials;
+        socklen_t len = sizeof(credentials);
+        if (getsockopt(client, SOL_SOCKET, SO_PEERCRED, &credentials, &len) ==
+            -1) {
+            out << label << ": no credentials of new client: "
+                << strerror(errno) << "\n";
+            close(client);
+            return std::shared_ptr<ExternalInterfaceBase>();
+        }
+        if (!isAllowed(credentials)) {
+            out << label << ": refusing pid " << credentials.pid << " (uid "
+                << credentials.uid << ", gid " << credentials.gid << ")\n";
+            close(client);
+            return std::shared_ptr<ExternalInterfaceBase>();
+        }
+        return std::shared_ptr<ExternalInterfaceBase>(
+            std::make_shared<ExternalInterfaceUnixClient>(
+                caller, label + "#" + std::to_string(credentials.pid), client,
+                credentials, txQueueSize, handler.flags));
+    });
+    return 0;
+}
+
+int ExternalInterfaceUnixServer::getPollFd() const { return fd; }
+
+bool ExternalInterfaceUnixServer::isAllowed(
+    const struct ucred &credentials) const {
+    if (allowedUid < 0 && allowedGid < 0) {
+        return true;
+    }
+    return (allowedUid >= 0 && credentials.uid == (uid_t)allowedUid) ||
+           (allowedGid >= 0 && credentials.gid == (gid_t)allowedGid);
+}
+
+bool ExternalInterfaceUnixServer::setOption(const std::string &key,
+                                            const std::string &value) {
+    if (key == "uid") {
+        allowedUid = std::stoi(value);
+        return true;
+    }
+    if (key == "gid") {
+        allowedGid = std::stoi(value);
+        return true;
+    }
+    if (key == "mode") {
+        if (chmod(path.c_str(), std::stoul(value, nullptr, 8)) == -1) {
+            reportRuntimeError("chmod() of '" + path + "' failed: " +
+                                   std::string(strerror(errno)),
+                               __FILE__, __LINE__);
+        }
+        return true;
+    }
+    if (key == "txqueue") {
+        txQueueSize = std::stoul(value);
+        return true;
+    }
+    return ExternalInterfaceServer::setOption(key, value);
+}
+
+std::vector<std::weak_ptr<ExternalInterfaceUnixClient>>
+ExternalInterfaceUnixServer::getClients() const {
+    std::vector<std::weak_ptr<ExternalInterfaceUnixClient>> retval;
+    for (auto it : children) {
+        retval.push_back(
+            std::static_pointer_cast<ExternalInterfaceUnixClient>(it));
+    }
+    return retval;
 }
 
 ExternalInterfacePipe::ExternalInterfacePipe(struct NDLComBridge &bridge,
@@ -748,8 +2668,11 @@ ExternalInterfacePipe::ExternalInterfacePipe(struct NDLComBridge &bridge,
     }
 }
 
-const std::regex
-    ndlcom::ExternalInterfacePipe::uri("^pipe://([^:&]*)(?:&(.*))?$");
+const std::regex &ndlcom::ExternalInterfacePipe::uri() {
+    static const std::regex regex(
+        "^pipe://([^:&]*)(?:&(.*))?$");
+    return regex;
+}
 ExternalInterfacePipe::ExternalInterfacePipe(struct NDLComBridge &_bridge,
                                              std::smatch match, uint8_t flags)
     : ExternalInterfacePipe(_bridge, match[1], flags) {}
@@ -815,7 +2738,8 @@ size_t ExternalInterfacePipe::readEscapedBytes(void *buf, size_t count) {
     return readSoFar;
 }
 
-void ExternalInterfacePipe::writeEscapedBytes(const void *buf, size_t count) {
+size_t ExternalInterfacePipe::writeEscapedBytes(const void *buf,
+                                                size_t count) {
     // simple
     for (size_t i = 0; i < count; ++i) {
         // printing hex-encoded packets into the pipe we opened before
@@ -827,7 +2751,11 @@ void ExternalInterfacePipe::writeEscapedBytes(const void *buf, size_t count) {
     // going on there...
     fflush(str_out);
 
-    return;
+    return count;
+}
+
+int ExternalInterfacePipe::getPollFd() const {
+    return str_in ? fileno(str_in) : -1;
 }
 
 ExternalInterfacePty::ExternalInterfacePty(struct NDLComBridge &bridge,
@@ -865,22 +2793,19 @@ ExternalInterfacePty::ExternalInterfacePty(struct NDLComBridge &bridge,
     // provide a nice symlink pointing to our "/dev/pts/\d\+"
     prepareSymlink();
 
-    // fdopen for the base-class
-    fd_read = fdopen(pty_fd, "r");
-    if (!fd_read) {
-        reportRuntimeError(strerror(errno), __FILE__, __LINE__);
-    }
-    fd_write = fdopen(pty_fd, "r+");
-    if (!fd_write) {
-        reportRuntimeError(strerror(errno), __FILE__, __LINE__);
-    }
+    // for the base-class
+    fd_read = pty_fd;
+    fd_write = pty_fd;
 
     out << "ExternalInterfacePty: the slave side is named '" << ptsname(pty_fd)
         << "', the symlink is '" << symlinkname << "'\n";
 }
 
-const std::regex
-    ndlcom::ExternalInterfacePty::uri("^pty://([^:&]*)(?:&(.*))?$");
+const std::regex &ndlcom::ExternalInterfacePty::uri() {
+    static const std::regex regex(
+        "^pty://([^:&]*)(?:&(.*))?$");
+    return regex;
+}
 ExternalInterfacePty::ExternalInterfacePty(struct NDLComBridge &_bridge,
                                            std::smatch match, uint8_t flags)
     : ExternalInterfacePty(_bridge, match[1], flags) {}
@@ -888,6 +2813,7 @@ ExternalInterfacePty::ExternalInterfacePty(struct NDLComBridge &_bridge,
 ExternalInterfacePty::~ExternalInterfacePty() {
     // delete the previously created symlink
     cleanSymlink();
+    uring.reset();
     // not sure...
     close(pty_fd);
 }
@@ -980,25 +2906,34 @@ void ExternalInterfacePty::prepareSymlink() const {
 }
 
 size_t ExternalInterfacePty::readEscapedBytes(void *buf, size_t count) {
-    if (!fd_read) {
+    if (fd_read < 0) {
         return 0;
     }
-    size_t bytesRead = fread(buf, sizeof(char), count, fd_read);
-    if (bytesRead == 0) {
-        if (ferror(fd_read)) {
-            if (errno == EAGAIN || errno == EIO) {
-                // in case of a pty, slaves connecting and disconnecting are
-                // seen as "errors", but we need to ignore some of them
-                return 0;
-            } else {
-                reportRuntimeError("error during fread(): " +
-                                       std::string(strerror(errno)),
-                                   __FILE__, __LINE__);
-                return 0;
-            }
-        } else {
+    if (uring) {
+        // see below, "EIO" just means no slave is connected
+        ssize_t bytesRead = uring->read(buf, count);
+        if (bytesRead < 0 && bytesRead != -EIO) {
+            reportRuntimeError("error during read: " +
+                                   std::string(strerror(-bytesRead)),
+                               __FILE__, __LINE__);
+        }
+        return bytesRead > 0 ? bytesRead : 0;
+    }
+again:
+    ssize_t bytesRead = read(fd_read, buf, count);
+    if (bytesRead < 0) {
+        if (errno == EINTR) {
+            // ignore signals
+            goto again;
+        } else if (errno == EAGAIN || errno == EIO) {
+            // in case of a pty, slaves connecting and disconnecting are
+            // seen as "errors", but we need to ignore some of them
             return 0;
         }
+        reportRuntimeError("error during read(): " +
+                               std::string(strerror(errno)),
+                           __FILE__, __LINE__);
+        return 0;
     }
     return bytesRead;
 }
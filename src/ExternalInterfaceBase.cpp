@@ -1,5 +1,17 @@
 #include "ndlcom/ExternalInterfaceBase.hpp"
 
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
 #include <cstdio>
 #include <iosfwd>
 #include <stdexcept>
@@ -8,14 +20,245 @@
 
 using namespace ndlcom;
 
+const size_t ExternalInterfaceBase::defaultBatchSize = 16;
+// a power of two, the indices are masked
+const size_t ExternalInterfaceBase::readerRingSize = 65536;
+
+// touched by every reader thread when started, in case memory is locked
+static const size_t readerStackPrefault = 64 * 1024;
+
 ExternalInterfaceBase::ExternalInterfaceBase(struct NDLComBridge &bridge,
                                              std::string _label,
                                              std::ostream &_out, uint8_t flags)
     : ExternalInterfaceVeryBase(bridge, external, _label, _out), paused(false),
-      bytesTransmitted(0), bytesReceived(0) {
-    ndlcomExternalInterfaceInit(&external, ExternalInterfaceBase::writeWrapper,
-                                ExternalInterfaceBase::readWrapper, flags,
-                                this);
+      bytesTransmitted(0), bytesReceived(0), bytesDropped(0), readerHead(0),
+      readerTail(0), readerStop(false), readerFailed(false),
+      readerEventFd(-1), parserResetRequested(false),
+      parserResetPending(false), parserResetAt(0) {
+    struct NDLComExternalInterfaceOps ops;
+    ops.read = ExternalInterfaceBase::readWrapper;
+    ops.writeFrames = ExternalInterfaceBase::writeFramesWrapper;
+    ops.pollFd = ExternalInterfaceBase::pollFdWrapper;
+    ndlcomExternalInterfaceInitOps(&external, &ops, flags, this);
+    setBatchSize(defaultBatchSize);
+}
+
+ExternalInterfaceBase::~ExternalInterfaceBase() {
+    // normally already done in "deregisterHandler()"
+    stopReaderThread();
+    if (readerEventFd != -1) {
+        close(readerEventFd);
+    }
+}
+
+size_t ExternalInterfaceBase::writeEscapedFrames(
+    const struct NDLComExternalInterfaceFrame *frames, size_t count) {
+    size_t written = 0;
+    for (size_t i = 0; i < count; ++i) {
+        written += writeEscapedBytes(frames[i].data, frames[i].length);
+    }
+    return written;
+}
+
+int ExternalInterfaceBase::getPollFd() const { return -1; }
+
+int ExternalInterfaceBase::getWakeupFd() const {
+    return hasReaderThread() ? readerEventFd : getPollFd();
+}
+
+void ExternalInterfaceBase::setBatchSize(size_t frames) {
+    // flushes whatever is pending in the old buffers
+    ndlcomExternalInterfaceSetBatchBuffer(&external, nullptr, 0, nullptr, 0);
+    // every frame is one iovec when writing them out
+    frames = std::min<size_t>(frames, IOV_MAX);
+    if (frames < 2) {
+        batchFrames.clear();
+        batchBuffer.clear();
+        return;
+    }
+    batchFrames.resize(frames);
+    batchBuffer.resize(frames * NDLCOM_MAX_ENCODED_MESSAGE_SIZE);
+    ndlcomExternalInterfaceSetBatchBuffer(&external, batchFrames.data(),
+                                          batchFrames.size(),
+                                          batchBuffer.data(),
+                                          batchBuffer.size());
+}
+
+void ExternalInterfaceBase::startReaderThread() {
+    if (readerThread.joinable()) {
+        return;
+    }
+    if (readerEventFd == -1) {
+        readerEventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (readerEventFd == -1) {
+            reportRuntimeError("eventfd() failed: " +
+                                   std::string(strerror(errno)),
+                               __FILE__, __LINE__);
+        }
+    }
+    readerRing.resize(readerRingSize);
+    readerHead = 0;
+    readerTail = 0;
+    readerStop = false;
+    readerFailed = false;
+    readerError = nullptr;
+    readerThread = std::thread(&ExternalInterfaceBase::readerLoop, this);
+}
+
+void ExternalInterfaceBase::stopReaderThread() {
+    if (!readerThread.joinable()) {
+        return;
+    }
+    readerStop = true;
+    readerThread.join();
+    // bytes still in the ring are lost, just like in kernel buffers when
+    // closing a device
+    readerHead = 0;
+    readerTail = 0;
+    // a reset the bridge did not reach yet is done with the next read
+    if (parserResetPending.exchange(false)) {
+        parserResetRequested = true;
+    }
+}
+
+bool ExternalInterfaceBase::hasReaderThread() const {
+    return readerThread.joinable();
+}
+
+void ExternalInterfaceBase::setReaderThreadCpu(int cpu) {
+    startReaderThread();
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    int r = pthread_setaffinity_np(readerThread.native_handle(), sizeof(cpus),
+                                   &cpus);
+    if (r != 0) {
+        reportRuntimeError("pthread_setaffinity_np() for cpu " +
+                               std::to_string(cpu) +
+                               " failed: " + std::string(strerror(r)),
+                           __FILE__, __LINE__);
+    }
+}
+
+void ExternalInterfaceBase::setReaderThreadPriority(int priority) {
+    startReaderThread();
+    struct sched_param p;
+    p.sched_priority = priority;
+    int r = pthread_setschedparam(readerThread.native_handle(),
+                                  priority ? SCHED_FIFO : SCHED_OTHER, &p);
+    if (r != 0) {
+        reportRuntimeError("pthread_setschedparam() with priority " +
+                               std::to_string(priority) +
+                               " failed: " + std::string(strerror(r)),
+                           __FILE__, __LINE__);
+    }
+}
+
+void ExternalInterfaceBase::lockMemory() {
+    // the ring is only allocated when a thread is started, do it now so that
+    // it is already there
+    readerRing.resize(readerRingSize);
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) == -1) {
+        reportRuntimeError("mlockall() failed: " + std::string(strerror(errno)),
+                           __FILE__, __LINE__);
+    }
+}
+
+void ExternalInterfaceBase::readerLoop() {
+    {
+        // prefault the stack, so that later calls do not page fault
+        volatile uint8_t stack[readerStackPrefault];
+        memset(const_cast<uint8_t *>(stack), 0, sizeof(stack));
+    }
+    const size_t mask = readerRing.size() - 1;
+    const std::chrono::milliseconds idle(1);
+    struct pollfd ufd;
+    ufd.events = POLLIN;
+    try {
+        while (!readerStop) {
+            const size_t head = readerHead.load(std::memory_order_relaxed);
+            // everything up to "head" came before the reset. only one at a
+            // time, a second one waits for the bridge to reach the first
+            if (!parserResetPending.load(std::memory_order_acquire) &&
+                parserResetRequested.exchange(false)) {
+                parserResetAt.store(head, std::memory_order_relaxed);
+                parserResetPending.store(true, std::memory_order_release);
+            }
+            const size_t space = readerRing.size() -
+                                 (head - readerTail.load(std::memory_order_acquire));
+            if (space == 0) {
+                // the bridge is too slow, leave the rest in the kernel
+                std::this_thread::sleep_for(idle);
+                continue;
+            }
+            // wake up now and then to check "readerStop". reading anyway
+            // then, some interfaces have to look after their connection.
+            // the descriptor may change with it
+            ufd.fd = getPollFd();
+            if (ufd.fd != -1 && poll(&ufd, 1, 100) < 0) {
+                continue;
+            }
+            const size_t offset = head & mask;
+            const size_t got = readEscapedBytes(
+                &readerRing[offset], std::min(space, readerRing.size() - offset));
+            if (got == 0) {
+                std::this_thread::sleep_for(idle);
+                continue;
+            }
+            readerHead.store(head + got, std::memory_order_release);
+            const uint64_t one = 1;
+            if (write(readerEventFd, &one, sizeof(one)) == -1) {
+                // the counter is already high enough, nothing to do
+            }
+        }
+    } catch (...) {
+        readerError = std::current_exception();
+        readerFailed.store(true, std::memory_order_release);
+        const uint64_t one = 1;
+        if (write(readerEventFd, &one, sizeof(one)) == -1) {
+        }
+    }
+}
+
+size_t ExternalInterfaceBase::readFromRing(void *buf, size_t count) {
+    if (readerFailed.load(std::memory_order_acquire)) {
+        readerThread.join();
+        readerFailed = false;
+        std::rethrow_exception(readerError);
+    }
+    const size_t mask = readerRing.size() - 1;
+    const size_t tail = readerTail.load(std::memory_order_relaxed);
+    size_t available = readerHead.load(std::memory_order_acquire) - tail;
+    if (parserResetPending.load(std::memory_order_acquire)) {
+        const size_t at = parserResetAt.load(std::memory_order_relaxed);
+        if (tail == at) {
+            ndlcomParserDestroyPacket(&external.parser);
+            parserResetPending.store(false, std::memory_order_release);
+        } else {
+            // the bytes before the reset first
+            available = std::min(available, at - tail);
+        }
+    }
+    const size_t offset = tail & mask;
+    // up to the end of the ring, the rest in the next call
+    const size_t len =
+        std::min(std::min(available, count), readerRing.size() - offset);
+    memcpy(buf, &readerRing[offset], len);
+    readerTail.store(tail + len, std::memory_order_release);
+    if (len == available) {
+        // empty: clear the eventfd, then check again for what the thread
+        // added meanwhile, its wakeup might just have been cleared
+        uint64_t value;
+        if (read(readerEventFd, &value, sizeof(value)) == -1) {
+            // was not set
+        }
+        if (readerHead.load(std::memory_order_acquire) != tail + len) {
+            const uint64_t one = 1;
+            if (write(readerEventFd, &one, sizeof(one)) == -1) {
+            }
+        }
+    }
+    return len;
 }
 
 void ExternalInterfaceBase::registerHandler() {
@@ -23,6 +266,8 @@ void ExternalInterfaceBase::registerHandler() {
 }
 
 void ExternalInterfaceBase::deregisterHandler() {
+    // before the deriving class is gone, the thread uses its functions
+    stopReaderThread();
     ndlcomBridgeDeregisterExternalInterface(&caller, &handler);
 }
 
@@ -34,23 +279,98 @@ size_t ExternalInterfaceBase::getCrcFails() const {
     return ndlcomParserGetNumberOfCRCFails(&external.parser);
 }
 
+size_t ExternalInterfaceBase::getPacketsReceived() const {
+    return ndlcomExternalInterfaceGetPacketsReceived(&external);
+}
+
+size_t ExternalInterfaceBase::getPacketsTransmitted() const {
+    return ndlcomExternalInterfaceGetPacketsTransmitted(&external);
+}
+
+size_t ExternalInterfaceBase::getPacketsRefused() const {
+    return ndlcomExternalInterfaceGetPacketsRefused(&external);
+}
+
+size_t ExternalInterfaceBase::getRxQueueDepth() const { return 0; }
+
+size_t ExternalInterfaceBase::getTxQueueDepth() const { return 0; }
+
+struct InterfaceMetrics ExternalInterfaceBase::getMetrics() const {
+    struct InterfaceMetrics retval;
+    retval.label = label;
+    retval.mirror =
+        external.flags & NDLCOM_EXTERNAL_INTERFACE_FLAGS_DEBUG_MIRROR;
+    retval.paused = paused;
+    retval.bytesReceived = bytesReceived;
+    retval.bytesTransmitted = bytesTransmitted;
+    retval.bytesDropped = bytesDropped;
+    retval.packetsReceived = getPacketsReceived();
+    retval.packetsTransmitted = getPacketsTransmitted();
+    retval.packetsRefused = getPacketsRefused();
+    retval.crcFails = getCrcFails();
+    retval.rxQueueDepth = getRxQueueDepth();
+    retval.txQueueDepth = getTxQueueDepth();
+    retval.connected = true;
+    retval.reconnects = 0;
+    retval.lastOutage = std::chrono::milliseconds(0);
+    return retval;
+}
+
+std::vector<std::shared_ptr<ExternalInterfaceBase>>
+ExternalInterfaceBase::getChildren() const {
+    return std::vector<std::shared_ptr<ExternalInterfaceBase>>();
+}
+
 void ExternalInterfaceBase::printStatus(const std::string prefix) const {
     HandlerCommon::printStatus(prefix);
     out << prefix << "   crcFail: " << getCrcFails()
         << " rawBytesRx: " << bytesReceived << " rawBytesTx: " << bytesTransmitted
+        << (bytesDropped ? " rawBytesDropped: " + std::to_string(bytesDropped)
+                         : "")
+        << (getPacketsRefused()
+                ? " packetsRefused: " + std::to_string(getPacketsRefused())
+                : "")
+        << (external.flags & NDLCOM_EXTERNAL_INTERFACE_FLAGS_COMPRESS
+                ? " [COMPRESS]"
+                : "")
+        << (external.flags & NDLCOM_EXTERNAL_INTERFACE_FLAGS_FRAMED
+                ? (external.flags & NDLCOM_EXTERNAL_INTERFACE_FLAGS_FRAMED_CRC
+                       ? " [FRAMED+CRC]"
+                       : " [FRAMED]")
+                : "")
         << (paused ? " [PAUSED]" : "") << "\n";
 }
 
 // static wrapper function for the c-callback
-void ExternalInterfaceBase::writeWrapper(void *context, const void *buf,
-                                         const size_t count) {
+size_t ExternalInterfaceBase::writeFramesWrapper(
+    void *context, const struct NDLComExternalInterfaceFrame *frames,
+    const size_t count) {
     class ExternalInterfaceBase *self =
         static_cast<class ExternalInterfaceBase *>(context);
+    size_t total = 0;
+    for (size_t i = 0; i < count; ++i) {
+        total += frames[i].length;
+    }
     if (self->paused) {
-        return;
+        return total;
+    }
+    const size_t written = self->writeEscapedFrames(frames, count);
+    // only what went out, the rest is counted as dropped
+    size_t left = written;
+    for (size_t i = 0; i < count && left; ++i) {
+        const size_t length = std::min(frames[i].length, left);
+        self->noteOutgoingBytes(frames[i].data, length);
+        left -= length;
+    }
+    if (written < total) {
+        self->noteDroppedBytes(total - written);
     }
-    self->writeEscapedBytes(buf, count);
-    self->noteOutgoingBytes(buf, count);
+    return written;
+}
+
+// static wrapper function for the C-callback
+int ExternalInterfaceBase::pollFdWrapper(void *context) {
+    return static_cast<class ExternalInterfaceBase *>(context)->getWakeupFd();
 }
 
 // static wrapper function for the C-callback
@@ -58,8 +378,12 @@ size_t ExternalInterfaceBase::readWrapper(void *context, void *buf,
                                           const size_t count) {
     class ExternalInterfaceBase *self =
         static_cast<class ExternalInterfaceBase *>(context);
+    if (!self->hasReaderThread() && self->parserResetRequested.exchange(false)) {
+        ndlcomParserDestroyPacket(&self->external.parser);
+    }
     // reading even if paused, to empty kernel buffer
-    size_t read = self->readEscapedBytes(buf, count);
+    size_t read = self->hasReaderThread() ? self->readFromRing(buf, count)
+                                          : self->readEscapedBytes(buf, count);
     if (self->paused) {
         read = 0;
     }
@@ -67,6 +391,8 @@ size_t ExternalInterfaceBase::readWrapper(void *context, void *buf,
     return read;
 }
 
+void ExternalInterfaceBase::resetParser() { parserResetRequested = true; }
+
 void ExternalInterfaceBase::noteIncomingBytes(const void *buf, size_t count) {
     bytesReceived += count;
 }
@@ -75,6 +401,14 @@ void ExternalInterfaceBase::noteOutgoingBytes(const void *buf, size_t count) {
     bytesTransmitted += count;
 }
 
+void ExternalInterfaceBase::noteDroppedBytes(size_t count) {
+    bytesDropped += count;
+}
+
+bool ExternalInterfaceBase::getFlag(uint8_t flag) const {
+    return external.flags & flag;
+}
+
 void ExternalInterfaceBase::setFlag(uint8_t flag, bool value) {
     uint8_t oldFlags = external.flags;
     if (value) {
@@ -84,6 +418,68 @@ void ExternalInterfaceBase::setFlag(uint8_t flag, bool value) {
     }
 }
 
+bool ExternalInterfaceBase::setOption(const std::string &key,
+                                      const std::string &value) {
+    if (key == "compress") {
+        setFlag(NDLCOM_EXTERNAL_INTERFACE_FLAGS_COMPRESS, value != "0");
+        return true;
+    }
+    if (key == "framed") {
+        setFlag(NDLCOM_EXTERNAL_INTERFACE_FLAGS_FRAMED, value != "0");
+        setFlag(NDLCOM_EXTERNAL_INTERFACE_FLAGS_FRAMED_CRC, value == "crc");
+        return true;
+    }
+    if (key == "batch") {
+        size_t frames = defaultBatchSize;
+        if (!value.empty()) {
+            size_t pos;
+            frames = std::stoul(value, &pos);
+            if (pos != value.size()) {
+                throw std::invalid_argument("batch");
+            }
+        }
+        setBatchSize(frames);
+        return true;
+    }
+    if (key == "thread") {
+        if (value == "0") {
+            stopReaderThread();
+        } else {
+            startReaderThread();
+        }
+        return true;
+    }
+    if (key == "cpu") {
+        setReaderThreadCpu(std::stoi(value));
+        return true;
+    }
+    if (key == "prio") {
+        setReaderThreadPriority(std::stoi(value));
+        return true;
+    }
+    if (key == "mlock") {
+        lockMemory();
+        return true;
+    }
+    if (key == "uring") {
+        // the reader thread waits on getPollFd(), which changes
+        const bool thread = hasReaderThread();
+        stopReaderThread();
+        const bool enabled = setIoUring(value != "0");
+        if (thread) {
+            startReaderThread();
+        }
+        if (!enabled && value != "0") {
+            out << label << ": io_uring not available, using the normal "
+                << "syscalls\n";
+        }
+        return true;
+    }
+    return false;
+}
+
+bool ExternalInterfaceBase::setIoUring(bool enable) { return false; }
+
 void ExternalInterfaceBase::setRoutingForDeviceId(const NDLComId deviceId) {
     ndlcomExternalInterfaceSetRoutingForDeviceId(&external, deviceId);
 }
@@ -0,0 +1,77 @@
+#include "ndlcom/ExternalInterfaceLoopback.hpp"
+
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <string>
+
+using namespace ndlcom;
+
+const size_t LoopbackLink::defaultCapacity = 64 * 1024;
+
+static std::atomic<unsigned int> numberOfLinks(0);
+
+LoopbackLink::LoopbackLink(size_t capacity) : id(numberOfLinks++) {
+    for (auto &r : ring) {
+        r.buffer.resize(capacity);
+        r.head = 0;
+        r.fill = 0;
+    }
+}
+
+bool LoopbackLink::Ring::write(const void *buf, size_t count) {
+    if (count > buffer.size() - fill) {
+        return false;
+    }
+    const uint8_t *bytes = static_cast<const uint8_t *>(buf);
+    const size_t tail = (head + fill) % buffer.size();
+    const size_t first = std::min(count, buffer.size() - tail);
+    memcpy(buffer.data() + tail, bytes, first);
+    memcpy(buffer.data(), bytes + first, count - first);
+    fill += count;
+    return true;
+}
+
+size_t LoopbackLink::Ring::read(void *buf, size_t count) {
+    uint8_t *bytes = static_cast<uint8_t *>(buf);
+    count = std::min(count, fill);
+    const size_t first = std::min(count, buffer.size() - head);
+    memcpy(bytes, buffer.data() + head, first);
+    memcpy(bytes + first, buffer.data(), count - first);
+    head = (head + count) % buffer.size();
+    fill -= count;
+    return count;
+}
+
+ExternalInterfaceLoopback::ExternalInterfaceLoopback(
+    struct NDLComBridge &bridge, std::shared_ptr<LoopbackLink> _link,
+    unsigned int side, uint8_t flags)
+    : ExternalInterfaceBase(bridge,
+                            "loopback://" + std::to_string(_link->id) +
+                                (side ? "b" : "a"),
+                            std::cerr, flags),
+      link(_link), rx(link->ring[side ? 0 : 1]), tx(link->ring[side ? 1 : 0]) {
+}
+
+size_t ExternalInterfaceLoopback::readEscapedBytes(void *buf, size_t count) {
+    return rx.read(buf, count);
+}
+
+size_t ExternalInterfaceLoopback::writeEscapedBytes(const void *buf,
+                                                    size_t count) {
+    return tx.write(buf, count) ? count : 0;
+}
+
+size_t ExternalInterfaceLoopback::getRxQueueDepth() const { return rx.fill; }
+
+size_t ExternalInterfaceLoopback::getTxQueueDepth() const { return tx.fill; }
+
+std::pair<std::weak_ptr<ExternalInterfaceLoopback>,
+          std::weak_ptr<ExternalInterfaceLoopback>>
+ndlcom::connectBridges(Bridge &a, Bridge &b, size_t capacity, uint8_t flags) {
+    std::shared_ptr<LoopbackLink> link =
+        std::make_shared<LoopbackLink>(capacity);
+    return std::make_pair(
+        a.createExternalInterface<ExternalInterfaceLoopback>(link, 0u, flags),
+        b.createExternalInterface<ExternalInterfaceLoopback>(link, 1u, flags));
+}
@@ -8,7 +8,7 @@ using namespace ndlcom;
 /**
  * BridgeHandler:
  */
-void BridgeHandler::sendRaw(const struct NDLComHeader *header,
+bool BridgeHandler::sendRaw(const struct NDLComHeader *header,
                             const void *payload) {
     // TODO: would need a check if this class is actually registered at the
     // "caller" as there is a small time-window during the creation of this
@@ -16,7 +16,7 @@ void BridgeHandler::sendRaw(const struct NDLComHeader *header,
     //
     // but this might not be a problem in this class, assuming the type of
     // "caller" is an actual "struct NDLComBridge"
-    ndlcomBridgeSendRaw(&caller, header, payload);
+    return ndlcomBridgeSendRaw(&caller, header, payload);
 }
 
 void BridgeHandler::registerHandler() {
@@ -30,9 +30,9 @@ void BridgeHandler::deregisterHandler() {
 /**
  * NodeHandler:
  */
-void NodeHandler::send(const NDLComId receiverId, const void *payload,
+bool NodeHandler::send(const NDLComId receiverId, const void *payload,
                        const size_t length) {
-    ndlcomNodeSend(&caller, receiverId, payload, length);
+    return ndlcomNodeSend(&caller, receiverId, payload, length);
 }
 
 void NodeHandler::registerHandler() {
@@ -0,0 +1,518 @@
+#include "ndlcom/IoUring.hpp"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+
+#ifdef NDLCOM_HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+using namespace ndlcom;
+
+// small enough that all three buffers stay below the default "memlock" limit
+// of 64k, which applies to registered buffers on older kernels
+const size_t IoUring::bufferSize = 16 * 1024;
+const size_t IoUring::maxFrames = 64;
+
+// entries of the submission queue: one read and a batch of datagrams, or a
+// cancel for each of them
+static const unsigned ringEntries = 128;
+
+// how long the destructor waits for the kernel to give up on its requests
+static const std::chrono::milliseconds cancelTimeout(500);
+
+// the lower byte of "user_data" tells what completed. writes store the send
+// buffer and the index of their frame above, to count what was lost. every
+// request has a "user_data" of its own, so that it can be cancelled alone
+enum {
+    TAG_READ = 1,
+    TAG_WRITE = 2,
+    TAG_CANCEL = 3,
+};
+
+static uint64_t writeTag(unsigned buffer, size_t frame) {
+    return TAG_WRITE | (uint64_t)buffer << 8 | (uint64_t)frame << 16;
+}
+
+IoUring::IoUring(int _fd, bool _datagram)
+    : fd(_fd), datagram(_datagram), oldFlags(-1), ringFd(-1), sqRing(nullptr),
+      sqRingSize(0), cqRing(nullptr), cqRingSize(0), sqes(nullptr),
+      sqesSize(0), sqEntries(0), sqLocalTail(0), fixedBuffers(false),
+      outstanding(0), cancelling(false), buffers(new Buffers()),
+      rxLength(0), rxPosition(0), rxArmed(false), rxEof(false), rxError(0),
+      txFill(0), txInFlight(0), txDropped(0), txError(0) {
+    memset(&buffers->rxSender, 0, sizeof(buffers->rxSender));
+    memset(&sender, 0, sizeof(sender));
+    for (int b = 0; b < 2; ++b) {
+        txLength[b] = 0;
+    }
+    setup();
+    if (ringFd == -1) {
+        return;
+    }
+    buffers->rx.resize(bufferSize);
+    for (int b = 0; b < 2; ++b) {
+        buffers->tx[b].resize(bufferSize);
+        buffers->txIov[b].resize(maxFrames);
+        buffers->txMsg[b].resize(maxFrames);
+        memset(&buffers->txTo[b], 0, sizeof(buffers->txTo[b]));
+    }
+#ifdef NDLCOM_HAVE_IO_URING
+    if (!datagram) {
+        // the kernel can skip mapping the pages for every request. optional,
+        // fails for example when over the "memlock" limit
+        struct iovec iov[3] = {
+            {buffers->rx.data(), buffers->rx.size()},
+            {buffers->tx[0].data(), buffers->tx[0].size()},
+            {buffers->tx[1].data(), buffers->tx[1].size()}};
+        fixedBuffers = syscall(__NR_io_uring_register, ringFd,
+                               IORING_REGISTER_BUFFERS, iov, 3) == 0;
+    }
+#endif
+    makeBlocking();
+    std::lock_guard<std::mutex> lock(mutex);
+    armRead();
+}
+
+IoUring::~IoUring() {
+    if (ringFd == -1) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    // the kernel must not write into the buffers after they are gone
+    cancelling = true;
+    if (!cancelAll()) {
+        // a request stuck somewhere in a driver. better to lose the memory
+        // than to have it overwritten later
+        buffers.release();
+    }
+    if (oldFlags != -1) {
+        fcntl(fd, F_SETFL, oldFlags);
+    }
+    teardown();
+}
+
+bool IoUring::cancelAll() {
+#ifdef NDLCOM_HAVE_IO_URING
+    if (!outstanding) {
+        return true;
+    }
+    // one cancel per request. "IORING_ASYNC_CANCEL_ANY" would be shorter, but
+    // needs a kernel of 5.19
+    std::vector<uint64_t> targets;
+    if (rxArmed) {
+        targets.push_back(TAG_READ);
+    }
+    if (txInFlight) {
+        const unsigned b = 1 - txFill;
+        const size_t frames = datagram ? txFrames[b].size() : 1;
+        for (size_t i = 0; i < frames; ++i) {
+            targets.push_back(writeTag(b, i));
+        }
+    }
+    for (auto target : targets) {
+        if (!getSqSpace()) {
+            submit(0);
+        }
+        struct io_uring_sqe *sqe = static_cast<struct io_uring_sqe *>(getSqe());
+        if (!sqe) {
+            break;
+        }
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->addr = target;
+        sqe->user_data = TAG_CANCEL;
+        outstanding++;
+    }
+    submit(0);
+    // the ring is readable as soon as something completed
+    const auto deadline = std::chrono::steady_clock::now() + cancelTimeout;
+    while (outstanding) {
+        const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now());
+        if (left.count() <= 0) {
+            return false;
+        }
+        struct pollfd pfd = {ringFd, POLLIN, 0};
+        if (poll(&pfd, 1, left.count()) < 0 && errno != EINTR) {
+            return false;
+        }
+        reap();
+    }
+#endif
+    return true;
+}
+
+bool IoUring::restart() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (ringFd == -1) {
+        return false;
+    }
+    cancelling = true;
+    if (!cancelAll()) {
+        return false;
+    }
+    cancelling = false;
+    // nothing of the old connection is of any use
+    txDropped += txLength[txFill];
+    for (int b = 0; b < 2; ++b) {
+        txLength[b] = 0;
+        txFrames[b].clear();
+    }
+    txFill = 0;
+    txError = 0;
+    rxLength = 0;
+    rxPosition = 0;
+    rxEof = false;
+    rxError = 0;
+    makeBlocking();
+    armRead();
+    return true;
+}
+
+void IoUring::makeBlocking() {
+    oldFlags = fcntl(fd, F_GETFL);
+    if (oldFlags != -1 && (oldFlags & O_NONBLOCK)) {
+        fcntl(fd, F_SETFL, oldFlags & ~O_NONBLOCK);
+    }
+}
+
+bool IoUring::valid() const { return ringFd != -1; }
+
+bool IoUring::eof() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return rxEof;
+}
+
+struct sockaddr_in IoUring::getSender() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return sender;
+}
+
+int IoUring::getPollFd() const { return ringFd; }
+
+size_t IoUring::takeDropped() {
+    std::lock_guard<std::mutex> lock(mutex);
+    reap();
+    size_t retval = txDropped;
+    txDropped = 0;
+    return retval;
+}
+
+ssize_t IoUring::read(void *buf, size_t count) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (ringFd == -1) {
+        return -ENOSYS;
+    }
+    reap();
+    if (rxError) {
+        const int error = rxError;
+        rxError = 0;
+        armRead();
+        return error;
+    }
+    const size_t len = std::min(count, rxLength - rxPosition);
+    memcpy(buf, buffers->rx.data() + rxPosition, len);
+    rxPosition += len;
+    if (len && datagram) {
+        sender = buffers->rxSender;
+    }
+    if (rxPosition == rxLength) {
+        rxPosition = 0;
+        rxLength = 0;
+        armRead();
+    }
+    return len;
+}
+
+ssize_t IoUring::write(const struct NDLComExternalInterfaceFrame *frames,
+                       size_t count, const struct sockaddr_in *to) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (ringFd == -1) {
+        return -ENOSYS;
+    }
+    reap();
+    if (txError) {
+        const int error = txError;
+        txError = 0;
+        return error;
+    }
+    const unsigned b = txFill;
+    std::vector<uint8_t> &tx = buffers->tx[b];
+    size_t accepted = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (txLength[b] + frames[i].length > tx.size() ||
+            (datagram && txFrames[b].size() == maxFrames)) {
+            break;
+        }
+        memcpy(tx.data() + txLength[b], frames[i].data, frames[i].length);
+        txLength[b] += frames[i].length;
+        txFrames[b].push_back(frames[i].length);
+        accepted += frames[i].length;
+    }
+    if (datagram && to) {
+        buffers->txTo[b] = *to;
+    }
+    if (!txInFlight) {
+        flushTx();
+    }
+    return accepted;
+}
+
+void IoUring::flushTx() {
+#ifdef NDLCOM_HAVE_IO_URING
+    const unsigned b = txFill;
+    if (!txLength[b] || cancelling) {
+        return;
+    }
+    // all of a batch or nothing. what stays collected is tried again with
+    // the next completion or write
+    const unsigned needed = datagram ? txFrames[b].size() : 1;
+    if (getSqSpace() < needed) {
+        submit(0);
+        if (getSqSpace() < needed) {
+            return;
+        }
+    }
+    if (!datagram) {
+        struct io_uring_sqe *sqe = static_cast<struct io_uring_sqe *>(getSqe());
+        sqe->opcode = fixedBuffers ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+        sqe->fd = fd;
+        sqe->addr = (uint64_t)(uintptr_t)buffers->tx[b].data();
+        sqe->len = txLength[b];
+        sqe->buf_index = 1 + b;
+        sqe->user_data = writeTag(b, 0);
+        txInFlight = 1;
+    } else {
+        size_t offset = 0;
+        for (size_t i = 0; i < txFrames[b].size(); ++i) {
+            struct iovec &iov = buffers->txIov[b][i];
+            struct msghdr &msg = buffers->txMsg[b][i];
+            iov.iov_base = buffers->tx[b].data() + offset;
+            iov.iov_len = txFrames[b][i];
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_name = &buffers->txTo[b];
+            msg.msg_namelen = sizeof(buffers->txTo[b]);
+            msg.msg_iov = &iov;
+            msg.msg_iovlen = 1;
+            offset += txFrames[b][i];
+
+            struct io_uring_sqe *sqe =
+                static_cast<struct io_uring_sqe *>(getSqe());
+            sqe->opcode = IORING_OP_SENDMSG;
+            sqe->fd = fd;
+            sqe->addr = (uint64_t)(uintptr_t)&msg;
+            sqe->len = 1;
+            sqe->msg_flags = MSG_NOSIGNAL;
+            sqe->user_data = writeTag(b, i);
+        }
+        txInFlight = txFrames[b].size();
+    }
+    outstanding += txInFlight;
+    txFill = 1 - b;
+    txLength[txFill] = 0;
+    txFrames[txFill].clear();
+    submit(0);
+#endif
+}
+
+void IoUring::armRead() {
+#ifdef NDLCOM_HAVE_IO_URING
+    if (rxArmed || rxEof || rxLength || cancelling) {
+        return;
+    }
+    struct io_uring_sqe *sqe = static_cast<struct io_uring_sqe *>(getSqe());
+    if (!sqe) {
+        return;
+    }
+    if (datagram) {
+        struct msghdr &msg = buffers->rxMsg;
+        buffers->rxIov.iov_base = buffers->rx.data();
+        buffers->rxIov.iov_len = buffers->rx.size();
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_name = &buffers->rxSender;
+        msg.msg_namelen = sizeof(buffers->rxSender);
+        msg.msg_iov = &buffers->rxIov;
+        msg.msg_iovlen = 1;
+        sqe->opcode = IORING_OP_RECVMSG;
+        sqe->addr = (uint64_t)(uintptr_t)&msg;
+        sqe->len = 1;
+    } else {
+        sqe->opcode = fixedBuffers ? IORING_OP_READ_FIXED : IORING_OP_READ;
+        sqe->addr = (uint64_t)(uintptr_t)buffers->rx.data();
+        sqe->len = buffers->rx.size();
+        sqe->buf_index = 0;
+        // a file position of -1 reads "at the current position", like read()
+        sqe->off = (uint64_t)-1;
+    }
+    sqe->fd = fd;
+    sqe->user_data = TAG_READ;
+    rxArmed = true;
+    outstanding++;
+    submit(0);
+#endif
+}
+
+void IoUring::reap() {
+#ifdef NDLCOM_HAVE_IO_URING
+    struct io_uring_cqe *entries = static_cast<struct io_uring_cqe *>(cqes);
+    unsigned head = *cqHead;
+    while (head != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+        const struct io_uring_cqe &cqe = entries[head & *cqMask];
+        const uint64_t tag = cqe.user_data & 0xff;
+        const int res = cqe.res;
+        head++;
+        outstanding--;
+        if (tag == TAG_READ) {
+            rxArmed = false;
+            if (res > 0) {
+                rxLength = res;
+                rxPosition = 0;
+            } else if (res == 0 && !datagram) {
+                // the other side closed the stream, reading again would
+                // complete at once, for ever
+                rxEof = true;
+            } else if (res < 0 && res != -EAGAIN && res != -EINTR &&
+                       res != -ECANCELED) {
+                rxError = res;
+            }
+        } else if (tag == TAG_WRITE) {
+            const unsigned b = (cqe.user_data >> 8) & 0xff;
+            const size_t length = datagram ? txFrames[b][cqe.user_data >> 16]
+                                           : txLength[b];
+            txDropped += length - std::min<size_t>(length, std::max(res, 0));
+            if (res < 0 && res != -ECANCELED && !txError) {
+                txError = res;
+            }
+            txInFlight--;
+        }
+    }
+    __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+    // the collected batch goes out as soon as the last one is done
+    if (!txInFlight && txLength[txFill]) {
+        flushTx();
+    }
+    if (!rxArmed && !rxLength && !rxError) {
+        armRead();
+    }
+#endif
+}
+
+unsigned IoUring::getSqSpace() const {
+#ifdef NDLCOM_HAVE_IO_URING
+    return sqEntries - (sqLocalTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE));
+#else
+    return 0;
+#endif
+}
+
+void *IoUring::getSqe() {
+#ifdef NDLCOM_HAVE_IO_URING
+    if (!getSqSpace()) {
+        return nullptr;
+    }
+    const unsigned index = sqLocalTail & *sqMask;
+    struct io_uring_sqe *sqe = static_cast<struct io_uring_sqe *>(sqes) + index;
+    memset(sqe, 0, sizeof(*sqe));
+    sqArray[index] = index;
+    sqLocalTail++;
+    return sqe;
+#else
+    return nullptr;
+#endif
+}
+
+int IoUring::submit(unsigned wait) {
+#ifdef NDLCOM_HAVE_IO_URING
+    const unsigned toSubmit = sqLocalTail - *sqTail;
+    __atomic_store_n(sqTail, sqLocalTail, __ATOMIC_RELEASE);
+    if (!toSubmit && !wait) {
+        return 0;
+    }
+    return syscall(__NR_io_uring_enter, ringFd, toSubmit, wait,
+                   wait ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+#else
+    return -1;
+#endif
+}
+
+void IoUring::setup() {
+#ifdef NDLCOM_HAVE_IO_URING
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    ringFd = syscall(__NR_io_uring_setup, ringEntries, &p);
+    if (ringFd < 0) {
+        // ENOSYS on old kernels, EPERM if disabled by sysctl or seccomp
+        ringFd = -1;
+        return;
+    }
+    sqRingSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    const bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+    if (single) {
+        sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+    }
+    sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+    if (sqRing == MAP_FAILED) {
+        sqRing = nullptr;
+        teardown();
+        return;
+    }
+    if (single) {
+        cqRing = sqRing;
+    } else {
+        cqRing = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+        if (cqRing == MAP_FAILED) {
+            cqRing = nullptr;
+            teardown();
+            return;
+        }
+    }
+    sqesSize = p.sq_entries * sizeof(struct io_uring_sqe);
+    sqes = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        sqes = nullptr;
+        teardown();
+        return;
+    }
+    uint8_t *sq = static_cast<uint8_t *>(sqRing);
+    uint8_t *cq = static_cast<uint8_t *>(cqRing);
+    sqHead = reinterpret_cast<unsigned *>(sq + p.sq_off.head);
+    sqTail = reinterpret_cast<unsigned *>(sq + p.sq_off.tail);
+    sqMask = reinterpret_cast<unsigned *>(sq + p.sq_off.ring_mask);
+    sqArray = reinterpret_cast<unsigned *>(sq + p.sq_off.array);
+    sqEntries = p.sq_entries;
+    sqLocalTail = *sqTail;
+    cqHead = reinterpret_cast<unsigned *>(cq + p.cq_off.head);
+    cqTail = reinterpret_cast<unsigned *>(cq + p.cq_off.tail);
+    cqMask = reinterpret_cast<unsigned *>(cq + p.cq_off.ring_mask);
+    cqes = cq + p.cq_off.cqes;
+#endif
+}
+
+void IoUring::teardown() {
+#ifdef NDLCOM_HAVE_IO_URING
+    if (sqes) {
+        munmap(sqes, sqesSize);
+    }
+    if (cqRing && cqRing != sqRing) {
+        munmap(cqRing, cqRingSize);
+    }
+    if (sqRing) {
+        munmap(sqRing, sqRingSize);
+    }
+#endif
+    if (ringFd != -1) {
+        close(ringFd);
+        ringFd = -1;
+    }
+}
@@ -0,0 +1,198 @@
+#include "ndlcom/Metrics.hpp"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+#include "ndlcom/Bridge.hpp"
+
+using namespace ndlcom;
+
+/**
+ * the labels are uri-strings and contain mostly harmless characters, but as
+ * they come from the commandline we better be careful
+ */
+static void writeJsonString(std::ostream &out, const std::string &s) {
+    out << '"';
+    for (auto c : s) {
+        switch (c) {
+        case '"':
+            out << "\\\"";
+            break;
+        case '\\':
+            out << "\\\\";
+            break;
+        case '\n':
+            out << "\\n";
+            break;
+        case '\t':
+            out << "\\t";
+            break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                char buf[8];
+                snprintf(buf, sizeof(buf), "\\u%04x", c);
+                out << buf;
+            } else {
+                out << c;
+            }
+        }
+    }
+    out << '"';
+}
+
+void ndlcom::writeMetricsJson(std::ostream &out,
+                              const struct BridgeMetrics &metrics) {
+    std::chrono::milliseconds sinceEpoch =
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            metrics.timestamp.time_since_epoch());
+    char timestamp[32];
+    snprintf(timestamp, sizeof(timestamp), "%lld.%03lld",
+             static_cast<long long>(sinceEpoch.count() / 1000),
+             static_cast<long long>(sinceEpoch.count() % 1000));
+
+    out << "{\"timestamp\":" << timestamp
+        << ",\"sendQueueDropped\":" << metrics.sendQueueDropped
+        << ",\"interfaces\":[";
+    for (size_t i = 0; i < metrics.interfaces.size(); ++i) {
+        const struct InterfaceMetrics &it = metrics.interfaces[i];
+        out << (i ? "," : "") << "{\"label\":";
+        writeJsonString(out, it.label);
+        out << ",\"mirror\":" << (it.mirror ? "true" : "false")
+            << ",\"paused\":" << (it.paused ? "true" : "false")
+            << ",\"bytesRx\":" << it.bytesReceived
+            << ",\"bytesTx\":" << it.bytesTransmitted
+            << ",\"bytesDropped\":" << it.bytesDropped
+            << ",\"packetsRx\":" << it.packetsReceived
+            << ",\"packetsTx\":" << it.packetsTransmitted
+            << ",\"packetsRefused\":" << it.packetsRefused
+            << ",\"crcFails\":" << it.crcFails
+            << ",\"rxQueue\":" << it.rxQueueDepth
+            << ",\"txQueue\":" << it.txQueueDepth
+            << ",\"connected\":" << (it.connected ? "true" : "false")
+            << ",\"reconnects\":" << it.reconnects
+            << ",\"lastOutageMs\":" << it.lastOutage.count() << "}";
+    }
+    out << "],\"missEvents\":[";
+    for (size_t i = 0; i < metrics.missEvents.size(); ++i) {
+        const struct MissEventMetrics &it = metrics.missEvents[i];
+        out << (i ? "," : "") << "{\"sender\":" << (int)it.senderId
+            << ",\"receiver\":" << (int)it.receiverId
+            << ",\"count\":" << it.missEvents
+            << ",\"lossRate\":" << it.lossRate
+            << ",\"reorderRate\":" << it.reorderRate << "}";
+    }
+    out << "],\"routing\":[";
+    for (size_t i = 0; i < metrics.routing.size(); ++i) {
+        const struct RoutingMetrics &it = metrics.routing[i];
+        out << (i ? "," : "") << "{\"deviceId\":" << (int)it.deviceId
+            << ",\"interface\":";
+        writeJsonString(out, it.interface);
+        out << "}";
+    }
+    out << "]}";
+}
+
+MetricsServer::MetricsServer(const ndlcom::Bridge &_bridge, std::string _path,
+                             std::chrono::milliseconds _interval,
+                             std::ostream &_out)
+    : bridge(_bridge), path(_path), interval(_interval), out(_out),
+      nextSnapshot(std::chrono::steady_clock::now() + _interval), fd(-1) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+        throw std::runtime_error(std::string(__FILE__) + ":" +
+                                 std::to_string(__LINE__) +
+                                 " -- invalid socket path '" + path + "'");
+    }
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        throw std::runtime_error(std::string(__FILE__) + ":" +
+                                 std::to_string(__LINE__) + " -- " +
+                                 strerror(errno));
+    }
+    // a leftover from a previous run would make "bind()" fail
+    unlink(path.c_str());
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1 ||
+        listen(fd, 8) == -1) {
+        std::string error(strerror(errno));
+        close(fd);
+        throw std::runtime_error(std::string(__FILE__) + ":" +
+                                 std::to_string(__LINE__) + " -- " + path +
+                                 ": " + error);
+    }
+    out << "MetricsServer: exporting metrics on '" << path << "' every "
+        << interval.count() << "ms\n";
+}
+
+MetricsServer::~MetricsServer() {
+    for (auto it : clients) {
+        close(it);
+    }
+    close(fd);
+    unlink(path.c_str());
+}
+
+size_t MetricsServer::getClientCount() const { return clients.size(); }
+
+void MetricsServer::process() {
+    // accept everybody who is waiting, they get a first snapshot right away
+    std::vector<int> newClients;
+    int client;
+    while ((client = accept4(fd, nullptr, nullptr,
+                             SOCK_NONBLOCK | SOCK_CLOEXEC)) != -1) {
+        newClients.push_back(client);
+    }
+    if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        out << "MetricsServer: accept() failed: " << strerror(errno) << "\n";
+    }
+    if (!newClients.empty()) {
+        clients.insert(clients.end(), newClients.begin(), newClients.end());
+        sendSnapshot(newClients);
+    }
+
+    std::chrono::time_point<std::chrono::steady_clock> now =
+        std::chrono::steady_clock::now();
+    if (now < nextSnapshot) {
+        return;
+    }
+    // not catching up on missed intervals, just start a new one
+    nextSnapshot = now + interval;
+    if (!clients.empty()) {
+        sendSnapshot(clients);
+    }
+}
+
+void MetricsServer::sendSnapshot(const std::vector<int> &receivers) {
+    std::ostringstream line;
+    writeMetricsJson(line, bridge.getMetrics());
+    line << "\n";
+    const std::string data = line.str();
+
+    std::vector<int> lost;
+    for (auto it : receivers) {
+        // a snapshot is either sent completely or the client is dropped. a
+        // half written line would leave the client with garbage, and waiting
+        // for it would stall the bridge.
+        ssize_t written =
+            send(it, data.data(), data.size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (written != static_cast<ssize_t>(data.size())) {
+            lost.push_back(it);
+        }
+    }
+    for (auto it : lost) {
+        close(it);
+        clients.erase(std::remove(clients.begin(), clients.end(), it),
+                      clients.end());
+    }
+}
@@ -109,8 +109,8 @@ void ndlcomNodeMessageHandler(void *context, const struct NDLComHeader *header,
 /*
  * Sending a payload to a receiver
  */
-void ndlcomNodeSend(struct NDLComNode *node, const NDLComId receiverId,
-                    const void *payload, const size_t payloadSize) {
+uint8_t ndlcomNodeSend(struct NDLComNode *node, const NDLComId receiverId,
+                       const void *payload, const size_t payloadSize) {
     /*
      * preparation of the header, filling in packet counter
      */
@@ -119,7 +119,7 @@ void ndlcomNodeSend(struct NDLComNode *node, const NDLComId receiverId,
     /*
      * transmitting a message using the bridge
      */
-    ndlcomBridgeSendRaw(node->bridgeHandler.bridge, &header, payload);
+    return ndlcomBridgeSendRaw(node->bridgeHandler.bridge, &header, payload);
 }
 
 void ndlcomNodeRegisterNodeHandler(struct NDLComNode *node,
@@ -42,13 +42,13 @@ const NDLComId Node::getOwnDeviceId() const {
     return ndlcomNodeGetOwnDeviceId(&node);
 }
 
-void Node::send(const NDLComId receiverId, const void *payload,
+bool Node::send(const NDLComId receiverId, const void *payload,
                 size_t payloadSize) {
-    ndlcomNodeSend(&node, receiverId, payload, payloadSize);
+    return ndlcomNodeSend(&node, receiverId, payload, payloadSize);
 }
 
-void Node::send(struct ndlcom::OutgoingPayload msg) {
-    ndlcomNodeSend(&node, msg.destinationId, msg.data(), msg.dataLen());
+bool Node::send(struct ndlcom::OutgoingPayload msg) {
+    return ndlcomNodeSend(&node, msg.destinationId, msg.data(), msg.dataLen());
 }
 
 void Node::setOwnDeviceId(const NDLComId ownDeviceId) {
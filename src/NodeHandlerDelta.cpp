@@ -0,0 +1,210 @@
+#include "ndlcom/NodeHandlerDelta.hpp"
+
+#include <string.h>
+#include <string>
+
+#include "ndlcom/Compression.h"
+
+using namespace ndlcom;
+
+const size_t NodeHandlerDelta::defaultNumberOfStreams = 16;
+const unsigned int NodeHandlerDelta::defaultKeyframeInterval = 100;
+
+NodeHandlerDelta::NodeHandlerDelta(struct NDLComNode &node,
+                                   size_t numberOfStreams,
+                                   unsigned int _keyframeInterval,
+                                   std::ostream &_out)
+    : NodeHandler(node, "NodeHandlerDelta", _out), keyframesSent(0),
+      deltasSent(0), bytesSaved(0), keyframesRequested(0),
+      messagesReceived(0), messagesLost(0),
+      keyframeInterval(_keyframeInterval ? _keyframeInterval : 1),
+      sending(numberOfStreams ? numberOfStreams : 1),
+      receiving(numberOfStreams ? numberOfStreams : 1), useCounter(0) {
+    for (auto &stream : sending) {
+        stream.used = false;
+        stream.lastUsed = 0;
+    }
+    for (auto &stream : receiving) {
+        stream.used = false;
+        stream.lastUsed = 0;
+    }
+}
+
+struct NodeHandlerDelta::Stream *
+NodeHandlerDelta::findStream(std::vector<struct Stream> &streams,
+                             const NDLComId peerId, const uint8_t type,
+                             const bool create) {
+    struct Stream *freeStream = nullptr;
+    struct Stream *oldestStream = &streams.front();
+    for (auto &stream : streams) {
+        if (!stream.used) {
+            freeStream = &stream;
+        } else if (stream.peerId == peerId && stream.type == type) {
+            stream.lastUsed = useCounter++;
+            return &stream;
+        } else if (stream.lastUsed < oldestStream->lastUsed) {
+            oldestStream = &stream;
+        }
+    }
+    if (!create) {
+        return nullptr;
+    }
+    struct Stream &stream = freeStream ? *freeStream : *oldestStream;
+    stream.used = true;
+    stream.valid = false;
+    stream.keyframeRequested = false;
+    stream.peerId = peerId;
+    stream.type = type;
+    stream.seq = 0;
+    stream.length = 0;
+    stream.sinceKeyframe = 0;
+    stream.lastUsed = useCounter++;
+    return &stream;
+}
+
+bool NodeHandlerDelta::sendStream(const NDLComId receiverId,
+                                  const void *payload, const size_t length) {
+    if (length == 0 || length > NDLCOM_DELTA_MAX_PAYLOAD_SIZE) {
+        return false;
+    }
+    const uint8_t *data = static_cast<const uint8_t *>(payload);
+    struct Stream &stream = *findStream(sending, receiverId, data[0], true);
+    uint8_t frame[NDLCOM_MAX_PAYLOAD_SIZE];
+    size_t frameLength = 0;
+    frame[0] = NDLCOM_DELTA_MARKER;
+    frame[2] = stream.type;
+    frame[3] = ++stream.seq;
+
+    if (stream.valid && stream.length == length && !stream.keyframeRequested &&
+        stream.sinceKeyframe + 1 < keyframeInterval) {
+        uint8_t delta[NDLCOM_DELTA_MAX_PAYLOAD_SIZE];
+        for (size_t i = 0; i < length; ++i) {
+            delta[i] = stream.data[i] ^ data[i];
+        }
+        // only worth it if it is smaller than the message itself
+        frameLength = ndlcomRunLengthEncode(frame + NDLCOM_DELTA_HEADER_SIZE,
+                                            length - 1, delta, length);
+    }
+    if (frameLength) {
+        frame[1] = NDLCOM_DELTA_KIND_DELTA;
+        stream.sinceKeyframe++;
+        deltasSent++;
+        bytesSaved += length - frameLength;
+    } else {
+        frame[1] = NDLCOM_DELTA_KIND_KEYFRAME;
+        memcpy(frame + NDLCOM_DELTA_HEADER_SIZE, data, length);
+        frameLength = length;
+        stream.sinceKeyframe = 0;
+        stream.keyframeRequested = false;
+        keyframesSent++;
+    }
+    memcpy(stream.data, data, length);
+    stream.length = length;
+    stream.valid = true;
+
+    NodeHandler::send(receiverId, frame,
+                      NDLCOM_DELTA_HEADER_SIZE + frameLength);
+    return true;
+}
+
+void NodeHandlerDelta::handle(const struct NDLComHeader *header,
+                              const void *payload,
+                              const struct NDLComExternalInterface *origin) {
+    const uint8_t *data = static_cast<const uint8_t *>(payload);
+    if (header->mDataLen < NDLCOM_DELTA_HEADER_SIZE ||
+        data[0] != NDLCOM_DELTA_MARKER) {
+        return;
+    }
+    const uint8_t kind = data[1];
+    const uint8_t type = data[2];
+    const uint8_t seq = data[3];
+    const size_t length = header->mDataLen - NDLCOM_DELTA_HEADER_SIZE;
+    switch (kind) {
+    case NDLCOM_DELTA_KIND_KEYFRAME:
+        handleKeyframe(header->mSenderId, type, seq,
+                       data + NDLCOM_DELTA_HEADER_SIZE, length);
+        break;
+    case NDLCOM_DELTA_KIND_DELTA:
+        handleDelta(header->mSenderId, type, seq,
+                    data + NDLCOM_DELTA_HEADER_SIZE, length);
+        break;
+    case NDLCOM_DELTA_KIND_REQUEST: {
+        // the stream may as well be sent to the broadcast address
+        struct Stream *stream =
+            findStream(sending, header->mSenderId, type, false);
+        if (!stream) {
+            stream = findStream(sending, NDLCOM_ADDR_BROADCAST, type, false);
+        }
+        if (stream) {
+            stream->keyframeRequested = true;
+            keyframesRequested++;
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+void NodeHandlerDelta::handleKeyframe(const NDLComId senderId,
+                                      const uint8_t type, const uint8_t seq,
+                                      const uint8_t *data,
+                                      const size_t length) {
+    if (length == 0) {
+        return;
+    }
+    struct Stream &stream = *findStream(receiving, senderId, type, true);
+    memcpy(stream.data, data, length);
+    stream.length = length;
+    stream.seq = seq;
+    stream.valid = true;
+    stream.keyframeRequested = false;
+    messagesReceived++;
+    handleStream(senderId, stream.data, stream.length);
+}
+
+void NodeHandlerDelta::handleDelta(const NDLComId senderId, const uint8_t type,
+                                   const uint8_t seq, const uint8_t *data,
+                                   const size_t length) {
+    struct Stream *stream = findStream(receiving, senderId, type, true);
+    uint8_t delta[NDLCOM_DELTA_MAX_PAYLOAD_SIZE];
+    if (stream->valid && seq == (uint8_t)(stream->seq + 1) &&
+        ndlcomRunLengthDecode(delta, stream->length, data, length) ==
+            stream->length) {
+        for (size_t i = 0; i < stream->length; ++i) {
+            stream->data[i] ^= delta[i];
+        }
+        stream->seq = seq;
+        messagesReceived++;
+        handleStream(senderId, stream->data, stream->length);
+        return;
+    }
+    messagesLost++;
+    // ask only once, when losing track. the periodic keyframe is the fallback
+    stream->valid = false;
+    if (!stream->keyframeRequested) {
+        stream->keyframeRequested = true;
+        const uint8_t request[NDLCOM_DELTA_HEADER_SIZE] = {
+            NDLCOM_DELTA_MARKER, NDLCOM_DELTA_KIND_REQUEST, type, seq};
+        NodeHandler::send(senderId, request, sizeof(request));
+    }
+}
+
+void NodeHandlerDelta::printStatus(const std::string prefix) const {
+    HandlerCommon::printStatus(prefix);
+    size_t streamsSending = 0;
+    size_t streamsReceiving = 0;
+    for (auto &stream : sending) {
+        streamsSending += stream.used;
+    }
+    for (auto &stream : receiving) {
+        streamsReceiving += stream.used;
+    }
+    out << prefix << "    sent: " << keyframesSent << " keyframes, "
+        << deltasSent << " deltas, " << bytesSaved << " bytes saved, "
+        << keyframesRequested << " keyframes requested, streams "
+        << streamsSending << "/" << sending.size() << "\n";
+    out << prefix << "    received: " << messagesReceived
+        << " lost: " << messagesLost << " streams " << streamsReceiving << "/"
+        << receiving.size() << "\n";
+}
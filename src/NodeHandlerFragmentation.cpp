@@ -0,0 +1,178 @@
+#include "ndlcom/NodeHandlerFragmentation.hpp"
+
+#include <string.h>
+#include <algorithm>
+#include <limits>
+#include <string>
+
+using namespace ndlcom;
+
+const size_t NodeHandlerFragmentation::defaultMaxMessageSize = 64 * 1024;
+const size_t NodeHandlerFragmentation::defaultNumberOfSlots = 4;
+const std::chrono::milliseconds NodeHandlerFragmentation::defaultTimeout(500);
+
+NodeHandlerFragmentation::NodeHandlerFragmentation(
+    struct NDLComNode &node, size_t _maxMessageSize, size_t numberOfSlots,
+    std::chrono::milliseconds _timeout, std::ostream &_out)
+    : NodeHandler(node, "NodeHandlerFragmentation", _out), messagesSent(0),
+      messagesReceived(0), messagesDropped(0), fragmentsRejected(0),
+      // the index of a fragment has to fit into 16 bit
+      maxMessageSize(std::min<size_t>(_maxMessageSize,
+                                      std::numeric_limits<uint16_t>::max() *
+                                          NDLCOM_FRAGMENT_CHUNK_SIZE)),
+      maxFragments((maxMessageSize + NDLCOM_FRAGMENT_CHUNK_SIZE - 1) /
+                   NDLCOM_FRAGMENT_CHUNK_SIZE),
+      timeout(_timeout), slots(numberOfSlots ? numberOfSlots : 1) {
+    // all the memory for reassembly is taken right here
+    for (auto &slot : slots) {
+        slot.used = false;
+        slot.received.resize(maxFragments);
+        slot.buffer.resize(maxMessageSize);
+    }
+    memset(nextMessageId, 0, sizeof(nextMessageId));
+    for (auto &completed : lastCompleted) {
+        completed.valid = false;
+    }
+}
+
+bool NodeHandlerFragmentation::sendLarge(const NDLComId receiverId,
+                                         const void *data,
+                                         const size_t length) {
+    if (length == 0 || length > maxMessageSize) {
+        return false;
+    }
+    const uint16_t count =
+        (length + NDLCOM_FRAGMENT_CHUNK_SIZE - 1) / NDLCOM_FRAGMENT_CHUNK_SIZE;
+    const uint8_t messageId = nextMessageId[receiverId]++;
+    uint8_t fragment[NDLCOM_MAX_PAYLOAD_SIZE];
+    fragment[0] = NDLCOM_FRAGMENT_MARKER;
+    fragment[1] = messageId;
+    fragment[4] = count;
+    fragment[5] = count >> 8;
+    // all fragments go out back to back, there is nothing to wait for. only
+    // a send queue of the bridge, when called from within a handler, may not
+    // take all of them
+    for (uint16_t index = 0; index < count; ++index) {
+        const size_t offset = (size_t)index * NDLCOM_FRAGMENT_CHUNK_SIZE;
+        const size_t chunk =
+            std::min<size_t>(NDLCOM_FRAGMENT_CHUNK_SIZE, length - offset);
+        fragment[2] = index;
+        fragment[3] = index >> 8;
+        memcpy(fragment + NDLCOM_FRAGMENT_HEADER_SIZE,
+               static_cast<const uint8_t *>(data) + offset, chunk);
+        if (!NodeHandler::send(receiverId, fragment,
+                               NDLCOM_FRAGMENT_HEADER_SIZE + chunk)) {
+            // the receiver drops the rest after its timeout
+            return false;
+        }
+    }
+    messagesSent++;
+    return true;
+}
+
+struct NodeHandlerFragmentation::Slot &
+NodeHandlerFragmentation::findSlot(const NDLComId senderId,
+                                   const uint8_t messageId,
+                                   const uint16_t count) {
+    struct Slot *freeSlot = nullptr;
+    struct Slot *oldestSlot = &slots.front();
+    for (auto &slot : slots) {
+        if (!slot.used) {
+            freeSlot = &slot;
+        } else if (slot.senderId == senderId && slot.messageId == messageId &&
+                   slot.count == count) {
+            return slot;
+        } else if (slot.lastFragment < oldestSlot->lastFragment) {
+            oldestSlot = &slot;
+        }
+    }
+    struct Slot &slot = freeSlot ? *freeSlot : *oldestSlot;
+    if (slot.used) {
+        messagesDropped++;
+    }
+    slot.used = true;
+    slot.senderId = senderId;
+    slot.messageId = messageId;
+    slot.count = count;
+    slot.missing = count;
+    slot.length = 0;
+    std::fill(slot.received.begin(), slot.received.begin() + count, false);
+    return slot;
+}
+
+void NodeHandlerFragmentation::handle(
+    const struct NDLComHeader *header, const void *payload,
+    const struct NDLComExternalInterface *origin) {
+    const uint8_t *data = static_cast<const uint8_t *>(payload);
+    if (header->mDataLen <= NDLCOM_FRAGMENT_HEADER_SIZE ||
+        data[0] != NDLCOM_FRAGMENT_MARKER) {
+        return;
+    }
+    const uint8_t messageId = data[1];
+    const uint16_t index = data[2] | data[3] << 8;
+    const uint16_t count = data[4] | data[5] << 8;
+    const size_t chunk = header->mDataLen - NDLCOM_FRAGMENT_HEADER_SIZE;
+    // only the last fragment may be shorter than a full chunk
+    if (index >= count || count > maxFragments ||
+        (index + 1 < count && chunk != NDLCOM_FRAGMENT_CHUNK_SIZE)) {
+        fragmentsRejected++;
+        return;
+    }
+    const size_t offset = (size_t)index * NDLCOM_FRAGMENT_CHUNK_SIZE;
+    if (offset + chunk > maxMessageSize) {
+        fragmentsRejected++;
+        return;
+    }
+
+    const TimePoint now = std::chrono::steady_clock::now();
+    struct Completed &completed = lastCompleted[header->mSenderId];
+    if (completed.valid && completed.messageId == messageId &&
+        now - completed.when < timeout) {
+        return;
+    }
+
+    struct Slot &slot = findSlot(header->mSenderId, messageId, count);
+    slot.lastFragment = now;
+    if (slot.received[index]) {
+        return;
+    }
+    slot.received[index] = true;
+    slot.missing--;
+    memcpy(slot.buffer.data() + offset, data + NDLCOM_FRAGMENT_HEADER_SIZE,
+           chunk);
+    if (index + 1 == count) {
+        slot.length = offset + chunk;
+    }
+    if (slot.missing == 0) {
+        // free the slot before calling out, the handler may send on its own
+        slot.used = false;
+        completed.valid = true;
+        completed.messageId = messageId;
+        completed.when = now;
+        messagesReceived++;
+        handleLarge(slot.senderId, slot.buffer.data(), slot.length);
+    }
+}
+
+void NodeHandlerFragmentation::process() {
+    const TimePoint now = std::chrono::steady_clock::now();
+    for (auto &slot : slots) {
+        if (slot.used && now - slot.lastFragment >= timeout) {
+            slot.used = false;
+            messagesDropped++;
+        }
+    }
+}
+
+void NodeHandlerFragmentation::printStatus(const std::string prefix) const {
+    HandlerCommon::printStatus(prefix);
+    size_t inProgress = 0;
+    for (auto &slot : slots) {
+        inProgress += slot.used;
+    }
+    out << prefix << "    sent: " << messagesSent
+        << " received: " << messagesReceived
+        << " dropped: " << messagesDropped
+        << " rejected fragments: " << fragmentsRejected
+        << " in progress: " << inProgress << "/" << slots.size() << "\n";
+}
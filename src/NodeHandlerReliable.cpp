@@ -0,0 +1,318 @@
+#include "ndlcom/NodeHandlerReliable.hpp"
+
+#include <string.h>
+#include <algorithm>
+#include <iomanip>
+#include <string>
+
+using namespace ndlcom;
+
+const uint8_t NodeHandlerReliable::defaultWindowSize = 16;
+const std::chrono::milliseconds NodeHandlerReliable::defaultTimeout(50);
+const unsigned int NodeHandlerReliable::defaultMaxRetries = 10;
+
+/**
+ * the slots are indexed by the lower bits of the sequence number. this only
+ * works if their number divides 256, so we round up to the next power of two.
+ */
+static size_t slotCountForWindow(uint8_t windowSize) {
+    size_t count = 1;
+    while (count < windowSize) {
+        count <<= 1;
+    }
+    return count;
+}
+
+NodeHandlerReliable::NodeHandlerReliable(struct NDLComNode &node,
+                                         uint8_t _windowSize,
+                                         std::chrono::milliseconds _timeout,
+                                         unsigned int _maxRetries,
+                                         std::ostream &_out)
+    : NodeHandler(node, "NodeHandlerReliable", _out), messagesSent(0),
+      messagesRetransmitted(0), messagesFailed(0), messagesDelivered(0),
+      messagesDuplicate(0),
+      windowSize(_windowSize == 0
+                     ? 1
+                     : std::min<uint8_t>(_windowSize,
+                                         NDLCOM_RELIABLE_MAX_WINDOW_SIZE)),
+      timeout(_timeout), maxRetries(_maxRetries),
+      epochGenerator(std::random_device()()) {}
+
+struct NodeHandlerReliable::Peer &
+NodeHandlerReliable::getPeer(const NDLComId deviceId) {
+    std::unique_ptr<struct Peer> &peer = peers[deviceId];
+    if (!peer) {
+        const size_t slots = slotCountForWindow(windowSize);
+        peer.reset(new Peer());
+        peer->txEpoch = epochGenerator();
+        peer->txNeedSync = true;
+        peer->txBase = 0;
+        peer->txNext = 0;
+        peer->tx.resize(slots);
+        peer->rxKnown = false;
+        peer->rxEpoch = 0;
+        peer->rxNext = 0;
+        peer->rx.resize(slots);
+    }
+    return *peer;
+}
+
+bool NodeHandlerReliable::sendReliable(const NDLComId receiverId,
+                                       const void *payload,
+                                       const size_t length) {
+    if (receiverId == NDLCOM_ADDR_BROADCAST ||
+        length > NDLCOM_RELIABLE_MAX_PAYLOAD_SIZE) {
+        return false;
+    }
+    struct Peer &peer = getPeer(receiverId);
+    if ((uint8_t)(peer.txNext - peer.txBase) >= windowSize) {
+        return false;
+    }
+    const uint8_t seq = peer.txNext++;
+    struct TxSlot &slot = peer.tx[seq & (peer.tx.size() - 1)];
+    slot.used = true;
+    slot.sync = peer.txNeedSync;
+    slot.retries = 0;
+    slot.length = NDLCOM_RELIABLE_HEADER_SIZE + length;
+    slot.data[0] =
+        slot.sync ? NDLCOM_RELIABLE_MARKER_SYNC : NDLCOM_RELIABLE_MARKER_DATA;
+    slot.data[1] = peer.txEpoch;
+    slot.data[2] = seq;
+    memcpy(slot.data + NDLCOM_RELIABLE_HEADER_SIZE, payload, length);
+    peer.txNeedSync = false;
+
+    messagesSent++;
+    transmit(receiverId, slot);
+    return true;
+}
+
+size_t NodeHandlerReliable::getPendingCount(const NDLComId receiverId) const {
+    auto it = peers.find(receiverId);
+    if (it == peers.end()) {
+        return 0;
+    }
+    size_t pending = 0;
+    for (auto &slot : it->second->tx) {
+        pending += slot.used;
+    }
+    return pending;
+}
+
+void NodeHandlerReliable::transmit(const NDLComId receiverId,
+                                   struct TxSlot &slot) {
+    slot.lastSent = std::chrono::steady_clock::now();
+    if (!NodeHandler::send(receiverId, slot.data, slot.length)) {
+        // did not fit into the send queue of the bridge, a whole window sent
+        // from within a handler may not. the next process() sends it again,
+        // counted as a retry
+        slot.lastSent -= timeout;
+    }
+}
+
+void NodeHandlerReliable::resetSender(const NDLComId receiverId,
+                                      struct Peer &peer) {
+    // the receiver delivers in order, so it would wait forever for the
+    // message we gave up on. everything after it is dropped as well, and the
+    // next message tells the receiver to start over.
+    for (uint8_t seq = peer.txBase; seq != peer.txNext; ++seq) {
+        struct TxSlot &slot = peer.tx[seq & (peer.tx.size() - 1)];
+        if (slot.used) {
+            slot.used = false;
+            messagesFailed++;
+            handleFailure(receiverId, slot.data + NDLCOM_RELIABLE_HEADER_SIZE,
+                          slot.length - NDLCOM_RELIABLE_HEADER_SIZE);
+        }
+    }
+    peer.txBase = peer.txNext;
+    // make sure the new epoch differs from the old one
+    peer.txEpoch += 1 + epochGenerator() % 255;
+    peer.txNeedSync = true;
+}
+
+void NodeHandlerReliable::process() {
+    const TimePoint now = std::chrono::steady_clock::now();
+    for (auto &it : peers) {
+        struct Peer &peer = *it.second;
+        for (uint8_t seq = peer.txBase; seq != peer.txNext; ++seq) {
+            struct TxSlot &slot = peer.tx[seq & (peer.tx.size() - 1)];
+            if (!slot.used || now - slot.lastSent < timeout) {
+                continue;
+            }
+            if (slot.retries >= maxRetries) {
+                resetSender(it.first, peer);
+                break;
+            }
+            slot.retries++;
+            messagesRetransmitted++;
+            transmit(it.first, slot);
+        }
+    }
+}
+
+void NodeHandlerReliable::handleFailure(const NDLComId receiverId,
+                                        const void *payload,
+                                        const size_t length) {
+    out << label << ": giving up on message to " << (int)receiverId << " with "
+        << length << " bytes after " << maxRetries << " retries\n";
+}
+
+void NodeHandlerReliable::handle(const struct NDLComHeader *header,
+                                 const void *payload,
+                                 const struct NDLComExternalInterface *origin) {
+    if (header->mReceiverId == NDLCOM_ADDR_BROADCAST || header->mDataLen < 3) {
+        return;
+    }
+    const uint8_t *data = static_cast<const uint8_t *>(payload);
+    switch (data[0]) {
+    case NDLCOM_RELIABLE_MARKER_DATA:
+    case NDLCOM_RELIABLE_MARKER_SYNC:
+        handleData(header->mSenderId, data[0] == NDLCOM_RELIABLE_MARKER_SYNC,
+                   data + 1, header->mDataLen - 1);
+        break;
+    case NDLCOM_RELIABLE_MARKER_ACK:
+    case NDLCOM_RELIABLE_MARKER_NACK:
+        handleAck(header->mSenderId, data[0] == NDLCOM_RELIABLE_MARKER_NACK,
+                  data + 1, header->mDataLen - 1);
+        break;
+    default:
+        // not for us, normal traffic of the node
+        break;
+    }
+}
+
+void NodeHandlerReliable::handleData(const NDLComId senderId, bool sync,
+                                     const uint8_t *data, size_t length) {
+    const uint8_t epoch = data[0];
+    const uint8_t seq = data[1];
+    struct Peer &peer = getPeer(senderId);
+
+    if (sync && (!peer.rxKnown || peer.rxEpoch != epoch)) {
+        // the sender (re)started: forget whatever we had buffered
+        peer.rxKnown = true;
+        peer.rxEpoch = epoch;
+        peer.rxNext = seq;
+        for (auto &slot : peer.rx) {
+            slot.used = false;
+        }
+    } else if (!peer.rxKnown || peer.rxEpoch != epoch) {
+        // the SYNC of this epoch was not seen yet. not acknowledging makes
+        // the sender retransmit everything, including the SYNC
+        return;
+    }
+
+    const uint8_t distance = seq - peer.rxNext;
+    const size_t mask = peer.rx.size() - 1;
+    if (distance >= 128) {
+        // already delivered, so our last acknowledgement got lost
+        messagesDuplicate++;
+    } else if (distance > mask) {
+        // cannot happen with a well behaved sender. nothing to buffer it in
+    } else if (distance > 0) {
+        struct RxSlot &slot = peer.rx[seq & mask];
+        if (slot.used) {
+            messagesDuplicate++;
+        } else {
+            slot.used = true;
+            slot.length = length - 2;
+            memcpy(slot.data, data + 2, length - 2);
+        }
+    } else {
+        peer.rxNext++;
+        messagesDelivered++;
+        handleReliable(senderId, data + 2, length - 2);
+        // and now everything which was waiting for this one
+        struct RxSlot *slot;
+        while ((slot = &peer.rx[peer.rxNext & mask])->used) {
+            slot->used = false;
+            peer.rxNext++;
+            messagesDelivered++;
+            handleReliable(senderId, slot->data, slot->length);
+        }
+    }
+    sendAck(senderId, peer);
+}
+
+void NodeHandlerReliable::sendAck(const NDLComId receiverId,
+                                  struct Peer &peer) {
+    uint8_t msg[7];
+    msg[1] = peer.rxEpoch;
+    msg[2] = peer.rxNext;
+    // bit "i" tells that "rxNext + 1 + i" was received
+    uint32_t bitmap = 0;
+    const size_t mask = peer.rx.size() - 1;
+    for (size_t i = 0; i < mask; ++i) {
+        if (peer.rx[(uint8_t)(peer.rxNext + 1 + i) & mask].used) {
+            bitmap |= 1u << i;
+        }
+    }
+    if (bitmap) {
+        msg[0] = NDLCOM_RELIABLE_MARKER_NACK;
+        msg[3] = bitmap;
+        msg[4] = bitmap >> 8;
+        msg[5] = bitmap >> 16;
+        msg[6] = bitmap >> 24;
+        NodeHandler::send(receiverId, msg, 7);
+    } else {
+        msg[0] = NDLCOM_RELIABLE_MARKER_ACK;
+        NodeHandler::send(receiverId, msg, 3);
+    }
+}
+
+void NodeHandlerReliable::handleAck(const NDLComId senderId, bool nack,
+                                    const uint8_t *data, size_t length) {
+    if (nack && length < 6) {
+        return;
+    }
+    auto it = peers.find(senderId);
+    if (it == peers.end()) {
+        return;
+    }
+    struct Peer &peer = *it->second;
+    const uint8_t epoch = data[0];
+    const uint8_t next = data[1];
+    const uint8_t inFlight = peer.txNext - peer.txBase;
+    if (epoch != peer.txEpoch || (uint8_t)(next - peer.txBase) > inFlight) {
+        // from an old epoch, or older than what we already know
+        return;
+    }
+    const size_t mask = peer.tx.size() - 1;
+    // cumulative part: everything before "next" arrived
+    for (; peer.txBase != next; ++peer.txBase) {
+        peer.tx[peer.txBase & mask].used = false;
+    }
+    if (!nack) {
+        return;
+    }
+    const uint32_t bitmap = data[2] | data[3] << 8 | data[4] << 16 |
+                            (uint32_t)data[5] << 24;
+    // selective part: release what was received after the first missing one
+    // and quickly repeat the holes in between. holes are only repeated if they
+    // where not just sent, so that a burst of NACKs does not cause a burst of
+    // retransmissions.
+    const TimePoint now = std::chrono::steady_clock::now();
+    for (size_t i = 0; i <= mask && (i == 0 || bitmap >> (i - 1)); ++i) {
+        struct TxSlot &slot = peer.tx[(uint8_t)(next + i) & mask];
+        if (i > 0 && bitmap & 1u << (i - 1)) {
+            slot.used = false;
+        } else if (slot.used && now - slot.lastSent >= timeout / 4) {
+            slot.retries++;
+            messagesRetransmitted++;
+            transmit(senderId, slot);
+        }
+    }
+}
+
+void NodeHandlerReliable::printStatus(const std::string prefix) const {
+    HandlerCommon::printStatus(prefix);
+    out << prefix << "    sent: " << messagesSent
+        << " retransmitted: " << messagesRetransmitted
+        << " failed: " << messagesFailed << " delivered: " << messagesDelivered
+        << " duplicates: " << messagesDuplicate << "\n";
+    for (auto &it : peers) {
+        size_t pending = getPendingCount(it.first);
+        if (pending) {
+            out << prefix << "    to " << std::setw(3) << (int)it.first << ": "
+                << pending << " pending\n";
+        }
+    }
+}
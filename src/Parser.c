@@ -9,6 +9,8 @@
 #include "ndlcom/Parser.h"
 #include "ndlcom/Crc.h"
 
+#include <string.h>
+
 /**
  * @brief mapping from "enum NDLComParserState" into human readable strings
  */
@@ -172,6 +174,95 @@ size_t ndlcomParserReceive(struct NDLComParser *parser, const void *newData,
     return dataRead;
 }
 
+size_t ndlcomParserReceiveFramed(struct NDLComParser *parser,
+                                 const void *newData, size_t newDataLen,
+                                 const int withCrc) {
+    const uint8_t *in = (const uint8_t *)newData;
+    const uint8_t *end = in + newDataLen;
+    size_t chunk;
+
+    while (in != end && parser->mState != mcCOMPLETE) {
+        switch (parser->mState) {
+        case mcWAIT_HEADER:
+            if (withCrc) {
+                parser->mDataCRC = ndlcomDoCrc(parser->mDataCRC, in);
+            }
+            *(parser->mpHeaderWritePos++) = *in++;
+            if (parser->mpHeaderWritePos - parser->mHeader.raw ==
+                sizeof(struct NDLComHeader)) {
+                /* see ndlcomParserReceive() */
+                if (parser->mHeader.hdr.mDataLen > NDLCOM_MAX_PAYLOAD_SIZE) {
+                    parser->mState = mcERROR;
+                } else if (parser->mHeader.hdr.mDataLen) {
+                    parser->mState = mcWAIT_DATA;
+                } else {
+                    parser->mState =
+                        withCrc ? mcWAIT_FIRST_CRC_BYTE : mcCOMPLETE;
+                }
+            }
+            break;
+        case mcWAIT_DATA:
+            /* nothing to unescape, the payload is copied in one go */
+            chunk = parser->mpData + parser->mHeader.hdr.mDataLen -
+                    parser->mpDataWritePos;
+            if (chunk > (size_t)(end - in)) {
+                chunk = end - in;
+            }
+            memcpy(parser->mpDataWritePos, in, chunk);
+            if (withCrc) {
+                const uint8_t *c;
+                for (c = in; c != in + chunk; ++c) {
+                    parser->mDataCRC = ndlcomDoCrc(parser->mDataCRC, c);
+                }
+            }
+            in += chunk;
+            parser->mpDataWritePos += chunk;
+            if (parser->mpDataWritePos ==
+                parser->mpData + parser->mHeader.hdr.mDataLen) {
+                parser->mState =
+                    withCrc ? mcWAIT_FIRST_CRC_BYTE : mcCOMPLETE;
+            }
+            break;
+#ifndef NDLCOM_CRC16
+        case mcWAIT_FIRST_CRC_BYTE:
+        case mcWAIT_SECOND_CRC_BYTE:
+            if (*in++ == parser->mDataCRC) {
+                parser->mState = mcCOMPLETE;
+            } else {
+                parser->mNumberOfCRCFails++;
+                ndlcomParserDestroyPacket(parser);
+            }
+            break;
+#else
+        case mcWAIT_FIRST_CRC_BYTE:
+            parser->mDataCRC = ndlcomDoCrc(parser->mDataCRC, in++);
+            parser->mState = mcWAIT_SECOND_CRC_BYTE;
+            break;
+        case mcWAIT_SECOND_CRC_BYTE:
+            parser->mDataCRC = ndlcomDoCrc(parser->mDataCRC, in++);
+            if (parser->mDataCRC == NDLCOM_CRC_REAL_GOOD_VALUE) {
+                parser->mState = mcCOMPLETE;
+            } else {
+                parser->mNumberOfCRCFails++;
+                ndlcomParserDestroyPacket(parser);
+            }
+            break;
+#endif
+        case mcCOMPLETE:
+            break;
+        case mcERROR:
+        case mcNUMBER_OF_STATES:
+            /* no way to find the next message, start over with the next
+             * byte */
+            in++;
+            ndlcomParserDestroyPacket(parser);
+            break;
+        }
+    }
+
+    return in - (const uint8_t *)newData;
+}
+
 char ndlcomParserHasPacket(const struct NDLComParser *parser) {
     return parser->mState == mcCOMPLETE;
 }
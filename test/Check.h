@@ -0,0 +1,35 @@
+/**
+ * @file test/Check.h
+ * @brief the CHECK() macro used by the tests
+ *
+ * A failed check is printed with its file and line and counted, the test goes
+ * on anyway. In the end main() returns checkResult(). Usable from C and C++.
+ */
+#ifndef NDLCOM_TEST_CHECK_H
+#define NDLCOM_TEST_CHECK_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static int failures = 0;
+
+#define CHECK(cond)                                                            \
+    do {                                                                       \
+        if (!(cond)) {                                                         \
+            fprintf(stderr, "%s:%i: check failed: %s\n", __FILE__, __LINE__,   \
+                    #cond);                                                    \
+            failures++;                                                        \
+        }                                                                      \
+    } while (0)
+
+/** prints the summary, to be returned from main() */
+static inline int checkResult(void) {
+    if (failures) {
+        fprintf(stderr, "%i checks failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    fprintf(stderr, "all checks passed\n");
+    return EXIT_SUCCESS;
+}
+
+#endif /*NDLCOM_TEST_CHECK_H*/
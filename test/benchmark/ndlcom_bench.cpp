@@ -0,0 +1,352 @@
+/**
+ * @file test/benchmark/ndlcom_bench.cpp
+ * @brief microbenchmarks of the C core, using google-benchmark
+ *
+ * Covers the parser fed byte-wise and in chunks (also with escape-heavy and
+ * flag-heavy streams), the encoder, the crc, the routing table and the bridge
+ * with a number of interfaces and handlers.
+ *
+ * All input data is generated up front from a fixed seed, so that runs can be
+ * compared. The seed can be changed with "--seed=N". Use the usual
+ * google-benchmark options for output, for example:
+ *
+ *     ndlcom_bench --benchmark_out=bench.json --benchmark_out_format=json
+ *
+ * Only meaningful in an optimized build. Note that NDLCOM_ENABLE_TESTING
+ * compiles everything with "-O0".
+ */
+#include "ndlcom/Bridge.h"
+#include "ndlcom/BridgeHandler.h"
+#include "ndlcom/Crc.h"
+#include "ndlcom/Encoder.h"
+#include "ndlcom/ExternalInterface.h"
+#include "ndlcom/Parser.h"
+#include "ndlcom/Routing.h"
+#include "ndlcom/Types.h"
+
+#include <benchmark/benchmark.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <random>
+#include <string>
+#include <vector>
+
+static unsigned int seed = 4711;
+
+/** what the payloads of a generated stream consist of */
+enum PayloadKind {
+    PAYLOAD_RANDOM,
+    /** every byte has to be escaped */
+    PAYLOAD_ESCAPES,
+};
+
+/** encoded packets with random header and "payloadSize" bytes each */
+static std::vector<uint8_t> encodedStream(const size_t numberOfPackets,
+                                          const size_t payloadSize,
+                                          const enum PayloadKind kind) {
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> stream;
+    uint8_t payload[NDLCOM_MAX_PAYLOAD_SIZE];
+    uint8_t encoded[NDLCOM_MAX_ENCODED_MESSAGE_SIZE];
+    struct NDLComHeader header;
+    for (size_t i = 0; i < numberOfPackets; ++i) {
+        header.mSenderId = rng();
+        header.mReceiverId = rng();
+        header.mCounter = i;
+        header.mDataLen = payloadSize;
+        for (size_t j = 0; j < payloadSize; ++j) {
+            payload[j] = kind == PAYLOAD_ESCAPES
+                             ? (rng() % 2 ? NDLCOM_ESC_CHAR
+                                          : NDLCOM_START_STOP_FLAG)
+                             : rng();
+        }
+        const size_t len =
+            ndlcomEncode(encoded, sizeof(encoded), &header, payload);
+        stream.insert(stream.end(), encoded, encoded + len);
+    }
+    return stream;
+}
+
+/** runs the parser over the whole stream, in chunks of "chunkSize" */
+static void parseStream(benchmark::State &state,
+                        const std::vector<uint8_t> &stream,
+                        const size_t chunkSize) {
+    uint8_t buffer[sizeof(struct NDLComParser)];
+    struct NDLComParser *parser = ndlcomParserCreate(buffer, sizeof(buffer));
+    size_t packets = 0;
+    for (auto _ : state) {
+        for (size_t pos = 0; pos < stream.size(); pos += chunkSize) {
+            const uint8_t *chunk = stream.data() + pos;
+            size_t remaining = std::min(chunkSize, stream.size() - pos);
+            while (remaining) {
+                const size_t used =
+                    ndlcomParserReceive(parser, chunk, remaining);
+                chunk += used;
+                remaining -= used;
+                if (ndlcomParserHasPacket(parser)) {
+                    benchmark::DoNotOptimize(ndlcomParserGetPacket(parser));
+                    ndlcomParserDestroyPacket(parser);
+                    packets++;
+                }
+            }
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * stream.size());
+    state.counters["packets"] =
+        benchmark::Counter(packets, benchmark::Counter::kIsRate);
+}
+
+/** arg: payload size */
+static void BM_ParserReceiveBytewise(benchmark::State &state) {
+    parseStream(state, encodedStream(64, state.range(0), PAYLOAD_RANDOM), 1);
+}
+BENCHMARK(BM_ParserReceiveBytewise)->Arg(0)->Arg(16)->Arg(64)->Arg(255);
+
+/** arg: chunk size passed into the parser at once */
+static void BM_ParserReceiveChunked(benchmark::State &state) {
+    parseStream(state, encodedStream(64, 64, PAYLOAD_RANDOM), state.range(0));
+}
+BENCHMARK(BM_ParserReceiveChunked)->RangeMultiplier(4)->Range(4, 4096);
+
+/** arg: chunk size. every payload byte is escaped on the wire */
+static void BM_ParserReceiveEscapeHeavy(benchmark::State &state) {
+    parseStream(state, encodedStream(64, 64, PAYLOAD_ESCAPES), state.range(0));
+}
+BENCHMARK(BM_ParserReceiveEscapeHeavy)->Arg(1)->Arg(4096);
+
+/**
+ * arg: chunk size. a stream consisting mostly of start/stop flags and short
+ * garbage between them, as seen on a noisy or idle line
+ */
+static void BM_ParserReceiveFlagHeavy(benchmark::State &state) {
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> stream;
+    for (int i = 0; i < 4096; ++i) {
+        stream.push_back(NDLCOM_START_STOP_FLAG);
+        if (rng() % 4 == 0) {
+            stream.push_back(rng());
+        }
+    }
+    parseStream(state, stream, state.range(0));
+}
+BENCHMARK(BM_ParserReceiveFlagHeavy)->Arg(1)->Arg(4096);
+
+/** arg: payload size */
+static void BM_Encode(benchmark::State &state) {
+    std::mt19937 rng(seed);
+    uint8_t payload[NDLCOM_MAX_PAYLOAD_SIZE];
+    uint8_t encoded[NDLCOM_MAX_ENCODED_MESSAGE_SIZE];
+    for (auto &b : payload) {
+        b = rng();
+    }
+    struct NDLComHeader header;
+    header.mSenderId = 1;
+    header.mReceiverId = 2;
+    header.mCounter = 3;
+    header.mDataLen = state.range(0);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(
+            ndlcomEncode(encoded, sizeof(encoded), &header, payload));
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * header.mDataLen);
+}
+BENCHMARK(BM_Encode)->Arg(0)->Arg(16)->Arg(64)->Arg(255);
+
+/** arg: payload size, split into four sections */
+static void BM_EncodeVar(benchmark::State &state) {
+    std::mt19937 rng(seed);
+    uint8_t payload[NDLCOM_MAX_PAYLOAD_SIZE];
+    uint8_t encoded[NDLCOM_MAX_ENCODED_MESSAGE_SIZE];
+    for (auto &b : payload) {
+        b = rng();
+    }
+    const size_t section = state.range(0) / 4;
+    struct NDLComHeader header;
+    header.mSenderId = 1;
+    header.mReceiverId = 2;
+    header.mCounter = 3;
+    header.mDataLen = 4 * section;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(ndlcomEncodeVar(
+            encoded, sizeof(encoded), &header, 4, payload, section,
+            payload + section, section, payload + 2 * section, section,
+            payload + 3 * section, section));
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * header.mDataLen);
+}
+BENCHMARK(BM_EncodeVar)->Arg(16)->Arg(64)->Arg(252);
+
+/** arg: number of bytes */
+static void BM_Crc(benchmark::State &state) {
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> data(state.range(0));
+    for (auto &b : data) {
+        b = rng();
+    }
+    for (auto _ : state) {
+        NDLComCrc crc = NDLCOM_CRC_INITIAL_VALUE;
+        for (auto &b : data) {
+            crc = ndlcomDoCrc(crc, &b);
+        }
+        benchmark::DoNotOptimize(crc);
+    }
+    state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_Crc)->Arg(64)->Arg(1024);
+
+static void BM_RoutingLookup(benchmark::State &state) {
+    std::mt19937 rng(seed);
+    struct NDLComRoutingTable table;
+    ndlcomRoutingTableInit(&table);
+    int interfaces[4];
+    for (int id = 0; id < NDLCOM_MAX_NUMBER_OF_DEVICES; ++id) {
+        ndlcomRoutingTableUpdate(&table, id, &interfaces[rng() % 4]);
+    }
+    std::vector<NDLComId> ids(1024);
+    for (auto &id : ids) {
+        id = rng();
+    }
+    for (auto _ : state) {
+        for (auto id : ids) {
+            benchmark::DoNotOptimize(ndlcomRoutingGetDestination(&table, id));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * ids.size());
+}
+BENCHMARK(BM_RoutingLookup);
+
+static void BM_RoutingUpdate(benchmark::State &state) {
+    std::mt19937 rng(seed);
+    struct NDLComRoutingTable table;
+    ndlcomRoutingTableInit(&table);
+    int interfaces[4];
+    std::vector<NDLComId> ids(1024);
+    for (auto &id : ids) {
+        id = rng();
+    }
+    for (auto _ : state) {
+        int i = 0;
+        for (auto id : ids) {
+            ndlcomRoutingTableUpdate(&table, id, &interfaces[i++ % 4]);
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * ids.size());
+}
+BENCHMARK(BM_RoutingUpdate);
+
+/**
+ * one interface of the bridge benchmark. "read()" returns one encoded packet
+ * per call, cycling through a pre-encoded stream. "write()" discards.
+ */
+struct BenchInterface {
+    struct NDLComExternalInterface external;
+    std::vector<uint8_t> stream;
+    std::vector<size_t> packetEnds;
+    size_t next;
+};
+
+static size_t benchRead(void *context, void *buf, const size_t count) {
+    struct BenchInterface *bench = static_cast<struct BenchInterface *>(context);
+    const size_t begin = bench->next ? bench->packetEnds[bench->next - 1] : 0;
+    const size_t end = bench->packetEnds[bench->next];
+    const size_t len = std::min(count, end - begin);
+    memcpy(buf, bench->stream.data() + begin, len);
+    bench->next = (bench->next + 1) % bench->packetEnds.size();
+    return len;
+}
+
+static void benchWrite(void *context, const void *buf, const size_t count) {
+    benchmark::DoNotOptimize(buf);
+}
+
+static void benchHandler(void *context, const struct NDLComHeader *header,
+                         const void *payload,
+                         const struct NDLComExternalInterface *origin) {
+    (*static_cast<size_t *>(context))++;
+}
+
+/**
+ * args: number of interfaces, number of handlers. every interface receives
+ * one packet per iteration, from one of 16 senders behind it. the receivers
+ * are random, so most packets are forwarded to another interface.
+ */
+static void BM_BridgeProcess(benchmark::State &state) {
+    const size_t numberOfInterfaces = state.range(0);
+    const size_t numberOfHandlers = state.range(1);
+    std::mt19937 rng(seed);
+    struct NDLComBridge bridge;
+    ndlcomBridgeInit(&bridge);
+
+    std::vector<struct BenchInterface> interfaces(numberOfInterfaces);
+    for (size_t i = 0; i < numberOfInterfaces; ++i) {
+        struct BenchInterface &bench = interfaces[i];
+        uint8_t payload[NDLCOM_MAX_PAYLOAD_SIZE];
+        uint8_t encoded[NDLCOM_MAX_ENCODED_MESSAGE_SIZE];
+        struct NDLComHeader header;
+        for (int p = 0; p < 256; ++p) {
+            header.mSenderId = 16 * i + rng() % 16;
+            header.mReceiverId = rng() % (16 * numberOfInterfaces);
+            header.mCounter = p;
+            header.mDataLen = 32;
+            for (size_t j = 0; j < header.mDataLen; ++j) {
+                payload[j] = rng();
+            }
+            const size_t len =
+                ndlcomEncode(encoded, sizeof(encoded), &header, payload);
+            bench.stream.insert(bench.stream.end(), encoded, encoded + len);
+            bench.packetEnds.push_back(bench.stream.size());
+        }
+        bench.next = 0;
+        ndlcomExternalInterfaceInit(&bench.external, benchWrite, benchRead,
+                                    NDLCOM_EXTERNAL_INTERFACE_FLAGS_DEFAULT,
+                                    &bench);
+        ndlcomBridgeRegisterExternalInterface(&bridge, &bench.external);
+    }
+
+    size_t handled = 0;
+    std::vector<struct NDLComBridgeHandler> handlers(numberOfHandlers);
+    for (auto &handler : handlers) {
+        ndlcomBridgeHandlerInit(&handler, benchHandler,
+                                NDLCOM_BRIDGE_HANDLER_FLAGS_DEFAULT, &handled);
+        ndlcomBridgeRegisterBridgeHandler(&bridge, &handler);
+    }
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(ndlcomBridgeProcessOnce(&bridge));
+    }
+    state.SetItemsProcessed(state.iterations() * numberOfInterfaces);
+    state.counters["handlerCalls"] =
+        benchmark::Counter(handled, benchmark::Counter::kIsRate);
+
+    for (auto &handler : handlers) {
+        ndlcomBridgeDeregisterBridgeHandler(&bridge, &handler);
+    }
+    for (auto &bench : interfaces) {
+        ndlcomBridgeDeregisterExternalInterface(&bridge, &bench.external);
+    }
+}
+BENCHMARK(BM_BridgeProcess)
+    ->ArgNames({"interfaces", "handlers"})
+    ->ArgsProduct({{1, 2, 4, 8}, {0, 1, 8}});
+
+int main(int argc, char **argv) {
+    benchmark::Initialize(&argc, argv);
+    // the remaining arguments are ours
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg(argv[i]);
+        if (arg.compare(0, 7, "--seed=") == 0) {
+            seed = std::stoul(arg.substr(7));
+        } else {
+            fprintf(stderr, "%s: unknown argument '%s'\n", argv[0], argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+    benchmark::AddCustomContext("seed", std::to_string(seed));
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,313 @@
+/**
+ * @file test/benchmark/ndlcom_stress.cpp
+ * @brief multithreaded encoder/decoder stress test
+ *
+ * Runs one independent encoder/parser pair per thread. Every thread encodes
+ * random packets and feeds them into its parser, either byte-wise, in random
+ * chunks or all at once. Each decoded packet is compared to the original by
+ * its header and the crc of its payload.
+ *
+ * The parsers live inside "struct NDLComExternalInterface", as in a bridge.
+ * With "--layout array" they are adjacent in one array, like a naive
+ * threaded bridge would keep them. With "--layout separate" every thread
+ * allocates its own, page aligned. Comparing both, and the scaling from one
+ * to N threads ("--sweep"), shows effects of false sharing.
+ */
+#include "ndlcom/Crc.h"
+#include "ndlcom/Encoder.h"
+#include "ndlcom/ExternalInterface.h"
+#include "ndlcom/Parser.h"
+#include "ndlcom/Types.h"
+
+#include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum Delivery {
+    DELIVERY_BYTEWISE,
+    DELIVERY_RANDOM_CHUNK,
+    DELIVERY_FULL_CHUNK,
+    /** chooses one of the above for every packet */
+    DELIVERY_MIXED,
+};
+
+struct Options {
+    unsigned int threads;
+    unsigned long packets;
+    enum Delivery delivery;
+    bool separate;
+    bool pin;
+    bool sweep;
+    unsigned int seed;
+};
+
+/** written by each worker once, at the end */
+struct Result {
+    unsigned long packets;
+    unsigned long bytes;
+    unsigned long failures;
+};
+
+static NDLComCrc crcOf(const void *data, const size_t length) {
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    NDLComCrc crc = NDLCOM_CRC_INITIAL_VALUE;
+    for (size_t i = 0; i < length; ++i) {
+        crc = ndlcomDoCrc(crc, &bytes[i]);
+    }
+    return crc;
+}
+
+static void worker(const struct Options &options, const unsigned int index,
+                   struct NDLComExternalInterface *external,
+                   std::atomic<bool> &go, struct Result &result) {
+    if (options.pin) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(index % std::thread::hardware_concurrency(), &cpus);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    }
+    struct NDLComExternalInterface *own = external;
+    void *memory = nullptr;
+    if (!own) {
+        // allocated by the thread itself, on its own pages
+        if (posix_memalign(&memory, 4096, sizeof(*own))) {
+            result.failures = options.packets;
+            return;
+        }
+        own = static_cast<struct NDLComExternalInterface *>(memory);
+    }
+    struct NDLComParser *parser =
+        ndlcomParserCreate(&own->parser, sizeof(own->parser));
+
+    std::mt19937 rng(options.seed + index);
+    struct NDLComHeader header;
+    uint8_t payload[NDLCOM_MAX_PAYLOAD_SIZE];
+    uint8_t encoded[NDLCOM_MAX_ENCODED_MESSAGE_SIZE];
+    unsigned long packets = 0;
+    unsigned long bytes = 0;
+    unsigned long failures = 0;
+
+    while (!go) {
+        std::this_thread::yield();
+    }
+    for (unsigned long p = 0; p < options.packets; ++p) {
+        header.mSenderId = rng();
+        header.mReceiverId = rng();
+        header.mCounter = rng();
+        header.mDataLen = rng();
+        for (size_t i = 0; i < header.mDataLen; ++i) {
+            payload[i] = rng();
+        }
+        const size_t length =
+            ndlcomEncode(encoded, sizeof(encoded), &header, payload);
+
+        enum Delivery delivery = options.delivery;
+        if (delivery == DELIVERY_MIXED) {
+            delivery = static_cast<enum Delivery>(rng() % DELIVERY_MIXED);
+        }
+        size_t pos = 0;
+        bool found = false;
+        while (pos < length && !found) {
+            size_t chunk = length - pos;
+            if (delivery == DELIVERY_BYTEWISE) {
+                chunk = 1;
+            } else if (delivery == DELIVERY_RANDOM_CHUNK) {
+                chunk = 1 + rng() % chunk;
+            }
+            pos += ndlcomParserReceive(parser, encoded + pos, chunk);
+            found = ndlcomParserHasPacket(parser);
+        }
+        const struct NDLComHeader *decoded = ndlcomParserGetHeader(parser);
+        if (!found || memcmp(decoded, &header, sizeof(header)) != 0 ||
+            crcOf(ndlcomParserGetPacket(parser), decoded->mDataLen) !=
+                crcOf(payload, header.mDataLen)) {
+            failures++;
+        }
+        if (found) {
+            ndlcomParserDestroyPacket(parser);
+        }
+        // the closing flag is not consumed together with the packet, as it
+        // may start the next one. feed it as a continuous stream would.
+        while (pos < length) {
+            pos += ndlcomParserReceive(parser, encoded + pos, length - pos);
+            if (ndlcomParserHasPacket(parser)) {
+                failures++;
+                ndlcomParserDestroyPacket(parser);
+            }
+        }
+        packets++;
+        bytes += length;
+    }
+
+    result.packets = packets;
+    result.bytes = bytes;
+    result.failures = failures;
+    free(memory);
+}
+
+/** returns the number of failed packets */
+static unsigned long run(const struct Options &options,
+                         const unsigned int threads) {
+    std::vector<struct NDLComExternalInterface> array(threads);
+    std::vector<struct Result> results(threads);
+    std::vector<std::thread> workers;
+    std::atomic<bool> go(false);
+    for (unsigned int i = 0; i < threads; ++i) {
+        workers.emplace_back(worker, std::cref(options), i,
+                             options.separate ? nullptr : &array[i],
+                             std::ref(go), std::ref(results[i]));
+    }
+    const auto start = std::chrono::steady_clock::now();
+    go = true;
+    for (auto &t : workers) {
+        t.join();
+    }
+    const double seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+            .count();
+
+    unsigned long packets = 0;
+    unsigned long bytes = 0;
+    unsigned long failures = 0;
+    for (auto &result : results) {
+        packets += result.packets;
+        bytes += result.bytes;
+        failures += result.failures;
+    }
+    printf("%3u threads: %10.0f packets/s %8.2f MB/s encoded, %lu failed\n",
+           threads, packets / seconds, bytes / seconds / 1e6, failures);
+    return failures;
+}
+
+void help(const char *name) {
+    /* clang-format off */
+    fprintf(stderr,
+"\n%s\n\n"
+"Runs one encoder/parser pair per thread on random packets, checks every\n"
+"decoded packet and reports the aggregated throughput.\n"
+"\n"
+"options:\n"
+"--threads\t-t\tnumber of threads (default: number of cores)\n"
+"--packets\t-n\tpackets per thread (default: 100000)\n"
+"--delivery\t-d\thow bytes reach the parser: 'byte', 'random', 'full' or\n"
+"\t\t\t'mixed' (default: mixed)\n"
+"--layout\t-l\t'array' keeps all parsers in one array, 'separate' gives\n"
+"\t\t\teach thread its own pages (default: array)\n"
+"--pin\t\t-p\tpin thread i to core i\n"
+"--sweep\t\t-w\trun with 1 up to the given number of threads\n"
+"--seed\t\t-S\tseed of thread 0, the others use seed+i (default: 4711)\n"
+"\n"
+"examples:\n"
+"\n"
+"compare the scaling of both layouts on all cores:\n"
+"\n"
+"\t%s -w -p -l array\n"
+"\t%s -w -p -l separate\n"
+"\n",
+name, name, name);
+    /* clang-format on */
+}
+
+int main(int argc, char *argv[]) {
+    struct Options options;
+    options.threads = std::max(1u, std::thread::hardware_concurrency());
+    options.packets = 100000;
+    options.delivery = DELIVERY_MIXED;
+    options.separate = false;
+    options.pin = false;
+    options.sweep = false;
+    options.seed = 4711;
+
+    while (1) {
+        static struct option long_options[] = {
+            {"threads", required_argument, 0, 't'},
+            {"packets", required_argument, 0, 'n'},
+            {"delivery", required_argument, 0, 'd'},
+            {"layout", required_argument, 0, 'l'},
+            {"pin", no_argument, 0, 'p'},
+            {"sweep", no_argument, 0, 'w'},
+            {"seed", required_argument, 0, 'S'},
+            {"help", no_argument, 0, 'h'},
+            {0, 0, 0, 0}};
+        int option_index = 0;
+        int c = getopt_long(argc, argv, "t:n:d:l:pwS:h", long_options,
+                            &option_index);
+        if (c == -1) {
+            break;
+        }
+        const std::string arg(optarg ? optarg : "");
+        switch (c) {
+        case 't':
+            options.threads = std::stoul(arg);
+            break;
+        case 'n':
+            options.packets = std::stoul(arg);
+            break;
+        case 'd':
+            if (arg == "byte") {
+                options.delivery = DELIVERY_BYTEWISE;
+            } else if (arg == "random") {
+                options.delivery = DELIVERY_RANDOM_CHUNK;
+            } else if (arg == "full") {
+                options.delivery = DELIVERY_FULL_CHUNK;
+            } else if (arg == "mixed") {
+                options.delivery = DELIVERY_MIXED;
+            } else {
+                std::cerr << "unknown delivery '" << arg << "'\n";
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'l':
+            if (arg != "array" && arg != "separate") {
+                std::cerr << "unknown layout '" << arg << "'\n";
+                exit(EXIT_FAILURE);
+            }
+            options.separate = arg == "separate";
+            break;
+        case 'p':
+            options.pin = true;
+            break;
+        case 'w':
+            options.sweep = true;
+            break;
+        case 'S':
+            options.seed = std::stoul(arg);
+            break;
+        case 'h':
+            help(argv[0]);
+            exit(EXIT_SUCCESS);
+        default:
+            help(argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (options.threads == 0) {
+        std::cerr << "need at least one thread\n";
+        exit(EXIT_FAILURE);
+    }
+
+    if (options.separate) {
+        printf("every parser on its own pages\n");
+    } else {
+        printf("parsers in one array of interfaces, %zu bytes each\n",
+               sizeof(struct NDLComExternalInterface));
+    }
+    unsigned long failures = 0;
+    for (unsigned int threads = options.sweep ? 1 : options.threads;
+         threads <= options.threads; ++threads) {
+        failures += run(options, threads);
+    }
+
+    exit(failures ? EXIT_FAILURE : EXIT_SUCCESS);
+}
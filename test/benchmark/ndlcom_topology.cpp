@@ -0,0 +1,337 @@
+/**
+ * @file test/benchmark/ndlcom_topology.cpp
+ * @brief throughput and latency of bridge topologies, without hardware
+ *
+ * Builds a chain or a star of ndlcom::Bridge instances in one process,
+ * connected by ndlcom::ExternalInterfaceLoopback. Every bridge has one Node,
+ * with deviceId "index+1". Random nodes send messages to random other nodes
+ * or to broadcast, carrying a timestamp. After each message all bridges are
+ * processed until every loopback is empty.
+ *
+ * Reported are packets/s and bytes/s of delivered messages, and latency
+ * percentiles by the number of hops between sender and receiver. As all
+ * bridges run in one thread the latency is pure processing time, no
+ * scheduling or transmission delays are included.
+ */
+#include "ndlcom/Bridge.hpp"
+#include "ndlcom/ExternalInterfaceLoopback.hpp"
+#include "ndlcom/Node.hpp"
+#include "ndlcom/NodeHandler.hpp"
+
+#include <getopt.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+struct Options {
+    bool star;
+    unsigned int bridges;
+    unsigned long packets;
+    unsigned int minSize;
+    unsigned int maxSize;
+    /** messages per second, 0 means as fast as possible */
+    double rate;
+    double broadcastRatio;
+    unsigned int seed;
+    size_t capacity;
+};
+
+/** what every message carries in front of its padding */
+struct Stamp {
+    uint32_t sequence;
+    int64_t sentNs;
+} __attribute__((packed));
+
+static unsigned int hopsBetween(const struct Options &options, unsigned int a,
+                                unsigned int b) {
+    if (a == b) {
+        return 0;
+    }
+    if (options.star) {
+        // the center is bridge 0
+        return (a == 0 || b == 0) ? 1 : 2;
+    }
+    return a > b ? a - b : b - a;
+}
+
+/**
+ * records latencies of all messages received by one node. pointers, as the
+ * factory of the node copies its arguments.
+ */
+class NodeHandlerLatency : public ndlcom::NodeHandler {
+  public:
+    NodeHandlerLatency(struct NDLComNode &node, const struct Options *_options,
+                       unsigned int _index,
+                       std::vector<std::vector<int64_t>> *_latencies)
+        : NodeHandler(node, "NodeHandlerLatency"), options(*_options),
+          index(_index), latencies(*_latencies), packets(0), bytes(0) {}
+
+    void handle(const struct NDLComHeader *header, const void *payload,
+                const struct NDLComExternalInterface *origin) override {
+        // own broadcasts come back from the internal side
+        if (header->mDataLen < sizeof(struct Stamp) || origin == nullptr) {
+            return;
+        }
+        struct Stamp stamp;
+        memcpy(&stamp, payload, sizeof(stamp));
+        const int64_t now =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                Clock::now().time_since_epoch())
+                .count();
+        const unsigned int hops =
+            hopsBetween(options, header->mSenderId - 1, index);
+        latencies[hops].push_back(now - stamp.sentNs);
+        packets++;
+        bytes += header->mDataLen;
+    }
+
+    const struct Options &options;
+    const unsigned int index;
+    std::vector<std::vector<int64_t>> &latencies;
+    unsigned long packets;
+    unsigned long bytes;
+};
+
+static int64_t percentile(std::vector<int64_t> &values, double p) {
+    const size_t n = (values.size() - 1) * p;
+    std::nth_element(values.begin(), values.begin() + n, values.end());
+    return values[n];
+}
+
+void help(const char *name) {
+    /* clang-format off */
+    fprintf(stderr,
+"\n%s\n\n"
+"Connects a number of bridges by in-process loopback interfaces and sends\n"
+"timestamped messages between their nodes. Reports throughput and latency\n"
+"percentiles by number of hops.\n"
+"\n"
+"options:\n"
+"--star\t\t-s\tconnect all bridges to bridge 0, instead of a chain\n"
+"--bridges\t-b\tnumber of bridges (default: 4)\n"
+"--packets\t-n\tnumber of messages to send (default: 100000)\n"
+"--size\t\t-l\tpayload size, or range of sizes as 'min:max' (default: 32)\n"
+"--rate\t\t-r\tmessages per second, 0 for as fast as possible (default: 0)\n"
+"--broadcast\t-B\tratio of messages sent to broadcast, 0..1 (default: 0)\n"
+"--capacity\t-c\tbytes per direction in each loopback (default: %zu)\n"
+"--seed\t\t-S\tseed for the random traffic (default: 4711)\n"
+"\n"
+"examples:\n"
+"\n"
+"chain of 8 bridges, random sizes, every tenth message is a broadcast:\n"
+"\n"
+"\t%s -b 8 -l 12:255 -B 0.1\n"
+"\n",
+name, ndlcom::LoopbackLink::defaultCapacity, name);
+    /* clang-format on */
+}
+
+int main(int argc, char *argv[]) {
+    struct Options options;
+    options.star = false;
+    options.bridges = 4;
+    options.packets = 100000;
+    options.minSize = 32;
+    options.maxSize = 32;
+    options.rate = 0;
+    options.broadcastRatio = 0;
+    options.seed = 4711;
+    options.capacity = ndlcom::LoopbackLink::defaultCapacity;
+
+    while (1) {
+        static struct option long_options[] = {
+            {"star", no_argument, 0, 's'},
+            {"bridges", required_argument, 0, 'b'},
+            {"packets", required_argument, 0, 'n'},
+            {"size", required_argument, 0, 'l'},
+            {"rate", required_argument, 0, 'r'},
+            {"broadcast", required_argument, 0, 'B'},
+            {"capacity", required_argument, 0, 'c'},
+            {"seed", required_argument, 0, 'S'},
+            {"help", no_argument, 0, 'h'},
+            {0, 0, 0, 0}};
+        int option_index = 0;
+        int c = getopt_long(argc, argv, "sb:n:l:r:B:c:S:h", long_options,
+                            &option_index);
+        if (c == -1) {
+            break;
+        }
+        switch (c) {
+        case 's':
+            options.star = true;
+            break;
+        case 'b':
+            options.bridges = std::stoul(optarg);
+            break;
+        case 'n':
+            options.packets = std::stoul(optarg);
+            break;
+        case 'l': {
+            const std::string arg(optarg);
+            const size_t colon = arg.find(':');
+            options.minSize = std::stoul(arg.substr(0, colon));
+            options.maxSize = colon == std::string::npos
+                                  ? options.minSize
+                                  : std::stoul(arg.substr(colon + 1));
+            break;
+        }
+        case 'r':
+            options.rate = std::stod(optarg);
+            break;
+        case 'B':
+            options.broadcastRatio = std::stod(optarg);
+            break;
+        case 'c':
+            options.capacity = std::stoul(optarg);
+            break;
+        case 'S':
+            options.seed = std::stoul(optarg);
+            break;
+        case 'h':
+            help(argv[0]);
+            exit(EXIT_SUCCESS);
+        default:
+            help(argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (options.bridges < 2 || options.bridges >= NDLCOM_ADDR_BROADCAST) {
+        std::cerr << "need between 2 and 254 bridges\n";
+        exit(EXIT_FAILURE);
+    }
+    if (options.minSize < sizeof(struct Stamp) ||
+        options.maxSize > NDLCOM_MAX_PAYLOAD_SIZE ||
+        options.minSize > options.maxSize) {
+        std::cerr << "payload sizes have to be between " << sizeof(struct Stamp)
+                  << " and " << NDLCOM_MAX_PAYLOAD_SIZE << "\n";
+        exit(EXIT_FAILURE);
+    }
+
+    // the bridges are never moved, they are referenced by their interfaces
+    std::vector<std::unique_ptr<ndlcom::Bridge>> bridges;
+    std::vector<std::shared_ptr<ndlcom::Node>> nodes;
+    std::vector<std::shared_ptr<NodeHandlerLatency>> receivers;
+    std::vector<std::shared_ptr<ndlcom::ExternalInterfaceLoopback>> loopbacks;
+    const unsigned int maxHops = options.star ? 2 : options.bridges - 1;
+    std::vector<std::vector<int64_t>> latencies(maxHops + 1);
+    for (unsigned int i = 0; i < options.bridges; ++i) {
+        bridges.emplace_back(new ndlcom::Bridge());
+        nodes.push_back(bridges.back()->createNode<ndlcom::Node>(i + 1).lock());
+        receivers.push_back(nodes.back()
+                                ->createNodeHandler<NodeHandlerLatency>(
+                                    &options, i, &latencies)
+                                .lock());
+    }
+    for (unsigned int i = 1; i < options.bridges; ++i) {
+        auto pair = ndlcom::connectBridges(
+            options.star ? *bridges[0] : *bridges[i - 1], *bridges[i],
+            options.capacity);
+        loopbacks.push_back(pair.first.lock());
+        loopbacks.push_back(pair.second.lock());
+    }
+
+    std::mt19937 rng(options.seed);
+    std::uniform_int_distribution<unsigned int> sizes(options.minSize,
+                                                      options.maxSize);
+    std::uniform_real_distribution<double> ratio(0, 1);
+    uint8_t payload[NDLCOM_MAX_PAYLOAD_SIZE];
+    for (auto &b : payload) {
+        b = rng();
+    }
+
+    // every unicast reaches one node, every broadcast all the others
+    unsigned long expected = 0;
+    const Clock::time_point start = Clock::now();
+    for (unsigned long sequence = 0; sequence < options.packets; ++sequence) {
+        if (options.rate > 0) {
+            std::this_thread::sleep_until(
+                start + std::chrono::duration_cast<Clock::duration>(
+                            std::chrono::duration<double>(sequence /
+                                                          options.rate)));
+        }
+        const unsigned int source = rng() % options.bridges;
+        NDLComId receiverId = NDLCOM_ADDR_BROADCAST;
+        expected += options.bridges - 1;
+        if (ratio(rng) >= options.broadcastRatio) {
+            receiverId = (source + 1 + rng() % (options.bridges - 1)) %
+                             options.bridges +
+                         1;
+            expected -= options.bridges - 2;
+        }
+        struct Stamp stamp;
+        stamp.sequence = sequence;
+        stamp.sentNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           Clock::now().time_since_epoch())
+                           .count();
+        memcpy(payload, &stamp, sizeof(stamp));
+        nodes[source]->send(receiverId, payload, sizes(rng));
+
+        // pump until all loopbacks are drained
+        bool pending = true;
+        while (pending) {
+            for (auto &bridge : bridges) {
+                bridge->process();
+            }
+            pending = false;
+            for (auto &loopback : loopbacks) {
+                pending |= loopback->getRxQueueDepth() != 0;
+            }
+        }
+    }
+    const double seconds =
+        std::chrono::duration<double>(Clock::now() - start).count();
+
+    unsigned long packets = 0;
+    unsigned long bytes = 0;
+    for (auto &receiver : receivers) {
+        packets += receiver->packets;
+        bytes += receiver->bytes;
+    }
+    unsigned long wireBytes = 0;
+    unsigned long droppedBytes = 0;
+    for (auto &loopback : loopbacks) {
+        wireBytes += loopback->bytesTransmitted;
+        droppedBytes += loopback->bytesDropped;
+    }
+
+    std::cout << (options.star ? "star" : "chain") << " of "
+              << options.bridges << " bridges, " << options.packets
+              << " messages sent in " << seconds << "s\n";
+    std::cout << "delivered: " << packets << "/" << expected << " messages, "
+              << packets / seconds << " messages/s, " << bytes / seconds
+              << " payload bytes/s\n";
+    std::cout << "on the loopbacks: " << wireBytes / seconds
+              << " bytes/s, dropped " << droppedBytes << " bytes\n";
+    std::cout << "latency in us by hops:    count      p50      p90      p99"
+                 "      max\n";
+    for (unsigned int hops = 1; hops <= maxHops; ++hops) {
+        std::vector<int64_t> &values = latencies[hops];
+        if (values.empty()) {
+            continue;
+        }
+        std::cout << std::setw(24) << hops << std::setw(9) << values.size()
+                  << std::fixed << std::setprecision(2);
+        for (double p : {0.5, 0.9, 0.99, 1.0}) {
+            std::cout << std::setw(9) << percentile(values, p) / 1e3;
+        }
+        std::cout << "\n";
+    }
+    std::cout.flush();
+
+    // the nodes and interfaces have to go before their bridges
+    receivers.clear();
+    nodes.clear();
+    loopbacks.clear();
+    bridges.clear();
+
+    return (droppedBytes || packets != expected) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -44,11 +44,8 @@
  *  x86_64, 2.8GHz i7, clang-3.7:
  *  all 100000 trials worked! encoding took 0.74204us decoding took 0.06868us
  *
- * TODO:
- * - implement a multithreaded version! worker-threads anyone?
- * - add optarg
- *   - commandline argument to set the "seed"
- *   - commandline argument to switch processing between byte-wise, random-chunk and full-chunk
+ * A multithreaded version, with options for the seed and for byte-wise,
+ * random-chunk and full-chunk processing, is "test/benchmark/ndlcom_stress".
  */
 int main(int argc, char const *argv[]) {
 
@@ -0,0 +1,109 @@
+/**
+ * @file test/fuzz/Differential.c
+ */
+#include "Differential.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void ndlcomFuzzRandomSeed(struct NDLComFuzzRandom *random, uint32_t seed) {
+    random->state = seed ? seed : 0x2545f491;
+}
+
+uint32_t ndlcomFuzzRandomNext(struct NDLComFuzzRandom *random) {
+    uint32_t x = random->state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    random->state = x;
+    return x;
+}
+
+static void differenceAt(const char *what, size_t position) {
+    fprintf(stderr, "ndlcomFuzzDifferential: %s at stream position %zu\n", what,
+            position);
+    abort();
+}
+
+/* everything observable of a parser, without its pointers */
+static int sameState(const struct NDLComParser *a,
+                     const struct NDLComParser *b) {
+    const size_t headerBytes = a->mpHeaderWritePos - a->mHeader.raw;
+    const size_t dataBytes = a->mpDataWritePos - a->mpData;
+    return a->mState == b->mState && a->mLastWasESC == b->mLastWasESC &&
+           a->mDataCRC == b->mDataCRC &&
+           a->mNumberOfCRCFails == b->mNumberOfCRCFails &&
+           headerBytes == (size_t)(b->mpHeaderWritePos - b->mHeader.raw) &&
+           dataBytes == (size_t)(b->mpDataWritePos - b->mpData) &&
+           memcmp(a->mHeader.raw, b->mHeader.raw, headerBytes) == 0 &&
+           memcmp(a->mpData, b->mpData, dataBytes) == 0;
+}
+
+/* byte-wise, up to "end" or up to the next packet */
+static void advanceReference(struct NDLComParser *reference, const uint8_t *data,
+                             size_t *position, size_t end) {
+    while (*position < end && !ndlcomParserHasPacket(reference)) {
+        *position += ndlcomParserReceive(reference, data + *position, 1);
+    }
+}
+
+size_t ndlcomFuzzDifferential(NDLComFuzzReceive candidate, const uint8_t *data,
+                              size_t size, struct NDLComFuzzRandom *random,
+                              size_t maxChunk) {
+    struct NDLComParser referenceStorage;
+    struct NDLComParser candidateStorage;
+    struct NDLComParser *reference =
+        ndlcomParserCreate(&referenceStorage, sizeof(referenceStorage));
+    struct NDLComParser *parser =
+        ndlcomParserCreate(&candidateStorage, sizeof(candidateStorage));
+    size_t referencePosition = 0;
+    size_t position = 0;
+    size_t packets = 0;
+
+    while (position < size) {
+        size_t end = size;
+        if (maxChunk) {
+            const size_t chunk = 1 + ndlcomFuzzRandomNext(random) % maxChunk;
+            if (chunk < size - position) {
+                end = position + chunk;
+            }
+        }
+
+        while (position < end) {
+            const size_t consumed =
+                candidate(parser, data + position, end - position);
+            if (consumed == 0 || consumed > end - position) {
+                differenceAt("candidate consumed a wrong number of bytes",
+                             position);
+            }
+            position += consumed;
+            if (!ndlcomParserHasPacket(parser)) {
+                continue;
+            }
+            advanceReference(reference, data, &referencePosition, position);
+            if (!ndlcomParserHasPacket(reference) ||
+                referencePosition != position) {
+                differenceAt("candidate found a packet the reference did not",
+                             position);
+            }
+            if (!sameState(parser, reference)) {
+                differenceAt("packets differ", position);
+            }
+            ndlcomParserDestroyPacket(parser);
+            ndlcomParserDestroyPacket(reference);
+            packets++;
+        }
+
+        /* at the end of every chunk both have seen the same bytes */
+        advanceReference(reference, data, &referencePosition, position);
+        if (ndlcomParserHasPacket(reference)) {
+            differenceAt("candidate missed a packet", referencePosition);
+        }
+        if (!sameState(parser, reference)) {
+            differenceAt("parser states differ", position);
+        }
+    }
+
+    return packets;
+}
@@ -0,0 +1,68 @@
+/**
+ * @file test/fuzz/Differential.h
+ * @brief compares a parser implementation with the byte-wise reference
+ *
+ * The reference is ndlcomParserReceive(), fed one byte per call. Whatever it
+ * extracts from a stream is, by definition, correct. Any other way of feeding
+ * the same stream into a parser -- other split points, or a future optimized
+ * receive function -- has to yield the very same packets, at the very same
+ * positions of the stream, and leave the parser in the same state.
+ *
+ * Both parsers run in lockstep: whenever the candidate reports a packet, the
+ * reference is advanced to the same position and has to report an identical
+ * one. The first difference aborts the program with a description, so that
+ * libFuzzer and AFL record the input as a crash.
+ */
+#ifndef NDLCOM_TEST_FUZZ_DIFFERENTIAL_H
+#define NDLCOM_TEST_FUZZ_DIFFERENTIAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ndlcom/Parser.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/**
+ * @brief Signature of a receive function to be checked
+ *
+ * Same contract as ndlcomParserReceive(): consume bytes until a packet is
+ * complete or "newDataLen" is used up, return the number of consumed bytes.
+ */
+typedef size_t (*NDLComFuzzReceive)(struct NDLComParser *parser,
+                                    const void *newData, size_t newDataLen);
+
+/**
+ * @brief Small deterministic PRNG to derive split points from fuzzer input
+ *
+ * xorshift32, a state of 0 is replaced by a fixed value.
+ */
+struct NDLComFuzzRandom {
+    uint32_t state;
+};
+
+void ndlcomFuzzRandomSeed(struct NDLComFuzzRandom *random, uint32_t seed);
+uint32_t ndlcomFuzzRandomNext(struct NDLComFuzzRandom *random);
+
+/**
+ * @brief Feed "data" into the reference and into "candidate", compare results
+ *
+ * The candidate gets chunks with random lengths between 1 and "maxChunk",
+ * drawn from "random". A "maxChunk" of 0 passes the whole remainder with each
+ * call.
+ *
+ * Aborts on the first difference.
+ *
+ * @return number of packets both parsers found
+ */
+size_t ndlcomFuzzDifferential(NDLComFuzzReceive candidate, const uint8_t *data,
+                              size_t size, struct NDLComFuzzRandom *random,
+                              size_t maxChunk);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /*NDLCOM_TEST_FUZZ_DIFFERENTIAL_H*/
@@ -0,0 +1,130 @@
+/**
+ * @file test/fuzz/StandaloneMain.c
+ * @brief runs a fuzz target without libFuzzer
+ *
+ * Linked into the fuzz targets instead of libFuzzer when building with a
+ * normal compiler. Three modes:
+ *
+ * - with file arguments, every file is one input. Useful to reproduce a
+ *   crash found by a fuzzer, or to run a corpus.
+ * - "--random N [--seed S]" generates N inputs, made of random bytes, runs of
+ *   flags and escapes, valid encoded packets and truncated ones. This is
+ *   what the tests do.
+ * - without arguments one input is read from stdin, which is what AFL
+ *   expects.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Differential.h"
+#include "ndlcom/Encoder.h"
+#include "ndlcom/Types.h"
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+#define MAX_INPUT_SIZE 4096
+
+static size_t readInput(FILE *file, uint8_t *buffer, size_t capacity) {
+    size_t size = 0;
+    size_t got;
+    while (size < capacity &&
+           (got = fread(buffer + size, 1, capacity - size, file)) > 0) {
+        size += got;
+    }
+    return size;
+}
+
+/* concatenates segments of different kinds */
+static size_t generateInput(struct NDLComFuzzRandom *random, uint8_t *buffer,
+                            size_t capacity) {
+    const size_t size = ndlcomFuzzRandomNext(random) % capacity;
+    uint8_t encoded[NDLCOM_MAX_ENCODED_MESSAGE_SIZE];
+    uint8_t payload[NDLCOM_MAX_PAYLOAD_SIZE];
+    struct NDLComHeader header;
+    size_t position = 0;
+    size_t length, i;
+
+    while (position < size) {
+        switch (ndlcomFuzzRandomNext(random) % 4) {
+        case 0: /* noise */
+            length = ndlcomFuzzRandomNext(random) % 64;
+            for (i = 0; i < length && position < size; ++i) {
+                buffer[position++] = ndlcomFuzzRandomNext(random);
+            }
+            break;
+        case 1: /* the special bytes of the protocol */
+            length = ndlcomFuzzRandomNext(random) % 8;
+            for (i = 0; i < length && position < size; ++i) {
+                buffer[position++] = ndlcomFuzzRandomNext(random) % 2
+                                         ? NDLCOM_START_STOP_FLAG
+                                         : NDLCOM_ESC_CHAR;
+            }
+            break;
+        default: /* a packet, sometimes truncated */
+            header.mReceiverId = ndlcomFuzzRandomNext(random);
+            header.mSenderId = ndlcomFuzzRandomNext(random);
+            header.mCounter = ndlcomFuzzRandomNext(random);
+            header.mDataLen = ndlcomFuzzRandomNext(random);
+            for (i = 0; i < header.mDataLen; ++i) {
+                /* many escapes */
+                payload[i] = ndlcomFuzzRandomNext(random) % 4
+                                 ? (uint8_t)ndlcomFuzzRandomNext(random)
+                                 : NDLCOM_ESC_CHAR;
+            }
+            length = ndlcomEncode(encoded, sizeof(encoded), &header, payload);
+            if (ndlcomFuzzRandomNext(random) % 8 == 0) {
+                length = ndlcomFuzzRandomNext(random) % length;
+            }
+            for (i = 0; i < length && position < size; ++i) {
+                buffer[position++] = encoded[i];
+            }
+            break;
+        }
+    }
+    return size;
+}
+
+int main(int argc, char *argv[]) {
+    static uint8_t buffer[MAX_INPUT_SIZE];
+    struct NDLComFuzzRandom random;
+    unsigned long runs = 0;
+    unsigned long seed = 4711;
+    unsigned long i;
+    int arg;
+
+    if (argc == 1) {
+        LLVMFuzzerTestOneInput(buffer, readInput(stdin, buffer, sizeof(buffer)));
+        return EXIT_SUCCESS;
+    }
+
+    if (strcmp(argv[1], "--random") == 0) {
+        if (argc != 3 && !(argc == 5 && strcmp(argv[3], "--seed") == 0)) {
+            fprintf(stderr, "usage: %s --random N [--seed S]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+        runs = strtoul(argv[2], NULL, 0);
+        if (argc == 5) {
+            seed = strtoul(argv[4], NULL, 0);
+        }
+        ndlcomFuzzRandomSeed(&random, seed);
+        for (i = 0; i < runs; ++i) {
+            LLVMFuzzerTestOneInput(
+                buffer, generateInput(&random, buffer, sizeof(buffer)));
+        }
+        printf("%lu random inputs with seed %lu passed\n", runs, seed);
+        return EXIT_SUCCESS;
+    }
+
+    for (arg = 1; arg < argc; ++arg) {
+        FILE *file = fopen(argv[arg], "rb");
+        if (!file) {
+            perror(argv[arg]);
+            return EXIT_FAILURE;
+        }
+        LLVMFuzzerTestOneInput(buffer, readInput(file, buffer, sizeof(buffer)));
+        fclose(file);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,42 @@
+/**
+ * @file test/fuzz/fuzz_differential.c
+ * @brief libFuzzer/AFL target comparing chunked parsing with the reference
+ *
+ * The first four bytes of the input seed the split points, the fifth limits
+ * the chunk length, the rest is the stream. Every stream is parsed with
+ * random splits and as one single chunk, both have to match the byte-wise
+ * reference.
+ *
+ * To check an optimized receive function, add it to "candidates".
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include "Differential.h"
+#include "ndlcom/Parser.h"
+
+static const NDLComFuzzReceive candidates[] = {
+    ndlcomParserReceive,
+};
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    struct NDLComFuzzRandom random;
+    uint32_t seed;
+    size_t maxChunk;
+    size_t i;
+
+    if (size < sizeof(seed) + 1) {
+        return 0;
+    }
+    memcpy(&seed, data, sizeof(seed));
+    maxChunk = 1 + data[sizeof(seed)];
+    data += sizeof(seed) + 1;
+    size -= sizeof(seed) + 1;
+
+    for (i = 0; i < sizeof(candidates) / sizeof(candidates[0]); ++i) {
+        ndlcomFuzzRandomSeed(&random, seed);
+        ndlcomFuzzDifferential(candidates[i], data, size, &random, maxChunk);
+        ndlcomFuzzDifferential(candidates[i], data, size, &random, 0);
+    }
+    return 0;
+}
@@ -0,0 +1,135 @@
+/**
+ * @file test/fuzz/fuzz_encoder.c
+ * @brief libFuzzer/AFL target for ndlcomEncodeVar()
+ *
+ * Input layout:
+ *
+ *   [receiver][sender][counter][control][outputSize][cut 0][cut 1][payload...]
+ *
+ * The payload is split into up to three sections at the "cut" positions,
+ * "control" selects the number of sections and whether the header lies about
+ * the payload length. The result has to be identical to ndlcomEncode() of
+ * the whole payload, and the parser has to return exactly the original
+ * message.
+ *
+ * Additionally the message is encoded into a buffer of only "outputSize"
+ * bytes, allocated to exactly that size so that the sanitizers notice any
+ * overflow. The encoder has to return either 0 or the complete message.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ndlcom/Encoder.h"
+#include "ndlcom/Parser.h"
+#include "ndlcom/Types.h"
+
+#define EXPECT(cond)                                                           \
+    do {                                                                       \
+        if (!(cond)) {                                                         \
+            fprintf(stderr, "%s:%i: expectation failed: %s\n", __FILE__,       \
+                    __LINE__, #cond);                                          \
+            abort();                                                           \
+        }                                                                      \
+    } while (0)
+
+#define INPUT_HEADER_SIZE 7
+
+static size_t encodeSections(uint8_t *output, size_t outputSize,
+                             const struct NDLComHeader *header,
+                             size_t sections, const uint8_t *payload,
+                             size_t cut0, size_t cut1, size_t length) {
+    switch (sections) {
+    case 0:
+        return ndlcomEncodeVar(output, outputSize, header, 0);
+    case 1:
+        return ndlcomEncodeVar(output, outputSize, header, 1, payload, length);
+    case 2:
+        return ndlcomEncodeVar(output, outputSize, header, 2, payload, cut0,
+                               payload + cut0, length - cut0);
+    default:
+        return ndlcomEncodeVar(output, outputSize, header, 3, payload, cut0,
+                               payload + cut0, cut1 - cut0, payload + cut1,
+                               length - cut1);
+    }
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    struct NDLComHeader header;
+    struct NDLComParser storage;
+    struct NDLComParser *parser;
+    uint8_t encoded[NDLCOM_MAX_ENCODED_MESSAGE_SIZE];
+    uint8_t reference[NDLCOM_MAX_ENCODED_MESSAGE_SIZE];
+    uint8_t *small;
+    const uint8_t *payload;
+    size_t length, sections, cut0, cut1, outputSize;
+    size_t encodedLength, smallLength;
+    int lie;
+
+    if (size < INPUT_HEADER_SIZE) {
+        return 0;
+    }
+    payload = data + INPUT_HEADER_SIZE;
+    length = size - INPUT_HEADER_SIZE;
+    if (length > NDLCOM_MAX_PAYLOAD_SIZE) {
+        length = NDLCOM_MAX_PAYLOAD_SIZE;
+    }
+    header.mReceiverId = data[0];
+    header.mSenderId = data[1];
+    header.mCounter = data[2];
+    header.mDataLen = length;
+    sections = data[3] & 0x03;
+    lie = data[3] & 0x04;
+    outputSize = data[4] * 3;
+    cut0 = length ? data[5] % (length + 1) : 0;
+    cut1 = length ? data[6] % (length + 1) : 0;
+    if (cut1 < cut0) {
+        const size_t tmp = cut0;
+        cut0 = cut1;
+        cut1 = tmp;
+    }
+    if (sections == 0 && length) {
+        /* zero sections can only describe an empty payload */
+        length = 0;
+        header.mDataLen = 0;
+    }
+    if (lie) {
+        header.mDataLen = length + 1 + data[4] % (NDLCOM_MAX_PAYLOAD_SIZE);
+    }
+
+    encodedLength = encodeSections(encoded, sizeof(encoded), &header, sections,
+                                   payload, cut0, cut1, length);
+    if (header.mDataLen != length) {
+        EXPECT(encodedLength == 0);
+        return 0;
+    }
+    EXPECT(encodedLength > 0);
+    EXPECT(encodedLength <= NDLCOM_MAX_ENCODED_MESSAGE_SIZE_FOR_PACKET((&header)));
+    EXPECT(encoded[0] == NDLCOM_START_STOP_FLAG);
+    EXPECT(encoded[encodedLength - 1] == NDLCOM_START_STOP_FLAG);
+
+    /* splitting into sections must not change the outcome */
+    EXPECT(ndlcomEncode(reference, sizeof(reference), &header, payload) ==
+           encodedLength);
+    EXPECT(memcmp(reference, encoded, encodedLength) == 0);
+
+    /* the parser has to see the original, at the closing flag */
+    parser = ndlcomParserCreate(&storage, sizeof(storage));
+    EXPECT(ndlcomParserReceive(parser, encoded, encodedLength) ==
+           encodedLength - 1);
+    EXPECT(ndlcomParserHasPacket(parser));
+    EXPECT(memcmp(ndlcomParserGetHeader(parser), &header, sizeof(header)) ==
+           0);
+    EXPECT(memcmp(ndlcomParserGetPacket(parser), payload, length) == 0);
+
+    /* a too small buffer yields nothing, not half a message */
+    small = (uint8_t *)malloc(outputSize ? outputSize : 1);
+    EXPECT(small != 0);
+    smallLength = encodeSections(small, outputSize, &header, sections, payload,
+                                 cut0, cut1, length);
+    EXPECT(smallLength == 0 || (smallLength == encodedLength &&
+                                memcmp(small, encoded, encodedLength) == 0));
+    free(small);
+    return 0;
+}
@@ -0,0 +1,55 @@
+/**
+ * @file test/fuzz/fuzz_parser.c
+ * @brief libFuzzer/AFL target for ndlcomParserReceive()
+ *
+ * The input is one chunk of the received bytestream, passed as a whole.
+ * Besides crashes, which the sanitizers catch, the returned byte counts and
+ * every extracted packet are checked for plausibility.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ndlcom/Parser.h"
+#include "ndlcom/Types.h"
+
+#define EXPECT(cond)                                                           \
+    do {                                                                       \
+        if (!(cond)) {                                                         \
+            fprintf(stderr, "%s:%i: expectation failed: %s\n", __FILE__,       \
+                    __LINE__, #cond);                                          \
+            abort();                                                           \
+        }                                                                      \
+    } while (0)
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    struct NDLComParser storage;
+    struct NDLComParser *parser = ndlcomParserCreate(&storage, sizeof(storage));
+    size_t position = 0;
+    size_t previousPacketEnd = 0;
+    size_t consumed;
+
+    while (position < size) {
+        consumed = ndlcomParserReceive(parser, data + position, size - position);
+        EXPECT(consumed > 0 && consumed <= size - position);
+        position += consumed;
+
+        if (ndlcomParserHasPacket(parser)) {
+            const struct NDLComHeader *header = ndlcomParserGetHeader(parser);
+            EXPECT(header != 0);
+            EXPECT(ndlcomParserGetPacket(parser) != 0);
+            /* the shortest encoded packet: header, payload and crc, no
+             * flags or escapes */
+            EXPECT(position - previousPacketEnd >=
+                   sizeof(struct NDLComHeader) + header->mDataLen +
+                       sizeof(NDLComCrc));
+            previousPacketEnd = position;
+            ndlcomParserDestroyPacket(parser);
+        } else {
+            EXPECT(position == size);
+            EXPECT(ndlcomParserGetHeader(parser) == 0);
+        }
+        EXPECT(ndlcomParserGetState(parser) != 0);
+    }
+    return 0;
+}
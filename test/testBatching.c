@@ -0,0 +1,179 @@
+/**
+ * @file test/testBatching.c
+ * @brief checks batched writes of "struct NDLComExternalInterface"
+ *
+ * A bridge reads a stream of packets from one interface and forwards them to
+ * another one, which collects them in a small batch buffer. The vectored
+ * write callback has to get the packets in batches, in order, and a message
+ * not fitting the buffer must not overtake the ones before it. An interface
+ * using the flat "write" callback gets the same bytes, one call per message.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ndlcom/Bridge.h"
+#include "ndlcom/Encoder.h"
+#include "ndlcom/ExternalInterface.h"
+#include "ndlcom/Types.h"
+
+#include "Check.h"
+
+#define NUMBER_OF_PACKETS 10
+
+/* bytes to be read by the bridge */
+struct Source {
+    uint8_t buffer[NUMBER_OF_PACKETS * NDLCOM_MAX_ENCODED_MESSAGE_SIZE];
+    size_t length;
+};
+
+/* what arrived at the other side */
+struct Sink {
+    uint8_t buffer[NUMBER_OF_PACKETS * NDLCOM_MAX_ENCODED_MESSAGE_SIZE];
+    size_t length;
+    int calls;
+    size_t framesPerCall[NUMBER_OF_PACKETS];
+};
+
+static size_t sourceRead(void *context, void *buf, const size_t count) {
+    struct Source *source = (struct Source *)context;
+    size_t len = source->length < count ? source->length : count;
+    memcpy(buf, source->buffer, len);
+    memmove(source->buffer, source->buffer + len, source->length - len);
+    source->length -= len;
+    return len;
+}
+
+static size_t nothingToRead(void *context, void *buf, const size_t count) {
+    return 0;
+}
+
+static void nothingToWrite(void *context, const void *buf,
+                           const size_t count) {}
+
+static size_t sinkWriteFrames(void *context,
+                              const struct NDLComExternalInterfaceFrame *frames,
+                              const size_t count) {
+    struct Sink *sink = (struct Sink *)context;
+    const size_t before = sink->length;
+    size_t i;
+    if (sink->calls < NUMBER_OF_PACKETS) {
+        sink->framesPerCall[sink->calls] = count;
+    }
+    sink->calls++;
+    for (i = 0; i < count; ++i) {
+        memcpy(sink->buffer + sink->length, frames[i].data, frames[i].length);
+        sink->length += frames[i].length;
+    }
+    return sink->length - before;
+}
+
+static void sinkWrite(void *context, const void *buf, const size_t count) {
+    struct Sink *sink = (struct Sink *)context;
+    sink->calls++;
+    memcpy(sink->buffer + sink->length, buf, count);
+    sink->length += count;
+}
+
+static int sinkPollFd(void *context) { return 42; }
+
+/*
+ * forwards the packets from a source to a sink with a batch buffer of
+ * "bufferSize" bytes, the sink uses the vectored or the flat callback.
+ * "expected" is what the sink has to see in the end.
+ */
+static void testForwarding(const size_t bufferSize, const int vectored,
+                           struct Sink *sink, const uint8_t *expected,
+                           const size_t expectedLength, struct Source *source) {
+    struct NDLComBridge bridge;
+    struct NDLComExternalInterface in, out;
+    struct NDLComExternalInterfaceOps ops;
+    struct NDLComExternalInterfaceFrame frames[4];
+    uint8_t buffer[4 * NDLCOM_MAX_ENCODED_MESSAGE_SIZE];
+
+    memset(sink, 0, sizeof(*sink));
+    ndlcomBridgeInit(&bridge);
+    ndlcomExternalInterfaceInit(&in, nothingToWrite, sourceRead,
+                                NDLCOM_EXTERNAL_INTERFACE_FLAGS_DEFAULT,
+                                source);
+    if (vectored) {
+        ops.read = nothingToRead;
+        ops.writeFrames = sinkWriteFrames;
+        ops.pollFd = sinkPollFd;
+        ndlcomExternalInterfaceInitOps(
+            &out, &ops, NDLCOM_EXTERNAL_INTERFACE_FLAGS_DEFAULT, sink);
+        CHECK(ndlcomExternalInterfaceGetPollFd(&out) == 42);
+    } else {
+        ndlcomExternalInterfaceInit(&out, sinkWrite, nothingToRead,
+                                    NDLCOM_EXTERNAL_INTERFACE_FLAGS_DEFAULT,
+                                    sink);
+        CHECK(ndlcomExternalInterfaceGetPollFd(&out) == -1);
+    }
+    ndlcomExternalInterfaceSetBatchBuffer(&out, frames, 4, buffer, bufferSize);
+    ndlcomBridgeRegisterExternalInterface(&bridge, &in);
+    ndlcomBridgeRegisterExternalInterface(&bridge, &out);
+
+    ndlcomBridgeProcess(&bridge);
+
+    CHECK(ndlcomExternalInterfaceGetPacketsTransmitted(&out) ==
+          NUMBER_OF_PACKETS);
+    CHECK(out.batchFramesUsed == 0);
+    CHECK(sink->length == expectedLength);
+    CHECK(memcmp(sink->buffer, expected, expectedLength) == 0);
+
+    /* pending messages go out before the interface is removed */
+    ndlcomExternalInterfaceQueue(&out, expected, 10);
+    CHECK(sink->length == expectedLength);
+    ndlcomBridgeDeregisterExternalInterface(&bridge, &out);
+    CHECK(sink->length == expectedLength + 10);
+}
+
+int main(int argc, char *argv[]) {
+    struct Source source;
+    struct Sink sink;
+    struct NDLComHeader header;
+    uint8_t payload[NDLCOM_MAX_PAYLOAD_SIZE];
+    uint8_t expected[sizeof(source.buffer)];
+    size_t expectedLength = 0;
+    int i;
+
+    /* broadcasts of different sizes, the third one is large */
+    header.mSenderId = 1;
+    header.mReceiverId = NDLCOM_ADDR_BROADCAST;
+    for (i = 0; i < NUMBER_OF_PACKETS; ++i) {
+        header.mCounter = i;
+        header.mDataLen = i == 2 ? 200 : 10 + i;
+        memset(payload, i, header.mDataLen);
+        expectedLength += ndlcomEncode(expected + expectedLength,
+                                       sizeof(expected) - expectedLength,
+                                       &header, payload);
+    }
+
+    /* everything fits: batches of four */
+    memcpy(source.buffer, expected, expectedLength);
+    source.length = expectedLength;
+    testForwarding(4 * NDLCOM_MAX_ENCODED_MESSAGE_SIZE, 1, &sink, expected,
+                   expectedLength, &source);
+    /* plus the flush when deregistering */
+    CHECK(sink.calls == 3 + 1);
+    CHECK(sink.framesPerCall[0] == 4);
+    CHECK(sink.framesPerCall[1] == 4);
+    CHECK(sink.framesPerCall[2] == 2);
+
+    /* the large message is written on its own, after the ones before */
+    memcpy(source.buffer, expected, expectedLength);
+    source.length = expectedLength;
+    testForwarding(100, 1, &sink, expected, expectedLength, &source);
+    CHECK(sink.framesPerCall[0] == 2);
+    CHECK(sink.framesPerCall[1] == 1);
+
+    /* the flat callback gets every message on its own */
+    memcpy(source.buffer, expected, expectedLength);
+    source.length = expectedLength;
+    testForwarding(4 * NDLCOM_MAX_ENCODED_MESSAGE_SIZE, 0, &sink, expected,
+                   expectedLength, &source);
+    CHECK(sink.calls == NUMBER_OF_PACKETS + 1);
+
+    return checkResult();
+}
@@ -0,0 +1,170 @@
+/**
+ * @file test/testCanFraming.cpp
+ * @brief checks splitting messages into can frames with ndlcom::CanFraming
+ *
+ * Messages of all sizes go through classic and fd frames and come out of the
+ * parser unchanged. Every message starts with a marked frame, fd frames only
+ * use valid lengths. A lost frame is counted and costs exactly the message it
+ * belonged to, without crc failures in the parser. The count of frames wraps
+ * around without false alarm. Raw frames carry only the bytes, cut to valid
+ * lengths. No can socket is needed, so this runs without "vcan" as well.
+ */
+#include "ndlcom/CanFraming.hpp"
+#include "ndlcom/Encoder.h"
+#include "ndlcom/Parser.h"
+
+#include "Check.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <iostream>
+#include <vector>
+
+static bool isValidLength(uint8_t len) {
+    return len <= 8 || len == 12 || len == 16 || len == 20 || len == 24 ||
+           len == 32 || len == 48 || len == 64;
+}
+
+/**
+ * packs messages with all payload sizes, passes the frames except the one at
+ * "lose" to the receiving side. returns the number of messages parsed.
+ */
+static unsigned int roundTrip(size_t maxDataLength, size_t lose,
+                              unsigned long &lost, uint32_t &crcFails) {
+    ndlcom::CanFraming tx(maxDataLength), rx(maxDataLength);
+    std::vector<struct canfd_frame> frames;
+    uint8_t encoded[NDLCOM_MAX_ENCODED_MESSAGE_SIZE];
+    uint8_t payload[NDLCOM_MAX_PAYLOAD_SIZE];
+    struct NDLComHeader header;
+    header.mSenderId = 1;
+    header.mReceiverId = 2;
+    for (size_t len = 0; len <= NDLCOM_MAX_PAYLOAD_SIZE; ++len) {
+        for (size_t i = 0; i < len; ++i) {
+            payload[i] = i % 5 ? rand() : NDLCOM_START_STOP_FLAG;
+        }
+        header.mCounter = len;
+        header.mDataLen = len;
+        const size_t first = frames.size();
+        const size_t count =
+            ndlcomEncode(encoded, sizeof(encoded), &header, payload);
+        tx.pack(encoded, count, 43, frames);
+        // marked is only the first frame of a message
+        for (size_t i = first; i < frames.size(); ++i) {
+            CHECK(frames[i].can_id == 43);
+            CHECK(frames[i].len <= maxDataLength);
+            CHECK(isValidLength(frames[i].len));
+            CHECK(!!(frames[i].data[0] & ndlcom::CanFraming::firstFlag) ==
+                  (i == first));
+        }
+    }
+
+    uint8_t parserBuffer[sizeof(struct NDLComParser)];
+    struct NDLComParser *parser =
+        ndlcomParserCreate(parserBuffer, sizeof(parserBuffer));
+    unsigned int messages = 0;
+    uint8_t buf[CANFD_MAX_DLEN];
+    for (size_t i = 0; i < frames.size(); ++i) {
+        if (i == lose) {
+            continue;
+        }
+        const size_t n = rx.unpack(frames[i], buf);
+        const uint8_t *pos = buf;
+        size_t left = n;
+        while (left) {
+            const size_t used = ndlcomParserReceive(parser, pos, left);
+            pos += used;
+            left -= used;
+            if (ndlcomParserHasPacket(parser)) {
+                const struct NDLComHeader *got = ndlcomParserGetHeader(parser);
+                CHECK(got->mCounter == (uint8_t)got->mDataLen);
+                messages++;
+                ndlcomParserDestroyPacket(parser);
+            }
+        }
+    }
+    lost = rx.framesLost;
+    crcFails = ndlcomParserGetNumberOfCRCFails(parser);
+    return messages;
+}
+
+int main(int argc, char *argv[]) {
+    srand(4711);
+    const unsigned int all = NDLCOM_MAX_PAYLOAD_SIZE + 1;
+    unsigned long lost;
+    uint32_t crcFails;
+
+    CHECK(ndlcom::CanFraming::validLength(0) == 0);
+    CHECK(ndlcom::CanFraming::validLength(8) == 8);
+    CHECK(ndlcom::CanFraming::validLength(9) == 12);
+    CHECK(ndlcom::CanFraming::validLength(13) == 16);
+    CHECK(ndlcom::CanFraming::validLength(33) == 48);
+    CHECK(ndlcom::CanFraming::validLength(49) == 64);
+
+    // everything arrives, also over many wraps of the counter
+    CHECK(roundTrip(CAN_MAX_DLEN, -1, lost, crcFails) == all);
+    CHECK(lost == 0);
+    CHECK(crcFails == 0);
+    CHECK(roundTrip(CANFD_MAX_DLEN, -1, lost, crcFails) == all);
+    CHECK(lost == 0);
+    CHECK(crcFails == 0);
+
+    // one frame in the middle of some message is lost, and only this message
+    CHECK(roundTrip(CAN_MAX_DLEN, 5001, lost, crcFails) == all - 1);
+    CHECK(lost == 1);
+    CHECK(crcFails == 0);
+    CHECK(roundTrip(CANFD_MAX_DLEN, 301, lost, crcFails) == all - 1);
+    CHECK(lost == 1);
+    CHECK(crcFails == 0);
+
+    // the first frame of a message is lost
+    {
+        ndlcom::CanFraming tx(CAN_MAX_DLEN), rx(CAN_MAX_DLEN);
+        std::vector<struct canfd_frame> frames;
+        uint8_t data[20] = {0};
+        uint8_t buf[CANFD_MAX_DLEN];
+        tx.pack(data, sizeof(data), 43, frames);
+        tx.pack(data, sizeof(data), 43, frames);
+        CHECK(frames.size() == 6);
+        CHECK(rx.unpack(frames[0], buf) == 7);
+        CHECK(rx.unpack(frames[1], buf) == 7);
+        CHECK(rx.unpack(frames[2], buf) == 6);
+        // frames[3] lost
+        CHECK(rx.unpack(frames[4], buf) == 0);
+        CHECK(rx.unpack(frames[5], buf) == 0);
+        CHECK(rx.framesLost == 1);
+        CHECK(rx.framesSkipped == 2);
+        // the next message is fine again
+        frames.clear();
+        tx.pack(data, sizeof(data), 43, frames);
+        CHECK(rx.unpack(frames[0], buf) == 7);
+    }
+
+    // raw frames without control byte, cut instead of padded
+    {
+        ndlcom::CanFraming tx(CANFD_MAX_DLEN), rx(CANFD_MAX_DLEN);
+        tx.sequenced = false;
+        rx.sequenced = false;
+        std::vector<struct canfd_frame> frames;
+        uint8_t data[77];
+        uint8_t buf[CANFD_MAX_DLEN];
+        for (size_t i = 0; i < sizeof(data); ++i) {
+            data[i] = i;
+        }
+        tx.pack(data, sizeof(data), 43, frames);
+        // 64 + 12 + 1
+        CHECK(frames.size() == 3);
+        CHECK(frames[0].len == 64);
+        CHECK(frames[1].len == 12);
+        CHECK(frames[2].len == 1);
+        size_t pos = 0;
+        for (auto &frame : frames) {
+            const size_t n = rx.unpack(frame, buf);
+            CHECK(memcmp(buf, data + pos, n) == 0);
+            pos += n;
+        }
+        CHECK(pos == sizeof(data));
+    }
+
+    return checkResult();
+}
@@ -0,0 +1,263 @@
+/**
+ * @file test/testCompression.c
+ * @brief checks the payload compression of "ndlcom/Compression.h"
+ *
+ * First the codec on its own: payloads of all sizes and different kinds of
+ * content have to survive the roundtrip, and garbage must not be accepted
+ * beyond the given buffer. Then two bridges are connected by an in-memory
+ * link with NDLCOM_EXTERNAL_INTERFACE_FLAGS_COMPRESS set on both sides, the
+ * receiving side has to see the original messages while fewer bytes passed
+ * the link. A receiver without the flag sees the compressed payload. A
+ * payload which would look compressed is not sent over the compressed link.
+ * Both also have to work with scratch buffers in the bridges.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ndlcom/Bridge.h"
+#include "ndlcom/BridgeHandler.h"
+#include "ndlcom/Compression.h"
+#include "ndlcom/ExternalInterface.h"
+#include "ndlcom/Types.h"
+
+#include "Check.h"
+
+/* the different kinds of payloads to throw at the codec */
+static void fillPayload(uint8_t *payload, const size_t len, const int kind) {
+    size_t i;
+    for (i = 0; i < len; ++i) {
+        switch (kind) {
+        case 0: /* noise */
+            payload[i] = rand();
+            break;
+        case 1: /* zeros */
+            payload[i] = 0;
+            break;
+        case 2: /* a slow ramp, like a counter */
+            payload[i] = i * 3;
+            break;
+        case 3: /* mostly zeros, some values */
+            payload[i] = rand() % 8 ? 0 : rand();
+            break;
+        default: /* starting with the marker */
+            payload[i] = i ? rand() % 4 : NDLCOM_COMPRESSION_MARKER;
+            break;
+        }
+    }
+}
+
+static void testCodec() {
+    uint8_t payload[NDLCOM_MAX_PAYLOAD_SIZE];
+    uint8_t compressed[NDLCOM_MAX_PAYLOAD_SIZE];
+    uint8_t restored[NDLCOM_MAX_PAYLOAD_SIZE];
+    size_t len;
+    int kind;
+
+    for (kind = 0; kind < 5; ++kind) {
+        for (len = 0; len <= NDLCOM_MAX_PAYLOAD_SIZE; ++len) {
+            fillPayload(payload, len, kind);
+            size_t compressedLen = ndlcomCompressPayload(
+                compressed, sizeof(compressed), payload, len);
+            if (compressedLen == 0) {
+                /* uncompressed payloads starting with the marker are only
+                 * possible if too large, and refused by the bridge */
+                CHECK(len == 0 || payload[0] != NDLCOM_COMPRESSION_MARKER ||
+                      len + NDLCOM_COMPRESSION_HEADER_SIZE >
+                          NDLCOM_MAX_PAYLOAD_SIZE);
+                continue;
+            }
+            CHECK(compressed[0] == NDLCOM_COMPRESSION_MARKER);
+            CHECK(compressedLen < len ||
+                  compressed[1] == NDLCOM_COMPRESSION_METHOD_STORED);
+            size_t restoredLen = ndlcomDecompressPayload(
+                restored, sizeof(restored), compressed, compressedLen);
+            CHECK(restoredLen == len);
+            CHECK(memcmp(restored, payload, len) == 0);
+        }
+    }
+
+    /* good data compresses well */
+    fillPayload(payload, 200, 1);
+    CHECK(ndlcomCompressPayload(compressed, sizeof(compressed), payload, 200) <
+          10);
+    fillPayload(payload, 200, 2);
+    CHECK(ndlcomCompressPayload(compressed, sizeof(compressed), payload, 200) <
+          10);
+
+    /* a small destination buffer is never overrun */
+    fillPayload(payload, 200, 1);
+    len = ndlcomCompressPayload(compressed, sizeof(compressed), payload, 200);
+    CHECK(ndlcomDecompressPayload(restored, 100, compressed, len) == 0);
+
+    /* garbage after the marker is never accepted beyond the buffer */
+    for (kind = 0; kind < 10000; ++kind) {
+        len = 3 + rand() % (NDLCOM_MAX_PAYLOAD_SIZE - 3);
+        fillPayload(compressed, len, 0);
+        compressed[0] = NDLCOM_COMPRESSION_MARKER;
+        compressed[1] = rand() % 4;
+        CHECK(ndlcomDecompressPayload(restored, 64, compressed, len) <= 64);
+    }
+}
+
+/* one direction of an in-memory link between two bridges */
+struct Link {
+    uint8_t buffer[4 * NDLCOM_MAX_ENCODED_MESSAGE_SIZE];
+    size_t length;
+    size_t bytesTotal;
+};
+
+static void linkWrite(void *context, const void *buf, const size_t count) {
+    struct Link *link = (struct Link *)context;
+    if (link->length + count <= sizeof(link->buffer)) {
+        memcpy(link->buffer + link->length, buf, count);
+        link->length += count;
+        link->bytesTotal += count;
+    }
+}
+
+static size_t linkRead(void *context, void *buf, const size_t count) {
+    struct Link *link = (struct Link *)context;
+    size_t len = link->length < count ? link->length : count;
+    memcpy(buf, link->buffer, len);
+    memmove(link->buffer, link->buffer + len, link->length - len);
+    link->length -= len;
+    return len;
+}
+
+static size_t nothingToRead(void *context, void *buf, const size_t count) {
+    return 0;
+}
+
+static void nothingToWrite(void *context, const void *buf,
+                           const size_t count) {}
+
+struct Received {
+    struct NDLComHeader header;
+    uint8_t payload[NDLCOM_MAX_PAYLOAD_SIZE];
+    int count;
+};
+
+static void receive(void *context, const struct NDLComHeader *header,
+                    const void *payload,
+                    const struct NDLComExternalInterface *origin) {
+    struct Received *received = (struct Received *)context;
+    received->header = *header;
+    memcpy(received->payload, payload, header->mDataLen);
+    received->count++;
+}
+
+/*
+ * sends all kinds of payloads from one bridge to the other, returns the
+ * number of bytes which passed the link. optionally both bridges use scratch
+ * buffers, with a small one for reading.
+ */
+static size_t testBridges(const uint8_t flagsSender,
+                          const uint8_t flagsReceiver, const int scratch) {
+    static uint8_t rxScratch[2][100];
+    static uint8_t txScratch[2][NDLCOM_BRIDGE_TX_SCRATCH_SIZE];
+    struct NDLComBridge sender, receiver;
+    struct NDLComExternalInterface senderInterface, receiverInterface;
+    struct NDLComBridgeHandler handler;
+    struct Link link;
+    struct Received received;
+    struct NDLComHeader header;
+    uint8_t payload[NDLCOM_MAX_PAYLOAD_SIZE];
+    size_t len;
+    int kind;
+
+    /* the same payloads in every run */
+    srand(4711);
+    memset(&link, 0, sizeof(link));
+    memset(&received, 0, sizeof(received));
+    ndlcomBridgeInit(&sender);
+    ndlcomBridgeInit(&receiver);
+    if (scratch) {
+        ndlcomBridgeSetScratchBuffers(&sender, rxScratch[0],
+                                      sizeof(rxScratch[0]), txScratch[0]);
+        ndlcomBridgeSetScratchBuffers(&receiver, rxScratch[1],
+                                      sizeof(rxScratch[1]), txScratch[1]);
+    }
+    ndlcomExternalInterfaceInit(&senderInterface, linkWrite, nothingToRead,
+                                flagsSender, &link);
+    ndlcomExternalInterfaceInit(&receiverInterface, nothingToWrite, linkRead,
+                                flagsReceiver, &link);
+    ndlcomBridgeRegisterExternalInterface(&sender, &senderInterface);
+    ndlcomBridgeRegisterExternalInterface(&receiver, &receiverInterface);
+    ndlcomBridgeHandlerInit(&handler, receive,
+                            NDLCOM_BRIDGE_HANDLER_FLAGS_DEFAULT, &received);
+    ndlcomBridgeRegisterBridgeHandler(&receiver, &handler);
+
+    header.mSenderId = 1;
+    header.mReceiverId = 2;
+    header.mCounter = 0;
+    for (kind = 0; kind < 5; ++kind) {
+        for (len = 0; len <= NDLCOM_MAX_PAYLOAD_SIZE; len += 7) {
+            fillPayload(payload, len, kind);
+            header.mDataLen = len;
+            header.mCounter++;
+            ndlcomBridgeSendRaw(&sender, &header, payload);
+            ndlcomBridgeProcess(&receiver);
+            CHECK(received.count == 1);
+            received.count = 0;
+            CHECK(received.header.mSenderId == header.mSenderId);
+            CHECK(received.header.mCounter == header.mCounter);
+            if (flagsSender == flagsReceiver) {
+                CHECK(received.header.mDataLen == len);
+                CHECK(memcmp(received.payload, payload, len) == 0);
+            } else if (kind == 1 && len > 7) {
+                /* legacy receivers see the marker */
+                CHECK(received.payload[0] == NDLCOM_COMPRESSION_MARKER);
+            }
+        }
+    }
+
+    /* too long for the STORED method and not compressible: would look like a
+     * compressed payload, so a compressed link does not carry it at all */
+    fillPayload(payload, NDLCOM_MAX_PAYLOAD_SIZE, 0);
+    payload[0] = NDLCOM_COMPRESSION_MARKER;
+    header.mDataLen = NDLCOM_MAX_PAYLOAD_SIZE;
+    header.mCounter++;
+    ndlcomBridgeSendRaw(&sender, &header, payload);
+    ndlcomBridgeProcess(&receiver);
+    if (flagsSender & NDLCOM_EXTERNAL_INTERFACE_FLAGS_COMPRESS) {
+        CHECK(received.count == 0);
+        CHECK(ndlcomExternalInterfaceGetPacketsRefused(&senderInterface) == 1);
+    } else {
+        CHECK(received.count == 1);
+        CHECK(received.header.mDataLen == NDLCOM_MAX_PAYLOAD_SIZE);
+        CHECK(memcmp(received.payload, payload, NDLCOM_MAX_PAYLOAD_SIZE) == 0);
+        CHECK(ndlcomExternalInterfaceGetPacketsRefused(&senderInterface) == 0);
+    }
+    received.count = 0;
+
+    CHECK(ndlcomExternalInterfaceGetPacketsReceived(&receiverInterface) ==
+          ndlcomExternalInterfaceGetPacketsTransmitted(&senderInterface));
+    return link.bytesTotal;
+}
+
+int main(int argc, char *argv[]) {
+    srand(4711);
+    testCodec();
+
+    const size_t plain = testBridges(NDLCOM_EXTERNAL_INTERFACE_FLAGS_DEFAULT,
+                                     NDLCOM_EXTERNAL_INTERFACE_FLAGS_DEFAULT, 0);
+    const size_t compressed =
+        testBridges(NDLCOM_EXTERNAL_INTERFACE_FLAGS_COMPRESS,
+                    NDLCOM_EXTERNAL_INTERFACE_FLAGS_COMPRESS, 0);
+    testBridges(NDLCOM_EXTERNAL_INTERFACE_FLAGS_COMPRESS,
+                NDLCOM_EXTERNAL_INTERFACE_FLAGS_DEFAULT, 0);
+    fprintf(stderr, "bytes on the link: %zu plain, %zu compressed\n", plain,
+            compressed);
+    CHECK(compressed < plain);
+
+    /* the same with scratch buffers instead of the stack */
+    CHECK(testBridges(NDLCOM_EXTERNAL_INTERFACE_FLAGS_DEFAULT,
+                      NDLCOM_EXTERNAL_INTERFACE_FLAGS_DEFAULT, 1) == plain);
+    CHECK(testBridges(NDLCOM_EXTERNAL_INTERFACE_FLAGS_COMPRESS,
+                      NDLCOM_EXTERNAL_INTERFACE_FLAGS_COMPRESS, 1) ==
+          compressed);
+
+    return checkResult();
+}
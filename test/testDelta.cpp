@@ -0,0 +1,125 @@
+/**
+ * @file test/testDelta.cpp
+ * @brief checks ndlcom::NodeHandlerDelta
+ *
+ * Two nodes on the same bridge exchange telemetry-like streams where only few
+ * bytes change between messages. Every message has to arrive unchanged, most
+ * of them as small deltas. Additionally, a handcrafted out-of-sequence delta
+ * is injected to check the resync by an early keyframe, and more streams than
+ * table entries are used.
+ */
+#include "ndlcom/Bridge.hpp"
+#include "ndlcom/Node.hpp"
+#include "ndlcom/NodeHandlerDelta.hpp"
+
+#include "Check.h"
+
+#include <string.h>
+#include <iostream>
+#include <random>
+#include <vector>
+
+class NodeHandlerDeltaCollect : public ndlcom::NodeHandlerDelta {
+  public:
+    NodeHandlerDeltaCollect(struct NDLComNode &node)
+        : ndlcom::NodeHandlerDelta(node, 2, 50) {}
+    void handleStream(const NDLComId senderId, const void *data,
+                      const size_t length) override {
+        const uint8_t *bytes = static_cast<const uint8_t *>(data);
+        received.push_back(std::vector<uint8_t>(bytes, bytes + length));
+    }
+    std::vector<std::vector<uint8_t>> received;
+};
+
+/** a slowly changing struct, starting with the "type" */
+static void updateTelemetry(std::vector<uint8_t> &message, std::mt19937 &rng) {
+    message[1]++;
+    message[2 + rng() % 8] = rng();
+}
+
+int main(int argc, char *argv[]) {
+    std::mt19937 rng(4711);
+    ndlcom::Bridge bridge;
+    std::shared_ptr<ndlcom::Node> nodeA =
+        bridge.createNode<ndlcom::Node>(1).lock();
+    std::shared_ptr<ndlcom::Node> nodeB =
+        bridge.createNode<ndlcom::Node>(2).lock();
+    std::shared_ptr<NodeHandlerDeltaCollect> sender =
+        nodeA->createNodeHandler<NodeHandlerDeltaCollect>().lock();
+    std::shared_ptr<NodeHandlerDeltaCollect> receiver =
+        nodeB->createNodeHandler<NodeHandlerDeltaCollect>().lock();
+
+    // two interleaved streams of different type and size
+    std::vector<uint8_t> first(64, 0);
+    std::vector<uint8_t> second(NDLCOM_DELTA_MAX_PAYLOAD_SIZE, 0);
+    first[0] = 0x10;
+    second[0] = 0x11;
+    for (int i = 0; i < 1000; ++i) {
+        updateTelemetry(first, rng);
+        updateTelemetry(second, rng);
+        CHECK(sender->sendStream(2, first.data(), first.size()));
+        CHECK(sender->sendStream(2, second.data(), second.size()));
+        CHECK(receiver->received.size() == 2);
+        if (receiver->received.size() == 2) {
+            CHECK(receiver->received[0] == first);
+            CHECK(receiver->received[1] == second);
+        }
+        receiver->received.clear();
+    }
+    CHECK(sender->keyframesSent == 2 * 1000 / 50);
+    CHECK(sender->deltasSent == 2 * 1000 - sender->keyframesSent);
+    CHECK(receiver->messagesLost == 0);
+    CHECK(!sender->sendStream(2, nullptr, 0));
+    CHECK(!sender->sendStream(2, second.data(), second.size() + 1));
+
+    // a delta out of sequence is dropped, and a keyframe is asked for
+    {
+        const uint8_t delta[] = {NDLCOM_DELTA_MARKER, NDLCOM_DELTA_KIND_DELTA,
+                                 0x10, 0x42, 0xc1, 0x00};
+        struct NDLComHeader header;
+        header.mSenderId = 1;
+        header.mReceiverId = 2;
+        header.mCounter = 0;
+        header.mDataLen = sizeof(delta);
+        bridge.sendMessageRaw(&header, delta);
+        CHECK(receiver->messagesLost == 1);
+        CHECK(receiver->received.empty());
+        CHECK(sender->keyframesRequested == 1);
+        // the next message of the stream resyncs
+        const unsigned long keyframesSent = sender->keyframesSent;
+        updateTelemetry(first, rng);
+        CHECK(sender->sendStream(2, first.data(), first.size()));
+        CHECK(sender->keyframesSent == keyframesSent + 1);
+        CHECK(receiver->received.size() == 1);
+        if (!receiver->received.empty()) {
+            CHECK(receiver->received.front() == first);
+        }
+        receiver->received.clear();
+    }
+
+    // a third stream does not fit into two entries, the least recently used
+    // one is replaced on both sides
+    std::vector<uint8_t> third(32, 0);
+    third[0] = 0x12;
+    for (int i = 0; i < 100; ++i) {
+        updateTelemetry(first, rng);
+        updateTelemetry(second, rng);
+        updateTelemetry(third, rng);
+        CHECK(sender->sendStream(2, first.data(), first.size()));
+        CHECK(sender->sendStream(2, second.data(), second.size()));
+        CHECK(sender->sendStream(2, third.data(), third.size()));
+        CHECK(receiver->received.size() == 3);
+        if (receiver->received.size() == 3) {
+            CHECK(receiver->received[0] == first);
+            CHECK(receiver->received[1] == second);
+            CHECK(receiver->received[2] == third);
+        }
+        receiver->received.clear();
+    }
+    CHECK(receiver->messagesLost == 1);
+
+    sender->printStatus("");
+    receiver->printStatus("");
+
+    return checkResult();
+}
@@ -0,0 +1,183 @@
+/**
+ * @file test/testFragmentation.cpp
+ * @brief checks ndlcom::NodeHandlerFragmentation
+ *
+ * Two nodes on the same bridge exchange messages of different sizes around
+ * the fragment boundaries. Additionally, handcrafted fragments are injected to
+ * check reassembly out of order, duplicates, invalid fragments and the
+ * timeout of incomplete messages.
+ *
+ * Finally a node answers every large message from within its handler. That
+ * works on a bridge without send queue, and on one with a queue as long as
+ * the fragments fit. Otherwise sendLarge() has to report the failure.
+ */
+#include "ndlcom/Bridge.hpp"
+#include "ndlcom/Node.hpp"
+#include "ndlcom/NodeHandlerFragmentation.hpp"
+
+#include "Check.h"
+
+#include <string.h>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+class NodeHandlerFragmentationCollect
+    : public ndlcom::NodeHandlerFragmentation {
+  public:
+    NodeHandlerFragmentationCollect(struct NDLComNode &node)
+        : ndlcom::NodeHandlerFragmentation(node, 20000, 2,
+                                           std::chrono::milliseconds(10)) {}
+    void handleLarge(const NDLComId senderId, const void *data,
+                     const size_t length) override {
+        const uint8_t *bytes = static_cast<const uint8_t *>(data);
+        received.push_back(std::vector<uint8_t>(bytes, bytes + length));
+    }
+    std::vector<std::vector<uint8_t>> received;
+};
+
+/** sends every message back, right from its handler */
+class NodeHandlerFragmentationEcho : public ndlcom::NodeHandlerFragmentation {
+  public:
+    NodeHandlerFragmentationEcho(struct NDLComNode &node)
+        : ndlcom::NodeHandlerFragmentation(node, 20000), failed(0) {}
+    void handleLarge(const NDLComId senderId, const void *data,
+                     const size_t length) override {
+        if (!sendLarge(senderId, data, length)) {
+            failed++;
+        }
+    }
+    unsigned int failed;
+};
+
+/** true if a message of "size" bytes comes back from the echo */
+static bool echo(size_t sendQueueSize, size_t size, unsigned int &failed) {
+    ndlcom::Bridge bridge(std::cerr, ndlcom::Bridge::defaultRxScratchSize,
+                          sendQueueSize);
+    std::shared_ptr<ndlcom::Node> nodeA = bridge.createNode<ndlcom::Node>(1).lock();
+    std::shared_ptr<ndlcom::Node> nodeB = bridge.createNode<ndlcom::Node>(2).lock();
+    std::shared_ptr<NodeHandlerFragmentationCollect> asking =
+        nodeA->createNodeHandler<NodeHandlerFragmentationCollect>().lock();
+    std::shared_ptr<NodeHandlerFragmentationEcho> answering =
+        nodeB->createNodeHandler<NodeHandlerFragmentationEcho>().lock();
+    std::vector<uint8_t> message(size, 0x44);
+    CHECK(asking->sendLarge(2, message.data(), message.size()));
+    failed = answering->failed;
+    return asking->received.size() == 1 && asking->received.front() == message;
+}
+
+/** inject one fragment, as if "senderId" had sent it to node 2 */
+static void sendFragment(ndlcom::Bridge &bridge, NDLComId senderId,
+                         uint8_t messageId, uint16_t index, uint16_t count,
+                         const std::vector<uint8_t> &message) {
+    uint8_t payload[NDLCOM_MAX_PAYLOAD_SIZE];
+    const size_t offset = index * NDLCOM_FRAGMENT_CHUNK_SIZE;
+    const size_t chunk = std::min<size_t>(NDLCOM_FRAGMENT_CHUNK_SIZE,
+                                          message.size() - offset);
+    payload[0] = NDLCOM_FRAGMENT_MARKER;
+    payload[1] = messageId;
+    payload[2] = index;
+    payload[3] = index >> 8;
+    payload[4] = count;
+    payload[5] = count >> 8;
+    memcpy(payload + NDLCOM_FRAGMENT_HEADER_SIZE, message.data() + offset,
+           chunk);
+    struct NDLComHeader header;
+    header.mSenderId = senderId;
+    header.mReceiverId = 2;
+    header.mCounter = 0;
+    header.mDataLen = NDLCOM_FRAGMENT_HEADER_SIZE + chunk;
+    bridge.sendMessageRaw(&header, payload);
+}
+
+int main(int argc, char *argv[]) {
+    std::mt19937 rng(4711);
+    ndlcom::Bridge bridge;
+    std::shared_ptr<ndlcom::Node> nodeA = bridge.createNode<ndlcom::Node>(1).lock();
+    std::shared_ptr<ndlcom::Node> nodeB = bridge.createNode<ndlcom::Node>(2).lock();
+    std::shared_ptr<NodeHandlerFragmentationCollect> sender =
+        nodeA->createNodeHandler<NodeHandlerFragmentationCollect>().lock();
+    std::shared_ptr<NodeHandlerFragmentationCollect> receiver =
+        nodeB->createNodeHandler<NodeHandlerFragmentationCollect>().lock();
+
+    // sizes around the fragment boundaries, up to the configured maximum
+    const size_t sizes[] = {1,
+                            NDLCOM_FRAGMENT_CHUNK_SIZE - 1,
+                            NDLCOM_FRAGMENT_CHUNK_SIZE,
+                            NDLCOM_FRAGMENT_CHUNK_SIZE + 1,
+                            3 * NDLCOM_FRAGMENT_CHUNK_SIZE,
+                            10000,
+                            20000};
+    for (auto size : sizes) {
+        std::vector<uint8_t> message(size);
+        for (auto &b : message) {
+            b = rng();
+        }
+        CHECK(sender->sendLarge(2, message.data(), message.size()));
+        CHECK(receiver->received.size() == 1);
+        if (!receiver->received.empty()) {
+            CHECK(receiver->received.front() == message);
+            receiver->received.clear();
+        }
+    }
+    CHECK(!sender->sendLarge(2, nullptr, 0));
+    std::vector<uint8_t> tooLarge(20001);
+    CHECK(!sender->sendLarge(2, tooLarge.data(), tooLarge.size()));
+
+    // two messages from different senders, interleaved, in reverse order and
+    // with duplicates
+    std::vector<uint8_t> first(5 * NDLCOM_FRAGMENT_CHUNK_SIZE + 17, 0x11);
+    std::vector<uint8_t> second(3 * NDLCOM_FRAGMENT_CHUNK_SIZE, 0x22);
+    for (int index = 5; index >= 0; --index) {
+        sendFragment(bridge, 5, 7, index, 6, first);
+        sendFragment(bridge, 5, 7, index, 6, first);
+        if (index < 3) {
+            sendFragment(bridge, 6, 7, index, 3, second);
+        }
+    }
+    CHECK(receiver->received.size() == 2);
+    if (receiver->received.size() == 2) {
+        CHECK(receiver->received[0] == first);
+        CHECK(receiver->received[1] == second);
+    }
+    receiver->received.clear();
+
+    // short fragment which is not the last one
+    {
+        std::vector<uint8_t> shortMessage(10, 0x33);
+        sendFragment(bridge, 5, 8, 0, 2, shortMessage);
+        CHECK(receiver->fragmentsRejected == 1);
+    }
+
+    // an incomplete message times out
+    sendFragment(bridge, 5, 9, 0, 2, first);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    receiver->process();
+    CHECK(receiver->messagesDropped == 1);
+    sendFragment(bridge, 5, 9, 1, 2, first);
+    CHECK(receiver->received.empty());
+
+    // with both slots in use a third message evicts the oldest one
+    sendFragment(bridge, 6, 1, 0, 2, first);
+    sendFragment(bridge, 7, 1, 0, 2, first);
+    CHECK(receiver->messagesDropped == 2);
+    sendFragment(bridge, 5, 9, 0, 2, first);
+    CHECK(receiver->received.empty());
+    sendFragment(bridge, 7, 1, 1, 2, first);
+    CHECK(receiver->received.size() == 1);
+
+    receiver->printStatus("");
+
+    // answering from within the handler
+    unsigned int failed;
+    CHECK(echo(0, 20000, failed));
+    CHECK(failed == 0);
+    CHECK(echo(8, 8 * NDLCOM_FRAGMENT_CHUNK_SIZE, failed));
+    CHECK(failed == 0);
+    CHECK(!echo(8, 8 * NDLCOM_FRAGMENT_CHUNK_SIZE + 1, failed));
+    CHECK(failed == 1);
+
+    return checkResult();
+}
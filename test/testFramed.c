@@ -0,0 +1,234 @@
+/**
+ * @file test/testFramed.c
+ * @brief checks the framed mode for transports keeping message boundaries
+ *
+ * First ndlcomEncodeFramed() and ndlcomParserReceiveFramed() on their own:
+ * messages of all sizes, with and without crc, have to survive the roundtrip
+ * also when the bytes arrive in chunks of odd sizes. A corrupted message has
+ * to be counted as bad crc. Then a bridge sends over two in-memory links, one
+ * framed and one escaped as usual, to two receiving bridges. Both have to see
+ * all messages, while only header, payload and crc passed the framed link.
+ * The same has to work with scratch buffers in the bridges.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ndlcom/Bridge.h"
+#include "ndlcom/BridgeHandler.h"
+#include "ndlcom/Encoder.h"
+#include "ndlcom/ExternalInterface.h"
+#include "ndlcom/Parser.h"
+#include "ndlcom/Types.h"
+
+#include "Check.h"
+
+/* payloads full of bytes which would need escaping */
+static void fillPayload(uint8_t *payload, const size_t len) {
+    size_t i;
+    for (i = 0; i < len; ++i) {
+        payload[i] = i % 3 ? rand() : NDLCOM_START_STOP_FLAG;
+    }
+}
+
+static void testCodec(const int withCrc) {
+    uint8_t stream[8 * NDLCOM_MAX_DECODED_MESSAGE_SIZE];
+    uint8_t payload[NDLCOM_MAX_PAYLOAD_SIZE];
+    uint8_t parserBuffer[sizeof(struct NDLComParser)];
+    struct NDLComParser *parser =
+        ndlcomParserCreate(parserBuffer, sizeof(parserBuffer));
+    struct NDLComHeader header;
+    const size_t crcSize = withCrc ? sizeof(NDLComCrc) : 0;
+    size_t len;
+
+    header.mSenderId = 1;
+    header.mReceiverId = 2;
+    header.mCounter = 0;
+    for (len = 0; len <= NDLCOM_MAX_PAYLOAD_SIZE; ++len) {
+        size_t streamLen = 0, pos = 0, chunk = 1 + len % 13;
+        int count = 0, i;
+        fillPayload(payload, len);
+        header.mDataLen = len;
+        /* three messages back to back */
+        for (i = 0; i < 3; ++i) {
+            header.mCounter++;
+            const size_t encoded = ndlcomEncodeFramed(
+                stream + streamLen, sizeof(stream) - streamLen, &header,
+                payload, withCrc);
+            CHECK(encoded == sizeof(header) + len + crcSize);
+            streamLen += encoded;
+        }
+        /* nothing fits into a buffer too small */
+        CHECK(ndlcomEncodeFramed(stream + streamLen,
+                                 sizeof(header) + len + crcSize - 1, &header,
+                                 payload, withCrc) == 0);
+
+        while (pos < streamLen) {
+            const size_t n = streamLen - pos < chunk ? streamLen - pos : chunk;
+            pos += ndlcomParserReceiveFramed(parser, stream + pos, n, withCrc);
+            if (ndlcomParserHasPacket(parser)) {
+                const struct NDLComHeader *got = ndlcomParserGetHeader(parser);
+                CHECK(got->mDataLen == len);
+                CHECK(got->mCounter == (uint8_t)(header.mCounter - 2 + count));
+                CHECK(memcmp(ndlcomParserGetPacket(parser), payload, len) ==
+                      0);
+                ndlcomParserDestroyPacket(parser);
+                count++;
+            }
+        }
+        CHECK(count == 3);
+    }
+    CHECK(ndlcomParserGetNumberOfCRCFails(parser) == 0);
+
+    if (withCrc) {
+        /* a flipped bit in the payload */
+        header.mDataLen = 20;
+        fillPayload(payload, 20);
+        len = ndlcomEncodeFramed(stream, sizeof(stream), &header, payload, 1);
+        stream[sizeof(header) + 5] ^= 0x10;
+        CHECK(ndlcomParserReceiveFramed(parser, stream, len, 1) == len);
+        CHECK(!ndlcomParserHasPacket(parser));
+        CHECK(ndlcomParserGetNumberOfCRCFails(parser) == 1);
+    }
+}
+
+/* one direction of an in-memory link between two bridges */
+struct Link {
+    uint8_t buffer[4 * NDLCOM_MAX_ENCODED_MESSAGE_SIZE];
+    size_t length;
+    size_t bytesTotal;
+};
+
+static void linkWrite(void *context, const void *buf, const size_t count) {
+    struct Link *link = (struct Link *)context;
+    if (link->length + count <= sizeof(link->buffer)) {
+        memcpy(link->buffer + link->length, buf, count);
+        link->length += count;
+        link->bytesTotal += count;
+    }
+}
+
+static size_t linkRead(void *context, void *buf, const size_t count) {
+    struct Link *link = (struct Link *)context;
+    size_t len = link->length < count ? link->length : count;
+    memcpy(buf, link->buffer, len);
+    memmove(link->buffer, link->buffer + len, link->length - len);
+    link->length -= len;
+    return len;
+}
+
+static size_t nothingToRead(void *context, void *buf, const size_t count) {
+    return 0;
+}
+
+static void nothingToWrite(void *context, const void *buf,
+                           const size_t count) {}
+
+struct Received {
+    struct NDLComHeader header;
+    uint8_t payload[NDLCOM_MAX_PAYLOAD_SIZE];
+    int count;
+};
+
+static void receive(void *context, const struct NDLComHeader *header,
+                    const void *payload,
+                    const struct NDLComExternalInterface *origin) {
+    struct Received *received = (struct Received *)context;
+    received->header = *header;
+    memcpy(received->payload, payload, header->mDataLen);
+    received->count++;
+}
+
+/*
+ * sends payloads of all sizes from one bridge to two others, over a framed
+ * link with the given flags and over an escaped link. optionally all bridges
+ * use scratch buffers, with a small one for reading.
+ */
+static void testBridges(const uint8_t flags, const int scratch) {
+    static uint8_t rxScratch[3][100];
+    static uint8_t txScratch[3][NDLCOM_BRIDGE_TX_SCRATCH_SIZE];
+    struct NDLComBridge sender, receiver[2];
+    struct NDLComExternalInterface senderInterface[2], receiverInterface[2];
+    struct NDLComBridgeHandler handler[2];
+    struct Link link[2];
+    struct Received received[2];
+    struct NDLComHeader header;
+    uint8_t payload[NDLCOM_MAX_PAYLOAD_SIZE];
+    const size_t crcSize =
+        flags & NDLCOM_EXTERNAL_INTERFACE_FLAGS_FRAMED_CRC ? sizeof(NDLComCrc)
+                                                           : 0;
+    size_t len, expected = 0;
+    int i;
+
+    memset(link, 0, sizeof(link));
+    memset(received, 0, sizeof(received));
+    ndlcomBridgeInit(&sender);
+    if (scratch) {
+        ndlcomBridgeSetScratchBuffers(&sender, rxScratch[2],
+                                      sizeof(rxScratch[2]), txScratch[2]);
+    }
+    for (i = 0; i < 2; ++i) {
+        const uint8_t f = i ? NDLCOM_EXTERNAL_INTERFACE_FLAGS_DEFAULT : flags;
+        ndlcomBridgeInit(&receiver[i]);
+        if (scratch) {
+            ndlcomBridgeSetScratchBuffers(&receiver[i], rxScratch[i],
+                                          sizeof(rxScratch[i]), txScratch[i]);
+        }
+        ndlcomExternalInterfaceInit(&senderInterface[i], linkWrite,
+                                    nothingToRead, f, &link[i]);
+        ndlcomExternalInterfaceInit(&receiverInterface[i], nothingToWrite,
+                                    linkRead, f, &link[i]);
+        ndlcomBridgeRegisterExternalInterface(&sender, &senderInterface[i]);
+        ndlcomBridgeRegisterExternalInterface(&receiver[i],
+                                              &receiverInterface[i]);
+        ndlcomBridgeHandlerInit(&handler[i], receive,
+                                NDLCOM_BRIDGE_HANDLER_FLAGS_DEFAULT,
+                                &received[i]);
+        ndlcomBridgeRegisterBridgeHandler(&receiver[i], &handler[i]);
+    }
+
+    header.mSenderId = 1;
+    header.mReceiverId = 2;
+    header.mCounter = 0;
+    for (len = 0; len <= NDLCOM_MAX_PAYLOAD_SIZE; len += 3) {
+        fillPayload(payload, len);
+        header.mDataLen = len;
+        header.mCounter++;
+        ndlcomBridgeSendRaw(&sender, &header, payload);
+        expected += sizeof(header) + len + crcSize;
+        for (i = 0; i < 2; ++i) {
+            ndlcomBridgeProcess(&receiver[i]);
+            CHECK(received[i].count == 1);
+            received[i].count = 0;
+            CHECK(received[i].header.mCounter == header.mCounter);
+            CHECK(received[i].header.mDataLen == len);
+            CHECK(memcmp(received[i].payload, payload, len) == 0);
+        }
+    }
+    CHECK(link[0].bytesTotal == expected);
+    /* a third of the payload needs escaping on the other link */
+    CHECK(link[1].bytesTotal > expected);
+    CHECK(ndlcomParserGetNumberOfCRCFails(&receiverInterface[0].parser) == 0);
+}
+
+int main(int argc, char *argv[]) {
+    srand(4711);
+    testCodec(0);
+    testCodec(1);
+
+    testBridges(NDLCOM_EXTERNAL_INTERFACE_FLAGS_FRAMED, 0);
+    testBridges(NDLCOM_EXTERNAL_INTERFACE_FLAGS_FRAMED |
+                    NDLCOM_EXTERNAL_INTERFACE_FLAGS_FRAMED_CRC,
+                0);
+    testBridges(NDLCOM_EXTERNAL_INTERFACE_FLAGS_FRAMED, 1);
+    testBridges(NDLCOM_EXTERNAL_INTERFACE_FLAGS_FRAMED |
+                    NDLCOM_EXTERNAL_INTERFACE_FLAGS_FRAMED_CRC,
+                1);
+    /* the compress flag is ignored on framed interfaces */
+    testBridges(NDLCOM_EXTERNAL_INTERFACE_FLAGS_FRAMED |
+                    NDLCOM_EXTERNAL_INTERFACE_FLAGS_COMPRESS,
+                0);
+
+    return checkResult();
+}
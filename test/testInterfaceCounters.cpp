@@ -0,0 +1,69 @@
+/**
+ * @file test/testInterfaceCounters.cpp
+ * @brief checks the byte counters and the "batch" option of interfaces
+ *
+ * An interface taking only part of what is written has to count only the
+ * accepted bytes as transmitted, the rest as dropped. A batch size which is
+ * no number, or too large a number, must not end the program when given in
+ * an uri.
+ */
+#include "ndlcom/Bridge.hpp"
+#include "ndlcom/ExternalInterfaceBase.hpp"
+
+#include "Check.h"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+/** accepts only "limit" bytes of every write */
+class ExternalInterfaceLimited : public ndlcom::ExternalInterfaceBase {
+  public:
+    ExternalInterfaceLimited(struct NDLComBridge &bridge, size_t _limit)
+        : ndlcom::ExternalInterfaceBase(bridge, "limited"), limit(_limit) {}
+    size_t writeEscapedBytes(const void *buf, size_t count) override {
+        return std::min(count, limit);
+    }
+    size_t writeEscapedFrames(const struct NDLComExternalInterfaceFrame *frames,
+                              size_t count) override {
+        size_t total = 0;
+        for (size_t i = 0; i < count; ++i) {
+            total += frames[i].length;
+        }
+        return std::min(total, limit);
+    }
+    size_t readEscapedBytes(void *buf, size_t count) override { return 0; }
+    size_t limit;
+};
+
+int main(int argc, char *argv[]) {
+    ndlcom::Bridge bridge;
+    std::shared_ptr<ExternalInterfaceLimited> limited =
+        bridge.createExternalInterface<ExternalInterfaceLimited>(10).lock();
+
+    struct NDLComHeader header;
+    uint8_t payload[50] = {0};
+    header.mSenderId = 1;
+    header.mReceiverId = 2;
+    header.mCounter = 0;
+    header.mDataLen = sizeof(payload);
+    bridge.sendMessageRaw(&header, payload);
+    CHECK(limited->bytesTransmitted == 10);
+    CHECK(limited->bytesDropped > 0);
+    const unsigned long total = limited->bytesTransmitted + limited->bytesDropped;
+    limited->limit = 1000;
+    bridge.sendMessageRaw(&header, payload);
+    CHECK(limited->bytesTransmitted == 10 + total);
+
+    // reported, but no exception
+    std::ostringstream out;
+    ndlcom::setOptionsByString(limited, "batch=abc&batch=4x", out);
+    ndlcom::setOptionsByString(limited, "batch=123456789012345678901234", out);
+    CHECK(out.str().find("invalid value") != std::string::npos);
+    CHECK(out.str().find("out of range") != std::string::npos);
+    CHECK(out.str().find("set option") == std::string::npos);
+
+    CHECK(limited->setOption("batch", "100000"));
+
+    return checkResult();
+}
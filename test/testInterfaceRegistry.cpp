@@ -0,0 +1,101 @@
+/**
+ * @file test/testInterfaceRegistry.cpp
+ * @brief checks the uri schemes known to ndlcom::Bridge::createInterface()
+ *
+ * An interface class living outside of the library is registered under a
+ * scheme of its own and created from an uri, with routing and options given
+ * in the tail. A second scheme is registered as plain function. Unknown
+ * schemes and uris not fitting the regex of their scheme give an empty
+ * pointer, the built-in types are still found.
+ */
+#include "ndlcom/Bridge.hpp"
+#include "ndlcom/ExternalInterfaceBase.hpp"
+
+#include "Check.h"
+
+#include <algorithm>
+#include <iostream>
+#include <regex>
+#include <stdexcept>
+
+/** does nothing, but knows the option "answer" */
+class ExternalInterfaceDummy : public ndlcom::ExternalInterfaceBase {
+  public:
+    ExternalInterfaceDummy(struct NDLComBridge &bridge, std::smatch match,
+                           uint8_t flags)
+        : ndlcom::ExternalInterfaceBase(bridge, "dummy", std::cerr, flags),
+          name(match[1].str()), answer(0) {}
+    static const std::regex &uri() {
+        static const std::regex regex("^dummy://([a-z]+)(?:&(.*))?$");
+        return regex;
+    }
+    size_t writeEscapedBytes(const void *buf, size_t count) override {
+        return count;
+    }
+    size_t readEscapedBytes(void *buf, size_t count) override { return 0; }
+    bool setOption(const std::string &key, const std::string &value) override {
+        if (key == "answer") {
+            answer = std::stoi(value);
+            return true;
+        }
+        return ndlcom::ExternalInterfaceBase::setOption(key, value);
+    }
+    std::string name;
+    int answer;
+};
+
+int main(int argc, char *argv[]) {
+    ndlcom::Bridge bridge;
+
+    CHECK(bridge.createInterface("dummy://abc").expired());
+    ndlcom::Bridge::registerInterfaceType(
+        "dummy", ndlcom::Bridge::interfaceFactory<ExternalInterfaceDummy>());
+    std::shared_ptr<ExternalInterfaceDummy> dummy =
+        std::dynamic_pointer_cast<ExternalInterfaceDummy>(
+            bridge.createInterface("dummy://abc&3,4&answer=42").lock());
+    CHECK(dummy);
+    if (!dummy) {
+        return EXIT_FAILURE;
+    }
+    CHECK(dummy->name == "abc");
+    CHECK(dummy->answer == 42);
+    CHECK(bridge.getInterfaceCount() == 1);
+    // not fitting the regex of the scheme
+    CHECK(bridge.createInterface("dummy://ABC").expired());
+    CHECK(bridge.getInterfaceCount() == 1);
+
+    // any function will do, here an alias for the dummy
+    unsigned int calls = 0;
+    ndlcom::Bridge::registerInterfaceType(
+        "alias", [&calls](ndlcom::Bridge &b, const std::string &uri,
+                          uint8_t flags) {
+            calls++;
+            return b.createInterface("dummy://" + uri.substr(8), flags);
+        });
+    CHECK(!bridge.createInterface("alias://xyz").expired());
+    CHECK(calls == 1);
+    CHECK(bridge.getInterfaceCount() == 2);
+
+    const std::vector<std::string> types = ndlcom::Bridge::getInterfaceTypes();
+    CHECK(std::is_sorted(types.begin(), types.end()));
+    for (const char *scheme : {"alias", "dummy", "serial", "udp", "udpmc",
+                               "fpga", "pipe", "can", "pty", "tcpclient",
+                               "tcpserver", "unix"}) {
+        CHECK(std::find(types.begin(), types.end(), scheme) != types.end());
+    }
+
+    // no scheme, or an unknown one
+    CHECK(bridge.createInterface("").expired());
+    CHECK(bridge.createInterface("dummy").expired());
+    CHECK(bridge.createInterface("nothing://abc").expired());
+    // a built-in one, on ports no other test uses
+    try {
+        CHECK(!bridge.createInterface("udp://localhost:34130:34131").expired());
+        CHECK(bridge.getInterfaceCount() == 3);
+    } catch (const std::runtime_error &e) {
+        std::cerr << "udp interface failed: " << e.what() << "\n";
+        failures++;
+    }
+
+    return checkResult();
+}
@@ -0,0 +1,216 @@
+/**
+ * @file test/testIoUring.cpp
+ * @brief checks reading and writing through ndlcom::IoUring
+ *
+ * Bytes written into one end of a socketpair in several batches have to come
+ * out of the other end complete and in order, also when they are more than
+ * the buffers hold. Closing the other end has to be seen. Two bridges talking
+ * over udp on localhost with "&uring" have to get all messages, the replies
+ * going to the learned sender.
+ *
+ * Skipped if the kernel does not allow io_uring.
+ */
+#include "ndlcom/Bridge.hpp"
+#include "ndlcom/BridgeHandler.hpp"
+#include "ndlcom/ExternalInterface.hpp"
+#include "ndlcom/IoUring.hpp"
+
+#include "Check.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+/** counts the messages seen by a bridge */
+class BridgeHandlerCount : public ndlcom::BridgeHandler {
+  public:
+    BridgeHandlerCount(struct NDLComBridge &bridge)
+        : ndlcom::BridgeHandler(bridge, "count"), count(0), outOfOrder(0) {}
+    void handle(const struct NDLComHeader *header, const void *payload,
+                const struct NDLComExternalInterface *origin) override {
+        if (header->mCounter != (uint8_t)count) {
+            outOfOrder++;
+        }
+        count++;
+    }
+    unsigned int count;
+    unsigned int outOfOrder;
+};
+
+static void testStream() {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1) {
+        std::cerr << "socketpair() failed: " << strerror(errno) << "\n";
+        failures++;
+        return;
+    }
+    fcntl(fds[1], F_SETFL, O_NONBLOCK);
+    ndlcom::IoUring uring(fds[0], false);
+    CHECK(uring.valid());
+
+    // three times the send buffers, in frames of odd sizes
+    std::vector<uint8_t> sent(3 * ndlcom::IoUring::bufferSize);
+    for (size_t i = 0; i < sent.size(); ++i) {
+        sent[i] = i * 7 + i / 251;
+    }
+    std::vector<uint8_t> received;
+    std::vector<uint8_t> buf(1000);
+    size_t pos = 0;
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (received.size() < sent.size() &&
+           std::chrono::steady_clock::now() < deadline) {
+        if (pos < sent.size()) {
+            struct NDLComExternalInterfaceFrame frames[3];
+            size_t total = 0;
+            for (int i = 0; i < 3; ++i) {
+                frames[i].data = sent.data() + pos + total;
+                frames[i].length =
+                    std::min<size_t>(333, sent.size() - pos - total);
+                total += frames[i].length;
+            }
+            const ssize_t accepted = uring.write(frames, 3);
+            CHECK(accepted >= 0);
+            if (accepted > 0) {
+                // only whole frames are accepted
+                CHECK(accepted == (ssize_t)total ||
+                      accepted == (ssize_t)frames[0].length ||
+                      accepted ==
+                          (ssize_t)(frames[0].length + frames[1].length));
+                pos += accepted;
+            }
+        }
+        ssize_t r = read(fds[1], buf.data(), buf.size());
+        if (r > 0) {
+            received.insert(received.end(), buf.data(), buf.data() + r);
+        }
+    }
+    CHECK(received == sent);
+    CHECK(uring.takeDropped() == 0);
+
+    // and the other way, waiting on the poll-fd
+    struct pollfd ufd;
+    ufd.fd = uring.getPollFd();
+    ufd.events = POLLIN;
+    CHECK(ufd.fd != fds[0]);
+    CHECK(write(fds[1], "hello", 5) == 5);
+    received.clear();
+    while (received.size() < 5 &&
+           std::chrono::steady_clock::now() < deadline) {
+        poll(&ufd, 1, 100);
+        ssize_t r = uring.read(buf.data(), 3);
+        CHECK(r >= 0);
+        if (r > 0) {
+            received.insert(received.end(), buf.data(), buf.data() + r);
+        }
+    }
+    CHECK(std::string(received.begin(), received.end()) == "hello");
+    CHECK(!uring.eof());
+
+    close(fds[1]);
+    while (!uring.eof() && std::chrono::steady_clock::now() < deadline) {
+        poll(&ufd, 1, 100);
+        CHECK(uring.read(buf.data(), buf.size()) == 0);
+    }
+    CHECK(uring.eof());
+    close(fds[0]);
+}
+
+static void testUdp() {
+    ndlcom::Bridge bridgeA, bridgeB;
+    std::shared_ptr<ndlcom::ExternalInterfaceUdp> udpA =
+        bridgeA
+            .createExternalInterface<ndlcom::ExternalInterfaceUdp>(
+                "localhost", 34510, 34511)
+            .lock();
+    std::shared_ptr<ndlcom::ExternalInterfaceUdp> udpB =
+        bridgeB
+            .createExternalInterface<ndlcom::ExternalInterfaceUdp>(
+                "localhost", 34511, 34510)
+            .lock();
+    std::shared_ptr<BridgeHandlerCount> countA =
+        bridgeA.createBridgeHandler<BridgeHandlerCount>().lock();
+    std::shared_ptr<BridgeHandlerCount> countB =
+        bridgeB.createBridgeHandler<BridgeHandlerCount>().lock();
+    CHECK(udpA->setOption("uring", ""));
+    CHECK(udpB->setOption("uring", ""));
+    CHECK(udpA->setIoUring(true));
+
+    const unsigned int messages = 200;
+    struct NDLComHeader header;
+    uint8_t payload[100];
+    memset(payload, 0x7e, sizeof(payload));
+    header.mSenderId = 1;
+    header.mReceiverId = 2;
+    header.mDataLen = sizeof(payload);
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    for (unsigned int i = 0; i < messages; ++i) {
+        header.mCounter = i;
+        bridgeA.sendMessageRaw(&header, payload);
+        // the buffers are not endless
+        if (i % 50 == 49) {
+            while (countB->count <= i &&
+                   std::chrono::steady_clock::now() < deadline) {
+                bridgeA.process();
+                bridgeB.process();
+            }
+        }
+    }
+    while (countB->count < messages &&
+           std::chrono::steady_clock::now() < deadline) {
+        bridgeA.process();
+        bridgeB.process();
+    }
+    CHECK(countB->count == messages);
+    CHECK(countB->outOfOrder == 0);
+    CHECK(udpA->bytesDropped == 0);
+
+    // and back, to where it came from. the handler of "A" also saw what "A"
+    // sent itself
+    const unsigned int seenByA = countA->count;
+    header.mSenderId = 2;
+    header.mReceiverId = 1;
+    bridgeB.sendMessageRaw(&header, payload);
+    while (countA->count < seenByA + 1 &&
+           std::chrono::steady_clock::now() < deadline) {
+        bridgeA.process();
+        bridgeB.process();
+    }
+    CHECK(countA->count == seenByA + 1);
+
+    // back to the normal syscalls
+    CHECK(udpB->setOption("uring", "0"));
+    bridgeB.sendMessageRaw(&header, payload);
+    while (countA->count < seenByA + 2 &&
+           std::chrono::steady_clock::now() < deadline) {
+        bridgeA.process();
+        bridgeB.process();
+    }
+    CHECK(countA->count == seenByA + 2);
+}
+
+int main(int argc, char *argv[]) {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0) {
+        const bool available = ndlcom::IoUring(fds[0], false).valid();
+        close(fds[0]);
+        close(fds[1]);
+        if (!available) {
+            std::cerr << "io_uring not available, skipped\n";
+            return EXIT_SUCCESS;
+        }
+    }
+
+    testStream();
+    testUdp();
+
+    return checkResult();
+}
@@ -0,0 +1,289 @@
+/**
+ * @file test/testMetrics.cpp
+ * @brief checks the JSON of ndlcom::writeMetricsJson() and the MetricsServer
+ *
+ * A snapshot of a bridge with an interface of a rather hostile label has to
+ * be valid JSON, the label coming back unchanged after parsing. Clients of
+ * the MetricsServer get whole lines of JSON, right away and after every
+ * interval. A client not reading anymore is dropped once its socket is full,
+ * without disturbing the others.
+ */
+#include "ndlcom/Bridge.hpp"
+#include "ndlcom/ExternalInterfaceBase.hpp"
+#include "ndlcom/Metrics.hpp"
+
+#include "Check.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/** just enough JSON for the snapshots */
+struct Json {
+    enum Type { NUL, BOOL, NUMBER, STRING, ARRAY, OBJECT } type;
+    bool boolean;
+    double number;
+    std::string string;
+    std::vector<Json> array;
+    std::map<std::string, Json> object;
+
+    const Json &operator[](const std::string &key) const {
+        static const Json none = {NUL};
+        auto it = object.find(key);
+        return it == object.end() ? none : it->second;
+    }
+};
+
+/** recursive descent, "ok" turns false on anything not valid */
+class JsonParser {
+  public:
+    JsonParser(const std::string &_s) : ok(true), s(_s), pos(0) {}
+
+    Json parseDocument() {
+        Json value = parseValue();
+        skipSpace();
+        ok = ok && pos == s.size();
+        return value;
+    }
+
+    bool ok;
+
+  private:
+    void skipSpace() {
+        while (pos < s.size() && strchr(" \t\r\n", s[pos])) {
+            pos++;
+        }
+    }
+
+    bool consume(const std::string &token) {
+        skipSpace();
+        if (s.compare(pos, token.size(), token) == 0) {
+            pos += token.size();
+            return true;
+        }
+        return false;
+    }
+
+    Json parseValue() {
+        Json value = {Json::NUL};
+        skipSpace();
+        if (!ok || pos >= s.size()) {
+            ok = false;
+        } else if (consume("{")) {
+            value.type = Json::OBJECT;
+            if (consume("}")) {
+                return value;
+            }
+            do {
+                skipSpace();
+                const std::string key = parseString();
+                ok = ok && consume(":");
+                value.object[key] = parseValue();
+            } while (ok && consume(","));
+            ok = ok && consume("}");
+        } else if (consume("[")) {
+            value.type = Json::ARRAY;
+            if (consume("]")) {
+                return value;
+            }
+            do {
+                value.array.push_back(parseValue());
+            } while (ok && consume(","));
+            ok = ok && consume("]");
+        } else if (s[pos] == '"') {
+            value.type = Json::STRING;
+            value.string = parseString();
+        } else if (consume("true")) {
+            value.type = Json::BOOL;
+            value.boolean = true;
+        } else if (consume("false")) {
+            value.type = Json::BOOL;
+            value.boolean = false;
+        } else if (!consume("null")) {
+            value.type = Json::NUMBER;
+            const char *begin = s.c_str() + pos;
+            char *end;
+            value.number = strtod(begin, &end);
+            ok = end != begin;
+            pos += end - begin;
+        }
+        return value;
+    }
+
+    std::string parseString() {
+        std::string retval;
+        if (pos >= s.size() || s[pos] != '"') {
+            ok = false;
+            return retval;
+        }
+        pos++;
+        while (pos < s.size() && s[pos] != '"') {
+            char c = s[pos++];
+            if ((unsigned char)c < 0x20) {
+                ok = false;
+            } else if (c == '\\' && pos < s.size()) {
+                c = s[pos++];
+                if (c == 'n') {
+                    c = '\n';
+                } else if (c == 't') {
+                    c = '\t';
+                } else if (c == 'u' && pos + 4 <= s.size()) {
+                    c = std::stoi(s.substr(pos, 4), nullptr, 16);
+                    pos += 4;
+                } else if (c != '"' && c != '\\' && c != '/') {
+                    ok = false;
+                }
+            }
+            retval += c;
+        }
+        ok = ok && pos < s.size();
+        pos++;
+        return retval;
+    }
+
+    const std::string s;
+    size_t pos;
+};
+
+/** does nothing, only its label is of interest */
+class ExternalInterfaceNull : public ndlcom::ExternalInterfaceBase {
+  public:
+    ExternalInterfaceNull(struct NDLComBridge &bridge, std::string label)
+        : ndlcom::ExternalInterfaceBase(bridge, label) {}
+    size_t writeEscapedBytes(const void *buf, size_t count) override {
+        return count;
+    }
+    size_t readEscapedBytes(void *buf, size_t count) override { return 0; }
+};
+
+static int connectTo(const std::string &path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path.c_str(), path.size());
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (fd == -1 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+        std::cerr << "connect() failed: " << strerror(errno) << "\n";
+        failures++;
+    }
+    return fd;
+}
+
+/**
+ * the whole lines waiting in "fd", the rest stays in "pending". "closed" is
+ * set when the other side is gone.
+ */
+static std::vector<std::string> readLines(int fd, std::string &pending,
+                                          bool *closed = nullptr) {
+    char buf[4096];
+    ssize_t r;
+    while ((r = recv(fd, buf, sizeof(buf), 0)) > 0) {
+        pending.append(buf, r);
+    }
+    if (closed) {
+        *closed = r == 0;
+    }
+    std::vector<std::string> lines;
+    size_t end;
+    while ((end = pending.find('\n')) != std::string::npos) {
+        lines.push_back(pending.substr(0, end));
+        pending.erase(0, end + 1);
+    }
+    return lines;
+}
+
+int main(int argc, char *argv[]) {
+    ndlcom::Bridge bridge;
+    const std::string label = "udp://\"host\"\\&\n\t\x01\x7f";
+    bridge.createExternalInterface<ExternalInterfaceNull>(label)
+        .lock()
+        ->setRoutingForDeviceId(7);
+
+    // a snapshot, written and parsed again
+    std::ostringstream ss;
+    ndlcom::writeMetricsJson(ss, bridge.getMetrics());
+    CHECK(ss.str().find('\n') == std::string::npos);
+    JsonParser parser(ss.str());
+    const Json json = parser.parseDocument();
+    CHECK(parser.ok);
+    CHECK(json.type == Json::OBJECT);
+    CHECK(json["timestamp"].type == Json::NUMBER);
+    CHECK(json["timestamp"].number > 1e9);
+    CHECK(json["sendQueueDropped"].number == 0);
+    CHECK(json["interfaces"].array.size() == 1);
+    CHECK(json["missEvents"].type == Json::ARRAY);
+    if (json["interfaces"].array.size() == 1) {
+        const Json &interface = json["interfaces"].array[0];
+        CHECK(interface["label"].string == label);
+        CHECK(interface["paused"].type == Json::BOOL);
+        CHECK(interface["connected"].boolean);
+        CHECK(interface["bytesTx"].type == Json::NUMBER);
+        CHECK(interface["lastOutageMs"].number == 0);
+    }
+    bool routed = false;
+    for (const auto &it : json["routing"].array) {
+        if (it["deviceId"].number == 7) {
+            routed = true;
+            CHECK(it["interface"].string == label);
+        }
+    }
+    CHECK(routed);
+
+    // now over the socket
+    const std::string path =
+        "/tmp/ndlcomTestMetrics-" + std::to_string(getpid()) + ".sock";
+    ndlcom::MetricsServer server(bridge, path, std::chrono::milliseconds(0));
+    int good = connectTo(path);
+    int slow = connectTo(path);
+    server.process();
+    CHECK(server.getClientCount() == 2);
+    std::string pending;
+    std::vector<std::string> lines = readLines(good, pending);
+    CHECK(!lines.empty());
+    for (const auto &line : lines) {
+        JsonParser lineParser(line);
+        lineParser.parseDocument();
+        CHECK(lineParser.ok);
+    }
+
+    // "slow" does not read, and fills up at some point
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    unsigned int received = 0;
+    while (server.getClientCount() == 2 &&
+           std::chrono::steady_clock::now() < deadline) {
+        server.process();
+        received += readLines(good, pending).size();
+    }
+    CHECK(server.getClientCount() == 1);
+    CHECK(received > 0);
+    // what it got is whole lines only, then the end
+    std::string slowPending;
+    bool closed = false;
+    lines = readLines(slow, slowPending, &closed);
+    CHECK(closed);
+    CHECK(!lines.empty());
+    CHECK(slowPending.empty());
+    if (!lines.empty()) {
+        JsonParser lineParser(lines.back());
+        lineParser.parseDocument();
+        CHECK(lineParser.ok);
+    }
+    // while the other one goes on
+    server.process();
+    CHECK(readLines(good, pending).size() == 1);
+    close(slow);
+    close(good);
+
+    return checkResult();
+}
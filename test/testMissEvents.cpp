@@ -0,0 +1,113 @@
+/**
+ * @file test/testMissEvents.cpp
+ * @brief checks the bookkeeping of ndlcom::BridgeMissEvents
+ *
+ * Packets with handcrafted packet counters are sent through a bridge without
+ * any interfaces, so that only the registered BridgeMissEvents sees them.
+ * Covers the first-seen case, gaps, late packets, counter wraparound, growing
+ * of the internal table and the windowed loss rate.
+ */
+#include "ndlcom/Bridge.hpp"
+#include "ndlcom/BridgeHandler.hpp"
+
+#include "Check.h"
+
+#include <cmath>
+#include <iostream>
+
+static void send(ndlcom::Bridge &bridge, NDLComId sender, NDLComId receiver,
+                 NDLComCounter counter) {
+    struct NDLComHeader header;
+    header.mSenderId = sender;
+    header.mReceiverId = receiver;
+    header.mCounter = counter;
+    header.mDataLen = 0;
+    bridge.sendMessageRaw(&header, nullptr);
+}
+
+static unsigned long
+missEventsOf(const std::vector<struct ndlcom::MissEventMetrics> &events,
+             NDLComId sender, NDLComId receiver) {
+    for (auto it : events) {
+        if (it.senderId == sender && it.receiverId == receiver) {
+            return it.missEvents;
+        }
+    }
+    return 0;
+}
+
+static unsigned long missEventsOf(const ndlcom::BridgeMissEvents &handler,
+                                  NDLComId sender, NDLComId receiver) {
+    return missEventsOf(handler.getMissEvents(), sender, receiver);
+}
+
+int main(int argc, char *argv[]) {
+    ndlcom::Bridge bridge;
+    std::shared_ptr<ndlcom::BridgeMissEvents> handler =
+        bridge.createBridgeHandler<ndlcom::BridgeMissEvents>().lock();
+
+    // first packet of a pair never counts, whatever its counter is
+    send(bridge, 1, 2, 17);
+    for (int i = 18; i < 300; ++i) {
+        send(bridge, 1, 2, i);
+    }
+    CHECK(handler->getMissEvents().empty());
+
+    // a gap of two packets, and a late one afterwards
+    send(bridge, 1, 2, 47);
+    send(bridge, 1, 2, 45);
+    CHECK(missEventsOf(*handler, 1, 2) == 2);
+    CHECK(missEventsOf(*handler, 2, 1) == 0);
+
+    // broadcasts from a sender are ignored
+    send(bridge, NDLCOM_ADDR_BROADCAST, 2, 0);
+    send(bridge, NDLCOM_ADDR_BROADCAST, 2, 5);
+    CHECK(handler->getMissEvents().size() == 1);
+
+    // fill in a lot of pairs to force the table to grow several times. each
+    // one gets one miss-event for every receiver which is a multiple of 7
+    for (int s = 10; s < 80; ++s) {
+        for (int r = 0; r < 255; ++r) {
+            send(bridge, s, r, 0);
+            send(bridge, s, r, 1);
+            send(bridge, s, r, r % 7 ? 2 : 3);
+        }
+    }
+    std::vector<struct ndlcom::MissEventMetrics> events =
+        handler->getMissEvents();
+    CHECK(events.size() == 1 + 70 * 37);
+    for (auto it : events) {
+        if (it.senderId >= 10 && it.senderId < 80) {
+            CHECK(it.receiverId % 7 == 0 && it.missEvents == 1);
+        }
+    }
+    // and the previous pair survived the rehashing
+    CHECK(missEventsOf(*handler, 1, 2) == 2);
+
+    // loss rate: windows of 10 received packets with one gap of 10, so that
+    // 10 out of 20 expected packets in the last window are lost
+    handler->setWindowSize(10);
+    handler->resetMissEvents();
+    CHECK(handler->getMissEvents().empty());
+    NDLComCounter counter = 0;
+    send(bridge, 3, 4, counter);
+    // wraps around the 8bit counter a few times
+    for (int i = 1; i < 1000; ++i) {
+        send(bridge, 3, 4, ++counter);
+    }
+    counter += 10;
+    for (int i = 0; i < 10; ++i) {
+        send(bridge, 3, 4, ++counter);
+    }
+    CHECK(missEventsOf(*handler, 3, 4) == 1);
+    for (auto it : handler->getMissEvents()) {
+        if (it.senderId == 3 && it.receiverId == 4) {
+            CHECK(std::fabs(it.lossRate - 0.5) < 0.001);
+            CHECK(it.reorderRate == 0.);
+        }
+    }
+
+    handler->printStatus("");
+
+    return checkResult();
+}
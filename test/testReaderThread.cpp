@@ -0,0 +1,168 @@
+/**
+ * @file test/testReaderThread.cpp
+ * @brief checks the reader thread of ndlcom::ExternalInterfaceBase
+ *
+ * An interface on one end of a socketpair is read by its own thread, pinned
+ * to the first core. Packets written into the other end in chunks of odd
+ * sizes have to arrive in the bridge complete and in order, also when more
+ * than fits into the ring is waiting. The file descriptor seen by the bridge
+ * has to become readable when there is data. An error in the reader thread
+ * has to show up in the thread calling the bridge.
+ */
+#include "ndlcom/Bridge.hpp"
+#include "ndlcom/BridgeHandler.hpp"
+#include "ndlcom/Encoder.h"
+#include "ndlcom/ExternalInterfaceBase.hpp"
+
+#include "Check.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+/** reads one end of a socketpair, can be told to fail */
+class ExternalInterfaceSocket : public ndlcom::ExternalInterfaceBase {
+  public:
+    ExternalInterfaceSocket(struct NDLComBridge &bridge, int _fd)
+        : ndlcom::ExternalInterfaceBase(bridge, "socket"), fd(_fd),
+          fail(false) {}
+
+    size_t writeEscapedBytes(const void *buf, size_t count) override {
+        return count;
+    }
+    size_t readEscapedBytes(void *buf, size_t count) override {
+        if (fail) {
+            reportRuntimeError("told to fail", __FILE__, __LINE__);
+        }
+        ssize_t r = read(fd, buf, count);
+        return r > 0 ? r : 0;
+    }
+    int getPollFd() const override { return fd; }
+
+    const int fd;
+    std::atomic<bool> fail;
+};
+
+/** checks the counter of every message */
+class BridgeHandlerCount : public ndlcom::BridgeHandler {
+  public:
+    BridgeHandlerCount(struct NDLComBridge &bridge)
+        : ndlcom::BridgeHandler(bridge, "count"), count(0), outOfOrder(0) {}
+    void handle(const struct NDLComHeader *header, const void *payload,
+                const struct NDLComExternalInterface *origin) override {
+        if (header->mCounter != (uint8_t)count ||
+            memcmp(payload, &count, sizeof(count)) != 0) {
+            outOfOrder++;
+        }
+        count++;
+    }
+    unsigned int count;
+    unsigned int outOfOrder;
+};
+
+int main(int argc, char *argv[]) {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1) {
+        std::cerr << "socketpair() failed: " << strerror(errno) << "\n";
+        return EXIT_FAILURE;
+    }
+    fcntl(fds[1], F_SETFL, O_NONBLOCK);
+
+    ndlcom::Bridge bridge;
+    std::shared_ptr<ExternalInterfaceSocket> interface =
+        bridge.createExternalInterface<ExternalInterfaceSocket>(fds[1]).lock();
+    std::shared_ptr<BridgeHandlerCount> handler =
+        bridge.createBridgeHandler<BridgeHandlerCount>().lock();
+
+    CHECK(!interface->hasReaderThread());
+    CHECK(interface->setOption("cpu", "0"));
+    CHECK(interface->hasReaderThread());
+
+    // more than the ring and the socket buffers hold, written from another
+    // thread while the bridge is processed
+    const unsigned int packets =
+        3 * ndlcom::ExternalInterfaceBase::readerRingSize / 64;
+    std::thread writer([&]() {
+        std::vector<uint8_t> stream;
+        uint8_t encoded[NDLCOM_MAX_ENCODED_MESSAGE_SIZE];
+        uint8_t payload[40];
+        struct NDLComHeader header;
+        header.mSenderId = 1;
+        header.mReceiverId = 2;
+        header.mDataLen = sizeof(payload);
+        for (unsigned int i = 0; i < packets; ++i) {
+            header.mCounter = i;
+            memset(payload, 0, sizeof(payload));
+            memcpy(payload, &i, sizeof(i));
+            const size_t len =
+                ndlcomEncode(encoded, sizeof(encoded), &header, payload);
+            stream.insert(stream.end(), encoded, encoded + len);
+        }
+        size_t pos = 0;
+        while (pos < stream.size()) {
+            ssize_t r = write(fds[0], stream.data() + pos,
+                              std::min<size_t>(777, stream.size() - pos));
+            if (r > 0) {
+                pos += r;
+            }
+        }
+    });
+
+    // wait like a bridge using "poll()" would
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    struct pollfd ufd;
+    ufd.fd = interface->getWakeupFd();
+    ufd.events = POLLIN;
+    CHECK(ufd.fd != -1 && ufd.fd != fds[1]);
+    while (handler->count < packets &&
+           std::chrono::steady_clock::now() < deadline) {
+        poll(&ufd, 1, 100);
+        bridge.process();
+    }
+    writer.join();
+    CHECK(handler->count == packets);
+    CHECK(handler->outOfOrder == 0);
+    CHECK(interface->bytesReceived > 0);
+
+    // drained, so the eventfd is not readable anymore
+    CHECK(poll(&ufd, 1, 0) == 0);
+
+    // the error of the reader thread is thrown by the bridge
+    interface->fail = true;
+    CHECK(write(fds[0], "x", 1) == 1);
+    bool thrown = false;
+    while (!thrown && std::chrono::steady_clock::now() < deadline) {
+        try {
+            bridge.process();
+        } catch (const std::runtime_error &e) {
+            thrown = strstr(e.what(), "told to fail") != nullptr;
+        }
+    }
+    CHECK(thrown);
+    CHECK(!interface->hasReaderThread());
+
+    // and can be started again, stopped when the interface goes away
+    interface->fail = false;
+    interface->startReaderThread();
+    CHECK(interface->hasReaderThread());
+    bridge.destroyExternalInterface(
+        std::weak_ptr<ExternalInterfaceSocket>(interface));
+    CHECK(!interface->hasReaderThread());
+    CHECK(interface->getWakeupFd() == fds[1]);
+    interface.reset();
+
+    close(fds[0]);
+    close(fds[1]);
+
+    return checkResult();
+}
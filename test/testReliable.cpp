@@ -0,0 +1,185 @@
+/**
+ * @file test/testReliable.cpp
+ * @brief checks ndlcom::NodeHandlerReliable over a lossy connection
+ *
+ * Two bridges are coupled by a pair of in-memory interfaces which drop a
+ * given percentage of the written packets in both directions. Node 1 sends a
+ * numbered sequence of messages to node 2, which has to receive every one of
+ * them exactly once and in order. Normal unreliable traffic is sent in
+ * between and has to pass untouched.
+ *
+ * call using:
+ *
+ *   ./testReliable [numberOfMessages] [lossPercent] [seed]
+ */
+#include "ndlcom/Bridge.hpp"
+#include "ndlcom/ExternalInterfaceBase.hpp"
+#include "ndlcom/Node.hpp"
+#include "ndlcom/NodeHandlerReliable.hpp"
+
+#include <string.h>
+#include <chrono>
+#include <deque>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+/** the shared state of both ends of the connection */
+struct LossyLink {
+    std::deque<uint8_t> queue[2];
+    std::mt19937 rng;
+    int lossPercent;
+    unsigned long dropped;
+};
+
+/**
+ * every call to "writeEscapedBytes()" is one whole encoded packet, also when
+ * the bridge writes batches, so dropping a write drops exactly one packet.
+ */
+class ExternalInterfaceLossy : public ndlcom::ExternalInterfaceBase {
+  public:
+    ExternalInterfaceLossy(struct NDLComBridge &bridge,
+                           std::shared_ptr<struct LossyLink> _link, int _side)
+        : ndlcom::ExternalInterfaceBase(bridge,
+                                        "lossy-" + std::to_string(_side)),
+          link(_link), side(_side) {}
+
+    size_t writeEscapedBytes(const void *buf, size_t count) override {
+        // lost on the line, not in the interface
+        if ((int)(link->rng() % 100) < link->lossPercent) {
+            link->dropped++;
+            return count;
+        }
+        const uint8_t *bytes = static_cast<const uint8_t *>(buf);
+        link->queue[1 - side].insert(link->queue[1 - side].end(), bytes,
+                                     bytes + count);
+        return count;
+    }
+    size_t readEscapedBytes(void *buf, size_t count) override {
+        std::deque<uint8_t> &q = link->queue[side];
+        count = std::min(count, q.size());
+        std::copy(q.begin(), q.begin() + count, static_cast<uint8_t *>(buf));
+        q.erase(q.begin(), q.begin() + count);
+        return count;
+    }
+
+  private:
+    std::shared_ptr<struct LossyLink> link;
+    const int side;
+};
+
+class NodeHandlerReliableCollect : public ndlcom::NodeHandlerReliable {
+  public:
+    NodeHandlerReliableCollect(struct NDLComNode &node)
+        : ndlcom::NodeHandlerReliable(node, 8, std::chrono::milliseconds(2),
+                                      50) {}
+    void handleReliable(const NDLComId senderId, const void *payload,
+                        const size_t length) override {
+        uint32_t number;
+        memcpy(&number, payload, sizeof(number));
+        received.push_back(number);
+    }
+    std::vector<uint32_t> received;
+};
+
+class NodeHandlerCountPlain : public ndlcom::NodeHandler {
+  public:
+    NodeHandlerCountPlain(struct NDLComNode &node)
+        : ndlcom::NodeHandler(node, "NodeHandlerCountPlain"), count(0) {}
+    void handle(const struct NDLComHeader *header, const void *payload,
+                const struct NDLComExternalInterface *origin) override {
+        if (header->mDataLen && *(const uint8_t *)payload == 0x42) {
+            count++;
+        }
+    }
+    unsigned long count;
+};
+
+int main(int argc, char *argv[]) {
+    const uint32_t numberOfMessages = argc > 1 ? std::stoul(argv[1]) : 1000;
+    const int lossPercent = argc > 2 ? std::stoi(argv[2]) : 20;
+    const unsigned int seed = argc > 3 ? std::stoul(argv[3]) : 4711;
+
+    std::shared_ptr<struct LossyLink> link(new LossyLink());
+    link->rng.seed(seed);
+    link->lossPercent = lossPercent;
+    link->dropped = 0;
+
+    ndlcom::Bridge bridgeA;
+    ndlcom::Bridge bridgeB;
+    bridgeA.createExternalInterface<ExternalInterfaceLossy>(link, 0);
+    bridgeB.createExternalInterface<ExternalInterfaceLossy>(link, 1);
+
+    std::shared_ptr<ndlcom::Node> nodeA = bridgeA.createNode<ndlcom::Node>(1).lock();
+    std::shared_ptr<ndlcom::Node> nodeB = bridgeB.createNode<ndlcom::Node>(2).lock();
+    std::shared_ptr<NodeHandlerReliableCollect> sender =
+        nodeA->createNodeHandler<NodeHandlerReliableCollect>().lock();
+    std::shared_ptr<NodeHandlerReliableCollect> receiver =
+        nodeB->createNodeHandler<NodeHandlerReliableCollect>().lock();
+    std::shared_ptr<NodeHandlerCountPlain> plain =
+        nodeB->createNodeHandler<NodeHandlerCountPlain>().lock();
+
+    const std::chrono::time_point<std::chrono::steady_clock> deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds(60);
+    uint32_t next = 0;
+    unsigned long plainSent = 0;
+    while (receiver->received.size() < numberOfMessages &&
+           std::chrono::steady_clock::now() < deadline) {
+        while (next < numberOfMessages &&
+               sender->sendReliable(2, &next, sizeof(next))) {
+            next++;
+        }
+        // unreliable traffic in between, with a first byte not used by the
+        // reliable layer
+        const uint8_t plainPayload[] = {0x42, 0x00};
+        nodeA->send(2, plainPayload, sizeof(plainPayload));
+        plainSent++;
+
+        bridgeA.process();
+        bridgeB.process();
+        sender->process();
+        receiver->process();
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+
+    sender->printStatus("");
+    receiver->printStatus("");
+    std::cerr << "link dropped " << link->dropped << " packets\n";
+
+    int failures = 0;
+    if (receiver->received.size() != numberOfMessages) {
+        std::cerr << "received " << receiver->received.size() << " of "
+                  << numberOfMessages << " messages\n";
+        failures++;
+    }
+    for (size_t i = 0; i < receiver->received.size(); ++i) {
+        if (receiver->received[i] != i) {
+            std::cerr << "message " << i << " has wrong number "
+                      << receiver->received[i] << "\n";
+            failures++;
+            break;
+        }
+    }
+    if (sender->messagesFailed) {
+        std::cerr << "sender gave up on " << sender->messagesFailed
+                  << " messages\n";
+        failures++;
+    }
+    // the plain messages are not repeated, so some of them are lost
+    if (plain->count == 0 || plain->count > plainSent) {
+        std::cerr << "plain messages: got " << plain->count << " of "
+                  << plainSent << "\n";
+        failures++;
+    }
+    if (!receiver->received.empty() && receiver->received.size() !=
+                                           receiver->messagesDelivered) {
+        failures++;
+    }
+
+    if (failures) {
+        return EXIT_FAILURE;
+    }
+    std::cerr << "all " << numberOfMessages << " messages delivered in order\n";
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,158 @@
+/**
+ * @file test/testSendQueue.c
+ * @brief checks the send queue of "struct NDLComBridge"
+ *
+ * A handler answers every message by sending the next one, and one message
+ * leads to several answers. Without a queue this nests deeper and deeper into
+ * the handlers. With a queue the handlers are never entered twice, see the
+ * messages in the order they were sent and every message is still written to
+ * the interface. Messages not fitting into a full queue are counted, and
+ * reported to the handler sending them.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ndlcom/Bridge.h"
+#include "ndlcom/BridgeHandler.h"
+#include "ndlcom/ExternalInterface.h"
+#include "ndlcom/Types.h"
+
+#include "Check.h"
+
+#define NUMBER_OF_MESSAGES 40
+
+struct Responder {
+    struct NDLComBridge *bridge;
+    /* every message with a counter below "last" is answered */
+    int last;
+    /* answers to every message */
+    int answers;
+    int depth;
+    int maxDepth;
+    int seen;
+    int answered;
+    /* answers ndlcomBridgeSendRaw() did not take */
+    int refused;
+    uint8_t order[4 * NUMBER_OF_MESSAGES];
+};
+
+static size_t nothingToRead(void *context, void *buf, const size_t count) {
+    return 0;
+}
+
+static void countWrites(void *context, const void *buf, const size_t count) {
+    (*(int *)context)++;
+}
+
+static void respond(void *context, const struct NDLComHeader *header,
+                    const void *payload,
+                    const struct NDLComExternalInterface *origin) {
+    struct Responder *responder = (struct Responder *)context;
+    struct NDLComHeader answer = *header;
+    int i;
+
+    responder->depth++;
+    if (responder->depth > responder->maxDepth) {
+        responder->maxDepth = responder->depth;
+    }
+    if (responder->seen < (int)sizeof(responder->order)) {
+        responder->order[responder->seen] = header->mCounter;
+    }
+    responder->seen++;
+    /* the payload is the counter, it has to survive the queue */
+    CHECK(((const uint8_t *)payload)[0] == header->mCounter);
+
+    if (header->mCounter < responder->last) {
+        responder->answered++;
+        for (i = 0; i < responder->answers; ++i) {
+            answer.mCounter = header->mCounter + 1 + i;
+            if (!ndlcomBridgeSendRaw(responder->bridge, &answer,
+                                     &answer.mCounter)) {
+                responder->refused++;
+            }
+        }
+    }
+    responder->depth--;
+}
+
+/* starts the chain with one message, returns the number of writes */
+static int runChain(struct NDLComBridgeQueuedMessage *slots, size_t count,
+                    struct Responder *responder) {
+    struct NDLComBridge bridge;
+    struct NDLComExternalInterface externalInterface;
+    struct NDLComBridgeHandler handler;
+    struct NDLComHeader header;
+    int writes = 0;
+
+    ndlcomBridgeInit(&bridge);
+    ndlcomBridgeSetSendQueue(&bridge, slots, count);
+    ndlcomExternalInterfaceInit(&externalInterface, countWrites, nothingToRead,
+                                NDLCOM_EXTERNAL_INTERFACE_FLAGS_DEFAULT,
+                                &writes);
+    ndlcomBridgeRegisterExternalInterface(&bridge, &externalInterface);
+    ndlcomBridgeHandlerInit(&handler, respond,
+                            NDLCOM_BRIDGE_HANDLER_FLAGS_DEFAULT, responder);
+    ndlcomBridgeRegisterBridgeHandler(&bridge, &handler);
+
+    responder->bridge = &bridge;
+    responder->depth = 0;
+    responder->maxDepth = 0;
+    responder->seen = 0;
+    responder->answered = 0;
+    responder->refused = 0;
+    header.mSenderId = 1;
+    header.mReceiverId = 2;
+    header.mCounter = 0;
+    header.mDataLen = 1;
+    ndlcomBridgeSendRaw(&bridge, &header, &header.mCounter);
+
+    CHECK(bridge.sendQueueUsed == 0);
+    CHECK(bridge.dispatching == 0);
+    CHECK((size_t)responder->refused == bridge.sendQueueDropped);
+    /* every message sent was either seen or dropped */
+    CHECK((size_t)responder->seen + bridge.sendQueueDropped ==
+          (size_t)(1 + responder->answered * responder->answers));
+    return writes;
+}
+
+int main(int argc, char *argv[]) {
+    struct NDLComBridgeQueuedMessage slots[4];
+    struct Responder responder;
+    int writes, i;
+
+    /* a chain of answers, nested without a queue */
+    responder.last = NUMBER_OF_MESSAGES;
+    responder.answers = 1;
+    writes = runChain(0, 0, &responder);
+    CHECK(writes == NUMBER_OF_MESSAGES + 1);
+    CHECK(responder.seen == NUMBER_OF_MESSAGES + 1);
+    CHECK(responder.maxDepth == NUMBER_OF_MESSAGES + 1);
+
+    /* the same chain in a loop. two slots are enough, the one being handled
+     * and the answer */
+    writes = runChain(slots, 2, &responder);
+    CHECK(writes == NUMBER_OF_MESSAGES + 1);
+    CHECK(responder.seen == NUMBER_OF_MESSAGES + 1);
+    CHECK(responder.maxDepth == 1);
+    for (i = 0; i < responder.seen; ++i) {
+        CHECK(responder.order[i] == i);
+    }
+
+    /* three answers each: breadth first, in the order they were sent */
+    responder.last = 3;
+    responder.answers = 3;
+    writes = runChain(slots, 4, &responder);
+    CHECK(responder.maxDepth == 1);
+    CHECK(writes == responder.seen);
+    CHECK(responder.order[0] == 0);
+    CHECK(responder.order[1] == 1);
+    CHECK(responder.order[2] == 2);
+    CHECK(responder.order[3] == 3);
+    CHECK(responder.order[4] == 2);
+    /* the queue was too small for all of them */
+    CHECK(responder.seen < 1 + 3 * responder.answered);
+
+    return checkResult();
+}
@@ -0,0 +1,117 @@
+/**
+ * @file test/testSerialOptions.cpp
+ * @brief checks the uri options of ndlcom::ExternalInterfaceSerial
+ *
+ * A pseudo terminal stands in for the serial port. The read thresholds and
+ * the flow control given as options have to show up in the settings of the
+ * terminal, unknown flow control modes are an error. The usb-serial options
+ * are not available on a pty and must not fail. A written request answered
+ * by the other side has to be counted as round-trip.
+ */
+#include "ndlcom/Bridge.hpp"
+#include "ndlcom/Encoder.h"
+#include "ndlcom/ExternalInterface.hpp"
+
+#include "Check.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+
+int main(int argc, char *argv[]) {
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+        std::cerr << "no pty: " << strerror(errno) << "\n";
+        return EXIT_FAILURE;
+    }
+    fcntl(master, F_SETFL, O_NONBLOCK);
+    const std::string slaveName = ptsname(master);
+    // opened before the interface takes exclusive access, to look at the
+    // settings of the terminal
+    int slave = open(slaveName.c_str(), O_RDWR | O_NOCTTY);
+    CHECK(slave != -1);
+
+    ndlcom::Bridge bridge;
+    std::shared_ptr<ndlcom::ExternalInterfaceSerial> serial =
+        bridge
+            .createExternalInterface<ndlcom::ExternalInterfaceSerial>(
+                slaveName, 115200)
+            .lock();
+    struct termios2 tio;
+
+    CHECK(serial->setOption("vmin", "1"));
+    CHECK(serial->setOption("vtime", "2"));
+    CHECK(ioctl(slave, TCGETS2, &tio) == 0);
+    CHECK(tio.c_cc[VMIN] == 1);
+    CHECK(tio.c_cc[VTIME] == 2);
+
+    CHECK(serial->setOption("flow", "rtscts"));
+    CHECK(ioctl(slave, TCGETS2, &tio) == 0);
+    CHECK(tio.c_cflag & CRTSCTS);
+    CHECK(serial->setOption("flow", "xonxoff"));
+    CHECK(ioctl(slave, TCGETS2, &tio) == 0);
+    CHECK(!(tio.c_cflag & CRTSCTS));
+    CHECK((tio.c_iflag & (IXON | IXOFF)) == (IXON | IXOFF));
+    CHECK(serial->setOption("flow", "none"));
+    CHECK(ioctl(slave, TCGETS2, &tio) == 0);
+    CHECK(!(tio.c_iflag & (IXON | IXOFF)));
+    bool thrown = false;
+    try {
+        serial->setOption("flow", "carrier-pigeon");
+    } catch (const std::runtime_error &e) {
+        thrown = true;
+    }
+    CHECK(thrown);
+
+    // a pty is no usb-serial adapter, only a note is printed
+    CHECK(serial->setOption("lowlatency", ""));
+    CHECK(serial->setOption("latency", "1"));
+
+    // a request, and the answer from the other side
+    CHECK(serial->roundTrips == 0);
+    struct NDLComHeader header;
+    uint8_t payload[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+    uint8_t encoded[NDLCOM_MAX_ENCODED_MESSAGE_SIZE];
+    header.mSenderId = 1;
+    header.mReceiverId = 2;
+    header.mCounter = 0;
+    header.mDataLen = sizeof(payload);
+    bridge.sendMessageRaw(&header, payload);
+    CHECK(serial->bytesTransmitted > 0);
+
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    ssize_t r = -1;
+    while (r <= 0 && std::chrono::steady_clock::now() < deadline) {
+        r = read(master, encoded, sizeof(encoded));
+    }
+    CHECK(r > 0);
+    header.mSenderId = 2;
+    header.mReceiverId = 1;
+    const size_t len = ndlcomEncode(encoded, sizeof(encoded), &header, payload);
+    CHECK(write(master, encoded, len) == (ssize_t)len);
+    while (serial->bytesReceived < len &&
+           std::chrono::steady_clock::now() < deadline) {
+        bridge.process();
+    }
+    CHECK(serial->bytesReceived == len);
+    CHECK(serial->roundTrips == 1);
+    CHECK(serial->roundTripMin == serial->roundTripMax);
+    CHECK(serial->roundTripSum == serial->roundTripMin);
+    bridge.printStatus();
+
+    bridge.destroyExternalInterface(
+        std::weak_ptr<ndlcom::ExternalInterfaceSerial>(serial));
+    serial.reset();
+    close(slave);
+    close(master);
+
+    return checkResult();
+}
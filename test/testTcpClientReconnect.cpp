@@ -0,0 +1,283 @@
+/**
+ * @file test/testTcpClientReconnect.cpp
+ * @brief checks connecting and reconnecting of ndlcom::ExternalInterfaceTcpClient
+ *
+ * A client created for a port nobody listens on must neither block nor throw,
+ * and keeps the messages given to it, up to its queue size. Once a server
+ * appears the client connects on its own, and the queued messages arrive in
+ * order, followed by new ones. Messages from the server reach the bridge. The
+ * server dropping the connection is noted, the client comes back, counts the
+ * outage and delivers what was sent meanwhile.
+ *
+ * A framed client must forget a message cut by a dropped connection, the
+ * messages of the next one have to arrive unharmed. Once as it is, once with
+ * io_uring and a reader thread, which keep waiting on the same descriptor.
+ */
+#include "ndlcom/Bridge.hpp"
+#include "ndlcom/BridgeHandler.hpp"
+#include "ndlcom/Encoder.h"
+#include "ndlcom/ExternalInterface.hpp"
+#include "ndlcom/Parser.h"
+
+#include "Check.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+/** counts the messages seen by the bridge, keeps the counters of sender 3 */
+class BridgeHandlerCount : public ndlcom::BridgeHandler {
+  public:
+    BridgeHandlerCount(struct NDLComBridge &bridge)
+        : ndlcom::BridgeHandler(bridge, "count"), count(0) {}
+    void handle(const struct NDLComHeader *header, const void *payload,
+                const struct NDLComExternalInterface *origin) override {
+        count++;
+        if (header->mSenderId == 3) {
+            fromThree.push_back(header->mCounter);
+        }
+    }
+    unsigned int count;
+    std::vector<uint8_t> fromThree;
+};
+
+/** a listening socket on "port", or on any free one if 0 */
+static int listenOn(unsigned int port) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (fd == -1 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1 ||
+        listen(fd, 4) == -1) {
+        std::cerr << "listen() failed: " << strerror(errno) << "\n";
+        failures++;
+    }
+    return fd;
+}
+
+static unsigned int portOf(int fd) {
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    getsockname(fd, (struct sockaddr *)&addr, &len);
+    return ntohs(addr.sin_port);
+}
+
+/** the counters of the messages read from "fd" */
+static std::vector<uint8_t> receive(int fd, struct NDLComParser *parser) {
+    std::vector<uint8_t> counters;
+    uint8_t buf[4096];
+    ssize_t r;
+    while ((r = recv(fd, buf, sizeof(buf), 0)) > 0) {
+        const uint8_t *pos = buf;
+        while (r > 0) {
+            size_t used = ndlcomParserReceive(parser, pos, r);
+            pos += used;
+            r -= used;
+            if (ndlcomParserHasPacket(parser)) {
+                counters.push_back(ndlcomParserGetHeader(parser)->mCounter);
+                ndlcomParserDestroyPacket(parser);
+            }
+        }
+    }
+    return counters;
+}
+
+int main(int argc, char *argv[]) {
+    // a port which is free right now
+    int listener = listenOn(0);
+    const unsigned int port = portOf(listener);
+    close(listener);
+
+    ndlcom::Bridge bridge;
+    const auto start = std::chrono::steady_clock::now();
+    std::shared_ptr<ndlcom::ExternalInterfaceTcpClient> client =
+        std::dynamic_pointer_cast<ndlcom::ExternalInterfaceTcpClient>(
+            bridge
+                .createInterface("tcpclient://localhost:" +
+                                 std::to_string(port) +
+                                 "&retry=10&retrymax=40&txqueue=10")
+                .lock());
+    CHECK(client);
+    if (!client) {
+        return EXIT_FAILURE;
+    }
+    CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(1));
+    std::shared_ptr<BridgeHandlerCount> count =
+        bridge.createBridgeHandler<BridgeHandlerCount>().lock();
+    bridge.process();
+    CHECK(!client->isConnected());
+    CHECK(!client->getMetrics().connected);
+
+    // more than the queue holds, the newer ones are lost
+    struct NDLComHeader header;
+    uint8_t payload[100];
+    memset(payload, 0x55, sizeof(payload));
+    header.mSenderId = 1;
+    header.mReceiverId = 2;
+    header.mDataLen = sizeof(payload);
+    for (unsigned int i = 0; i < 15; ++i) {
+        header.mCounter = i;
+        bridge.sendMessageRaw(&header, payload);
+    }
+    CHECK(client->bytesDropped > 0);
+    CHECK(client->getTxQueueDepth() > 0);
+
+    // the server comes up, the client finds it
+    listener = listenOn(port);
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (!client->isConnected() &&
+           std::chrono::steady_clock::now() < deadline) {
+        bridge.process();
+    }
+    CHECK(client->isConnected());
+    CHECK(client->reconnects == 0);
+    int server = -1;
+    while (server == -1 && std::chrono::steady_clock::now() < deadline) {
+        server = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK);
+    }
+    CHECK(server != -1);
+    header.mCounter = 15;
+    bridge.sendMessageRaw(&header, payload);
+
+    uint8_t parserBuffer[sizeof(struct NDLComParser)];
+    struct NDLComParser *parser =
+        ndlcomParserCreate(parserBuffer, sizeof(parserBuffer));
+    std::vector<uint8_t> counters;
+    while (counters.size() < 11 && std::chrono::steady_clock::now() < deadline) {
+        bridge.process();
+        std::vector<uint8_t> got = receive(server, parser);
+        counters.insert(counters.end(), got.begin(), got.end());
+    }
+    std::vector<uint8_t> expected = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 15};
+    CHECK(counters == expected);
+    CHECK(client->getTxQueueDepth() == 0);
+
+    // the other direction
+    uint8_t encoded[NDLCOM_MAX_ENCODED_MESSAGE_SIZE];
+    header.mSenderId = 2;
+    header.mReceiverId = 1;
+    size_t len = ndlcomEncode(encoded, sizeof(encoded), &header, payload);
+    CHECK(send(server, encoded, len, 0) == (ssize_t)len);
+    // the handler also saw the ones sent by the bridge itself
+    const unsigned int before = count->count;
+    while (count->count == before &&
+           std::chrono::steady_clock::now() < deadline) {
+        bridge.process();
+    }
+    CHECK(count->count == before + 1);
+    CHECK(client->bytesReceived == len);
+
+    // the server drops the connection, messages sent meanwhile are kept
+    close(server);
+    while (client->isConnected() &&
+           std::chrono::steady_clock::now() < deadline) {
+        bridge.process();
+    }
+    header.mSenderId = 1;
+    header.mReceiverId = 2;
+    header.mCounter = 16;
+    bridge.sendMessageRaw(&header, payload);
+    while (client->reconnects == 0 &&
+           std::chrono::steady_clock::now() < deadline) {
+        bridge.process();
+    }
+    CHECK(client->reconnects == 1);
+    CHECK(client->isConnected());
+    CHECK(client->longestOutage >= client->lastOutage);
+    CHECK(client->getMetrics().reconnects == 1);
+    server = -1;
+    while (server == -1 && std::chrono::steady_clock::now() < deadline) {
+        server = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK);
+    }
+    CHECK(server != -1);
+    counters.clear();
+    while (counters.empty() && std::chrono::steady_clock::now() < deadline) {
+        bridge.process();
+        counters = receive(server, parser);
+    }
+    CHECK(counters.size() == 1 && counters.front() == 16);
+    bridge.printStatus();
+
+    bridge.destroyExternalInterface(
+        std::weak_ptr<ndlcom::ExternalInterfaceTcpClient>(client));
+    client.reset();
+    close(server);
+
+    // framed, with a message cut in the middle
+    header.mSenderId = 3;
+    header.mReceiverId = 1;
+    for (const char *options : {"&framed", "&framed&uring&thread"}) {
+        const auto framedDeadline =
+            std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        std::shared_ptr<ndlcom::ExternalInterfaceTcpClient> framed =
+            std::dynamic_pointer_cast<ndlcom::ExternalInterfaceTcpClient>(
+                bridge
+                    .createInterface("tcpclient://localhost:" +
+                                     std::to_string(port) + "&retry=10" +
+                                     options)
+                    .lock());
+        CHECK(framed);
+        if (!framed) {
+            break;
+        }
+        server = -1;
+        while (server == -1 &&
+               std::chrono::steady_clock::now() < framedDeadline) {
+            bridge.process();
+            server = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK);
+        }
+        CHECK(server != -1);
+        header.mCounter = 19;
+        len = ndlcomEncodeFramed(encoded, sizeof(encoded), &header, payload, 0);
+        CHECK(send(server, encoded, len / 2, 0) == (ssize_t)(len / 2));
+        while (framed->bytesReceived < len / 2 &&
+               std::chrono::steady_clock::now() < framedDeadline) {
+            bridge.process();
+        }
+        CHECK(framed->bytesReceived == len / 2);
+        close(server);
+        while (framed->reconnects == 0 &&
+               std::chrono::steady_clock::now() < framedDeadline) {
+            bridge.process();
+        }
+        CHECK(framed->reconnects == 1);
+        server = -1;
+        while (server == -1 &&
+               std::chrono::steady_clock::now() < framedDeadline) {
+            server = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK);
+        }
+        CHECK(server != -1);
+        count->fromThree.clear();
+        for (uint8_t counter : {20, 21}) {
+            header.mCounter = counter;
+            len = ndlcomEncodeFramed(encoded, sizeof(encoded), &header,
+                                     payload, 0);
+            CHECK(send(server, encoded, len, 0) == (ssize_t)len);
+        }
+        while (count->fromThree.size() < 2 &&
+               std::chrono::steady_clock::now() < framedDeadline) {
+            bridge.process();
+        }
+        expected = {20, 21};
+        CHECK(count->fromThree == expected);
+
+        bridge.destroyExternalInterface(
+            std::weak_ptr<ndlcom::ExternalInterfaceTcpClient>(framed));
+        close(server);
+    }
+    close(listener);
+
+    return checkResult();
+}
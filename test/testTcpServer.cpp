@@ -0,0 +1,217 @@
+/**
+ * @file test/testTcpServer.cpp
+ * @brief checks ndlcom::ExternalInterfaceTcpServer and its clients
+ *
+ * Many connections to a server on localhost become interfaces of their own.
+ * A message of each of them is seen with a single call to the bridge, and
+ * teaches the routing table so that the answer goes only to this client. A
+ * client not reading anymore gets its buffer filled up, then whole messages
+ * are dropped for it, while the others are not disturbed. A closed client is
+ * removed. The bridge counts and lists the clients like its own interfaces.
+ */
+#include "ndlcom/Bridge.hpp"
+#include "ndlcom/BridgeHandler.hpp"
+#include "ndlcom/Encoder.h"
+#include "ndlcom/ExternalInterface.hpp"
+#include "ndlcom/Parser.h"
+
+#include "Check.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+/** counts the messages seen by the bridge */
+class BridgeHandlerCount : public ndlcom::BridgeHandler {
+  public:
+    BridgeHandlerCount(struct NDLComBridge &bridge)
+        : ndlcom::BridgeHandler(bridge, "count"), count(0) {}
+    void handle(const struct NDLComHeader *header, const void *payload,
+                const struct NDLComExternalInterface *origin) override {
+        count++;
+    }
+    unsigned int count;
+};
+
+static int connectTo(unsigned int port) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    // small, so that a client not reading is noticed soon
+    int size = 4096;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    if (fd == -1 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+        std::cerr << "connect() failed: " << strerror(errno) << "\n";
+        failures++;
+    }
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    return fd;
+}
+
+/** a client parsing what it reads */
+struct Client {
+    int fd;
+    uint8_t parserBuffer[sizeof(struct NDLComParser)];
+    struct NDLComParser *parser;
+    unsigned int messages;
+    unsigned int wrongReceiver;
+};
+
+static void receive(struct Client &client, NDLComId receiverId) {
+    uint8_t buf[4096];
+    ssize_t r;
+    while ((r = recv(client.fd, buf, sizeof(buf), 0)) > 0) {
+        const uint8_t *pos = buf;
+        while (r > 0) {
+            size_t used = ndlcomParserReceive(client.parser, pos, r);
+            pos += used;
+            r -= used;
+            if (ndlcomParserHasPacket(client.parser)) {
+                if (ndlcomParserGetHeader(client.parser)->mReceiverId !=
+                    receiverId) {
+                    client.wrongReceiver++;
+                }
+                client.messages++;
+                ndlcomParserDestroyPacket(client.parser);
+            }
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    ndlcom::Bridge bridge;
+    std::shared_ptr<ndlcom::ExternalInterfaceTcpServer> server =
+        std::dynamic_pointer_cast<ndlcom::ExternalInterfaceTcpServer>(
+            bridge.createInterface("tcpserver://localhost:0&txbuffer=8192")
+                .lock());
+    CHECK(server);
+    if (!server) {
+        return EXIT_FAILURE;
+    }
+    std::shared_ptr<BridgeHandlerCount> count =
+        bridge.createBridgeHandler<BridgeHandlerCount>().lock();
+
+    const unsigned int clientCount = 60;
+    std::vector<struct Client> clients(clientCount);
+    for (auto &client : clients) {
+        client.fd = connectTo(server->getPort());
+        client.parser = ndlcomParserCreate(client.parserBuffer,
+                                           sizeof(client.parserBuffer));
+        client.messages = 0;
+        client.wrongReceiver = 0;
+    }
+    bridge.process();
+    CHECK(server->getClients().size() == clientCount);
+
+    // every client is another deviceId
+    struct NDLComHeader header;
+    uint8_t payload[200];
+    uint8_t encoded[NDLCOM_MAX_ENCODED_MESSAGE_SIZE];
+    memset(payload, 0x55, sizeof(payload));
+    header.mReceiverId = 1;
+    header.mCounter = 0;
+    header.mDataLen = sizeof(payload);
+    for (unsigned int i = 0; i < clientCount; ++i) {
+        header.mSenderId = 10 + i;
+        const size_t len =
+            ndlcomEncode(encoded, sizeof(encoded), &header, payload);
+        CHECK(send(clients[i].fd, encoded, len, 0) == (ssize_t)len);
+    }
+    bridge.process();
+    CHECK(count->count == clientCount);
+
+    // the bridge knows the clients like its own interfaces, and where the
+    // routing table points to
+    CHECK(bridge.getInterfaceCount() == clientCount + 1);
+    struct ndlcom::BridgeMetrics metrics = bridge.getMetrics();
+    CHECK(metrics.interfaces.size() == clientCount + 1);
+    CHECK(metrics.routing.size() == clientCount);
+    for (const auto &entry : metrics.routing) {
+        CHECK(entry.interface.compare(0, server->label.size() + 1,
+                                      server->label + "#") == 0);
+        CHECK(bridge.getInterfaceByName(entry.interface).lock());
+    }
+
+    // forwarded to all others, as nobody knows about deviceId 1
+    for (unsigned int i = 0; i < clientCount; ++i) {
+        receive(clients[i], 1);
+        CHECK(clients[i].messages == clientCount - 1);
+        clients[i].messages = 0;
+    }
+
+    // the answers go to the one asking
+    header.mSenderId = 1;
+    for (unsigned int i = 0; i < clientCount; ++i) {
+        header.mReceiverId = 10 + i;
+        bridge.sendMessageRaw(&header, payload);
+    }
+    for (unsigned int i = 0; i < clientCount; ++i) {
+        receive(clients[i], 10 + i);
+        CHECK(clients[i].messages == 1);
+        CHECK(clients[i].wrongReceiver == 0);
+        clients[i].messages = 0;
+    }
+
+    // the first one stops reading. the socket and the buffer fill up and
+    // messages are lost, only for this client. the payload is escaped to
+    // twice its size, to get beyond the socket buffers quicker
+    std::shared_ptr<ndlcom::ExternalInterfaceTcpServerClient> slow =
+        server->getClients().front().lock();
+    memset(payload, NDLCOM_START_STOP_FLAG, sizeof(payload));
+    const unsigned int messages = 40000;
+    for (unsigned int i = 0; i < messages; ++i) {
+        header.mReceiverId = 10 + i % 2;
+        bridge.sendMessageRaw(&header, payload);
+        bridge.process();
+        receive(clients[1], 11);
+    }
+    CHECK(clients[1].messages == messages / 2);
+    CHECK(slow->bytesDropped > 0);
+    CHECK(slow->getTxQueueDepth() > 0);
+    CHECK(server->getClients()[1].lock()->bytesDropped == 0);
+    // only whole messages where lost
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (slow->getTxQueueDepth() > 0 &&
+           std::chrono::steady_clock::now() < deadline) {
+        receive(clients[0], 10);
+        bridge.process();
+    }
+    receive(clients[0], 10);
+    CHECK(clients[0].messages > 0);
+    CHECK(clients[0].messages < messages / 2);
+    CHECK(clients[0].wrongReceiver == 0);
+    CHECK(ndlcomParserGetNumberOfCRCFails(clients[0].parser) == 0);
+    slow.reset();
+
+    // closed ones go away
+    close(clients[0].fd);
+    close(clients[1].fd);
+    while (server->getClients().size() > clientCount - 2 &&
+           std::chrono::steady_clock::now() < deadline) {
+        bridge.process();
+    }
+    CHECK(server->getClients().size() == clientCount - 2);
+    CHECK(!server->setOption("thread", ""));
+    CHECK(!server->getClients().front().lock()->setOption("thread", ""));
+
+    bridge.destroyExternalInterface(
+        std::weak_ptr<ndlcom::ExternalInterfaceTcpServer>(server));
+    server.reset();
+    CHECK(bridge.getInterfaceCount() == 0);
+    for (unsigned int i = 2; i < clientCount; ++i) {
+        close(clients[i].fd);
+    }
+
+    return checkResult();
+}
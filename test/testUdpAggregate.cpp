@@ -0,0 +1,158 @@
+/**
+ * @file test/testUdpAggregate.cpp
+ * @brief checks the aggregation of frames into datagrams of ExternalInterfaceUdp
+ *
+ * Two bridges are connected over udp on localhost. Many small messages sent
+ * by the aggregating one arrive complete and in order at the other one, in a
+ * handful of datagrams instead of one each. A single message waits until its
+ * timer expired while the bridge is processed. The poll descriptor wakes up
+ * a bridge waiting for it when the timer expired. Framed interfaces still send
+ * one message per datagram, and reader threads are refused.
+ */
+#include "ndlcom/Bridge.hpp"
+#include "ndlcom/BridgeHandler.hpp"
+#include "ndlcom/ExternalInterface.hpp"
+
+#include "Check.h"
+
+#include <poll.h>
+
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+/** remembers the counters of the messages from outside */
+class BridgeHandlerCounters : public ndlcom::BridgeHandler {
+  public:
+    BridgeHandlerCounters(struct NDLComBridge &bridge)
+        : ndlcom::BridgeHandler(bridge, "counters") {}
+    void handle(const struct NDLComHeader *header, const void *payload,
+                const struct NDLComExternalInterface *origin) override {
+        if (origin) {
+            counters.push_back(header->mCounter);
+        }
+    }
+    std::vector<uint8_t> counters;
+};
+
+/** processes "receiver" until it saw "count" messages, or some time passed */
+static void receive(ndlcom::Bridge &receiver, BridgeHandlerCounters &handler,
+                    size_t count) {
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (handler.counters.size() < count &&
+           std::chrono::steady_clock::now() < deadline) {
+        receiver.process();
+    }
+}
+
+int main(int argc, char *argv[]) {
+    ndlcom::Bridge sender;
+    ndlcom::Bridge receiver;
+    std::shared_ptr<ndlcom::ExternalInterfaceUdp> udp =
+        std::dynamic_pointer_cast<ndlcom::ExternalInterfaceUdp>(
+            sender
+                .createInterface(
+                    "udp://localhost:34110:34111&aggregate=1400,50ms")
+                .lock());
+    CHECK(udp);
+    if (!udp) {
+        return EXIT_FAILURE;
+    }
+    CHECK(udp->aggregateSize == 1400);
+    CHECK(udp->aggregateDelay == std::chrono::milliseconds(50));
+    receiver.createInterface("udp://localhost:34111:34110");
+    std::shared_ptr<BridgeHandlerCounters> handler =
+        receiver.createBridgeHandler<BridgeHandlerCounters>().lock();
+
+    // 300 messages of some 12 bytes each fit into three datagrams
+    struct NDLComHeader header;
+    uint8_t payload[4] = {1, 2, 3, 4};
+    header.mSenderId = 1;
+    header.mReceiverId = 2;
+    header.mDataLen = sizeof(payload);
+    const unsigned int messages = 300;
+    for (unsigned int i = 0; i < messages; ++i) {
+        header.mCounter = i;
+        sender.sendMessageRaw(&header, payload);
+    }
+    CHECK(udp->datagramsTransmitted > 0);
+    CHECK(udp->datagramsTransmitted < 5);
+    // the rest goes out when the timer expired
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (udp->getTxQueueDepth() > 0 &&
+           std::chrono::steady_clock::now() < deadline) {
+        sender.process();
+    }
+    receive(receiver, *handler, messages);
+    CHECK(handler->counters.size() == messages);
+    for (unsigned int i = 0; i < handler->counters.size(); ++i) {
+        CHECK(handler->counters[i] == (uint8_t)i);
+    }
+    CHECK(udp->datagramsTransmitted < 5);
+    CHECK(udp->bytesDropped == 0);
+
+    // a single message waits for its timer
+    handler->counters.clear();
+    const unsigned long datagrams = udp->datagramsTransmitted;
+    const auto sent = std::chrono::steady_clock::now();
+    sender.sendMessageRaw(&header, payload);
+    sender.process();
+    CHECK(udp->datagramsTransmitted == datagrams);
+    while (udp->datagramsTransmitted == datagrams &&
+           std::chrono::steady_clock::now() < deadline) {
+        sender.process();
+    }
+    CHECK(std::chrono::steady_clock::now() - sent >=
+          std::chrono::milliseconds(50));
+    CHECK(udp->datagramsTransmitted == datagrams + 1);
+    receive(receiver, *handler, 1);
+    CHECK(handler->counters.size() == 1);
+
+    // the same, but only processing when woken up
+    handler->counters.clear();
+    const auto waiting = std::chrono::steady_clock::now();
+    sender.sendMessageRaw(&header, payload);
+    struct pollfd pfd = {udp->getWakeupFd(), POLLIN, 0};
+    CHECK(poll(&pfd, 1, 0) == 0);
+    CHECK(poll(&pfd, 1, 5000) == 1);
+    CHECK(std::chrono::steady_clock::now() - waiting >=
+          std::chrono::milliseconds(50));
+    sender.process();
+    CHECK(udp->datagramsTransmitted == datagrams + 2);
+    CHECK(poll(&pfd, 1, 0) == 0);
+    receive(receiver, *handler, 1);
+    CHECK(handler->counters.size() == 1);
+
+    // without a delay every write is one datagram
+    CHECK(udp->setOption("aggregate", "1400,0us"));
+    sender.sendMessageRaw(&header, payload);
+    CHECK(udp->datagramsTransmitted == datagrams + 3);
+
+    // framed interfaces need one message per datagram
+    CHECK(udp->setOption("framed", ""));
+    for (unsigned int i = 0; i < 3; ++i) {
+        sender.sendMessageRaw(&header, payload);
+    }
+    CHECK(udp->datagramsTransmitted == datagrams + 6);
+
+    bool thrown = false;
+    try {
+        udp->setOption("thread", "");
+    } catch (const std::runtime_error &e) {
+        thrown = true;
+    }
+    CHECK(thrown);
+    thrown = false;
+    try {
+        udp->setOption("aggregate", "1400,3fortnights");
+    } catch (const std::runtime_error &e) {
+        thrown = true;
+    }
+    CHECK(thrown);
+    sender.printStatus();
+
+    return checkResult();
+}
@@ -0,0 +1,204 @@
+/**
+ * @file test/testUdpMulticast.cpp
+ * @brief checks ndlcom::ExternalInterfaceUdpMulticast
+ *
+ * A bridge sends into a multicast group, where two listening sockets and a
+ * second bridge on this host get every message, sent only once. The sending
+ * bridge does not read its own datagrams back. Messages sent to the group and
+ * to the unicast reply port reach the bridge. Without loop, listeners on
+ * this host see nothing. The reply port cannot be changed under a reader
+ * thread. Skipped if the host has no route for multicast.
+ */
+#include "ndlcom/Bridge.hpp"
+#include "ndlcom/BridgeHandler.hpp"
+#include "ndlcom/Encoder.h"
+#include "ndlcom/ExternalInterface.hpp"
+
+#include "Check.h"
+
+#include <errno.h>
+#include <string.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+
+static const char *groupAddress = "239.255.42.99";
+static const unsigned int groupPort = 34120;
+static const unsigned int replyPort = 34121;
+
+/** counts the messages from outside */
+class BridgeHandlerCount : public ndlcom::BridgeHandler {
+  public:
+    BridgeHandlerCount(struct NDLComBridge &bridge)
+        : ndlcom::BridgeHandler(bridge, "count"), count(0) {}
+    void handle(const struct NDLComHeader *header, const void *payload,
+                const struct NDLComExternalInterface *origin) override {
+        if (origin) {
+            count++;
+        }
+    }
+    unsigned int count;
+};
+
+/** a listener joined to the group, like a gui would be */
+static int listener() {
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    const int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(groupPort);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    struct ip_mreq mreq;
+    memset(&mreq, 0, sizeof(mreq));
+    mreq.imr_multiaddr.s_addr = inet_addr(groupAddress);
+    mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1 ||
+        setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) ==
+            -1) {
+        std::cerr << "listener failed: " << strerror(errno) << "\n";
+        failures++;
+    }
+    return fd;
+}
+
+/** number of datagrams arriving at "fd" within a short time */
+static unsigned int datagrams(int fd) {
+    unsigned int count = 0;
+    uint8_t buf[NDLCOM_MAX_ENCODED_MESSAGE_SIZE];
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(200);
+    while (std::chrono::steady_clock::now() < deadline) {
+        if (recv(fd, buf, sizeof(buf), 0) > 0) {
+            count++;
+        }
+    }
+    return count;
+}
+
+/** processes "bridge" until "handler" counted "count", or some time passed */
+static void receive(ndlcom::Bridge &bridge, BridgeHandlerCount &handler,
+                    unsigned int count) {
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (handler.count < count &&
+           std::chrono::steady_clock::now() < deadline) {
+        bridge.process();
+    }
+}
+
+int main(int argc, char *argv[]) {
+    // without a route no multicast leaves this process
+    struct sockaddr_in group;
+    memset(&group, 0, sizeof(group));
+    group.sin_family = AF_INET;
+    group.sin_port = htons(groupPort);
+    group.sin_addr.s_addr = inet_addr(groupAddress);
+    int probe = socket(AF_INET, SOCK_DGRAM, 0);
+    if (connect(probe, (struct sockaddr *)&group, sizeof(group)) == -1) {
+        std::cerr << "no multicast route, skipped: " << strerror(errno)
+                  << "\n";
+        close(probe);
+        return EXIT_SUCCESS;
+    }
+    close(probe);
+
+    ndlcom::Bridge sender;
+    ndlcom::Bridge other;
+    std::shared_ptr<ndlcom::ExternalInterfaceUdpMulticast> mc =
+        std::dynamic_pointer_cast<ndlcom::ExternalInterfaceUdpMulticast>(
+            sender
+                .createInterface("udpmc://" + std::string(groupAddress) + ":" +
+                                 std::to_string(groupPort) +
+                                 "&ttl=0&reply=" + std::to_string(replyPort))
+                .lock());
+    CHECK(mc);
+    if (!mc) {
+        return EXIT_FAILURE;
+    }
+    other.createInterface("udpmc://" + std::string(groupAddress) + ":" +
+                          std::to_string(groupPort) + "&ttl=0");
+    std::shared_ptr<BridgeHandlerCount> senderCount =
+        sender.createBridgeHandler<BridgeHandlerCount>().lock();
+    std::shared_ptr<BridgeHandlerCount> otherCount =
+        other.createBridgeHandler<BridgeHandlerCount>().lock();
+    int a = listener();
+    int b = listener();
+
+    // once on the wire, seen by everybody in the group
+    struct NDLComHeader header;
+    uint8_t payload[20];
+    memset(payload, 0x42, sizeof(payload));
+    header.mSenderId = 1;
+    header.mReceiverId = 2;
+    header.mCounter = 0;
+    header.mDataLen = sizeof(payload);
+    sender.sendMessageRaw(&header, payload);
+    uint8_t encoded[NDLCOM_MAX_ENCODED_MESSAGE_SIZE];
+    const size_t len = ndlcomEncode(encoded, sizeof(encoded), &header, payload);
+    CHECK(mc->bytesTransmitted == len);
+    CHECK(datagrams(a) == 1);
+    CHECK(datagrams(b) == 1);
+    receive(other, *otherCount, 1);
+    CHECK(otherCount->count == 1);
+    // but not by the sender itself
+    receive(sender, *senderCount, 1);
+    CHECK(senderCount->count == 0);
+    CHECK(mc->bytesReceived == 0);
+
+    // an answer into the group, and one to the reply port
+    header.mSenderId = 2;
+    header.mReceiverId = 1;
+    ndlcomEncode(encoded, sizeof(encoded), &header, payload);
+    CHECK(sendto(a, encoded, len, 0, (struct sockaddr *)&group,
+                 sizeof(group)) == (ssize_t)len);
+    struct sockaddr_in reply;
+    memset(&reply, 0, sizeof(reply));
+    reply.sin_family = AF_INET;
+    reply.sin_port = htons(replyPort);
+    reply.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    CHECK(sendto(a, encoded, len, 0, (struct sockaddr *)&reply,
+                 sizeof(reply)) == (ssize_t)len);
+    receive(sender, *senderCount, 2);
+    CHECK(senderCount->count == 2);
+    // the answer into the group went to "b" as well, and back to "a"
+    CHECK(datagrams(b) == 1);
+    CHECK(datagrams(a) == 1);
+
+    // nothing for this host without loop
+    CHECK(mc->setOption("loop", "0"));
+    header.mSenderId = 1;
+    header.mReceiverId = 2;
+    sender.sendMessageRaw(&header, payload);
+    CHECK(datagrams(a) == 0);
+    CHECK(mc->bytesTransmitted == 2 * len);
+
+    bool thrown = false;
+    try {
+        sender.createInterface("udpmc://192.168.0.1");
+    } catch (const std::runtime_error &e) {
+        thrown = true;
+    }
+    CHECK(thrown);
+
+    // the reader thread would read the old socket
+    mc->startReaderThread();
+    thrown = false;
+    try {
+        mc->setOption("reply", std::to_string(replyPort));
+    } catch (const std::runtime_error &e) {
+        thrown = true;
+    }
+    CHECK(thrown);
+    mc->stopReaderThread();
+
+    close(a);
+    close(b);
+
+    return checkResult();
+}
@@ -0,0 +1,206 @@
+/**
+ * @file test/testUnixServer.cpp
+ * @brief checks ndlcom::ExternalInterfaceUnixServer and its clients
+ *
+ * Two processes -- here two sockets of this one -- connect to the server and
+ * become interfaces of their own, with their credentials known. A message
+ * from one of them teaches the routing table, so the answer goes only to this
+ * client, every message in one packet. Broadcasts go to both. Packets which
+ * do not fit into the socket of a client wait in its queue. A closed client
+ * is removed, a client of a user not allowed is refused. A stale socket file
+ * is replaced, one in use is not.
+ */
+#include "ndlcom/Bridge.hpp"
+#include "ndlcom/BridgeHandler.hpp"
+#include "ndlcom/Encoder.h"
+#include "ndlcom/ExternalInterface.hpp"
+#include "ndlcom/Parser.h"
+
+#include "Check.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+
+/** counts the messages seen by the bridge */
+class BridgeHandlerCount : public ndlcom::BridgeHandler {
+  public:
+    BridgeHandlerCount(struct NDLComBridge &bridge)
+        : ndlcom::BridgeHandler(bridge, "count"), count(0) {}
+    void handle(const struct NDLComHeader *header, const void *payload,
+                const struct NDLComExternalInterface *origin) override {
+        count++;
+    }
+    unsigned int count;
+};
+
+static int connectTo(const std::string &path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path.c_str(), path.size());
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK, 0);
+    if (fd == -1 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+        std::cerr << "connect() failed: " << strerror(errno) << "\n";
+        failures++;
+    }
+    return fd;
+}
+
+/** the number of messages in the packets waiting in "fd" */
+static unsigned int receive(int fd, NDLComId receiverId) {
+    uint8_t packet[NDLCOM_MAX_ENCODED_MESSAGE_SIZE * 2];
+    uint8_t parserBuffer[sizeof(struct NDLComParser)];
+    struct NDLComParser *parser =
+        ndlcomParserCreate(parserBuffer, sizeof(parserBuffer));
+    unsigned int messages = 0;
+    ssize_t r;
+    while ((r = recv(fd, packet, sizeof(packet), 0)) > 0) {
+        // exactly one message in each packet
+        ndlcomParserReceive(parser, packet, r);
+        CHECK(ndlcomParserHasPacket(parser));
+        if (ndlcomParserHasPacket(parser)) {
+            CHECK(ndlcomParserGetHeader(parser)->mReceiverId == receiverId);
+            ndlcomParserDestroyPacket(parser);
+            messages++;
+        }
+    }
+    return messages;
+}
+
+int main(int argc, char *argv[]) {
+    const std::string path =
+        "/tmp/ndlcomTestUnixServer-" + std::to_string(getpid()) + ".sock";
+    ndlcom::Bridge bridge;
+    std::shared_ptr<ndlcom::ExternalInterfaceUnixServer> server =
+        std::dynamic_pointer_cast<ndlcom::ExternalInterfaceUnixServer>(
+            bridge.createInterface("unix://" + path + "&mode=0600&txqueue=4096")
+                .lock());
+    CHECK(server);
+    if (!server) {
+        return EXIT_FAILURE;
+    }
+    std::shared_ptr<BridgeHandlerCount> count =
+        bridge.createBridgeHandler<BridgeHandlerCount>().lock();
+
+    int a = connectTo(path);
+    int b = connectTo(path);
+    bridge.process();
+    CHECK(server->getClients().size() == 2);
+    std::shared_ptr<ndlcom::ExternalInterfaceUnixClient> clientA =
+        server->getClients().front().lock();
+    CHECK(clientA->credentials.pid == getpid());
+    CHECK(clientA->credentials.uid == getuid());
+
+    // "a" is deviceId 5
+    struct NDLComHeader header;
+    uint8_t payload[100];
+    uint8_t encoded[NDLCOM_MAX_ENCODED_MESSAGE_SIZE];
+    memset(payload, 0x7e, sizeof(payload));
+    header.mSenderId = 5;
+    header.mReceiverId = 1;
+    header.mCounter = 0;
+    header.mDataLen = sizeof(payload);
+    size_t len = ndlcomEncode(encoded, sizeof(encoded), &header, payload);
+    CHECK(send(a, encoded, len, 0) == (ssize_t)len);
+    bridge.process();
+    CHECK(count->count == 1);
+    CHECK(clientA->bytesReceived == len);
+    // the bridge knows where deviceId 5 is
+    CHECK(bridge.getInterfaceCount() == 3);
+    struct ndlcom::BridgeMetrics metrics = bridge.getMetrics();
+    CHECK(metrics.interfaces.size() == 3);
+    CHECK(metrics.routing.size() == 1);
+    CHECK(metrics.routing.front().deviceId == 5);
+    CHECK(metrics.routing.front().interface == clientA->label);
+    // and was forwarded to "b", nobody knows where deviceId 1 is
+    CHECK(receive(b, 1) == 1);
+
+    // the answer only goes to "a", the broadcast to both
+    header.mSenderId = 1;
+    header.mReceiverId = 5;
+    bridge.sendMessageRaw(&header, payload);
+    CHECK(receive(a, 5) == 1);
+    CHECK(receive(b, 5) == 0);
+    header.mReceiverId = NDLCOM_ADDR_BROADCAST;
+    bridge.sendMessageRaw(&header, payload);
+    CHECK(receive(a, NDLCOM_ADDR_BROADCAST) == 1);
+    CHECK(receive(b, NDLCOM_ADDR_BROADCAST) == 1);
+
+    // "a" does not read for a while, more than the socket holds
+    header.mReceiverId = 5;
+    const unsigned int sent = 2000;
+    for (unsigned int i = 0; i < sent; ++i) {
+        bridge.sendMessageRaw(&header, payload);
+        bridge.process();
+    }
+    CHECK(clientA->getTxQueueDepth() > 0);
+    CHECK(clientA->bytesDropped == 0);
+    unsigned int received = 0;
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (received < sent && std::chrono::steady_clock::now() < deadline) {
+        received += receive(a, 5);
+        bridge.process();
+    }
+    CHECK(received == sent);
+
+    // "b" goes away, and with it its interface
+    close(b);
+    bridge.process();
+    CHECK(server->getClients().size() == 1);
+
+    // users not allowed are refused
+    CHECK(server->setOption("uid", std::to_string(getuid() + 1)));
+    b = connectTo(path);
+    bridge.process();
+    CHECK(server->getClients().size() == 1);
+    uint8_t byte;
+    CHECK(recv(b, &byte, 1, 0) == 0);
+    close(b);
+    CHECK(server->setOption("gid", std::to_string(getgid())));
+    b = connectTo(path);
+    bridge.process();
+    CHECK(server->getClients().size() == 2);
+    close(b);
+
+    // the thread of the bridge has to do the reading, also for the clients
+    CHECK(!server->setOption("thread", ""));
+    CHECK(!clientA->setOption("thread", ""));
+    bridge.printStatus();
+
+    // the socket file is removed, and the clients with the server
+    bridge.destroyExternalInterface(
+        std::weak_ptr<ndlcom::ExternalInterfaceUnixServer>(server));
+    server.reset();
+    clientA.reset();
+    CHECK(access(path.c_str(), F_OK) == -1);
+    CHECK(bridge.getInterfaceCount() == 0);
+    close(a);
+
+    // a file left by a crashed process is no problem
+    int stale = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path.c_str(), path.size());
+    CHECK(bind(stale, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    close(stale);
+    CHECK(!bridge.createInterface("unix://" + path).expired());
+    // but one in use is
+    bool thrown = false;
+    try {
+        bridge.createInterface("unix://" + path);
+    } catch (const std::runtime_error &e) {
+        thrown = true;
+    }
+    CHECK(thrown);
+
+    return checkResult();
+}
@@ -71,9 +71,12 @@ class ExampleHandler final : public ndlcom::NodeHandler {
         /* at first do some printing */
         printf("message from 0x%02x with %i bytes",
                header->mSenderId, (int)header->mDataLen);
-        if (origin) {
-            printf(" from %s\n",
-                   bridge.getInterfaceByOrigin(origin).lock()->label.c_str());
+        std::shared_ptr<ndlcom::ExternalInterfaceBase> interface =
+            bridge.getInterfaceByOrigin(origin).lock();
+        if (interface) {
+            printf(" from %s\n", interface->label.c_str());
+        } else if (origin) {
+            printf(" from an unknown interface\n");
         } else {
             printf(" from internal\n");
         }
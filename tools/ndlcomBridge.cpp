@@ -24,10 +24,14 @@
 #include "ndlcom/Node.h"
 
 #include "ndlcom/BridgeHandler.hpp"
+#include "ndlcom/Metrics.hpp"
 #include "ndlcom/NodeHandler.hpp"
 
 class ndlcom::Bridge bridge;
 
+std::string metricsSocket;
+long metricsInterval_ms = 1000;
+
 bool stopMainLoop = false;
 
 double mainLoopFrequency_hz = 1000.0;
@@ -49,15 +53,19 @@ void help(const char *_name) {
 "\n"
 "DeviceIds which are reachable behind an interfrace can be appended in the form '&id1,id2,id3' to the interface description. Thus it is possible to preconfigure the internal routing table in known environments\n"
 "\n"
+"Options for an interface can be appended in the same way, as '&key' or '&key=value'. Known options: 'compress' to compress payloads on slow links, needs the same option on the other side of the link. 'batch=N' to write up to N messages at once (default: 16, 0 disables). 'thread' to read the interface in a thread of its own, 'cpu=N' and 'prio=N' pin this thread to core N and give it SCHED_FIFO priority N. 'mlock' locks all memory of the process. 'uring' reads and writes serial, pty, udp and tcp interfaces through io_uring, if the kernel supports it. 'framed' sends plain messages without escaping, for udp or other transports keeping message boundaries, 'framed=crc' adds the crc. Needs the same option on the other side. Serial ports also know 'lowlatency', 'latency=MS' for the latency timer of usb-serial adapters, 'vmin=N', 'vtime=N' and 'flow=none|rtscts|xonxoff'. A 'unix' socket accepts local processes as interfaces of their own, limited by 'uid=N', 'gid=N' and 'mode=0660'. A 'tcpserver' does the same for tcp connections, buffering up to 'txbuffer=N' bytes for each of them. A 'tcpclient' reconnects after 'retry=MS', doubled up to 'retrymax=MS', and keeps up to 'txqueue=N' messages meanwhile. A 'udp' interface packs messages into datagrams with 'aggregate=BYTES,TIMEus', sent when full or after TIME (default: 1400,200us), not together with 'thread'. BYTES must fit the read buffer of the other side, 4096 for the tools. A 'udpmc' interface sends once into a multicast group, with 'ttl=N' (default: 1), 'loop=0' to exclude listeners on this host, and 'reply=PORT' for answers by unicast. A 'can' interface counts its frames to notice lost ones, 'raw' sends plain bytes for older peers\n"
+"\n"
 "options:\n"
-"--uri\t\t-u\tInterface to create. Possible: 'fpga', 'serial', 'pty', 'pipe', 'udp'\n"
+"--uri\t\t-u\tInterface to create. Possible: 'fpga', 'serial', 'pty', 'pipe', 'udp', 'udpmc', 'tcpclient', 'tcpserver', 'unix'\n"
 "--mirrorUri\t-m\tMirror interface to create, otherwise the same as in '--uri'\n"
 "--ownDeviceId\t-i\tCreates and adds a node to the bridge listening to this deviceId\n"
 "--frequency\t-f\tPolling of the main-loop in Hz\n"
 "--print-all\t-A\tPrint every packet\n"
 "--print-own\t-O\tPrint packets directed at the given 'deviceId'\n"
 "--print-miss\t-M\tPrint miss events of packets passing thorugh the bridge\n"
-"--realtime\t-R\ttry to obtain realtime scheduling. needs root.\n"
+"--realtime\t-R\ttry to obtain realtime scheduling for the whole process. needs root.\n"
+"--metrics-socket\t-S\tExport metrics as one line of JSON per interval on this unix socket\n"
+"--metrics-interval\t-T\tInterval of the metrics export in ms (default: 1000)\n"
 "\n"
 "examples:\n"
 "\n"
@@ -96,8 +104,21 @@ void help(const char *_name) {
 "route from one hex-encoded pipe to another, print all passing packages:\n"
 "\n"
 "\t%s -u pipe://pipeA -u pipe://pipeB -A\n"
+"\n"
+"export metrics every 5s, count miss events, read a snapshot with socat:\n"
+"\n"
+"\t%s -u udp://localhost:34000:34001 -M -S /tmp/ndlcom.metrics -T 5000\n"
+"\tsocat -u UNIX-CONNECT:/tmp/ndlcom.metrics - | head -n1\n"
+"\n"
+"compress payloads on a slow serial line, deviceIds 2 and 3 are behind it:\n"
+"\n"
+"\t%s -u \"serial:///dev/ttyUSB0:115200&2,3&compress\" -u udp://localhost:34000:34001\n"
+"\n"
+"read a serial link to motor controllers on an isolated core, logging at normal priority:\n"
+"\n"
+"\t%s -u \"serial:///dev/ttyUSB0:921600&latency=1&lowlatency&cpu=2&prio=80&mlock\" -m pipe://log\n"
 ,
-actualName.c_str(), name.c_str(), name.c_str(), name.c_str(), name.c_str(), name.c_str(), name.c_str());
+actualName.c_str(), name.c_str(), name.c_str(), name.c_str(), name.c_str(), name.c_str(), name.c_str(), name.c_str(), name.c_str(), name.c_str());
 }
 /* clang-format on */
 
@@ -137,9 +158,11 @@ int main(int argc, char *argv[]) {
             {"print-own", required_argument, 0, 'O'},
             {"print-miss", no_argument, 0, 'M'},
             {"realtime", no_argument, 0, 'R'},
+            {"metrics-socket", required_argument, 0, 'S'},
+            {"metrics-interval", required_argument, 0, 'T'},
             {"help", no_argument, 0, 'h'},
             {0, 0, 0, 0}};
-        c = getopt_long(argc, argv, "u:m:i:f:AO:MRh", long_options,
+        c = getopt_long(argc, argv, "u:m:i:f:AO:MRS:T:h", long_options,
                         &option_index);
         if (c == -1) {
             break;
@@ -203,6 +226,19 @@ int main(int argc, char *argv[]) {
             }
             break;
         }
+        case 'S': {
+            metricsSocket = optarg;
+            break;
+        }
+        case 'T': {
+            std::istringstream ss(optarg);
+            ss >> metricsInterval_ms;
+            if (metricsInterval_ms <= 0) {
+                std::cerr << "invalid metrics interval: '" << optarg << "'\n";
+                exit(EXIT_FAILURE);
+            }
+            break;
+        }
         case 'h':
         case '?':
         default:
@@ -224,6 +260,13 @@ int main(int argc, char *argv[]) {
     std::cerr << "using update rate of " << mainLoopFrequency_hz
               << "Hz (update every " << sleepTime.count() << "us)\n\n";
 
+    std::unique_ptr<ndlcom::MetricsServer> metrics;
+    if (!metricsSocket.empty()) {
+        metrics.reset(new ndlcom::MetricsServer(
+            bridge, metricsSocket,
+            std::chrono::milliseconds(metricsInterval_ms)));
+    }
+
     bridge.printStatus();
 
     std::chrono::time_point<std::chrono::high_resolution_clock> nextProcessing =
@@ -236,6 +279,11 @@ int main(int argc, char *argv[]) {
         // check for keyboard-input to create a cheap user-interface
         handleInput();
 
+        // never blocks, slow scrapers are disconnected
+        if (metrics) {
+            metrics->process();
+        }
+
         // take care that we sleep enough, but not too long
         nextProcessing += sleepTime;
         std::this_thread::sleep_until(nextProcessing);
@@ -243,5 +291,8 @@ int main(int argc, char *argv[]) {
 
     std::cerr << "quitting\n";
 
+    // "exit()" does not unwind the stack, remove the socket file here
+    metrics.reset();
+
     exit(EXIT_SUCCESS);
 }